@@ -51,6 +51,7 @@ namespace DBoW2
 
 #include "TemplatedVocabulary.h"
 #include "TemplatedDatabase.h"
+#include "MappedVocabulary.h"
 #include "BowVector.h"
 #include "FeatureVector.h"
 #include "QueryResults.h"
@@ -61,6 +62,10 @@ namespace DBoW2
 typedef DBoW2::TemplatedVocabulary<DBoW2::FORB::TDescriptor, DBoW2::FORB> 
   OrbVocabulary;
 
+/// ORB Vocabulary mapped from a binary file
+typedef DBoW2::TemplatedMappedVocabulary<DBoW2::FORB::TDescriptor, DBoW2::FORB>
+  OrbMappedVocabulary;
+
 /// FORB Database
 typedef DBoW2::TemplatedDatabase<DBoW2::FORB::TDescriptor, DBoW2::FORB> 
   OrbDatabase;
@@ -69,6 +74,10 @@ typedef DBoW2::TemplatedDatabase<DBoW2::FORB::TDescriptor, DBoW2::FORB>
 typedef DBoW2::TemplatedVocabulary<DBoW2::FBrief::TDescriptor, DBoW2::FBrief> 
   BriefVocabulary;
 
+/// BRIEF Vocabulary mapped from a binary file
+typedef DBoW2::TemplatedMappedVocabulary<DBoW2::FBrief::TDescriptor, 
+  DBoW2::FBrief> BriefMappedVocabulary;
+
 /// BRIEF Database
 typedef DBoW2::TemplatedDatabase<DBoW2::FBrief::TDescriptor, DBoW2::FBrief> 
   BriefDatabase;
@@ -0,0 +1,137 @@
+/**
+ * File: DatabaseFile.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: binary snapshot of the indexes of a database
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_DATABASE_FILE__
+#define __D_T_DATABASE_FILE__
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+namespace DBoW2 {
+
+/// Binary snapshot of a database, with its indexes as contiguous arrays.
+/// The file starts with a header: the 4 bytes "DBDB", a version, flags,
+/// the numbers of entries and words, the direct index levels, the hash of
+/// the vocabulary (see TemplatedVocabulary::getBinaryHash), a checksum
+/// of the whole file (see VocabularyFile::checksum), the id of the first
+/// entry kept (the previous ones were evicted by a database with limited
+/// capacity) and the generation of the entry ids, which is increased each
+/// time they are renumbered.
+/// Then come these sections, each one with its number of items and its 
+/// size in bytes, and padded to 8 bytes:
+/// - the binary file of the vocabulary, if it is embedded
+/// - inverted index: number of items of each word, and entry id and weight
+///   of the items of all the words
+/// - direct index (if used): number of nodes of each entry kept, and node
+///   id and number of features of the nodes of all the entries, and the
+///   features of all the nodes
+/// - ids of the removed entries
+/// Numbers are little-endian. If the file is compressed, the integer
+/// sections are stored as the differences between consecutive values,
+/// which are small because the ids are sorted, in a variable-length code
+class DatabaseFile
+{
+public:
+
+  /// Version of the format
+  static const uint32_t VERSION = 1;
+
+  /**
+   * Creates an empty snapshot
+   */
+  DatabaseFile();
+
+  /**
+   * Writes the snapshot
+   * @param filename
+   * @param compress if true, the integer sections are compressed
+   * @throw string if the file cannot be written
+   */
+  void save(const std::string &filename, bool compress) const;
+
+  /**
+   * Reads a snapshot, checking its checksum, the sizes of its sections and
+   * that the entry ids of each word are ascending
+   * @param filename
+   * @throw string if the file cannot be read, is not a database snapshot
+   *   or is corrupt
+   */
+  void load(const std::string &filename);
+
+  /**
+   * Returns whether a file starts as a database snapshot
+   * @param filename
+   * @return true iff the file starts with the magic bytes
+   */
+  static bool isDatabaseFile(const std::string &filename);
+
+  /**
+   * Replaces a file with another one, so that the replaced file remains 
+   * complete, either the old one or the new one, if this is interrupted.
+   * The new file and the rename are written to the disk before this
+   * returns, so that they survive a crash of the system
+   * @param from name of the new file, which is renamed
+   * @param to name of the file to replace
+   * @throw string if the file cannot be replaced
+   */
+  static void replace(const std::string &from, const std::string &to);
+
+public:
+
+  /// Number of entries
+  uint32_t entries;
+
+  /// Id of the first entry kept
+  uint32_t first_entry;
+
+  /// Number of times the entry ids were renumbered
+  uint32_t generation;
+
+  /// Whether the direct index is used
+  bool direct_index;
+
+  /// Levels up of the nodes of the direct index
+  int32_t di_levels;
+
+  /// Hash of the binary file of the vocabulary
+  uint64_t vocabulary_hash;
+
+  /// Binary file of the vocabulary, or empty if it is not embedded
+  std::vector<unsigned char> vocabulary;
+
+  /// Number of items of the inverted index of each word
+  std::vector<uint32_t> word_items;
+
+  /// Entry id of each item of the inverted index, in word order
+  std::vector<uint32_t> item_entries;
+
+  /// Weight of each item of the inverted index
+  std::vector<double> item_weights;
+
+  /// Number of nodes of the direct index of each entry from first_entry
+  std::vector<uint32_t> entry_nodes;
+
+  /// Node id of each node of the direct index, in entry order
+  std::vector<uint32_t> node_ids;
+
+  /// Number of features of each node of the direct index
+  std::vector<uint32_t> node_features;
+
+  /// Features of each node of the direct index, in node order
+  std::vector<uint32_t> features;
+
+  /// Ids of the removed entries, in ascending order
+  std::vector<uint32_t> removed_entries;
+
+};
+
+} // namespace DBoW2
+
+#endif
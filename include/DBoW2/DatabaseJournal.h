@@ -0,0 +1,189 @@
+/**
+ * File: DatabaseJournal.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: append-only journal of the entries added to a database
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_DATABASE_JOURNAL__
+#define __D_T_DATABASE_JOURNAL__
+
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <functional>
+#include <stdint.h>
+
+#include "BowVector.h"
+#include "FeatureVector.h"
+#include "QueryResults.h"
+
+namespace DBoW2 {
+
+/// Append-only log of the entries added to and removed from a database
+/// since its last snapshot, so that it can be recovered by loading the
+/// snapshot and replaying the log.
+/// The file starts with a header: the 4 bytes "DBWL", a version, the hash
+/// of the vocabulary (see TemplatedVocabulary::getBinaryHash), the
+/// direct index parameters of the database and the generation of its
+/// entry ids (see DatabaseFile). Then come the records, each one with its
+/// type, entry id, number of words, nodes and features, the weights and
+/// ids of the words, the ids and number of features of the nodes (if the
+/// direct index is used), the features, and a checksum of the record (see
+/// VocabularyFile::checksum). Removals are records without words. A record
+/// that was not completely written (e.g. the process was killed) is
+/// discarded when the journal is opened again.
+/// Numbers are little-endian
+class DatabaseJournal
+{
+public:
+
+  /// Version of the format
+  static const uint32_t VERSION = 1;
+
+  /// Function that receives the entries of a journal when it is opened
+  typedef std::function<void(EntryId, const BowVector &,
+    const FeatureVector &)> Replay;
+
+  /// Function that receives the removals of a journal when it is opened
+  typedef std::function<void(EntryId)> ReplayRemoval;
+
+  /**
+   * Creates a closed journal
+   */
+  DatabaseJournal();
+
+  /**
+   * Closes the journal
+   */
+  ~DatabaseJournal();
+
+  /**
+   * Opens a journal to append entries to it, creating the file if it does
+   * not exist. The entries and removals that the file already has are 
+   * given to replay and replay_removal, in order
+   * @param filename
+   * @param vocabulary_hash hash of the vocabulary of the database
+   * @param direct_index whether the database uses the direct index
+   * @param di_levels direct index levels of the database
+   * @param generation number of times the entries of the database were
+   *   renumbered
+   * @param replay function that receives the entries of the file
+   * @param replay_removal function that receives the removed entries
+   * @param sync if true, each entry is written to the disk when it is
+   *   appended, so that it survives a crash of the system, not only of the
+   *   process
+   * @throw string if the file cannot be opened, is not a journal or was
+   *   written by a database with other vocabulary, parameters or
+   *   generation. Exceptions of replay are thrown too
+   */
+  void open(const std::string &filename, uint64_t vocabulary_hash,
+    bool direct_index, int di_levels, uint32_t generation,
+    const Replay &replay, const ReplayRemoval &replay_removal,
+    bool sync = false);
+
+  /**
+   * Appends an entry to the journal
+   * @param id entry id
+   * @param v bow vector of the entry
+   * @param fv feature vector of the entry, which is ignored if the
+   *   direct index is not used
+   * @throw string if the entry cannot be written. The journal is left as
+   *   it was
+   */
+  void append(EntryId id, const BowVector &v, const FeatureVector &fv);
+
+  /**
+   * Appends the removal of an entry to the journal
+   * @param id entry id
+   * @throw string if the removal cannot be written. The journal is left as
+   *   it was
+   */
+  void appendRemoval(EntryId id);
+
+  /**
+   * Removes all the records of the journal
+   * @throw string if the file cannot be truncated
+   */
+  void reset();
+
+  /**
+   * Closes the file
+   */
+  void close();
+
+  /**
+   * Returns whether the journal is open
+   * @return true iff open was called and close was not
+   */
+  inline bool isOpen() const
+  {
+    return m_file != NULL;
+  }
+
+  /**
+   * Returns the name of the file
+   * @return filename
+   */
+  inline const std::string& filename() const
+  {
+    return m_filename;
+  }
+
+  /**
+   * Returns the size of the file, which can be used to decide when to fold
+   * the journal into a new snapshot
+   * @return bytes
+   */
+  inline uint64_t bytes() const
+  {
+    return m_size;
+  }
+
+protected:
+
+  /**
+   * Writes the data of m_buffer at the end of the file, and removes them
+   * if they could not be written completely
+   * @throw string if the data cannot be written
+   */
+  void write();
+
+  /**
+   * Truncates the file to some size
+   * @param size
+   * @return true iff the file was truncated
+   */
+  bool truncate(uint64_t size);
+
+protected:
+
+  /// File, or NULL if closed
+  FILE *m_file;
+
+  /// Name of the file
+  std::string m_filename;
+
+  /// Size of the valid part of the file
+  uint64_t m_size;
+
+  /// Whether the direct index is stored
+  bool m_direct_index;
+
+  /// Whether each record is written to the disk
+  bool m_sync;
+
+  /// Record being written, reused to avoid allocations
+  std::vector<unsigned char> m_buffer;
+
+private:
+
+  DatabaseJournal(const DatabaseJournal &);
+  DatabaseJournal& operator=(const DatabaseJournal &);
+};
+
+} // namespace DBoW2
+
+#endif
@@ -0,0 +1,239 @@
+/**
+ * File: DescriptorReader.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: sources of training descriptors read from disk or from a 
+ *   callback, and temporary files to train vocabularies out of core
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_DESCRIPTOR_READER__
+#define __D_T_DESCRIPTOR_READER__
+
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <functional>
+
+namespace DBoW2 {
+
+/// Source of training descriptors, read image by image. Each descriptor is
+/// a fixed number of bytes, as read by F::fromArray8U
+class DescriptorReader
+{
+public:
+
+  virtual ~DescriptorReader() {}
+
+  /**
+   * Returns the size of each descriptor
+   * @return bytes per descriptor
+   */
+  virtual int descriptorBytes() const = 0;
+
+  /**
+   * Goes back to the first image
+   */
+  virtual void rewind() = 0;
+
+  /**
+   * Reads the descriptors of the next image
+   * @param descriptors (out) descriptors of the image, one after the other
+   * @return false iff there are no more images
+   */
+  virtual bool next(std::vector<unsigned char> &descriptors) = 0;
+};
+
+/// Reads descriptors from a sequence of shard files written by ShardWriter
+class ShardReader: public DescriptorReader
+{
+public:
+
+  /**
+   * Creates the reader of a sequence of shards. The shards are opened 
+   * when they are read
+   * @param files shard files
+   * @param descriptor_bytes size of each descriptor. All the shards must
+   *   have this size
+   */
+  ShardReader(const std::vector<std::string> &files, int descriptor_bytes);
+
+  virtual ~ShardReader();
+
+  virtual int descriptorBytes() const { return m_bytes; }
+  
+  virtual void rewind();
+
+  /**
+   * Reads the descriptors of the next image
+   * @param descriptors (out) descriptors of the image, one after the other
+   * @return false iff there are no more images
+   * @throw string if a shard cannot be read
+   */
+  virtual bool next(std::vector<unsigned char> &descriptors);
+
+protected:
+
+  /**
+   * Opens a shard and checks its header
+   * @param i index of the shard in m_files
+   * @throw string if the shard cannot be read
+   */
+  void open(size_t i);
+
+protected:
+
+  /// Shard files
+  std::vector<std::string> m_files;
+
+  /// Bytes per descriptor
+  int m_bytes;
+
+  /// Index of the shard being read
+  size_t m_current;
+
+  /// Shard being read, or NULL
+  FILE *m_file;
+
+private:
+
+  ShardReader(const ShardReader &);
+  ShardReader& operator=(const ShardReader &);
+};
+
+/// Writes the descriptors of a set of images into a shard file.
+/// A shard starts with the 4 bytes "DBSH" and the descriptor size, and then
+/// stores each image as its number of descriptors and the descriptors.
+/// Numbers are 32-bit little-endian
+class ShardWriter
+{
+public:
+
+  /**
+   * Creates a shard file
+   * @param filename
+   * @param descriptor_bytes size of each descriptor
+   * @throw string if the file cannot be created
+   */
+  ShardWriter(const std::string &filename, int descriptor_bytes);
+
+  /**
+   * Closes the file
+   */
+  ~ShardWriter();
+
+  /**
+   * Adds the descriptors of an image
+   * @param descriptors descriptors, one after the other
+   * @param n number of descriptors
+   * @throw string if the file cannot be written
+   */
+  void add(const unsigned char *descriptors, int n);
+
+protected:
+
+  /// Shard file
+  FILE *m_file;
+
+  /// Bytes per descriptor
+  int m_bytes;
+
+private:
+
+  ShardWriter(const ShardWriter &);
+  ShardWriter& operator=(const ShardWriter &);
+};
+
+/// Reads descriptors from user functions
+class CallbackReader: public DescriptorReader
+{
+public:
+
+  /**
+   * Creates the reader
+   * @param descriptor_bytes size of each descriptor
+   * @param next function that returns the descriptors of the next image,
+   *   as DescriptorReader::next
+   * @param rewind function that goes back to the first image
+   */
+  CallbackReader(int descriptor_bytes,
+    const std::function<bool(std::vector<unsigned char> &)> &next,
+    const std::function<void()> &rewind)
+    : m_bytes(descriptor_bytes), m_next(next), m_rewind(rewind) {}
+
+  virtual int descriptorBytes() const { return m_bytes; }
+  
+  virtual void rewind() { m_rewind(); }
+  
+  virtual bool next(std::vector<unsigned char> &descriptors)
+  {
+    return m_next(descriptors);
+  }
+
+protected:
+
+  /// Bytes per descriptor
+  int m_bytes;
+
+  /// User functions
+  std::function<bool(std::vector<unsigned char> &)> m_next;
+  std::function<void()> m_rewind;
+};
+
+/// Temporary file, deleted when the object is destroyed
+class SpillFile
+{
+public:
+
+  /**
+   * Creates an empty temporary file
+   * @param directory directory of the file. If empty, the file is created
+   *   where the system keeps its temporary files
+   * @throw string if the file cannot be created
+   */
+  explicit SpillFile(const std::string &directory = "");
+
+  /**
+   * Closes and deletes the file
+   */
+  ~SpillFile();
+
+  /**
+   * Appends data to the file
+   * @param data
+   * @param bytes
+   * @throw string if the file cannot be written
+   */
+  void write(const void *data, size_t bytes);
+
+  /**
+   * Goes back to the beginning of the file to read it
+   */
+  void rewind();
+
+  /**
+   * Reads data from the file
+   * @param data (out)
+   * @param bytes maximum number of bytes to read
+   * @return number of bytes read, 0 at the end of the file
+   */
+  size_t read(void *data, size_t bytes);
+
+protected:
+
+  /// File
+  FILE *m_file;
+
+  /// Path of the file if it must be deleted, or empty
+  std::string m_path;
+
+private:
+
+  SpillFile(const SpillFile &);
+  SpillFile& operator=(const SpillFile &);
+};
+
+} // namespace DBoW2
+
+#endif
@@ -25,6 +25,7 @@ class FBrief: protected FClass
 public:
 
   static const int L = 256; // Descriptor length (in bits)
+  static const int BYTES = L / 8; // Size of the raw data (fromArray8U)
   typedef std::bitset<L> TDescriptor;
   typedef const TDescriptor *pDescriptor;
 
@@ -43,6 +44,16 @@ public:
    * @return distance
    */
   static double distance(const TDescriptor &a, const TDescriptor &b);
+
+  /**
+   * Calculates the distances between a descriptor and a set of descriptors
+   * @param a
+   * @param b array of n descriptors
+   * @param n number of descriptors in b
+   * @param d (out) array of n distances
+   */
+  static void distances(const TDescriptor &a, const TDescriptor *b, int n,
+    double *d);
   
   /**
    * Returns a string version of the descriptor
@@ -57,6 +68,65 @@ public:
    * @param s string version
    */
   static void fromString(TDescriptor &a, const std::string &s);
+
+  /**
+   * Returns a descriptor from L/8 bytes of raw data. Bit i of the 
+   * descriptor is the bit (7 - i%8) of the byte i/8
+   * @param a (out) descriptor
+   * @param p raw data of the descriptor
+   */
+  static void fromArray8U(TDescriptor &a, const unsigned char *p);
+
+  /**
+   * Stores the L / 8 bytes of a descriptor, as read by fromArray8U
+   * @param a descriptor
+   * @param p (out) raw data of the descriptor
+   */
+  static void toArray8U(const TDescriptor &a, unsigned char *p);
+
+  /**
+   * Calculates the distances between a descriptor and a set of descriptors,
+   * all of them given as raw data of L/8 bytes
+   * @param a raw data of a descriptor
+   * @param b raw data of n descriptors
+   * @param n number of descriptors in b
+   * @param d (out) array of n distances
+   */
+  static void distances8U(const unsigned char *a, 
+    const unsigned char *const *b, int n, double *d);
+
+  /**
+   * Calculates the distances between a descriptor and a set of descriptors
+   * stored in a buffer, all of them given as raw data of L/8 bytes
+   * @param a raw data of a descriptor
+   * @param b raw data of the first descriptor of the buffer
+   * @param stride bytes from a descriptor of b to the next one
+   * @param n number of descriptors in b
+   * @param d (out) array of n distances
+   */
+  static void distances8U(const unsigned char *a, const unsigned char *b,
+    size_t stride, int n, double *d);
+
+  /**
+   * Calculates the mean value of a set of descriptors given as raw data,
+   * with the same rule as meanValue. The mean of no descriptors is all 
+   * zeros
+   * @param descriptors raw data of the descriptors
+   * @param mean (out) raw data of the mean descriptor
+   */
+  static void meanValue8U(const std::vector<const unsigned char *> &descriptors,
+    unsigned char *mean);
+
+  /**
+   * Calculates the mean value of n descriptors from the number of them
+   * that have each bit set (see MajorityVote::count), with the same rule 
+   * as meanValue
+   * @param counts counts of the L bits
+   * @param n number of descriptors
+   * @param mean (out) raw data of the mean descriptor
+   */
+  static void meanValueCounts8U(const int *counts, int n, 
+    unsigned char *mean);
   
   /**
    * Returns a mat with the descriptors in float format
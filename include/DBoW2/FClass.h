@@ -42,6 +42,18 @@ class FClass
    * @return distance
    */
   static double distance(const TDescriptor &a, const TDescriptor &b);
+
+  /**
+   * Calculates the distances between a descriptor and a set of descriptors.
+   * This function is optional. If a derived class provides it, the
+   * templated classes use it instead of calling distance n times
+   * @param a
+   * @param b array of n descriptors
+   * @param n number of descriptors in b
+   * @param d (out) array of n distances
+   */
+  static void distances(const TDescriptor &a, const TDescriptor *b, int n,
+    double *d);
   
   /**
    * Returns a string version of the descriptor
@@ -57,6 +69,87 @@ class FClass
    */
   static void fromString(TDescriptor &a, const std::string &s);
 
+  /**
+   * Returns a descriptor from its raw data. The data are not copied if the
+   * descriptor type allows it. This function is optional, and needed only
+   * to transform descriptors stored in matrices or buffers
+   * @param a (out) descriptor
+   * @param p raw data of the descriptor
+   */
+  static void fromArray8U(TDescriptor &a, const unsigned char *p);
+
+  /**
+   * Stores the raw data of a descriptor, as read by fromArray8U. This 
+   * function is optional, and needed only to save binary vocabularies and
+   * to create vocabularies from packed descriptors, along with the 
+   * constant BYTES, the size of the raw data
+   * @param a descriptor
+   * @param p (out) raw data of the descriptor
+   */
+  static void toArray8U(const TDescriptor &a, unsigned char *p);
+
+  /**
+   * Calculates the distances between a descriptor and a set of descriptors,
+   * all of them given as raw data. This function is optional, and needed
+   * only to create vocabularies from packed descriptors
+   * @param a raw data of a descriptor
+   * @param b raw data of n descriptors
+   * @param n number of descriptors in b
+   * @param d (out) array of n distances
+   */
+  static void distances8U(const unsigned char *a, 
+    const unsigned char *const *b, int n, double *d);
+
+  /**
+   * Calculates the distances between a descriptor and a set of descriptors
+   * stored in a buffer, all of them given as raw data of BYTES bytes. This
+   * function is optional. If a derived class provides it, the compiled 
+   * tree of the vocabularies and the mapped vocabularies compare the
+   * features with the contiguous children of each node through it
+   * @param a raw data of a descriptor
+   * @param b raw data of the first descriptor of the buffer
+   * @param stride bytes from a descriptor of b to the next one
+   * @param n number of descriptors in b
+   * @param d (out) array of n distances
+   */
+  static void distances8U(const unsigned char *a, const unsigned char *b,
+    size_t stride, int n, double *d);
+
+  /**
+   * Calculates the mean value of a set of descriptors given as raw data,
+   * as meanValue does. This function is optional, and needed only to 
+   * create vocabularies from packed descriptors
+   * @param descriptors raw data of the descriptors
+   * @param mean (out) raw data of the mean descriptor
+   */
+  static void meanValue8U(const std::vector<const unsigned char *> &descriptors,
+    unsigned char *mean);
+
+  /**
+   * Calculates the mean value of n binary descriptors from the number of 
+   * them that have each bit set, as counted by MajorityVote::count, with 
+   * the rule of meanValue8U. This function is optional. If a derived class 
+   * provides it (and toArray8U and fromArray8U), mini-batch kmeans keeps 
+   * the bit counts of its clusters instead of their descriptors
+   * @param counts counts of the BYTES * 8 bits
+   * @param n number of descriptors
+   * @param mean (out) raw data of the mean descriptor
+   */
+  static void meanValueCounts8U(const int *counts, int n, 
+    unsigned char *mean);
+
+  /**
+   * Calculates the weighted mean value of a set of descriptors. This 
+   * function is optional. If a derived class provides it, mini-batch 
+   * kmeans keeps the running mean of its clusters instead of their 
+   * descriptors
+   * @param descriptors
+   * @param weights weight of each descriptor
+   * @param mean mean descriptor
+   */
+  static void weightedMeanValue(const std::vector<pDescriptor> &descriptors,
+    const std::vector<double> &weights, TDescriptor &mean);
+
   /**
    * Returns a mat with the descriptors in float format
    * @param descriptors
@@ -66,6 +159,130 @@ class FClass
     cv::Mat &mat);
 };
 
+/// Checks whether the class F provides F::distances
+template<class F>
+class HasDistances
+{
+  template<class G>
+  static char test(int, decltype(G::distances(
+    *(const typename G::TDescriptor*)0, (const typename G::TDescriptor*)0,
+    0, (double*)0)) * = 0);
+
+  template<class G>
+  static long test(...);
+
+public:
+  /// True iff F::distances(a, b, n, d) can be called
+  static const bool value = (sizeof(test<F>(0)) == sizeof(char));
+};
+
+/// Checks whether the class F provides F::fromArray8U and F::BYTES, which
+/// are needed to load binary vocabularies
+template<class F>
+class HasArray8U
+{
+  template<class G>
+  static char test(int, decltype((void)G::BYTES, G::fromArray8U(
+    *(typename G::TDescriptor*)0, (const unsigned char*)0)) * = 0);
+
+  template<class G>
+  static long test(...);
+
+public:
+  /// True iff F::fromArray8U(a, p) can be called and F::BYTES exists
+  static const bool value = (sizeof(test<F>(0)) == sizeof(char));
+};
+
+/// Checks whether the class F provides F::toArray8U and F::BYTES, which
+/// are needed to save binary vocabularies
+template<class F>
+class HasToArray8U
+{
+  template<class G>
+  static char test(int, decltype((void)G::BYTES, G::toArray8U(
+    *(const typename G::TDescriptor*)0, (unsigned char*)0)) * = 0);
+
+  template<class G>
+  static long test(...);
+
+public:
+  /// True iff F::toArray8U(a, p) can be called and F::BYTES exists
+  static const bool value = (sizeof(test<F>(0)) == sizeof(char));
+};
+
+/// Checks whether the class F provides F::meanValueCounts8U and F::BYTES
+template<class F>
+class HasMeanCounts8U
+{
+  template<class G>
+  static char test(int, decltype((void)G::BYTES, G::meanValueCounts8U(
+    (const int*)0, 0, (unsigned char*)0)) * = 0);
+
+  template<class G>
+  static long test(...);
+
+public:
+  /// True iff F::meanValueCounts8U(counts, n, mean) can be called
+  static const bool value = (sizeof(test<F>(0)) == sizeof(char));
+};
+
+/// Checks whether the class F provides F::distances8U for descriptors
+/// stored in a buffer, and F::BYTES
+template<class F>
+class HasStridedDistances8U
+{
+  template<class G>
+  static char test(int, decltype((void)G::BYTES, G::distances8U(
+    (const unsigned char*)0, (const unsigned char*)0, (size_t)0, 0,
+    (double*)0)) * = 0);
+
+  template<class G>
+  static long test(...);
+
+public:
+  /// True iff F::distances8U(a, b, stride, n, d) can be called
+  static const bool value = (sizeof(test<F>(0)) == sizeof(char));
+};
+
+/// Checks whether the class F provides F::fromArray8U, F::toArray8U,
+/// F::distances8U and F::meanValue8U for raw data, and F::BYTES, which are
+/// needed to create vocabularies from packed descriptors
+template<class F>
+class HasPacked8U
+{
+  template<class G>
+  static char test(int, decltype((void)G::distances8U(
+    (const unsigned char*)0, (const unsigned char* const*)0, 0,
+    (double*)0), G::meanValue8U(
+    *(const std::vector<const unsigned char*>*)0, (unsigned char*)0)) * = 0);
+
+  template<class G>
+  static long test(...);
+
+public:
+  /// True iff F::distances8U(a, b, n, d) and F::meanValue8U(v, mean) can be
+  /// called, and F::fromArray8U and F::toArray8U too
+  static const bool value = (sizeof(test<F>(0)) == sizeof(char)) &&
+    HasArray8U<F>::value && HasToArray8U<F>::value;
+};
+
+/// Checks whether the class F provides F::weightedMeanValue
+template<class F>
+class HasWeightedMean
+{
+  template<class G>
+  static char test(int, decltype(G::weightedMeanValue(
+    *(const std::vector<const typename G::TDescriptor*>*)0,
+    *(const std::vector<double>*)0, *(typename G::TDescriptor*)0)) * = 0);
+
+  template<class G>
+  static long test(...);
+
+public:
+  /// True iff F::weightedMeanValue(descriptors, weights, mean) can be called
+  static const bool value = (sizeof(test<F>(0)) == sizeof(char));
+};
+
 } // namespace DBoW2
 
 #endif
@@ -29,6 +29,8 @@ public:
   typedef const TDescriptor *pDescriptor;
   /// Descriptor length (in bytes)
   static const int L = 32;
+  /// Size of the raw data of a descriptor (fromArray8U, toArray8U)
+  static const int BYTES = L;
 
   /**
    * Calculates the mean value of a set of descriptors
@@ -45,6 +47,17 @@ public:
    * @return distance
    */
   static double distance(const TDescriptor &a, const TDescriptor &b);
+
+  /**
+   * Calculates the distances between a descriptor and a set of descriptors
+   * of the same length
+   * @param a
+   * @param b array of n descriptors
+   * @param n number of descriptors in b
+   * @param d (out) array of n distances
+   */
+  static void distances(const TDescriptor &a, const TDescriptor *b, int n,
+    double *d);
   
   /**
    * Returns a string version of the descriptor
@@ -59,6 +72,66 @@ public:
    * @param s string version
    */
   static void fromString(TDescriptor &a, const std::string &s);
+
+  /**
+   * Makes a descriptor that wraps L bytes of raw data without copying them.
+   * The data must outlive the descriptor
+   * @param a (out) descriptor
+   * @param p raw data of the descriptor
+   */
+  static void fromArray8U(TDescriptor &a, const unsigned char *p);
+
+  /**
+   * Stores the L bytes of a descriptor. An empty descriptor is stored as
+   * zeros
+   * @param a descriptor
+   * @param p (out) raw data of the descriptor
+   */
+  static void toArray8U(const TDescriptor &a, unsigned char *p);
+
+  /**
+   * Calculates the distances between a descriptor and a set of descriptors,
+   * all of them given as raw data of L bytes
+   * @param a raw data of a descriptor
+   * @param b raw data of n descriptors
+   * @param n number of descriptors in b
+   * @param d (out) array of n distances
+   */
+  static void distances8U(const unsigned char *a, 
+    const unsigned char *const *b, int n, double *d);
+
+  /**
+   * Calculates the distances between a descriptor and a set of descriptors
+   * stored in a buffer, all of them given as raw data of L bytes
+   * @param a raw data of a descriptor
+   * @param b raw data of the first descriptor of the buffer
+   * @param stride bytes from a descriptor of b to the next one
+   * @param n number of descriptors in b
+   * @param d (out) array of n distances
+   */
+  static void distances8U(const unsigned char *a, const unsigned char *b,
+    size_t stride, int n, double *d);
+
+  /**
+   * Calculates the mean value of a set of descriptors given as raw data,
+   * with the same rule as meanValue. The mean of no descriptors is all 
+   * zeros
+   * @param descriptors raw data of the descriptors
+   * @param mean (out) raw data of the mean descriptor
+   */
+  static void meanValue8U(const std::vector<const unsigned char *> &descriptors,
+    unsigned char *mean);
+
+  /**
+   * Calculates the mean value of n descriptors from the number of them
+   * that have each bit set (see MajorityVote::count), with the same rule 
+   * as meanValue
+   * @param counts counts of the L * 8 bits
+   * @param n number of descriptors
+   * @param mean (out) raw data of the mean descriptor
+   */
+  static void meanValueCounts8U(const int *counts, int n, 
+    unsigned char *mean);
   
   /**
    * Returns a mat with the descriptors in float format
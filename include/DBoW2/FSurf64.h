@@ -46,6 +46,15 @@ public:
    */
   static void meanValue(const std::vector<pDescriptor> &descriptors, 
     TDescriptor &mean);
+
+  /**
+   * Calculates the weighted mean value of a set of descriptors
+   * @param descriptors vector of pointers to descriptors
+   * @param weights weight of each descriptor
+   * @param mean mean descriptor
+   */
+  static void weightedMeanValue(const std::vector<pDescriptor> &descriptors,
+    const std::vector<double> &weights, TDescriptor &mean);
   
   /**
    * Calculates the (squared) distance between two descriptors
@@ -0,0 +1,63 @@
+/**
+ * File: HammingDistance.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: one-to-many hamming distance kernels for binary descriptors
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_HAMMING_DISTANCE__
+#define __D_T_HAMMING_DISTANCE__
+
+#include <cstddef>
+
+namespace DBoW2 {
+
+/// Hamming distance between one binary descriptor and many others.
+/**
+ * The implementation is chosen at runtime according to the CPU: 
+ * AVX-512 VPOPCNTDQ, AVX2 or portable scalar code. The vectorized versions
+ * are used for 32-byte descriptors (ORB, BRIEF-256); other lengths use the
+ * scalar code, and must be multiple of 8 bytes
+ */
+class HammingDistance
+{
+public:
+
+  /**
+   * Calculates the distances between a descriptor and n descriptors given
+   * by pointers
+   * @param a descriptor
+   * @param b array of n pointers to descriptors
+   * @param n number of descriptors in b
+   * @param bytes length of the descriptors in bytes
+   * @param d (out) array of n distances
+   */
+  static void distances(const unsigned char *a, 
+    const unsigned char *const *b, int n, int bytes, int *d);
+
+  /**
+   * Calculates the distances between a descriptor and n descriptors stored
+   * in a buffer
+   * @param a descriptor
+   * @param b first descriptor of the buffer
+   * @param stride bytes from the start of a descriptor in b to the next one
+   * @param n number of descriptors in b
+   * @param bytes length of the descriptors in bytes
+   * @param d (out) array of n distances
+   */
+  static void distances(const unsigned char *a, 
+    const unsigned char *b, size_t stride, int n, int bytes, int *d);
+
+  /**
+   * Returns the name of the implementation selected for this CPU
+   * @return "avx512", "avx2" or "scalar"
+   */
+  static const char* implementation();
+
+};
+
+} // namespace DBoW2
+
+#endif
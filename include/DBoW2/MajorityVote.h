@@ -0,0 +1,75 @@
+/**
+ * File: MajorityVote.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: bitwise majority vote of binary descriptors
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_MAJORITY_VOTE__
+#define __D_T_MAJORITY_VOTE__
+
+namespace DBoW2 {
+
+/// Counts how many binary descriptors have each bit set, to compute their
+/// bitwise majority (their mean value).
+/**
+ * The bits are counted with bit-sliced vertical counters: each 64-bit word
+ * of a descriptor is added to eight bit planes with carry-save logic, so
+ * that a descriptor costs a few word operations instead of a test per bit.
+ * The planes are flushed into integer counters every 255 descriptors
+ */
+class MajorityVote
+{
+public:
+
+  /**
+   * Counts the descriptors that have each bit set. Bit j is bit 7 - j % 8
+   * of byte j / 8
+   * @param descriptors array of n pointers to descriptors
+   * @param n number of descriptors
+   * @param bytes length of the descriptors in bytes
+   * @param counts (out) array of bytes * 8 counts
+   */
+  static void count(const unsigned char *const *descriptors, int n, 
+    int bytes, int *counts);
+
+  /**
+   * Adds the descriptors that have each bit set to some counts, as count 
+   * does, so that the counts of a set can be updated as it grows
+   * @param descriptors array of n pointers to descriptors
+   * @param n number of descriptors
+   * @param bytes length of the descriptors in bytes
+   * @param counts (in/out) array of bytes * 8 counts
+   */
+  static void add(const unsigned char *const *descriptors, int n, 
+    int bytes, int *counts);
+
+  /**
+   * Sets the bits that are set in at least a number of descriptors
+   * @param descriptors array of n pointers to descriptors
+   * @param n number of descriptors
+   * @param bytes length of the descriptors in bytes
+   * @param threshold minimum number of descriptors with a bit set to set
+   *   it in the result
+   * @param result (out) descriptor of bytes length
+   */
+  static void majority(const unsigned char *const *descriptors, int n,
+    int bytes, int threshold, unsigned char *result);
+
+  /**
+   * Sets the bits whose counts reach a threshold
+   * @param counts array of bytes * 8 counts, as given by count
+   * @param bytes length of the descriptors in bytes
+   * @param threshold minimum count of a bit to set it in the result
+   * @param result (out) descriptor of bytes length
+   */
+  static void majority(const int *counts, int bytes, int threshold,
+    unsigned char *result);
+
+};
+
+} // namespace DBoW2
+
+#endif
@@ -0,0 +1,526 @@
+/**
+ * File: MappedVocabulary.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: read-only vocabulary that uses the tables of a binary
+ *   vocabulary file in place
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_MAPPED_VOCABULARY__
+#define __D_T_MAPPED_VOCABULARY__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "TemplatedVocabulary.h"
+#include "VocabularyFile.h"
+
+namespace DBoW2 {
+
+/// Read-only vocabulary whose nodes, weights and descriptors are read
+/// directly from a binary vocabulary file (see saveBinary) mapped in memory.
+/// The processes that map the same file share its pages, and creating the
+/// vocabulary does not copy the tree.
+/// It supports transform, getWord, getWordWeight, getParentNode,
+/// getWordsFromNode, save and saveBinary, and can be the vocabulary of a
+/// TemplatedDatabase. Copies share the same mapping. The tree cannot be
+/// modified: stopWords and load throw, and the functions that are not
+/// virtual in TemplatedVocabulary (create, loadBinary, ...) must not be
+/// called through a TemplatedVocabulary reference.
+/// F must provide BYTES, fromArray8U, toArray8U and distances8U
+template<class TDescriptor, class F>
+class TemplatedMappedVocabulary : public TemplatedVocabulary<TDescriptor, F>
+{
+public:
+
+  using TemplatedVocabulary<TDescriptor, F>::transform;
+  using TemplatedVocabulary<TDescriptor, F>::save;
+  using TemplatedVocabulary<TDescriptor, F>::saveBinary;
+
+  /**
+   * Maps a binary vocabulary file
+   * @param filename
+   * @param verify if true, the checksum of the file is checked, which reads
+   *   the whole file. The tables are always checked, so that a damaged file
+   *   cannot make transform read out of them
+   * @throw string if the file cannot be mapped, is corrupt or has
+   *   descriptors of another size
+   */
+  explicit TemplatedMappedVocabulary(const std::string &filename,
+    bool verify = false);
+
+  /**
+   * Copy constructor. The copy shares the mapping
+   * @param voc
+   */
+  TemplatedMappedVocabulary(
+    const TemplatedMappedVocabulary<TDescriptor,F> &voc);
+
+  /**
+   * Makes this vocabulary share the mapping of another one
+   * @param voc
+   * @return reference to this vocabulary
+   */
+  TemplatedMappedVocabulary<TDescriptor,F>& operator=(
+    const TemplatedMappedVocabulary<TDescriptor,F> &voc);
+
+  /**
+   * Returns a copy that shares the mapping
+   * @return new vocabulary
+   */
+  virtual TemplatedMappedVocabulary<TDescriptor,F>* clone() const;
+
+  /**
+   * Returns the number of words in the vocabulary
+   * @return number of words
+   */
+  virtual inline unsigned int size() const;
+
+  /**
+   * Returns whether the vocabulary is empty (i.e. it has not been trained)
+   * @return true iff the vocabulary is empty
+   */
+  virtual inline bool empty() const;
+
+  /**
+   * Returns the id of the node that is "levelsup" levels from the word given
+   * @param wid word id
+   * @param levelsup 0..L
+   * @return node id. if levelsup is 0, returns the node id associated to the
+   *   word id
+   */
+  virtual NodeId getParentNode(WordId wid, int levelsup) const;
+
+  /**
+   * Returns the ids of all the words that are under the given node id,
+   * by traversing any of the branches that goes down from the node
+   * @param nid starting node id
+   * @param words ids of words
+   */
+  virtual void getWordsFromNode(NodeId nid, std::vector<WordId> &words)
+    const;
+
+  /**
+   * Returns the descriptor of a word. Its data are a copy
+   * @param wid word id
+   * @return descriptor
+   */
+  virtual inline TDescriptor getWord(WordId wid) const;
+
+  /**
+   * Returns the weight of a word
+   * @param wid word id
+   * @return weight
+   */
+  virtual inline WordValue getWordWeight(WordId wid) const;
+
+  /**
+   * Saves the vocabulary to a file storage structure, as
+   * TemplatedVocabulary does
+   * @param fs
+   * @param name
+   */
+  virtual void save(cv::FileStorage &fs,
+    const std::string &name = "vocabulary") const;
+
+  /**
+   * Copies the contents of the mapped file
+   * @param data (out) contents of the file
+   */
+  virtual void saveBinary(std::vector<unsigned char> &data) const;
+
+  /**
+   * Throws, because the vocabulary is read-only
+   */
+  virtual void load(const cv::FileStorage &fs,
+    const std::string &name = "vocabulary");
+
+  /**
+   * Throws, because the vocabulary is read-only
+   */
+  virtual int stopWords(double minWeight);
+
+  /**
+   * Returns the mapped file
+   * @return file
+   */
+  inline const VocabularyFile& getFile() const { return *m_file; }
+
+protected:
+
+  /**
+   * Returns the checksum of the mapped file
+   * @return hash
+   */
+  virtual unsigned long long computeBinaryHash() const;
+
+  /**
+   * Returns the word id associated to a feature by traversing the mapped
+   * node table. The results are the same as those of TemplatedVocabulary
+   * @param feature
+   * @param id (out) word id
+   * @param weight (out) word weight
+   * @param nid (out) if given, id of the node "levelsup" levels up
+   * @param levelsup
+   */
+  virtual void transform(const TDescriptor &feature,
+    WordId &id, WordValue &weight, NodeId* nid = NULL, int levelsup = 0) const;
+
+  /**
+   * Returns the index of the child closest to a feature, breaking ties by
+   * choosing the lowest index, as findClosest does
+   * @param feature raw data of the feature
+   * @param first index in the node table of the first child
+   * @param n number of children (n > 0)
+   * @return index of the closest child in [0, n)
+   */
+  inline unsigned int findClosestChild(const unsigned char *feature,
+    uint32_t first, unsigned int n) const
+  {
+    return findClosestChild(feature, first, n,
+      std::integral_constant<bool, HasStridedDistances8U<F>::value>());
+  }
+
+  /// findClosestChild when F provides F::distances8U for descriptors stored
+  /// in a buffer, which the children are in the descriptor section
+  unsigned int findClosestChild(const unsigned char *feature,
+    uint32_t first, unsigned int n, std::true_type) const;
+
+  /// findClosestChild when F only provides F::distances8U for pointers
+  unsigned int findClosestChild(const unsigned char *feature,
+    uint32_t first, unsigned int n, std::false_type) const;
+
+  /**
+   * Throws the error of the functions that modify the vocabulary
+   */
+  void throwReadOnly() const;
+
+protected:
+
+  /// Mapped file, shared by the copies
+  std::shared_ptr<const VocabularyFile> m_file;
+
+};
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+TemplatedMappedVocabulary<TDescriptor,F>::TemplatedMappedVocabulary(
+  const std::string &filename, bool verify)
+  : m_file(new VocabularyFile(filename, verify))
+{
+  const VocabularyFile::Header &header = m_file->header();
+
+  if(header.nodes > 0 && header.descriptor_bytes != (uint32_t)F::BYTES)
+  {
+    throw std::string("Binary vocabulary ") + filename +
+      " has descriptors of another size";
+  }
+
+  this->m_k = header.k;
+  this->m_L = header.L;
+  this->m_weighting = (WeightingType)header.weighting;
+  this->m_scoring = (ScoringType)header.scoring;
+  this->createScoringObject();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+TemplatedMappedVocabulary<TDescriptor,F>::TemplatedMappedVocabulary(
+  const TemplatedMappedVocabulary<TDescriptor,F> &voc)
+  : TemplatedVocabulary<TDescriptor,F>(voc), m_file(voc.m_file)
+{
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+TemplatedMappedVocabulary<TDescriptor,F>&
+TemplatedMappedVocabulary<TDescriptor,F>::operator=(
+  const TemplatedMappedVocabulary<TDescriptor,F> &voc)
+{
+  TemplatedVocabulary<TDescriptor,F>::operator=(voc);
+  m_file = voc.m_file;
+  return *this;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+TemplatedMappedVocabulary<TDescriptor,F>*
+TemplatedMappedVocabulary<TDescriptor,F>::clone() const
+{
+  return new TemplatedMappedVocabulary<TDescriptor,F>(*this);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline unsigned int TemplatedMappedVocabulary<TDescriptor,F>::size() const
+{
+  return m_file->header().words;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline bool TemplatedMappedVocabulary<TDescriptor,F>::empty() const
+{
+  return m_file->header().words == 0;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+NodeId TemplatedMappedVocabulary<TDescriptor,F>::getParentNode
+  (WordId wid, int levelsup) const
+{
+  const VocabularyFile::Node *nodes = m_file->nodes();
+
+  uint32_t i = m_file->words()[wid];
+  while(levelsup > 0 && i != 0) // i == 0 --> root
+  {
+    --levelsup;
+    i = nodes[i].parent;
+  }
+  return nodes[i].id;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedMappedVocabulary<TDescriptor,F>::getWordsFromNode
+  (NodeId nid, std::vector<WordId> &words) const
+{
+  words.clear();
+
+  const VocabularyFile::Node *nodes = m_file->nodes();
+  const uint32_t i = m_file->nodeIndex()[nid];
+
+  if(nodes[i].n_children == 0)
+  {
+    words.push_back(nodes[i].word_id);
+    return;
+  }
+
+  // same order as TemplatedVocabulary::getWordsFromNode
+  words.reserve(this->m_k);
+
+  std::vector<uint32_t> parents;
+  parents.push_back(i);
+
+  while(!parents.empty())
+  {
+    const VocabularyFile::Node &parent = nodes[parents.back()];
+    parents.pop_back();
+
+    for(uint32_t c = 0; c < parent.n_children; ++c)
+    {
+      const uint32_t child = parent.first_child + c;
+
+      if(nodes[child].n_children == 0)
+        words.push_back(nodes[child].word_id);
+      else
+        parents.push_back(child);
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline TDescriptor TemplatedMappedVocabulary<TDescriptor,F>::getWord
+  (WordId wid) const
+{
+  // the mapped data are read-only, so that they are not shared
+  TDescriptor descriptor;
+  F::fromArray8U(descriptor, m_file->descriptor(m_file->words()[wid]));
+  detachDescriptor(descriptor);
+  return descriptor;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline WordValue TemplatedMappedVocabulary<TDescriptor,F>::getWordWeight
+  (WordId wid) const
+{
+  return m_file->nodes()[m_file->words()[wid]].weight;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedMappedVocabulary<TDescriptor,F>::transform(
+  const TDescriptor &feature, WordId &word_id, WordValue &weight,
+  NodeId *nid, int levelsup) const
+{
+  const VocabularyFile::Node *nodes = m_file->nodes();
+
+  unsigned char raw[F::BYTES];
+  F::toArray8U(feature, raw);
+
+  // level at which the node must be stored in nid, if given
+  const int nid_level = this->m_L - levelsup;
+  if(nid_level <= 0 && nid != NULL) *nid = 0; // root
+
+  // propagate the feature down the node table
+  uint32_t final_idx = 0; // root
+  int current_level = 0;
+
+  do
+  {
+    ++current_level;
+    const VocabularyFile::Node &node = nodes[final_idx];
+
+    final_idx = node.first_child +
+      findClosestChild(raw, node.first_child, node.n_children);
+
+    if(nid != NULL && current_level == nid_level)
+      *nid = nodes[final_idx].id;
+
+  } while( nodes[final_idx].n_children > 0 );
+
+  word_id = nodes[final_idx].word_id;
+  weight = nodes[final_idx].weight;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+unsigned int TemplatedMappedVocabulary<TDescriptor,F>::findClosestChild(
+  const unsigned char *feature, uint32_t first, unsigned int n, 
+  std::true_type) const
+{
+  // distances are computed by chunks to keep them in the stack
+  const unsigned int CHUNK = 64;
+  double d[CHUNK];
+
+  const unsigned char *data = m_file->descriptor(first);
+
+  unsigned int best = 0;
+  double best_dist = 0;
+
+  for(unsigned int i = 0; i < n; i += CHUNK)
+  {
+    const unsigned int m = (n - i < CHUNK ? n - i : CHUNK);
+    F::distances8U(feature, data + (size_t)i * F::BYTES, F::BYTES, m, d);
+
+    for(unsigned int j = 0; j < m; ++j)
+    {
+      if(i + j == 0 || d[j] < best_dist)
+      {
+        best_dist = d[j];
+        best = i + j;
+      }
+    }
+  }
+
+  return best;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+unsigned int TemplatedMappedVocabulary<TDescriptor,F>::findClosestChild(
+  const unsigned char *feature, uint32_t first, unsigned int n, 
+  std::false_type) const
+{
+  // distances are computed by chunks to keep them in the stack
+  const unsigned int CHUNK = 64;
+  const unsigned char *descriptors[CHUNK];
+  double d[CHUNK];
+
+  const unsigned char *data = m_file->descriptor(first);
+
+  unsigned int best = 0;
+  double best_dist = 0;
+
+  for(unsigned int i = 0; i < n; i += CHUNK)
+  {
+    const unsigned int m = (n - i < CHUNK ? n - i : CHUNK);
+    for(unsigned int j = 0; j < m; ++j)
+      descriptors[j] = data + (size_t)(i + j) * F::BYTES;
+
+    F::distances8U(feature, descriptors, m, d);
+
+    for(unsigned int j = 0; j < m; ++j)
+    {
+      if(i + j == 0 || d[j] < best_dist)
+      {
+        best_dist = d[j];
+        best = i + j;
+      }
+    }
+  }
+
+  return best;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedMappedVocabulary<TDescriptor,F>::save(cv::FileStorage &fs,
+  const std::string &name) const
+{
+  // the tree is copied only while it is saved
+  TemplatedVocabulary<TDescriptor,F> voc;
+  voc.loadBinary(*m_file);
+  voc.save(fs, name);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedMappedVocabulary<TDescriptor,F>::saveBinary(
+  std::vector<unsigned char> &data) const
+{
+  data.assign(m_file->data(), m_file->data() + m_file->size());
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+unsigned long long
+TemplatedMappedVocabulary<TDescriptor,F>::computeBinaryHash() const
+{
+  return m_file->header().checksum;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedMappedVocabulary<TDescriptor,F>::load(const cv::FileStorage &,
+  const std::string &)
+{
+  throwReadOnly();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+int TemplatedMappedVocabulary<TDescriptor,F>::stopWords(double)
+{
+  throwReadOnly();
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedMappedVocabulary<TDescriptor,F>::throwReadOnly() const
+{
+  throw std::string("Vocabulary ") + m_file->filename() +
+    " is mapped read-only";
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
+
+#endif
@@ -0,0 +1,162 @@
+/**
+ * File: PackedDescriptors.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: training descriptors stored in one contiguous buffer
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_PACKED_DESCRIPTORS__
+#define __D_T_PACKED_DESCRIPTORS__
+
+#include <cstddef>
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace DBoW2 {
+
+/// Descriptors of a set of images stored one after the other in a single
+/// buffer aligned to 64 bytes. Each descriptor is a fixed number of bytes,
+/// as read by F::fromArray8U
+class PackedDescriptors
+{
+public:
+
+  /// Alignment of the buffer in bytes
+  static const size_t ALIGNMENT = 64;
+
+  /**
+   * Creates an empty set
+   * @param descriptor_bytes size of each descriptor
+   */
+  explicit PackedDescriptors(int descriptor_bytes);
+
+  /**
+   * Releases the buffer
+   */
+  ~PackedDescriptors();
+
+  /**
+   * Allocates space for a number of descriptors
+   * @param n total number of descriptors
+   */
+  void reserve(size_t n);
+
+  /**
+   * Removes all the descriptors and images, and releases the buffer
+   */
+  void clear();
+
+  /**
+   * Adds the descriptors of an image
+   * @param descriptors descriptors, one after the other
+   * @param n number of descriptors
+   */
+  void add(const unsigned char *descriptors, size_t n);
+
+  /**
+   * Adds the descriptors of an image stored in a matrix, one per row
+   * @param descriptors CV_8U matrix with descriptorBytes() columns
+   * @throw string if the matrix has another type or number of columns
+   */
+  void add(const cv::Mat &descriptors);
+
+  /**
+   * Adds descriptors to the last image, or to a new one if there are no
+   * images yet
+   * @param descriptors descriptors, one after the other
+   * @param n number of descriptors
+   */
+  void append(const unsigned char *descriptors, size_t n);
+
+  /**
+   * Returns the number of descriptors
+   * @return number of descriptors
+   */
+  inline size_t size() const { return m_size; }
+
+  /**
+   * Returns the size of each descriptor
+   * @return bytes per descriptor
+   */
+  inline int descriptorBytes() const { return m_bytes; }
+
+  /**
+   * Returns the number of images
+   * @return number of images
+   */
+  inline size_t images() const { return m_images.size(); }
+
+  /**
+   * Returns the index of the first descriptor of an image
+   * @param i image index
+   * @return descriptor index
+   */
+  inline size_t imageBegin(size_t i) const { return m_images[i]; }
+
+  /**
+   * Returns the index after the last descriptor of an image
+   * @param i image index
+   * @return descriptor index
+   */
+  inline size_t imageEnd(size_t i) const 
+  { 
+    return (i + 1 < m_images.size() ? m_images[i + 1] : m_size);
+  }
+
+  /**
+   * Returns the buffer
+   * @return pointer to the first descriptor
+   */
+  inline const unsigned char* data() const { return m_data; }
+
+  /**
+   * Returns a descriptor
+   * @param i descriptor index
+   * @return pointer to the descriptor
+   */
+  inline const unsigned char* operator[](size_t i) const 
+  { 
+    return m_data + i * m_bytes;
+  }
+
+  /**
+   * Returns a descriptor to modify it
+   * @param i descriptor index
+   * @return pointer to the descriptor
+   */
+  inline unsigned char* operator[](size_t i) 
+  { 
+    return m_data + i * m_bytes;
+  }
+
+protected:
+
+  /// Allocated memory
+  unsigned char *m_memory;
+
+  /// Aligned buffer inside m_memory
+  unsigned char *m_data;
+
+  /// Bytes per descriptor
+  int m_bytes;
+
+  /// Number of descriptors
+  size_t m_size;
+
+  /// Number of descriptors that fit in the buffer
+  size_t m_capacity;
+
+  /// Index of the first descriptor of each image
+  std::vector<size_t> m_images;
+
+private:
+
+  PackedDescriptors(const PackedDescriptors &);
+  PackedDescriptors& operator=(const PackedDescriptors &);
+};
+
+} // namespace DBoW2
+
+#endif
@@ -11,6 +11,8 @@
 #define __D_T_QUERY_RESULTS__
 
 #include <vector>
+#include <string>
+#include <iostream>
 
 namespace DBoW2 {
 
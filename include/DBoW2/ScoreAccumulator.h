@@ -0,0 +1,185 @@
+/**
+ * File: ScoreAccumulator.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: accumulator of the scores of the entries of a database
+ *   during a query
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_SCORE_ACCUMULATOR__
+#define __D_T_SCORE_ACCUMULATOR__
+
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "QueryResults.h"
+
+namespace DBoW2 {
+
+/// Accumulates the partial scores of the entries found in the inverted
+/// index during a query. The slots of the entries are kept in an array
+/// indexed by entry id (from the first id of the query) and stamped with
+/// the number of the query, so that it is not cleared between queries, and
+/// the touched entries are listed to extract them. If the database has
+/// more entries than getMaxDenseEntries or the array cannot be allocated,
+/// a hash table of the touched entries is used instead. Each thread has its
+/// own accumulator (see local), which is reused by all its queries. The 
+/// array is released when the queries of several calls in a row need a
+/// much smaller one, or none
+class ScoreAccumulator
+{
+public:
+
+  /// Partial score of an entry
+  struct Slot
+  {
+    /// Accumulated score
+    double score;
+    /// Sum of the query weights of the common words
+    double sum_v;
+    /// Sum of the entry weights of the common words
+    double sum_w;
+    /// Number of common words
+    int count;
+    /// Query in which the slot was set
+    uint32_t stamp;
+  };
+
+  /// Default maximum number of entries of the array (40 MB per thread)
+  static const size_t DEFAULT_MAX_DENSE_ENTRIES = 1 << 20;
+
+  /**
+   * Creates an empty accumulator
+   */
+  ScoreAccumulator();
+
+  /**
+   * Returns the accumulator of the calling thread
+   * @return accumulator
+   */
+  static ScoreAccumulator& local();
+
+  /**
+   * Sets the maximum number of entries of a database for which the
+   * accumulators use an array. Larger databases use a hash table
+   * @param n number of entries
+   */
+  static void setMaxDenseEntries(size_t n);
+
+  /**
+   * Returns the maximum number of entries for which arrays are used
+   * @return number of entries
+   */
+  static size_t getMaxDenseEntries();
+
+  /**
+   * Starts a query, forgetting the previous scores
+   * @param first entry ids will be >= first
+   * @param entries entry ids will be < first + entries
+   */
+  void reset(EntryId first, size_t entries);
+
+  /**
+   * Returns the slot of an entry, which is set to zero the first time it
+   * is requested in the query
+   * @param id entry id
+   * @return slot
+   */
+  inline Slot& at(EntryId id)
+  {
+    if(m_dense)
+    {
+      Slot &slot = m_slots[id - m_first];
+      if(slot.stamp != m_epoch)
+      {
+        // -0 + x is x for every x, also 0 and -0, so the first value added
+        // to a sum is kept as it is
+        slot.score = slot.sum_v = slot.sum_w = -0.0;
+        slot.count = 0;
+        slot.stamp = m_epoch;
+        m_touched.push_back(id);
+      }
+      return slot;
+    }
+    return sparseAt(id);
+  }
+
+  /**
+   * Sorts the touched entries by id, so that they are extracted in the
+   * same order as before
+   * @return touched entries
+   */
+  const std::vector<EntryId>& sortTouched();
+
+  /**
+   * Returns the entries touched in the query, in touching order
+   * @return entry ids
+   */
+  inline const std::vector<EntryId>& touched() const
+  {
+    return m_touched;
+  }
+
+  /**
+   * Returns whether the accumulator is using an array
+   * @return true iff dense
+   */
+  inline bool isDense() const
+  {
+    return m_dense;
+  }
+
+  /**
+   * Returns the number of slots of the array, used or not
+   * @return number of slots
+   */
+  inline size_t denseCapacity() const
+  {
+    return m_slots.size();
+  }
+
+protected:
+
+  /**
+   * Returns the slot of an entry in the hash table
+   * @param id entry id
+   * @return slot
+   */
+  Slot& sparseAt(EntryId id);
+
+protected:
+
+  /// Whether the array is used
+  bool m_dense;
+
+  /// Number of the current query
+  uint32_t m_epoch;
+
+  /// Entry id of the first slot
+  EntryId m_first;
+
+  /// Slot of each entry
+  std::vector<Slot> m_slots;
+
+  /// Slots of the touched entries when the array is not used
+  std::unordered_map<EntryId, Slot> m_sparse;
+
+  /// Entries touched in the current query
+  std::vector<EntryId> m_touched;
+
+  /// Queries in a row that needed a much smaller array than m_slots
+  unsigned int m_small_queries;
+
+private:
+
+  ScoreAccumulator(const ScoreAccumulator &);
+  ScoreAccumulator& operator=(const ScoreAccumulator &);
+};
+
+} // namespace DBoW2
+
+#endif
@@ -11,10 +11,11 @@
 #define __D_T_TEMPLATED_DATABASE__
 
 #include <vector>
+#include <deque>
 #include <numeric>
 #include <fstream>
 #include <string>
-#include <list>
+#include <algorithm>
 #include <set>
 
 #include "TemplatedVocabulary.h"
@@ -22,6 +23,9 @@
 #include "ScoringObject.h"
 #include "BowVector.h"
 #include "FeatureVector.h"
+#include "DatabaseFile.h"
+#include "DatabaseJournal.h"
+#include "ScoreAccumulator.h"
 
 namespace DBoW2 {
 
@@ -36,6 +40,47 @@ class TemplatedDatabase
 {
 public:
 
+  /// New id of a removed entry in the mappings of compact
+  static const EntryId REMOVED_ENTRY = (EntryId)-1;
+
+  /// New ids given by compact to the entries of a database, indexed by
+  /// their old ids
+  struct IdMap
+  {
+    /// Id of the first entry kept before the compaction. The lower ones
+    /// were evicted, and are not stored
+    EntryId first;
+
+    /// New id of each entry from first, or REMOVED_ENTRY
+    std::vector<EntryId> ids;
+
+    IdMap() : first(0) {}
+
+    /**
+     * Returns the new id of an entry
+     * @param id id of the entry before the compaction
+     * @return new id, or REMOVED_ENTRY if the entry was removed or evicted
+     */
+    inline EntryId operator[](EntryId id) const
+    {
+      return (id < first || id - first >= ids.size() ? REMOVED_ENTRY :
+        ids[id - first]);
+    }
+
+    /**
+     * Returns the number of entries mapped, evicted ones included
+     * @return first + ids.size()
+     */
+    inline size_t size() const
+    {
+      return first + ids.size();
+    }
+  };
+
+  /// Compacted indexes of a database, prepared by prepareCompaction to be
+  /// applied by applyCompaction
+  struct Compaction;
+
   /**
    * Creates an empty database without vocabulary
    * @param use_di a direct index is used to store feature indexes
@@ -57,7 +102,7 @@ public:
     int di_levels = 0);
 
   /**
-   * Copy constructor. Copies the vocabulary too
+   * Copy constructor. Copies the vocabulary too, but not the journal
    * @param db object to copy
    */
   TemplatedDatabase(const TemplatedDatabase<TDescriptor, F> &db);
@@ -80,7 +125,8 @@ public:
   virtual ~TemplatedDatabase(void);
 
   /**
-   * Copies the given database and its vocabulary
+   * Copies the given database and its vocabulary. The journal of this
+   * database, if any, is closed, and the one of db is not copied
    * @param db database to copy
    */
   TemplatedDatabase<TDescriptor,F>& operator=(
@@ -113,10 +159,12 @@ public:
   inline const TemplatedVocabulary<TDescriptor,F>* getVocabulary() const;
 
   /** 
-   * Allocates some memory for the direct and inverted indexes
+   * Allocates some memory for the direct and inverted indexes. The rows of
+   * the inverted index reserve room for nd * ni items, spread evenly over 
+   * the words
    * @param nd number of expected image entries in the database 
    * @param ni number of expected words per image
-   * @note Use 0 to ignore a parameter
+   * @note Use 0 to ignore a parameter. The inverted index needs both
    */
   void allocate(int nd = 0, int ni = 0);
 
@@ -141,15 +189,126 @@ public:
     const FeatureVector &fec = FeatureVector() );
 
   /**
-   * Empties the database
+   * Adds an entry to the database from descriptors stored as the rows of a
+   * matrix, and returns its index
+   * @param features matrix with one descriptor per row (e.g. NxL CV_8U)
+   * @param bowvec if given, the bow vector of these features is returned
+   * @param fvec if given, the vector of nodes and feature indexes is returned
+   * @param word_ids if given, the word id of each feature is returned
+   * @return id of new entry
+   */
+  EntryId add(const cv::Mat &features, BowVector *bowvec = NULL, 
+    FeatureVector *fvec = NULL, std::vector<WordId> *word_ids = NULL);
+
+  /**
+   * Adds an entry to the database from descriptors stored in a buffer, and
+   * returns its index
+   * @param features pointer to the first descriptor
+   * @param n number of descriptors
+   * @param stride bytes from the start of a descriptor to the next one
+   * @param bowvec if given, the bow vector of these features is returned
+   * @param fvec if given, the vector of nodes and feature indexes is returned
+   * @param word_ids if given, the word id of each feature is returned
+   * @return id of new entry
+   */
+  EntryId add(const unsigned char *features, int n, size_t stride,
+    BowVector *bowvec = NULL, FeatureVector *fvec = NULL, 
+    std::vector<WordId> *word_ids = NULL);
+
+  /**
+   * Empties the database and closes its journal, if any
    */
   inline void clear();
 
   /**
-   * Returns the number of entries in the database 
+   * Returns the number of entries in the database, including the removed
+   * ones until the database is compacted with renumbering, and the evicted
+   * ones (see setCapacity). It is the id of the next entry
    * @return number of entries in the database
    */
   inline unsigned int size() const;
+
+  /**
+   * Limits the number of entries kept in the database. When an entry is
+   * added beyond the capacity, the oldest one is evicted: it is not 
+   * returned by queries any more and its items are trimmed from the
+   * indexes, in amortized constant time per item, so that memory and query
+   * time stay flat however many entries are added. The ids are not reused.
+   * Removed entries count until they are evicted. If there are more 
+   * entries than the capacity, the oldest ones are evicted now. The 
+   * capacity is kept by clear and applied by load
+   * @param capacity maximum number of entries, or 0 for no limit
+   */
+  void setCapacity(unsigned int capacity);
+
+  /**
+   * Returns the maximum number of entries kept
+   * @return capacity, or 0 if there is no limit
+   */
+  inline unsigned int getCapacity() const;
+
+  /**
+   * Returns the id of the oldest entry kept. The previous ones were evicted
+   * @return entry id
+   */
+  inline EntryId getFirstEntry() const;
+
+  /**
+   * Removes an entry from the database. It is not returned by queries any
+   * more, but its items stay in the indexes until compact is called, and 
+   * its id is not reused
+   * @param id entry id
+   * @throw string if the entry does not exist, was already removed or
+   *   evicted, or the removal cannot be written to the journal
+   */
+  void remove(EntryId id);
+
+  /**
+   * Checks if an entry was removed
+   * @param id entry id
+   * @return true iff id was removed and not renumbered by compact
+   */
+  inline bool isRemoved(EntryId id) const;
+
+  /**
+   * Returns the number of removed entries counted by size
+   * @return number of removed entries
+   */
+  inline unsigned int removedSize() const;
+
+  /**
+   * Purges the removed entries from the inverted and direct indexes. This
+   * is prepareCompaction followed by applyCompaction
+   * @param renumber if true, the remaining entries are given consecutive
+   *   ids, keeping their order, and the removed ones are forgotten. The
+   *   journals written before cannot be opened by the database then
+   * @param new_ids if given, the new id of each entry is returned, or
+   *   REMOVED_ENTRY for the removed and evicted ones: (*new_ids)[id] is
+   *   that of the entry id as it was before the compaction
+   * @throw string if renumber is true, some entry was removed and the
+   *   journal is open
+   */
+  void compact(bool renumber = false, IdMap *new_ids = NULL);
+
+  /**
+   * Builds the compacted rows of the inverted index without modifying the
+   * database. Since it only reads it, it can run in another thread while 
+   * the database is queried, but the database must not be modified until
+   * the compaction is applied
+   * @param c (out) compaction
+   * @param renumber (see compact)
+   */
+  void prepareCompaction(Compaction &c, bool renumber = false) const;
+
+  /**
+   * Replaces the indexes of the database with the compacted ones. This 
+   * only swaps rows, so it is much faster than prepareCompaction
+   * @param c compaction prepared for this database, which is emptied
+   * @param new_ids (see compact)
+   * @throw string if the database was modified after preparing c, or if
+   *   c renumbers entries and the journal is open
+   */
+  void applyCompaction(Compaction &c, IdMap *new_ids = NULL);
   
   /**
    * Checks if the direct index is being used
@@ -185,11 +344,40 @@ public:
   void query(const BowVector &vec, QueryResults &ret, 
     int max_results = 1, int max_id = -1) const;
 
+  /**
+   * Queries the database with descriptors stored as the rows of a matrix
+   * @param features matrix with one descriptor per row (e.g. NxL CV_8U)
+   * @param ret (out) query results
+   * @param max_results number of results to return. <= 0 means all
+   * @param max_id only entries with id <= max_id are returned in ret. 
+   *   < 0 means all
+   * @param word_ids if given, the word id of each feature is returned
+   */
+  void query(const cv::Mat &features, QueryResults &ret,
+    int max_results = 1, int max_id = -1, 
+    std::vector<WordId> *word_ids = NULL) const;
+
+  /**
+   * Queries the database with descriptors stored in a buffer
+   * @param features pointer to the first descriptor
+   * @param n number of descriptors
+   * @param stride bytes from the start of a descriptor to the next one
+   * @param ret (out) query results
+   * @param max_results number of results to return. <= 0 means all
+   * @param max_id only entries with id <= max_id are returned in ret. 
+   *   < 0 means all
+   * @param word_ids if given, the word id of each feature is returned
+   */
+  void query(const unsigned char *features, int n, size_t stride,
+    QueryResults &ret, int max_results = 1, int max_id = -1, 
+    std::vector<WordId> *word_ids = NULL) const;
+
   /**
    * Returns the a feature vector associated with a database entry
    * @param id entry id (must be < size())
    * @return const reference to map of nodes and their associated features in
-   *   the given entry
+   *   the given entry. It is empty if the entry was removed and compacted,
+   *   or evicted
    */
   const FeatureVector& retrieveFeatures(EntryId id) const;
 
@@ -204,6 +392,78 @@ public:
    * @param filename
    */
   void load(const std::string &filename);
+
+  /**
+   * Stores the database in a binary snapshot (see DatabaseFile), which is
+   * loaded much faster than the text formats of save
+   * @param filename
+   * @param embed_vocabulary if true, the binary file of the vocabulary is
+   *   stored in the snapshot; if false, only its hash is stored, and the 
+   *   database must have the same vocabulary when the snapshot is loaded
+   * @param compress if true, the integer arrays are compressed
+   * @throw string if the file cannot be written
+   */
+  void saveBinary(const std::string &filename, bool embed_vocabulary = true,
+    bool compress = false) const;
+
+  /**
+   * Loads the database from a binary snapshot saved by saveBinary. The
+   * current vocabulary is kept if it is the one of the snapshot; otherwise,
+   * the snapshot must have its vocabulary embedded. load also reads these
+   * files
+   * @param filename
+   * @throw string if the file cannot be read, is corrupt or does not match
+   *   the vocabulary. The database is left as it was
+   */
+  void loadBinary(const std::string &filename);
+
+  /**
+   * Starts appending every entry added to the database to a journal, so
+   * that the database can be recovered after a restart without saving it
+   * completely each time. Removals are logged too. If the journal exists,
+   * the entries it has that the database does not have yet are added
+   * first, and its removals are applied. To recover a database,
+   * load its last snapshot and open its journal again. The journal is 
+   * closed by clear (and so, by load and setVocabulary)
+   * @param filename
+   * @param sync if true, each entry is written to the disk when it is
+   *   added, so that it survives a crash of the system, not only of the
+   *   process
+   * @throw string if the journal cannot be opened, or was written by a
+   *   database with other vocabulary or parameters, or does not continue
+   *   this database (e.g. it was written before compact renumbered the
+   *   entries)
+   */
+  void openJournal(const std::string &filename, bool sync = false);
+
+  /**
+   * Stops writing the journal
+   */
+  void closeJournal();
+
+  /**
+   * Returns the journal of the database
+   * @return journal, or NULL if not open
+   */
+  inline const DatabaseJournal* getJournal() const
+  {
+    return m_journal;
+  }
+
+  /**
+   * Folds the journal into a new snapshot: the database is stored with
+   * saveBinary in a temporary file that then replaces the snapshot, and the
+   * journal is emptied once the new snapshot is on the disk. If this is 
+   * interrupted, even by a crash of the system, the journal has at least 
+   * the entries that the remaining snapshot lacks
+   * @param filename snapshot file
+   * @param embed_vocabulary (see saveBinary). The vocabulary is usually
+   *   loaded apart, so it is not copied into every snapshot by default
+   * @param compress (see saveBinary)
+   * @throw string if the files cannot be written
+   */
+  void checkpoint(const std::string &filename, bool embed_vocabulary = false,
+    bool compress = false);
   
   /** 
    * Stores the database in the given file storage structure
@@ -223,6 +483,47 @@ public:
 
 protected:
   
+  /// loadBinary when F provides F::fromArray8U, called by load
+  inline void loadBinary(const std::string &filename, std::true_type)
+  {
+    loadBinary(filename);
+  }
+
+  /// loadBinary when F does not provide F::fromArray8U, called by load
+  inline void loadBinary(const std::string &filename, std::false_type)
+  {
+    throw filename + " is a binary database, which needs "
+      "F::fromArray8U and F::BYTES";
+  }
+
+  /**
+   * Flags an entry as removed
+   * @param id entry id (must be < size() and >= getFirstEntry())
+   */
+  void markRemoved(EntryId id);
+
+  /**
+   * Evicts the oldest entry kept
+   */
+  void evict();
+
+  /**
+   * Fills m_window with the words of the entries kept, taken from the 
+   * inverted index
+   */
+  void buildWindow();
+
+  /**
+   * Sorts the results and cuts them to max_results. If not all of them are
+   * kept, the best ones are selected first and only they are sorted. 
+   * Results with the same score are sorted by entry id
+   * @param ret results
+   * @param max_results number of results to keep. <= 0 means all
+   * @param descending if true, the greater the score the better
+   */
+  static void sortResults(QueryResults &ret, int max_results, 
+    bool descending);
+
   /// Query with L1 scoring
   void queryL1(const BowVector &vec, QueryResults &ret, 
     int max_results, int max_id) const;
@@ -251,37 +552,87 @@ protected:
 
   /* Inverted file declaration */
   
-  /// Item of IFRow
-  struct IFPair
+  /// Row of InvertedFile. The entry ids and the weights of its items are
+  /// kept in separate contiguous arrays, so that queries scan them without
+  /// jumping in memory. The items of the evicted entries are skipped at the
+  /// beginning of the arrays until they are as many as the rest
+  struct IFRow
   {
-    /// Entry id
-    EntryId entry_id;
+    /// Entry id of each item
+    std::vector<EntryId> entries;
     
-    /// Word weight in this entry
-    WordValue word_weight;
+    /// Word weight in the entry of each item
+    std::vector<WordValue> weights;
+
+    /// Index of the first item kept
+    size_t head;
+
+    /**
+     * Creates an empty row
+     */
+    IFRow(): head(0) {}
     
     /**
-     * Creates an empty pair
+     * Returns the number of items kept
+     * @return number of items
      */
-    IFPair(){}
+    inline size_t size() const { return entries.size() - head; }
     
     /**
-     * Creates an inverted file pair
+     * Checks if the row is empty
+     * @return true iff there are no items
+     */
+    inline bool empty() const { return entries.size() == head; }
+    
+    /**
+     * Appends an item
      * @param eid entry id
      * @param wv word weight
      */
-    IFPair(EntryId eid, WordValue wv): entry_id(eid), word_weight(wv) {}
+    inline void push_back(EntryId eid, WordValue wv)
+    {
+      entries.push_back(eid);
+      weights.push_back(wv);
+    }
     
     /**
-     * Compares the entry ids
-     * @param eid
-     * @return true iff this entry id is the same as eid
+     * Reserves memory for some items
+     * @param n number of items
      */
-    inline bool operator==(EntryId eid) const { return entry_id == eid; }
+    inline void reserve(size_t n)
+    {
+      entries.reserve(n);
+      weights.reserve(n);
+    }
+    
+    /**
+     * Checks if an entry has an item in the row
+     * @param eid entry id
+     * @return true iff eid is in the row
+     */
+    inline bool contains(EntryId eid) const
+    {
+      return std::binary_search(entries.begin() + head, entries.end(), eid);
+    }
+
+    /**
+     * Skips the items of the entries before some one, and releases the 
+     * skipped items when they are as many as the rest, so that each item
+     * is moved once on average
+     * @param first first entry id to keep
+     */
+    inline void trim(EntryId first)
+    {
+      while(head < entries.size() && entries[head] < first) ++head;
+      
+      if(head > 0 && head >= entries.size() - head)
+      {
+        entries.erase(entries.begin(), entries.begin() + head);
+        weights.erase(weights.begin(), weights.begin() + head);
+        head = 0;
+      }
+    }
   };
-  
-  /// Row of InvertedFile
-  typedef std::list<IFPair> IFRow;
   // IFRows are sorted in ascending entry_id order
   
   /// Inverted index
@@ -291,8 +642,8 @@ protected:
   /* Direct file declaration */
 
   /// Direct index
-  typedef std::vector<FeatureVector> DirectFile;
-  // DirectFile[entry_id] --> [ directentry, ... ]
+  typedef std::deque<FeatureVector> DirectFile;
+  // DirectFile[entry_id - first entry] --> [ directentry, ... ]
 
 protected:
 
@@ -312,17 +663,71 @@ protected:
   /// Direct file (resized for allocation)
   DirectFile m_dfile;
   
-  /// Number of valid entries in m_dfile
+  /// Number of entries added, which is the id of the next one
   int m_nentries;
+
+  /// Journal of the added and removed entries, or NULL if not used
+  DatabaseJournal *m_journal;
+
+  /// Removed flag of each entry kept (it may be shorter)
+  std::deque<bool> m_removed;
+
+  /// Number of removed entries
+  int m_nremoved;
+
+  /// Maximum number of entries kept, or 0
+  unsigned int m_capacity;
+
+  /// Id of the first entry kept
+  EntryId m_first;
+
+  /// Number of times the entries were renumbered, so that a journal
+  /// written before is not replayed
+  unsigned int m_generation;
+
+  /// Words of each entry kept, to trim their rows when they are evicted. 
+  /// Only used if m_capacity > 0
+  std::deque<std::vector<WordId> > m_window;
   
 };
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+const EntryId TemplatedDatabase<TDescriptor, F>::REMOVED_ENTRY;
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+struct TemplatedDatabase<TDescriptor, F>::Compaction
+{
+  /// Whether the entries are renumbered
+  bool renumber;
+
+  /// Number of entries and of removed entries of the database
+  unsigned int entries, removed;
+
+  /// First entry kept by the database
+  EntryId first;
+
+  /// New id of each entry
+  IdMap new_ids;
+
+  /// Words whose rows are replaced
+  std::vector<WordId> words;
+
+  /// New row of each word of words
+  std::vector<IFRow> rows;
+};
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 TemplatedDatabase<TDescriptor, F>::TemplatedDatabase
   (bool use_di, int di_levels)
-  : m_voc(NULL), m_use_di(use_di), m_dilevels(di_levels), m_nentries(0)
+  : m_voc(NULL), m_use_di(use_di), m_dilevels(di_levels), m_nentries(0),
+  m_journal(NULL), m_nremoved(0), m_capacity(0), m_first(0),
+  m_generation(0)
 {
 }
 
@@ -332,7 +737,9 @@ template<class TDescriptor, class F>
 template<class T>
 TemplatedDatabase<TDescriptor, F>::TemplatedDatabase
   (const T &voc, bool use_di, int di_levels)
-  : m_voc(NULL), m_use_di(use_di), m_dilevels(di_levels)
+  : m_voc(NULL), m_use_di(use_di), m_dilevels(di_levels), m_journal(NULL),
+  m_nremoved(0), m_capacity(0), m_first(0),
+  m_generation(0)
 {
   setVocabulary(voc);
   clear();
@@ -343,7 +750,8 @@ TemplatedDatabase<TDescriptor, F>::TemplatedDatabase
 template<class TDescriptor, class F>
 TemplatedDatabase<TDescriptor,F>::TemplatedDatabase
   (const TemplatedDatabase<TDescriptor,F> &db)
-  : m_voc(NULL)
+  : m_voc(NULL), m_journal(NULL), m_nremoved(0), m_capacity(0), m_first(0),
+  m_generation(0)
 {
   *this = db;
 }
@@ -353,7 +761,8 @@ TemplatedDatabase<TDescriptor,F>::TemplatedDatabase
 template<class TDescriptor, class F>
 TemplatedDatabase<TDescriptor, F>::TemplatedDatabase
   (const std::string &filename)
-  : m_voc(NULL)
+  : m_voc(NULL), m_journal(NULL), m_nremoved(0), m_capacity(0), m_first(0),
+  m_generation(0)
 {
   load(filename);
 }
@@ -363,7 +772,8 @@ TemplatedDatabase<TDescriptor, F>::TemplatedDatabase
 template<class TDescriptor, class F>
 TemplatedDatabase<TDescriptor, F>::TemplatedDatabase
   (const char *filename)
-  : m_voc(NULL)
+  : m_voc(NULL), m_journal(NULL), m_nremoved(0), m_capacity(0), m_first(0),
+  m_generation(0)
 {
   load(filename);
 }
@@ -373,6 +783,7 @@ TemplatedDatabase<TDescriptor, F>::TemplatedDatabase
 template<class TDescriptor, class F>
 TemplatedDatabase<TDescriptor, F>::~TemplatedDatabase(void)
 {
+  delete m_journal;
   delete m_voc;
 }
 
@@ -384,12 +795,23 @@ TemplatedDatabase<TDescriptor,F>& TemplatedDatabase<TDescriptor,F>::operator=
 {
   if(this != &db)
   {
+    closeJournal();
+
     m_dfile = db.m_dfile;
     m_dilevels = db.m_dilevels;
     m_ifile = db.m_ifile;
     m_nentries = db.m_nentries;
     m_use_di = db.m_use_di;
-    setVocabulary(*db.m_voc);
+    m_removed = db.m_removed;
+    m_nremoved = db.m_nremoved;
+    m_capacity = db.m_capacity;
+    m_first = db.m_first;
+    m_generation = db.m_generation;
+    m_window = db.m_window;
+    
+    // the vocabulary is cloned to keep its class
+    delete m_voc;
+    m_voc = (db.m_voc ? db.m_voc->clone() : NULL);
   }
   return *this;
 }
@@ -429,10 +851,57 @@ EntryId TemplatedDatabase<TDescriptor, F>::add(
 
 // ---------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+EntryId TemplatedDatabase<TDescriptor, F>::add(const cv::Mat &features,
+  BowVector *bowvec, FeatureVector *fvec, std::vector<WordId> *word_ids)
+{
+  return add(features.ptr<unsigned char>(), features.rows, features.step,
+    bowvec, fvec, word_ids);
+}
+
+// ---------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+EntryId TemplatedDatabase<TDescriptor, F>::add(const unsigned char *features,
+  int n, size_t stride, BowVector *bowvec, FeatureVector *fvec, 
+  std::vector<WordId> *word_ids)
+{
+  BowVector aux;
+  BowVector& v = (bowvec ? *bowvec : aux);
+  
+  if(m_use_di && fvec != NULL)
+  {
+    m_voc->transform(features, n, stride, v, *fvec, m_dilevels, word_ids);
+    return add(v, *fvec);
+  }
+  else if(m_use_di)
+  {
+    FeatureVector fv;
+    m_voc->transform(features, n, stride, v, fv, m_dilevels, word_ids);
+    return add(v, fv);
+  }
+  else if(fvec != NULL)
+  {
+    m_voc->transform(features, n, stride, v, *fvec, m_dilevels, word_ids);
+    return add(v);
+  }
+  else
+  {
+    m_voc->transform(features, n, stride, v, word_ids);
+    return add(v);
+  }
+}
+
+// ---------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 EntryId TemplatedDatabase<TDescriptor, F>::add(const BowVector &v,
   const FeatureVector &fv)
 {
+  // the entry is logged before it is added, so that a failure leaves
+  // the database unchanged
+  if(m_journal) m_journal->append(m_nentries, v, fv);
+
   EntryId entry_id = m_nentries++;
 
   BowVector::const_iterator vit;
@@ -440,13 +909,13 @@ EntryId TemplatedDatabase<TDescriptor, F>::add(const BowVector &v,
   if(m_use_di)
   {
     // update direct file
-    if(entry_id == m_dfile.size())
+    if(entry_id - m_first == m_dfile.size())
     {
       m_dfile.push_back(fv);
     }
     else
     {
-      m_dfile[entry_id] = fv;
+      m_dfile[entry_id - m_first] = fv;
     }
   }
   
@@ -456,8 +925,17 @@ EntryId TemplatedDatabase<TDescriptor, F>::add(const BowVector &v,
     const WordId& word_id = vit->first;
     const WordValue& word_weight = vit->second;
     
-    IFRow& ifrow = m_ifile[word_id];
-    ifrow.push_back(IFPair(entry_id, word_weight));
+    m_ifile[word_id].push_back(entry_id, word_weight);
+  }
+
+  if(m_capacity > 0)
+  {
+    m_window.push_back(std::vector<WordId>());
+    std::vector<WordId> &words = m_window.back();
+    words.reserve(v.size());
+    for(vit = v.begin(); vit != v.end(); ++vit) words.push_back(vit->first);
+
+    while((unsigned int)m_nentries - m_first > m_capacity) evict();
   }
   
   return entry_id;
@@ -492,83 +970,375 @@ inline void TemplatedDatabase<TDescriptor, F>::setVocabulary
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-inline const TemplatedVocabulary<TDescriptor,F>* 
-TemplatedDatabase<TDescriptor, F>::getVocabulary() const
+inline const TemplatedVocabulary<TDescriptor,F>* 
+TemplatedDatabase<TDescriptor, F>::getVocabulary() const
+{
+  return m_voc;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline void TemplatedDatabase<TDescriptor, F>::clear()
+{
+  closeJournal();
+
+  // resize vectors
+  m_ifile.resize(0);
+  m_ifile.resize(m_voc->size());
+  m_dfile.resize(0);
+  m_nentries = 0;
+  m_removed.clear();
+  m_nremoved = 0;
+  m_first = 0;
+  m_generation = 0;
+  m_window.clear();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::allocate(int nd, int ni)
+{
+  // m_ifile already contains |words| items
+  if(nd > 0 && ni > 0 && !m_ifile.empty())
+  {
+    const size_t n = ((size_t)nd * ni + m_ifile.size() - 1) / m_ifile.size();
+    
+    typename std::vector<IFRow>::iterator rit;
+    for(rit = m_ifile.begin(); rit != m_ifile.end(); ++rit)
+    {
+      rit->reserve(n); // does nothing if there is already room
+    }
+  }
+  
+  if(m_use_di && (int)m_dfile.size() < nd)
+  {
+    m_dfile.resize(nd);
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline unsigned int TemplatedDatabase<TDescriptor, F>::size() const
+{
+  return m_nentries;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline bool TemplatedDatabase<TDescriptor, F>::usingDirectIndex() const
+{
+  return m_use_di;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline int TemplatedDatabase<TDescriptor, F>::getDirectIndexLevels() const
+{
+  return m_dilevels;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::remove(EntryId id)
+{
+  if(id >= (EntryId)m_nentries || id < m_first || isRemoved(id))
+    throw std::string("Cannot remove entry ") + std::to_string(id) + 
+      " from the database";
+
+  // as in add, a failure leaves the database unchanged
+  if(m_journal) m_journal->appendRemoval(id);
+
+  markRemoved(id);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::markRemoved(EntryId id)
+{
+  const size_t i = id - m_first;
+  if(m_removed.size() <= i) m_removed.resize(m_nentries - m_first, false);
+  m_removed[i] = true;
+  ++m_nremoved;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline bool TemplatedDatabase<TDescriptor, F>::isRemoved(EntryId id) const
+{
+  return id >= m_first && id - m_first < m_removed.size() && 
+    m_removed[id - m_first];
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline unsigned int TemplatedDatabase<TDescriptor, F>::removedSize() const
+{
+  return m_nremoved;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::setCapacity(unsigned int capacity)
+{
+  m_capacity = capacity;
+
+  if(capacity == 0)
+  {
+    std::deque<std::vector<WordId> >().swap(m_window);
+    return;
+  }
+
+  // the window is not kept without capacity, and not saved
+  if(m_window.size() != (size_t)(m_nentries - m_first)) buildWindow();
+
+  while((unsigned int)m_nentries - m_first > m_capacity) evict();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline unsigned int TemplatedDatabase<TDescriptor, F>::getCapacity() const
+{
+  return m_capacity;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline EntryId TemplatedDatabase<TDescriptor, F>::getFirstEntry() const
+{
+  return m_first;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::evict()
+{
+  ++m_first;
+
+  // the items of the entry are the first ones kept in the rows of its words
+  const std::vector<WordId> &words = m_window.front();
+  for(size_t i = 0; i < words.size(); ++i)
+    m_ifile[words[i]].trim(m_first);
+  m_window.pop_front();
+
+  if(!m_dfile.empty()) m_dfile.pop_front();
+
+  if(!m_removed.empty())
+  {
+    if(m_removed.front()) --m_nremoved;
+    m_removed.pop_front();
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::buildWindow()
+{
+  m_window.assign(m_nentries - m_first, std::vector<WordId>());
+
+  for(WordId wid = 0; wid < m_ifile.size(); ++wid)
+  {
+    const IFRow &row = m_ifile[wid];
+    for(size_t i = row.head; i < row.entries.size(); ++i)
+      m_window[row.entries[i] - m_first].push_back(wid);
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::compact(bool renumber,
+  IdMap *new_ids)
 {
-  return m_voc;
+  if(renumber && m_journal && (m_nremoved > 0 || m_first > 0))
+  {
+    // checked before the work of prepareCompaction
+    throw std::string("Cannot renumber the entries of a database while "
+      "its journal is open");
+  }
+
+  Compaction c;
+  prepareCompaction(c, renumber);
+  applyCompaction(c, new_ids);
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-inline void TemplatedDatabase<TDescriptor, F>::clear()
+void TemplatedDatabase<TDescriptor, F>::prepareCompaction(Compaction &c,
+  bool renumber) const
 {
-  // resize vectors
-  m_ifile.resize(0);
-  m_ifile.resize(m_voc->size());
-  m_dfile.resize(0);
-  m_nentries = 0;
+  c.renumber = renumber;
+  c.entries = m_nentries;
+  c.removed = m_nremoved;
+  c.first = m_first;
+  c.words.clear();
+  c.rows.clear();
+
+  // the rows with items of entries from first_changed on are replaced
+  const EntryId end = m_nentries;
+  EntryId first_changed = end;
+
+  // only the entries kept are mapped, which are few if the capacity is
+  // limited
+  c.new_ids.first = m_first;
+  c.new_ids.ids.resize(m_nentries - m_first);
+  EntryId next = 0;
+  for(EntryId id = m_first; id < end; ++id)
+  {
+    EntryId &nid = c.new_ids.ids[id - m_first];
+    if(isRemoved(id))
+      nid = REMOVED_ENTRY;
+    else
+      nid = (renumber ? next++ : id);
+
+    if(nid != id && first_changed == end) first_changed = id;
+  }
+
+  if(first_changed == end) return;
+
+  for(WordId wid = 0; wid < m_ifile.size(); ++wid)
+  {
+    const IFRow &row = m_ifile[wid];
+    if(row.empty() || row.entries.back() < first_changed) continue;
+
+    size_t kept = 0;
+    for(size_t i = row.head; i < row.entries.size(); ++i)
+      if(!isRemoved(row.entries[i])) ++kept;
+
+    if(kept == row.size() && !renumber) continue;
+
+    // the new row is allocated with its exact size, so that the room of 
+    // the purged items is released
+    c.words.push_back(wid);
+    c.rows.push_back(IFRow());
+    IFRow &new_row = c.rows.back();
+    new_row.reserve(kept);
+
+    for(size_t i = row.head; i < row.entries.size(); ++i)
+    {
+      const EntryId eid = row.entries[i];
+      if(!isRemoved(eid))
+        new_row.push_back(c.new_ids[eid], row.weights[i]);
+    }
+  }
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-void TemplatedDatabase<TDescriptor, F>::allocate(int nd, int ni)
+void TemplatedDatabase<TDescriptor, F>::applyCompaction(Compaction &c,
+  IdMap *new_ids)
 {
-  // m_ifile already contains |words| items
-  if(ni > 0)
+  if(c.entries != (unsigned int)m_nentries || 
+    c.removed != (unsigned int)m_nremoved || c.first != m_first ||
+    (!c.words.empty() && c.words.back() >= m_ifile.size()))
   {
-    typename std::vector<IFRow>::iterator rit;
-    for(rit = m_ifile.begin(); rit != m_ifile.end(); ++rit)
+    throw std::string("The database was modified after preparing its "
+      "compaction");
+  }
+
+  // the ids of the journal would not match the snapshot any more
+  if(c.renumber && m_journal && (m_nremoved > 0 || m_first > 0))
+    throw std::string("Cannot renumber the entries of a database while "
+      "its journal is open");
+
+  for(size_t i = 0; i < c.words.size(); ++i)
+    std::swap(m_ifile[c.words[i]], c.rows[i]);
+
+  c.words.clear();
+  c.rows.clear();
+
+  if(c.renumber)
+  {
+    // the new ids start at 0, so they are the new indexes of the entries
+    const EntryId stored = m_nentries - m_first;
+    EntryId kept = 0;
+    for(EntryId i = 0; i < stored; ++i)
     {
-      int n = (int)rit->size();
-      if(ni > n)
-      {
-        rit->resize(ni);
-        rit->resize(n);
-      }
+      const EntryId nid = c.new_ids.ids[i];
+      if(nid == REMOVED_ENTRY) continue;
+      if(m_use_di && nid != i) m_dfile[nid].swap(m_dfile[i]);
+      if(m_capacity > 0 && nid != i) m_window[nid].swap(m_window[i]);
+      ++kept;
     }
+
+    // the rows preallocated by allocate after the entries are kept
+    if(m_use_di)
+      m_dfile.erase(m_dfile.begin() + kept, m_dfile.begin() + stored);
+    if(m_capacity > 0) m_window.resize(kept);
+
+    // the ids only change if some entries were dropped
+    if(m_nremoved > 0 || m_first > 0) ++m_generation;
+
+    m_nentries = kept;
+    m_first = 0;
+    m_removed.clear();
+    m_nremoved = 0;
   }
-  
-  if(m_use_di && (int)m_dfile.size() < nd)
+  else
   {
-    m_dfile.resize(nd);
+    for(size_t i = 0; i < m_removed.size(); ++i)
+    {
+      if(!m_removed[i]) continue;
+      if(m_use_di) FeatureVector().swap(m_dfile[i]);
+      if(m_capacity > 0) std::vector<WordId>().swap(m_window[i]);
+    }
   }
-}
-
-// --------------------------------------------------------------------------
 
-template<class TDescriptor, class F>
-inline unsigned int TemplatedDatabase<TDescriptor, F>::size() const
-{
-  return m_nentries;
+  if(new_ids)
+  {
+    new_ids->first = c.new_ids.first;
+    new_ids->ids.swap(c.new_ids.ids);
+  }
+  c.new_ids.ids.clear();
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-inline bool TemplatedDatabase<TDescriptor, F>::usingDirectIndex() const
+void TemplatedDatabase<TDescriptor, F>::query(
+  const std::vector<TDescriptor> &features,
+  QueryResults &ret, int max_results, int max_id) const
 {
-  return m_use_di;
+  BowVector vec;
+  m_voc->transform(features, vec);
+  query(vec, ret, max_results, max_id);
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-inline int TemplatedDatabase<TDescriptor, F>::getDirectIndexLevels() const
+void TemplatedDatabase<TDescriptor, F>::query(const cv::Mat &features,
+  QueryResults &ret, int max_results, int max_id, 
+  std::vector<WordId> *word_ids) const
 {
-  return m_dilevels;
+  query(features.ptr<unsigned char>(), features.rows, features.step,
+    ret, max_results, max_id, word_ids);
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-void TemplatedDatabase<TDescriptor, F>::query(
-  const std::vector<TDescriptor> &features,
-  QueryResults &ret, int max_results, int max_id) const
+void TemplatedDatabase<TDescriptor, F>::query(const unsigned char *features,
+  int n, size_t stride, QueryResults &ret, int max_results, int max_id,
+  std::vector<WordId> *word_ids) const
 {
   BowVector vec;
-  m_voc->transform(features, vec);
+  m_voc->transform(features, n, stride, vec, word_ids);
   query(vec, ret, max_results, max_id);
 }
 
@@ -611,15 +1381,38 @@ void TemplatedDatabase<TDescriptor, F>::query(
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::sortResults(QueryResults &ret,
+  int max_results, bool descending)
+{
+  auto better = [descending](const Result &a, const Result &b)
+    {
+      if(a.Score != b.Score)
+        return (descending ? a.Score > b.Score : a.Score < b.Score);
+      return a.Id < b.Id;
+    };
+  
+  if(max_results > 0 && (int)ret.size() > max_results)
+  {
+    // O(n) selection, so that only the kept results are sorted
+    std::nth_element(ret.begin(), ret.begin() + (max_results - 1), 
+      ret.end(), better);
+    ret.resize(max_results);
+  }
+  
+  std::sort(ret.begin(), ret.end(), better);
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 void TemplatedDatabase<TDescriptor, F>::queryL1(const BowVector &vec, 
   QueryResults &ret, int max_results, int max_id) const
 {
   BowVector::const_iterator vit;
-  typename IFRow::const_iterator rit;
     
-  std::map<EntryId, double> pairs;
-  std::map<EntryId, double>::iterator pit;
+  ScoreAccumulator &acc = ScoreAccumulator::local();
+  acc.reset(m_first, m_nentries - m_first);
   
   for(vit = vec.begin(); vit != vec.end(); ++vit)
   {
@@ -630,46 +1423,35 @@ void TemplatedDatabase<TDescriptor, F>::queryL1(const BowVector &vec,
     
     // IFRows are sorted in ascending entry_id order
     
-    for(rit = row.begin(); rit != row.end(); ++rit)
+    for(size_t i = row.head; i < row.entries.size(); ++i)
     {
-      const EntryId entry_id = rit->entry_id;
-      const WordValue& dvalue = rit->word_weight;
+      const EntryId entry_id = row.entries[i];
+      const WordValue& dvalue = row.weights[i];
       
       if((int)entry_id < max_id || max_id == -1)
       {
         double value = fabs(qvalue - dvalue) - fabs(qvalue) - fabs(dvalue);
         
-        pit = pairs.lower_bound(entry_id);
-        if(pit != pairs.end() && !(pairs.key_comp()(entry_id, pit->first)))
-        {
-          pit->second += value;
-        }
-        else
-        {
-          pairs.insert(pit, 
-            std::map<EntryId, double>::value_type(entry_id, value));
-        }
+        acc.at(entry_id).score += value;
       }
       
     } // for each inverted row
   } // for each query word
 	
   // move to vector
-  ret.reserve(pairs.size());
-  for(pit = pairs.begin(); pit != pairs.end(); ++pit)
+  const std::vector<EntryId> &touched = acc.sortTouched();
+  ret.reserve(touched.size());
+  for(size_t i = 0; i < touched.size(); ++i)
   {
-    ret.push_back(Result(pit->first, pit->second));
+    if(isRemoved(touched[i])) continue;
+    ret.push_back(Result(touched[i], acc.at(touched[i]).score));
   }
 	
   // resulting "scores" are now in [-2 best .. 0 worst]	
   
-  // sort vector in ascending order of score
-  std::sort(ret.begin(), ret.end());
+  // keep the best results, sorted in ascending order of score
+  sortResults(ret, max_results, false);
   // (ret is inverted now --the lower the better--)
-
-  // cut vector
-  if(max_results > 0 && (int)ret.size() > max_results)
-    ret.resize(max_results);
   
   // complete and scale score to [0 worst .. 1 best]
   // ||v - w||_{L1} = 2 + Sum(|v_i - w_i| - |v_i| - |w_i|) 
@@ -688,13 +1470,9 @@ void TemplatedDatabase<TDescriptor, F>::queryL2(const BowVector &vec,
   QueryResults &ret, int max_results, int max_id) const
 {
   BowVector::const_iterator vit;
-  typename IFRow::const_iterator rit;
   
-  std::map<EntryId, double> pairs;
-  std::map<EntryId, double>::iterator pit;
-  
-  //map<EntryId, int> counters;
-  //map<EntryId, int>::iterator cit;
+  ScoreAccumulator &acc = ScoreAccumulator::local();
+  acc.reset(m_first, m_nentries - m_first);
   
   for(vit = vec.begin(); vit != vec.end(); ++vit)
   {
@@ -705,53 +1483,36 @@ void TemplatedDatabase<TDescriptor, F>::queryL2(const BowVector &vec,
     
     // IFRows are sorted in ascending entry_id order
     
-    for(rit = row.begin(); rit != row.end(); ++rit)
+    for(size_t i = row.head; i < row.entries.size(); ++i)
     {
-      const EntryId entry_id = rit->entry_id;
-      const WordValue& dvalue = rit->word_weight;
+      const EntryId entry_id = row.entries[i];
+      const WordValue& dvalue = row.weights[i];
       
       if((int)entry_id < max_id || max_id == -1)
       {
         double value = - qvalue * dvalue; // minus sign for sorting trick
         
-        pit = pairs.lower_bound(entry_id);
-        //cit = counters.lower_bound(entry_id);
-        if(pit != pairs.end() && !(pairs.key_comp()(entry_id, pit->first)))
-        {
-          pit->second += value; 
-          //cit->second += 1;
-        }
-        else
-        {
-          pairs.insert(pit, 
-            std::map<EntryId, double>::value_type(entry_id, value));
-          
-          //counters.insert(cit, 
-          //  map<EntryId, int>::value_type(entry_id, 1));
-        }
+        acc.at(entry_id).score += value;
       }
       
     } // for each inverted row
   } // for each query word
 	
   // move to vector
-  ret.reserve(pairs.size());
-  //cit = counters.begin();
-  for(pit = pairs.begin(); pit != pairs.end(); ++pit)//, ++cit)
+  const std::vector<EntryId> &touched = acc.sortTouched();
+  ret.reserve(touched.size());
+  for(size_t i = 0; i < touched.size(); ++i)
   {
-    ret.push_back(Result(pit->first, pit->second));// / cit->second));
+    if(isRemoved(touched[i])) continue;
+    ret.push_back(Result(touched[i], acc.at(touched[i]).score));
   }
 	
   // resulting "scores" are now in [-1 best .. 0 worst]	
   
-  // sort vector in ascending order of score
-  std::sort(ret.begin(), ret.end());
+  // keep the best results, sorted in ascending order of score
+  sortResults(ret, max_results, false);
   // (ret is inverted now --the lower the better--)
 
-  // cut vector
-  if(max_results > 0 && (int)ret.size() > max_results)
-    ret.resize(max_results);
-
   // complete and scale score to [0 worst .. 1 best]
   // ||v - w||_{L2} = sqrt( 2 - 2 * Sum(v_i * w_i) 
 	//		for all i | v_i != 0 and w_i != 0 )
@@ -776,19 +1537,13 @@ void TemplatedDatabase<TDescriptor, F>::queryChiSquare(const BowVector &vec,
   QueryResults &ret, int max_results, int max_id) const
 {
   BowVector::const_iterator vit;
-  typename IFRow::const_iterator rit;
-  
-  std::map<EntryId, std::pair<double, int> > pairs;
-  std::map<EntryId, std::pair<double, int> >::iterator pit;
   
-  std::map<EntryId, std::pair<double, double> > sums; // < sum vi, sum wi >
-  std::map<EntryId, std::pair<double, double> >::iterator sit;
+  // slots with score, number of common words, sum vi and sum wi
+  ScoreAccumulator &acc = ScoreAccumulator::local();
+  acc.reset(m_first, m_nentries - m_first);
   
   // In the current implementation, we suppose vec is not normalized
   
-  //map<EntryId, double> expected;
-  //map<EntryId, double>::iterator eit;
-  
   for(vit = vec.begin(); vit != vec.end(); ++vit)
   {
     const WordId word_id = vit->first;
@@ -798,10 +1553,10 @@ void TemplatedDatabase<TDescriptor, F>::queryChiSquare(const BowVector &vec,
     
     // IFRows are sorted in ascending entry_id order
     
-    for(rit = row.begin(); rit != row.end(); ++rit)
+    for(size_t i = row.head; i < row.entries.size(); ++i)
     {
-      const EntryId entry_id = rit->entry_id;
-      const WordValue& dvalue = rit->word_weight;
+      const EntryId entry_id = row.entries[i];
+      const WordValue& dvalue = row.weights[i];
       
       if((int)entry_id < max_id || max_id == -1)
       {
@@ -811,63 +1566,40 @@ void TemplatedDatabase<TDescriptor, F>::queryChiSquare(const BowVector &vec,
         if(qvalue + dvalue != 0.0) // words may have weight zero
           value = - qvalue * dvalue / (qvalue + dvalue);
         
-        pit = pairs.lower_bound(entry_id);
-        sit = sums.lower_bound(entry_id);
-        //eit = expected.lower_bound(entry_id);
-        if(pit != pairs.end() && !(pairs.key_comp()(entry_id, pit->first)))
-        {
-          pit->second.first += value;
-          pit->second.second += 1;
-          //eit->second += dvalue;
-          sit->second.first += qvalue;
-          sit->second.second += dvalue;
-        }
-        else
-        {
-          pairs.insert(pit, 
-            std::map<EntryId, std::pair<double, int> >::value_type(entry_id,
-              std::make_pair(value, 1) ));
-          //expected.insert(eit, 
-          //  map<EntryId, double>::value_type(entry_id, dvalue));
-          
-          sums.insert(sit, 
-            std::map<EntryId, std::pair<double, double> >::value_type(entry_id,
-              std::make_pair(qvalue, dvalue) ));
-        }
+        ScoreAccumulator::Slot &slot = acc.at(entry_id);
+        slot.score += value;
+        slot.count += 1;
+        slot.sum_v += qvalue;
+        slot.sum_w += dvalue;
       }
       
     } // for each inverted row
   } // for each query word
 	
   // move to vector
-  ret.reserve(pairs.size());
-  sit = sums.begin();
-  for(pit = pairs.begin(); pit != pairs.end(); ++pit, ++sit)
+  const std::vector<EntryId> &touched = acc.sortTouched();
+  ret.reserve(touched.size());
+  for(size_t i = 0; i < touched.size(); ++i)
   {
-    if(pit->second.second >= MIN_COMMON_WORDS)
+    const ScoreAccumulator::Slot &slot = acc.at(touched[i]);
+    if(slot.count >= MIN_COMMON_WORDS && !isRemoved(touched[i]))
     {
-      ret.push_back(Result(pit->first, pit->second.first));
-      ret.back().nWords = pit->second.second;
-      ret.back().sumCommonVi = sit->second.first;
-      ret.back().sumCommonWi = sit->second.second;
+      ret.push_back(Result(touched[i], slot.score));
+      ret.back().nWords = slot.count;
+      ret.back().sumCommonVi = slot.sum_v;
+      ret.back().sumCommonWi = slot.sum_w;
       ret.back().expectedChiScore = 
-        2 * sit->second.second / (1 + sit->second.second);
+        2 * slot.sum_w / (1 + slot.sum_w);
     }
-  
-    //ret.push_back(Result(pit->first, pit->second));
   }
 	
   // resulting "scores" are now in [-2 best .. 0 worst]	
   // we have to add +2 to the scores to obtain the chi square score
   
-  // sort vector in ascending order of score
-  std::sort(ret.begin(), ret.end());
+  // keep the best results, sorted in ascending order of score
+  sortResults(ret, max_results, false);
   // (ret is inverted now --the lower the better--)
 
-  // cut vector
-  if(max_results > 0 && (int)ret.size() > max_results)
-    ret.resize(max_results);
-
   // complete and scale score to [0 worst .. 1 best]
   QueryResults::iterator qit;
   for(qit = ret.begin(); qit != ret.end(); qit++)
@@ -887,10 +1619,9 @@ void TemplatedDatabase<TDescriptor, F>::queryKL(const BowVector &vec,
   QueryResults &ret, int max_results, int max_id) const
 {
   BowVector::const_iterator vit;
-  typename IFRow::const_iterator rit;
   
-  std::map<EntryId, double> pairs;
-  std::map<EntryId, double>::iterator pit;
+  ScoreAccumulator &acc = ScoreAccumulator::local();
+  acc.reset(m_first, m_nentries - m_first);
   
   for(vit = vec.begin(); vit != vec.end(); ++vit)
   {
@@ -901,26 +1632,17 @@ void TemplatedDatabase<TDescriptor, F>::queryKL(const BowVector &vec,
     
     // IFRows are sorted in ascending entry_id order
     
-    for(rit = row.begin(); rit != row.end(); ++rit)
-    {    
-      const EntryId entry_id = rit->entry_id;
-      const WordValue& wi = rit->word_weight;
+    for(size_t i = row.head; i < row.entries.size(); ++i)
+    {
+      const EntryId entry_id = row.entries[i];
+      const WordValue& wi = row.weights[i];
       
       if((int)entry_id < max_id || max_id == -1)
       {
         double value = 0;
         if(vi != 0 && wi != 0) value = vi * log(vi/wi);
         
-        pit = pairs.lower_bound(entry_id);
-        if(pit != pairs.end() && !(pairs.key_comp()(entry_id, pit->first)))
-        {
-          pit->second += value;
-        }
-        else
-        {
-          pairs.insert(pit, 
-            std::map<EntryId, double>::value_type(entry_id, value));
-        }
+        acc.at(entry_id).score += value;
       }
       
     } // for each inverted row
@@ -931,10 +1653,13 @@ void TemplatedDatabase<TDescriptor, F>::queryKL(const BowVector &vec,
   // the complete score
 
   // complete scores and move to vector
-  ret.reserve(pairs.size());
-  for(pit = pairs.begin(); pit != pairs.end(); ++pit)
+  const std::vector<EntryId> &touched = acc.sortTouched();
+  ret.reserve(touched.size());
+  for(size_t i = 0; i < touched.size(); ++i)
   {
-    EntryId eid = pit->first;
+    EntryId eid = touched[i];
+    if(isRemoved(eid)) continue;
+    
     double value = 0.0;
 
     for(vit = vec.begin(); vit != vec.end(); ++vit)
@@ -944,28 +1669,25 @@ void TemplatedDatabase<TDescriptor, F>::queryKL(const BowVector &vec,
 
       if(vi != 0)
       {
-        if(row.end() == find(row.begin(), row.end(), eid ))
+        if(!row.contains(eid))
         {
           value += vi * (log(vi) - GeneralScoring::LOG_EPS);
         }
       }
     }
     
-    pit->second += value;
+    ScoreAccumulator::Slot &slot = acc.at(eid);
+    slot.score += value;
     
     // to vector
-    ret.push_back(Result(pit->first, pit->second));
+    ret.push_back(Result(eid, slot.score));
   }
   
   // real scores are now in [0 best .. X worst]
 
-  // sort vector in ascending order
+  // keep the best results, sorted in ascending order
   // (scores are inverted now --the lower the better--)
-  std::sort(ret.begin(), ret.end());
-
-  // cut vector
-  if(max_results > 0 && (int)ret.size() > max_results)
-    ret.resize(max_results);
+  sortResults(ret, max_results, false);
 
   // cannot scale scores
     
@@ -978,13 +1700,10 @@ void TemplatedDatabase<TDescriptor, F>::queryBhattacharyya(
   const BowVector &vec, QueryResults &ret, int max_results, int max_id) const
 {
   BowVector::const_iterator vit;
-  typename IFRow::const_iterator rit;
   
-  //map<EntryId, double> pairs;
-  //map<EntryId, double>::iterator pit;
-  
-  std::map<EntryId, std::pair<double, int> > pairs; // <eid, <score, counter> >
-  std::map<EntryId, std::pair<double, int> >::iterator pit;
+  // slots with score and number of common words
+  ScoreAccumulator &acc = ScoreAccumulator::local();
+  acc.reset(m_first, m_nentries - m_first);
   
   for(vit = vec.begin(); vit != vec.end(); ++vit)
   {
@@ -995,52 +1714,41 @@ void TemplatedDatabase<TDescriptor, F>::queryBhattacharyya(
     
     // IFRows are sorted in ascending entry_id order
     
-    for(rit = row.begin(); rit != row.end(); ++rit)
+    for(size_t i = row.head; i < row.entries.size(); ++i)
     {
-      const EntryId entry_id = rit->entry_id;
-      const WordValue& dvalue = rit->word_weight;
+      const EntryId entry_id = row.entries[i];
+      const WordValue& dvalue = row.weights[i];
       
       if((int)entry_id < max_id || max_id == -1)
       {
         double value = sqrt(qvalue * dvalue);
         
-        pit = pairs.lower_bound(entry_id);
-        if(pit != pairs.end() && !(pairs.key_comp()(entry_id, pit->first)))
-        {
-          pit->second.first += value;
-          pit->second.second += 1;
-        }
-        else
-        {
-          pairs.insert(pit, 
-            std::map<EntryId, std::pair<double, int> >::value_type(entry_id,
-              std::make_pair(value, 1)));
-        }
+        ScoreAccumulator::Slot &slot = acc.at(entry_id);
+        slot.score += value;
+        slot.count += 1;
       }
       
     } // for each inverted row
   } // for each query word
 	
   // move to vector
-  ret.reserve(pairs.size());
-  for(pit = pairs.begin(); pit != pairs.end(); ++pit)
+  const std::vector<EntryId> &touched = acc.sortTouched();
+  ret.reserve(touched.size());
+  for(size_t i = 0; i < touched.size(); ++i)
   {
-    if(pit->second.second >= MIN_COMMON_WORDS)
+    const ScoreAccumulator::Slot &slot = acc.at(touched[i]);
+    if(slot.count >= MIN_COMMON_WORDS && !isRemoved(touched[i]))
     {
-      ret.push_back(Result(pit->first, pit->second.first));
-      ret.back().nWords = pit->second.second;
-      ret.back().bhatScore = pit->second.first;
+      ret.push_back(Result(touched[i], slot.score));
+      ret.back().nWords = slot.count;
+      ret.back().bhatScore = slot.score;
     }
   }
 	
   // scores are already in [0..1]
 
-  // sort vector in descending order
-  std::sort(ret.begin(), ret.end(), Result::gt);
-
-  // cut vector
-  if(max_results > 0 && (int)ret.size() > max_results)
-    ret.resize(max_results);
+  // keep the best results, sorted in descending order
+  sortResults(ret, max_results, true);
 
 }
 
@@ -1051,10 +1759,9 @@ void TemplatedDatabase<TDescriptor, F>::queryDotProduct(
   const BowVector &vec, QueryResults &ret, int max_results, int max_id) const
 {
   BowVector::const_iterator vit;
-  typename IFRow::const_iterator rit;
   
-  std::map<EntryId, double> pairs;
-  std::map<EntryId, double>::iterator pit;
+  ScoreAccumulator &acc = ScoreAccumulator::local();
+  acc.reset(m_first, m_nentries - m_first);
   
   for(vit = vec.begin(); vit != vec.end(); ++vit)
   {
@@ -1065,10 +1772,10 @@ void TemplatedDatabase<TDescriptor, F>::queryDotProduct(
     
     // IFRows are sorted in ascending entry_id order
     
-    for(rit = row.begin(); rit != row.end(); ++rit)
+    for(size_t i = row.head; i < row.entries.size(); ++i)
     {
-      const EntryId entry_id = rit->entry_id;
-      const WordValue& dvalue = rit->word_weight;
+      const EntryId entry_id = row.entries[i];
+      const WordValue& dvalue = row.weights[i];
       
       if((int)entry_id < max_id || max_id == -1)
       {
@@ -1078,36 +1785,25 @@ void TemplatedDatabase<TDescriptor, F>::queryDotProduct(
         else
           value = qvalue * dvalue;
         
-        pit = pairs.lower_bound(entry_id);
-        if(pit != pairs.end() && !(pairs.key_comp()(entry_id, pit->first)))
-        {
-          pit->second += value;
-        }
-        else
-        {
-          pairs.insert(pit, 
-            std::map<EntryId, double>::value_type(entry_id, value));
-        }
+        acc.at(entry_id).score += value;
       }
       
     } // for each inverted row
   } // for each query word
 	
   // move to vector
-  ret.reserve(pairs.size());
-  for(pit = pairs.begin(); pit != pairs.end(); ++pit)
+  const std::vector<EntryId> &touched = acc.sortTouched();
+  ret.reserve(touched.size());
+  for(size_t i = 0; i < touched.size(); ++i)
   {
-    ret.push_back(Result(pit->first, pit->second));
+    if(isRemoved(touched[i])) continue;
+    ret.push_back(Result(touched[i], acc.at(touched[i]).score));
   }
 	
   // scores are the greater the better
 
-  // sort vector in descending order
-  std::sort(ret.begin(), ret.end(), Result::gt);
-
-  // cut vector
-  if(max_results > 0 && (int)ret.size() > max_results)
-    ret.resize(max_results);
+  // keep the best results, sorted in descending order
+  sortResults(ret, max_results, true);
 
   // these scores cannot be scaled
 }
@@ -1119,7 +1815,12 @@ const FeatureVector& TemplatedDatabase<TDescriptor, F>::retrieveFeatures
   (EntryId id) const
 {
   assert(id < size());
-  return m_dfile[id];
+  if(id < m_first)
+  {
+    static const FeatureVector evicted;
+    return evicted;
+  }
+  return m_dfile[id - m_first];
 }
 
 // --------------------------------------------------------------------------
@@ -1146,6 +1847,8 @@ void TemplatedDatabase<TDescriptor, F>::save(cv::FileStorage &fs,
   //   nEntries: 
   //   usingDI: 
   //   diLevels: 
+  //   firstEntry: 
+  //   generation: 
   //   invertedIndex
   //   [
   //     [
@@ -1164,10 +1867,13 @@ void TemplatedDatabase<TDescriptor, F>::save(cv::FileStorage &fs,
   //        }
   //      ]
   //   ]
+  //   removedEntries: [ ]
+  // }
 
   // invertedIndex[i] is for the i-th word
-  // directIndex[i] is for the i-th entry
+  // directIndex[i] is for the entry firstEntry + i
   // directIndex may be empty if not using direct index
+  // firstEntry, generation and removedEntries may be missing in old files
   //
   // imageId's and nodeId's must be stored in ascending order
   // (according to the construction of the indexes)
@@ -1179,19 +1885,20 @@ void TemplatedDatabase<TDescriptor, F>::save(cv::FileStorage &fs,
   fs << "nEntries" << m_nentries;
   fs << "usingDI" << (m_use_di ? 1 : 0);
   fs << "diLevels" << m_dilevels;
+  fs << "firstEntry" << (int)m_first;
+  fs << "generation" << (int)m_generation;
   
   fs << "invertedIndex" << "[";
   
   typename InvertedFile::const_iterator iit;
-  typename IFRow::const_iterator irit;
   for(iit = m_ifile.begin(); iit != m_ifile.end(); ++iit)
   {
     fs << "["; // word of IF
-    for(irit = iit->begin(); irit != iit->end(); ++irit)
+    for(size_t i = iit->head; i < iit->entries.size(); ++i)
     {
       fs << "{:" 
-        << "imageId" << (int)irit->entry_id
-        << "weight" << irit->word_weight
+        << "imageId" << (int)iit->entries[i]
+        << "weight" << iit->weights[i]
         << "}";
     }
     fs << "]"; // word of IF
@@ -1226,6 +1933,13 @@ void TemplatedDatabase<TDescriptor, F>::save(cv::FileStorage &fs,
   }
   
   fs << "]"; // directIndex
+
+  fs << "removedEntries" << "[:";
+  for(size_t i = 0; i < m_removed.size(); ++i)
+  {
+    if(m_removed[i]) fs << (int)(m_first + i);
+  }
+  fs << "]"; // removedEntries
   
   fs << "}"; // database
 }
@@ -1235,6 +1949,13 @@ void TemplatedDatabase<TDescriptor, F>::save(cv::FileStorage &fs,
 template<class TDescriptor, class F>
 void TemplatedDatabase<TDescriptor, F>::load(const std::string &filename)
 {
+  if(DatabaseFile::isDatabaseFile(filename))
+  {
+    loadBinary(filename, 
+      std::integral_constant<bool, HasArray8U<F>::value>());
+    return;
+  }
+
   cv::FileStorage fs(filename.c_str(), cv::FileStorage::READ);
   if(!fs.isOpened()) throw std::string("Could not open file ") + filename;
   
@@ -1261,6 +1982,8 @@ void TemplatedDatabase<TDescriptor, F>::load(const cv::FileStorage &fs,
   m_nentries = (int)fdb["nEntries"]; 
   m_use_di = (int)fdb["usingDI"] != 0;
   m_dilevels = (int)fdb["diLevels"];
+  m_first = (int)fdb["firstEntry"];
+  m_generation = (int)fdb["generation"];
   
   cv::FileNode fn = fdb["invertedIndex"];
   for(WordId wid = 0; wid < fn.size(); ++wid)
@@ -1272,7 +1995,7 @@ void TemplatedDatabase<TDescriptor, F>::load(const cv::FileStorage &fs,
       EntryId eid = (int)fw[i]["imageId"];
       WordValue v = fw[i]["weight"];
       
-      m_ifile[wid].push_back(IFPair(eid, v));
+      m_ifile[wid].push_back(eid, v);
     }
   }
   
@@ -1281,7 +2004,7 @@ void TemplatedDatabase<TDescriptor, F>::load(const cv::FileStorage &fs,
     fn = fdb["directIndex"];
     
     m_dfile.resize(fn.size());
-    assert(m_nentries == (int)fn.size());
+    assert(m_nentries - (int)m_first == (int)fn.size());
     
     FeatureVector::iterator dit;
     for(EntryId eid = 0; eid < fn.size(); ++eid)
@@ -1316,11 +2039,287 @@ void TemplatedDatabase<TDescriptor, F>::load(const cv::FileStorage &fs,
       }
     } // for each entry
   } // if use_id
+
+  fn = fdb["removedEntries"];
+  for(unsigned int i = 0; i < fn.size(); ++i)
+  {
+    EntryId eid = (int)fn[i];
+    if(eid >= m_first && eid < (EntryId)m_nentries && !isRemoved(eid)) 
+      markRemoved(eid);
+  }
+
+  // evicts the entries beyond the capacity of this database
+  if(m_capacity > 0) setCapacity(m_capacity);
   
 }
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::saveBinary(
+  const std::string &filename, bool embed_vocabulary, bool compress) const
+{
+  DatabaseFile file;
+  file.entries = m_nentries;
+  file.first_entry = m_first;
+  file.generation = m_generation;
+  file.direct_index = m_use_di;
+  file.di_levels = m_dilevels;
+
+  if(embed_vocabulary)
+  {
+    m_voc->saveBinary(file.vocabulary);
+
+    VocabularyFile::Header header;
+    memcpy(&header, file.vocabulary.data(), sizeof(header));
+    file.vocabulary_hash = header.checksum;
+  }
+  else
+  {
+    file.vocabulary_hash = m_voc->getBinaryHash();
+  }
+
+  // inverted index
+  size_t items = 0;
+  typename InvertedFile::const_iterator iit;
+  for(iit = m_ifile.begin(); iit != m_ifile.end(); ++iit)
+    items += iit->size();
+
+  file.word_items.reserve(m_ifile.size());
+  file.item_entries.reserve(items);
+  file.item_weights.reserve(items);
+
+  for(iit = m_ifile.begin(); iit != m_ifile.end(); ++iit)
+  {
+    file.word_items.push_back(iit->size());
+    file.item_entries.insert(file.item_entries.end(), 
+      iit->entries.begin() + iit->head, iit->entries.end());
+    file.item_weights.insert(file.item_weights.end(), 
+      iit->weights.begin() + iit->head, iit->weights.end());
+  }
+
+  // direct index, without the entries preallocated by allocate
+  if(m_use_di)
+  {
+    const size_t stored = m_nentries - m_first;
+    const size_t entries = std::min(stored, m_dfile.size());
+
+    size_t nodes = 0, features = 0;
+    FeatureVector::const_iterator drit;
+    for(size_t e = 0; e < entries; ++e)
+    {
+      nodes += m_dfile[e].size();
+      for(drit = m_dfile[e].begin(); drit != m_dfile[e].end(); ++drit)
+        features += drit->second.size();
+    }
+
+    file.entry_nodes.reserve(stored);
+    file.node_ids.reserve(nodes);
+    file.node_features.reserve(nodes);
+    file.features.reserve(features);
+
+    for(size_t e = 0; e < entries; ++e)
+    {
+      file.entry_nodes.push_back(m_dfile[e].size());
+      for(drit = m_dfile[e].begin(); drit != m_dfile[e].end(); ++drit)
+      {
+        file.node_ids.push_back(drit->first);
+        file.node_features.push_back(drit->second.size());
+        file.features.insert(file.features.end(), drit->second.begin(),
+          drit->second.end());
+      }
+    }
+    file.entry_nodes.resize(stored, 0);
+  }
+
+  file.removed_entries.reserve(m_nremoved);
+  for(size_t i = 0; i < m_removed.size(); ++i)
+  {
+    if(m_removed[i]) file.removed_entries.push_back(m_first + i);
+  }
+
+  file.save(filename, compress);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::loadBinary(const std::string &filename)
+{
+  DatabaseFile file;
+  file.load(filename);
+
+  const std::string corrupt = std::string("Binary database ") + filename +
+    " is corrupt";
+
+  // the database is not modified until the whole file is validated, so
+  // that it is left as it was if the load fails
+  TemplatedVocabulary<TDescriptor, F> *voc = m_voc;
+  if(!m_voc || m_voc->getBinaryHash() != file.vocabulary_hash)
+  {
+    if(file.vocabulary.empty())
+      throw filename + " needs the vocabulary it was saved with";
+
+    // the checksum of the database covers the vocabulary too
+    VocabularyFile vfile(file.vocabulary.data(), file.vocabulary.size(),
+      filename, false);
+    if(vfile.header().checksum != file.vocabulary_hash) throw corrupt;
+
+    voc = new TemplatedVocabulary<TDescriptor, F>;
+    try
+    {
+      voc->loadBinary(vfile);
+    }
+    catch(...)
+    {
+      delete voc;
+      throw;
+    }
+  }
+
+  InvertedFile ifile;
+  DirectFile dfile;
+  std::deque<bool> removed;
+  try
+  {
+    if(file.word_items.size() != voc->size()) throw corrupt;
+
+    // the sizes of the arrays were checked by DatabaseFile::load
+    ifile.resize(voc->size());
+    size_t i = 0;
+    for(size_t w = 0; w < file.word_items.size(); ++w)
+    {
+      IFRow &row = ifile[w];
+      const size_t end = i + file.word_items[w];
+      row.entries.assign(file.item_entries.begin() + i, 
+        file.item_entries.begin() + end);
+      row.weights.assign(file.item_weights.begin() + i,
+        file.item_weights.begin() + end);
+      i = end;
+    }
+
+    if(file.direct_index)
+    {
+      dfile.resize(file.entries - file.first_entry);
+
+      size_t n = 0, f = 0;
+      for(size_t e = 0; e < file.entry_nodes.size(); ++e)
+      {
+        FeatureVector &fvec = dfile[e];
+        for(size_t end = n + file.entry_nodes[e]; n < end; ++n)
+        {
+          const unsigned int *features = file.features.data() + f;
+          f += file.node_features[n];
+
+          fvec.insert(fvec.end(), std::make_pair(file.node_ids[n],
+            std::vector<unsigned int>(features, features + 
+              file.node_features[n])));
+        }
+      }
+    }
+
+    // the ids were checked by DatabaseFile::load too
+    if(!file.removed_entries.empty())
+      removed.resize(file.entries - file.first_entry, false);
+    for(size_t r = 0; r < file.removed_entries.size(); ++r)
+      removed[file.removed_entries[r] - file.first_entry] = true;
+  }
+  catch(...)
+  {
+    if(voc != m_voc) delete voc;
+    throw;
+  }
+
+  closeJournal();
+
+  if(voc != m_voc)
+  {
+    delete m_voc;
+    m_voc = voc;
+  }
+
+  m_use_di = file.direct_index;
+  m_dilevels = file.di_levels;
+  m_ifile.swap(ifile);
+  m_dfile.swap(dfile);
+  m_nentries = file.entries;
+  m_removed.swap(removed);
+  m_nremoved = file.removed_entries.size();
+  m_first = file.first_entry;
+  m_generation = file.generation;
+  m_window.clear();
+
+  // evicts the entries beyond the capacity of this database
+  if(m_capacity > 0) setCapacity(m_capacity);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::openJournal(
+  const std::string &filename, bool sync)
+{
+  closeJournal();
+
+  DatabaseJournal *journal = new DatabaseJournal;
+  try
+  {
+    // the entries of the journal already in the database (because it was
+    // interrupted in a checkpoint) are skipped
+    journal->open(filename, m_voc->getBinaryHash(), m_use_di, m_dilevels,
+      m_generation,
+      [&](EntryId id, const BowVector &v, const FeatureVector &fv)
+      {
+        if(id > (EntryId)m_nentries)
+          throw std::string("Journal ") + filename + 
+            " does not continue the database";
+        else if(id == (EntryId)m_nentries)
+          add(v, fv);
+      },
+      [&](EntryId id)
+      {
+        if(id >= (EntryId)m_nentries)
+          throw std::string("Journal ") + filename + 
+            " does not continue the database";
+        else if(id >= m_first && !isRemoved(id))
+          markRemoved(id);
+      }, sync);
+  }
+  catch(...)
+  {
+    delete journal;
+    throw;
+  }
+
+  m_journal = journal;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::closeJournal()
+{
+  delete m_journal;
+  m_journal = NULL;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedDatabase<TDescriptor, F>::checkpoint(
+  const std::string &filename, bool embed_vocabulary, bool compress)
+{
+  const std::string tmp = filename + ".tmp";
+  saveBinary(tmp, embed_vocabulary, compress);
+
+  // the new snapshot is on the disk before the journal is emptied
+  DatabaseFile::replace(tmp, filename);
+
+  if(m_journal) m_journal->reset();
+}
+
+// --------------------------------------------------------------------------
+
 /**
  * Writes printable information of the database
  * @param os stream to write to
@@ -1335,6 +2334,9 @@ std::ostream& operator<<(std::ostream &os,
   
   if(db.usingDirectIndex())
     os << ", Direct index levels = " << db.getDirectIndexLevels();
+
+  if(db.getCapacity() > 0)
+    os << ", Capacity = " << db.getCapacity();
   
   os << ". " << *db.getVocabulary();
   return os;
@@ -17,11 +17,31 @@
 #include <fstream>
 #include <string>
 #include <algorithm>
+#include <type_traits>
+#include <random>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <cstring>
+#include <cstdio>
+#include <limits>
 #include <opencv2/core.hpp>
 
 #include "FeatureVector.h"
 #include "BowVector.h"
 #include "ScoringObject.h"
+#include "FClass.h"
+#include "ThreadPool.h"
+#include "TrainingOptions.h"
+#include "DescriptorReader.h"
+#include "TrainingCheckpoint.h"
+#include "PackedDescriptors.h"
+#include "WordOccupancy.h"
+#include "VocabularyFile.h"
+#include "TextVocabularyFile.h"
+#include "MajorityVote.h"
+#include "TrainingSet.h"
 
 namespace DBoW2 {
 
@@ -65,6 +85,13 @@ public:
    * Destructor
    */
   virtual ~TemplatedVocabulary();
+
+  /**
+   * Returns a copy of the vocabulary of its same class, which the caller
+   * must delete
+   * @return new vocabulary
+   */
+  virtual TemplatedVocabulary<TDescriptor, F>* clone() const;
   
   /** 
    * Assigns the given vocabulary to this by copying its data and removing
@@ -103,6 +130,76 @@ public:
     (const std::vector<std::vector<TDescriptor> > &training_features,
       int k, int L, WeightingType weighting, ScoringType scoring);
 
+  /**
+   * Creates a vocabulary from the training features, setting the branching
+   * factor and the depth levels of the tree, the weighting and scoring
+   * schemes, and the training options
+   * @param training_features
+   * @param k branching factor
+   * @param L depth levels
+   * @param weighting weighting type
+   * @param scoring scoring type
+   * @param options training options, kept for subsequent calls to create
+   */
+  virtual void create
+    (const std::vector<std::vector<TDescriptor> > &training_features,
+      int k, int L, WeightingType weighting, ScoringType scoring,
+      const TrainingOptions &options);
+
+  /**
+   * Creates a vocabulary from descriptors packed in a single buffer, with 
+   * the already defined parameters. The clustering works on indices into
+   * the buffer and on the raw descriptors, which takes less memory and 
+   * time than the descriptor objects. F must provide F::fromArray8U, 
+   * F::toArray8U, F::distances8U and F::meanValue8U. The vocabulary is the
+   * same as the one created from the same descriptors by 
+   * create(training_features)
+   * @param training descriptors of the training images
+   * @throw string if F does not provide those functions
+   */
+  void create(const PackedDescriptors &training);
+
+  /**
+   * Creates a vocabulary from descriptors packed in a single buffer, setting
+   * the branching factor and the depth levels of the tree, and the 
+   * weighting and scoring schemes
+   * @param training descriptors of the training images
+   * @param k branching factor
+   * @param L depth levels
+   * @param weighting weighting type
+   * @param scoring scoring type
+   */
+  void create(const PackedDescriptors &training, 
+    int k, int L, WeightingType weighting, ScoringType scoring);
+
+  /**
+   * Creates a vocabulary from the descriptors of a reader, with the already
+   * defined parameters. The reader is read several times, and only the 
+   * descriptors of the node being split are kept in memory, packed (see 
+   * TrainingOptions::max_in_memory). F must provide the functions required
+   * by create(const PackedDescriptors &).
+   * If all the descriptors fit in memory, the vocabulary is the same as the
+   * one created from the same descriptors in memory
+   * @param reader
+   * @throw string if the reader or the temporary files fail, or if F does
+   *   not provide the functions required
+   */
+  void create(DescriptorReader &reader);
+
+  /**
+   * Creates a vocabulary from the descriptors of a reader, setting the 
+   * branching factor and the depth levels of the tree, and the weighting 
+   * and scoring schemes
+   * @param reader
+   * @param k branching factor
+   * @param L depth levels
+   * @param weighting weighting type
+   * @param scoring scoring type
+   * @throw string if the reader or the temporary files fail
+   */
+  void create(DescriptorReader &reader, 
+    int k, int L, WeightingType weighting, ScoringType scoring);
+
   /**
    * Returns the number of words in the vocabulary
    * @return number of words
@@ -133,6 +230,57 @@ public:
   virtual void transform(const std::vector<TDescriptor>& features,
     BowVector &v, FeatureVector &fv, int levelsup) const;
 
+  /**
+   * Transforms a set of descriptors stored as the rows of a matrix into a
+   * bow vector. No descriptor object is allocated for the rows.
+   * F must provide F::fromArray8U
+   * @param features matrix with one descriptor per row (e.g. NxL CV_8U)
+   * @param v (out) bow vector of weighted words
+   * @param word_ids (out) if given, the word id of each feature
+   */
+  void transform(const cv::Mat &features, BowVector &v,
+    std::vector<WordId> *word_ids = NULL) const;
+
+  /**
+   * Transforms a set of descriptors stored as the rows of a matrix into a
+   * bow vector and a feature vector. No descriptor object is allocated for
+   * the rows. F must provide F::fromArray8U
+   * @param features matrix with one descriptor per row (e.g. NxL CV_8U)
+   * @param v (out) bow vector
+   * @param fv (out) feature vector of nodes and feature indexes
+   * @param levelsup levels to go up the vocabulary tree to get the node index
+   * @param word_ids (out) if given, the word id of each feature
+   */
+  void transform(const cv::Mat &features, BowVector &v, FeatureVector &fv,
+    int levelsup, std::vector<WordId> *word_ids = NULL) const;
+
+  /**
+   * Transforms a set of descriptors stored in a buffer into a bow vector.
+   * F must provide F::fromArray8U
+   * @param features pointer to the first descriptor
+   * @param n number of descriptors
+   * @param stride bytes from the start of a descriptor to the next one
+   * @param v (out) bow vector of weighted words
+   * @param word_ids (out) if given, the word id of each feature
+   */
+  void transform(const unsigned char *features, int n, size_t stride,
+    BowVector &v, std::vector<WordId> *word_ids = NULL) const;
+
+  /**
+   * Transforms a set of descriptors stored in a buffer into a bow vector
+   * and a feature vector. F must provide F::fromArray8U
+   * @param features pointer to the first descriptor
+   * @param n number of descriptors
+   * @param stride bytes from the start of a descriptor to the next one
+   * @param v (out) bow vector
+   * @param fv (out) feature vector of nodes and feature indexes
+   * @param levelsup levels to go up the vocabulary tree to get the node index
+   * @param word_ids (out) if given, the word id of each feature
+   */
+  void transform(const unsigned char *features, int n, size_t stride,
+    BowVector &v, FeatureVector &fv, int levelsup, 
+    std::vector<WordId> *word_ids = NULL) const;
+
   /**
    * Transforms a single feature into a word (without weight)
    * @param feature
@@ -164,7 +312,8 @@ public:
    * @param nid starting node id
    * @param words ids of words
    */
-  void getWordsFromNode(NodeId nid, std::vector<WordId> &words) const;
+  virtual void getWordsFromNode(NodeId nid, std::vector<WordId> &words) 
+    const;
   
   /**
    * Returns the branching factor of the tree (k)
@@ -229,10 +378,82 @@ public:
   void save(const std::string &filename) const;
   
   /**
-   * Loads the vocabulary from a file
+   * Loads the vocabulary from a file saved by save, saveBinary or 
+   * saveText. Binary files are recognized by their first bytes, and text
+   * files by their extension .txt
    * @param filename
    */
   void load(const std::string &filename);
+
+  /**
+   * Saves the vocabulary into a binary file (see VocabularyFile), which
+   * is loaded without parsing. F must provide toArray8U and BYTES
+   * @param filename
+   * @throw string if the file cannot be written
+   */
+  void saveBinary(const std::string &filename) const;
+
+  /**
+   * Composes the binary file of the vocabulary in memory, as saveBinary
+   * writes it
+   * @param data (out) contents of the file
+   * @throw string if F does not provide toArray8U and BYTES
+   */
+  virtual void saveBinary(std::vector<unsigned char> &data) const;
+
+  /**
+   * Returns the checksum of the binary file of the vocabulary, which 
+   * identifies the vocabulary (e.g. in the binary files of a database). 
+   * It is computed the first time and kept until the vocabulary changes.
+   * F must provide toArray8U and BYTES
+   * @return hash
+   */
+  unsigned long long getBinaryHash() const;
+
+  /**
+   * Loads the vocabulary from a binary file saved by saveBinary. F must
+   * provide fromArray8U and BYTES
+   * @param filename
+   * @throw string if the file cannot be read, or if it is corrupt or has
+   *   descriptors of another size
+   */
+  void loadBinary(const std::string &filename);
+
+  /**
+   * Loads the vocabulary from a binary file already mapped, copying its
+   * tables. F must provide fromArray8U and BYTES
+   * @param file
+   * @throw string if the file has descriptors of another size
+   */
+  void loadBinary(const VocabularyFile &file);
+
+  /**
+   * Saves the vocabulary in the text format of ORB-SLAM (see 
+   * TextVocabularyFile). Word ids are not saved: loadText gives them to the
+   * leaves in node id order, as create does
+   * @param filename
+   * @throw string if the file cannot be written
+   */
+  void saveText(const std::string &filename) const;
+
+  /**
+   * Loads the vocabulary from a file in the text format of ORB-SLAM. The
+   * file is parsed with the thread pool, if any. If F provides fromArray8U
+   * and the descriptors are written as bytes, as FORB does, they are read
+   * without F::fromString
+   * @param filename
+   * @throw string if the file cannot be read or is wrong
+   */
+  void loadText(const std::string &filename);
+
+  /**
+   * Converts a vocabulary file saved by save (e.g. a .yml.gz file) or in
+   * text format into a binary file
+   * @param from file to read
+   * @param to binary file to write
+   */
+  static void convertToBinary(const std::string &from, 
+    const std::string &to);
   
   /** 
    * Saves the vocabulary to a file storage structure
@@ -264,6 +485,64 @@ public:
    */
   virtual int stopWords(double minWeight);
 
+  /**
+   * Computes how a set of images is distributed among the words: the 
+   * descriptors and images of each word, which give the length of the 
+   * inverted rows of a database, and the quantization error. Computing it
+   * with the training images of two vocabularies shows how balancing the
+   * clusters (TrainingOptions::max_occupancy) changed the word frequencies
+   * @param features descriptors of each image
+   * @param occupancy (out) distribution
+   */
+  void computeOccupancy(const std::vector<std::vector<TDescriptor> > &features,
+    WordOccupancy &occupancy) const;
+
+  /**
+   * Computes how a set of packed images is distributed among the words, as
+   * the other computeOccupancy does
+   * @param training descriptors of each image
+   * @param occupancy (out) distribution
+   */
+  void computeOccupancy(const PackedDescriptors &training, 
+    WordOccupancy &occupancy) const;
+
+  /**
+   * Sets the thread pool used to quantize the features of large sets in
+   * parallel when transforming them, and to run the kmeans assignments and
+   * train the subtrees in parallel when creating the vocabulary. The size
+   * of the pool sets the number of threads. The results are the same as
+   * without a pool: the tree created only depends on the training features
+   * and on the seed of rand() when create is called.
+   * The pool is not owned by the vocabulary and must outlive it.
+   * The vocabulary can still be used by several threads at once
+   * @param pool thread pool, or NULL to work in the calling thread only
+   */
+  inline void setThreadPool(ThreadPool *pool) { m_pool = pool; }
+
+  /**
+   * Returns the thread pool used by the vocabulary
+   * @return thread pool, or NULL if none
+   */
+  inline ThreadPool* getThreadPool() const { return m_pool; }
+
+  /**
+   * Sets the options used by create
+   * @param options
+   */
+  inline void setTrainingOptions(const TrainingOptions &options)
+  {
+    m_training = options;
+  }
+
+  /**
+   * Returns the options used by create
+   * @return training options
+   */
+  inline const TrainingOptions& getTrainingOptions() const
+  {
+    return m_training;
+  }
+
 protected:
 
   /// Pointer to descriptor
@@ -304,8 +583,25 @@ protected:
     inline bool isLeaf() const { return children.empty(); }
   };
 
+  /// Node of the compiled (flat) version of the tree. Flat nodes are stored
+  /// in level order, so that the children of a node are contiguous
+  struct FlatNode
+  {
+    /// Id of the node in m_nodes
+    NodeId id;
+    /// Index of the first child in the flat arrays
+    unsigned int first_child;
+    /// Number of children (0 if the node is a leaf)
+    unsigned int n_children;
+  };
+
 protected:
 
+  // The members that call optional functions of F (see FClass) are 
+  // selected with the traits of FClass.h. The overloads that call them are
+  // member templates, which are only instantiated when they are used, so
+  // that the vocabulary can be explicitly instantiated for any F
+
   /**
    * Creates an instance of the scoring object accoring to m_scoring
    */
@@ -337,148 +633,1233 @@ protected:
    * @param id (out) word id
    */
   virtual void transform(const TDescriptor &feature, WordId &id) const;
-      
+
   /**
-   * Creates a level in the tree, under the parent, by running kmeans with
-   * a descriptor set, and recursively creates the subsequent levels too
-   * @param parent_id id of parent node
-   * @param descriptors descriptors to run the kmeans on
-   * @param current_level current level in the tree
+   * Transforms a set of descriptors stored in a buffer into a bow vector
+   * and, if given, a feature vector
+   * @param features pointer to the first descriptor
+   * @param n number of descriptors
+   * @param stride bytes from the start of a descriptor to the next one
+   * @param v (out) bow vector
+   * @param fv (out) if given, feature vector of nodes and feature indexes
+   * @param levelsup levels to go up the vocabulary tree to get the node index
+   * @param word_ids (out) if given, the word id of each feature
    */
-  void HKmeansStep(NodeId parent_id, const std::vector<pDescriptor> &descriptors,
-    int current_level);
+  inline void transformRows(const unsigned char *features, int n, 
+    size_t stride, BowVector &v, FeatureVector *fv, int levelsup, 
+    std::vector<WordId> *word_ids) const
+  {
+    transformRows(features, n, stride, v, fv, levelsup, word_ids,
+      std::integral_constant<bool, HasArray8U<F>::value>());
+  }
+
+  /// transformRows when F provides F::fromArray8U
+  template<class G = F>
+  void transformRows(const unsigned char *features, int n, size_t stride,
+    BowVector &v, FeatureVector *fv, int levelsup, 
+    std::vector<WordId> *word_ids, std::true_type) const;
+
+  /// transformRows when F does not provide F::fromArray8U
+  inline void transformRows(const unsigned char *, int, size_t, BowVector &,
+    FeatureVector *, int, std::vector<WordId> *, std::false_type) const
+  {
+    throw std::string("Raw descriptors need F::fromArray8U and F::BYTES");
+  }
 
   /**
-   * Creates k clusters from the given descriptors with some seeding algorithm.
-   * @note In this class, kmeans++ is used, but this function should be
-   *   overriden by inherited classes.
+   * Computes the word of each of a set of features with the thread pool
+   * @param features
+   * @param ids (out) word id of each feature
+   * @param weights (out) word weight of each feature
+   * @param nids (out) if given, node id "levelsup" levels up of each feature
+   * @param levelsup
    */
-  virtual void initiateClusters(const std::vector<pDescriptor> &descriptors,
-    std::vector<TDescriptor> &clusters) const;
-  
+  void quantize(const std::vector<TDescriptor> &features, 
+    std::vector<WordId> &ids, std::vector<WordValue> &weights,
+    std::vector<NodeId> *nids, int levelsup) const;
+
   /**
-   * Creates k clusters from the given descriptor sets by running the
-   * initial step of kmeans++
-   * @param descriptors 
-   * @param clusters resulting clusters
+   * Computes the word of each of a set of features stored in a buffer with
+   * the thread pool
+   * @param features pointer to the first descriptor
+   * @param n number of descriptors
+   * @param stride bytes from the start of a descriptor to the next one
+   * @param ids (out) word id of each feature
+   * @param weights (out) word weight of each feature
+   * @param nids (out) if given, node id "levelsup" levels up of each feature
+   * @param levelsup
    */
-  void initiateClustersKMpp(const std::vector<pDescriptor> &descriptors,
-    std::vector<TDescriptor> &clusters) const;
-  
+  template<class G = F>
+  void quantize(const unsigned char *features, int n, size_t stride,
+    std::vector<WordId> &ids, std::vector<WordValue> &weights,
+    std::vector<NodeId> *nids, int levelsup) const;
+
   /**
-   * Create the words of the vocabulary once the tree has been built
+   * Creates the bow vector and the feature vector of a set of features 
+   * whose words are already known, as transform does
+   * @param ids word id of each feature
+   * @param weights word weight of each feature
+   * @param nids if given, node id of each feature for the feature vector
+   * @param v (out) bow vector
+   * @param fv (out) if given, feature vector
    */
-  void createWords();
-  
+  void createVectors(const std::vector<WordId> &ids, 
+    const std::vector<WordValue> &weights, const std::vector<NodeId> *nids,
+    BowVector &v, FeatureVector *fv) const;
+
   /**
-   * Sets the weights of the nodes of tree according to the given features.
-   * Before calling this function, the nodes and the words must be already
-   * created (by calling HKmeansStep and createWords)
-   * @param features
+   * Returns whether a set of features is large enough to use the pool
+   * @param n number of features
+   * @return true iff the features must be quantized in parallel
    */
-  void setNodeWeights(const std::vector<std::vector<TDescriptor> > &features);
-  
+  inline bool useThreadPool(size_t n) const
+  {
+    return m_pool != NULL && m_pool->size() > 1 && n > PARALLEL_GRAIN;
+  }
+
+  /// Number of features quantized by each task of the thread pool
+  static const unsigned int PARALLEL_GRAIN = 256;
+
+  /// Number of descriptors sampled with the same random engine by the
+  /// kmeans|| seeding. It does not depend on the pool, so that the seeding
+  /// is the same with any number of threads
+  static const size_t SEEDING_CHUNK = 1024;
+
   /**
-   * Returns a random number in the range [min..max]
-   * @param min
-   * @param max
-   * @return random T number in [min..max]
+   * Returns the index of the descriptor closest to a feature among n 
+   * contiguous descriptors. Ties are broken by choosing the lowest index.
+   * F::distances is used if F provides it
+   * @param feature
+   * @param descriptors array of n descriptors (n > 0)
+   * @param n
+   * @param best_d (out) if given, distance to the closest descriptor
+   * @return index of the closest descriptor in [0, n)
    */
-  template <class T>
-  static T RandomValue(T min, T max){
-      return ((T)rand()/(T)RAND_MAX) * (max - min) + min;
+  static unsigned int findClosest(const TDescriptor &feature, 
+    const TDescriptor *descriptors, unsigned int n, double *best_d = NULL);
+
+  /**
+   * Calculates the distances between a feature and n descriptors with 
+   * F::distances if F provides it, or with F::distance otherwise
+   * @param feature
+   * @param descriptors array of n descriptors
+   * @param n
+   * @param d (out) array of n distances
+   */
+  static inline void distances(const TDescriptor &feature, 
+    const TDescriptor *descriptors, int n, double *d)
+  {
+    descriptorDistances<F>(feature, descriptors, n, d, 
+      std::integral_constant<bool, HasDistances<F>::value>());
   }
 
   /**
-   * Returns a random int in the range [min..max]
-   * @param min
-   * @param max
-   * @return random int in [min..max]
+   * Reads the descriptors of the nodes of a text vocabulary as bytes, if 
+   * they are written so, or with F::fromString otherwise
+   * @param file
+   * @param lines node lines
+   * @param buffer (out) data wrapped by the descriptors, if any
    */
-  static int RandomInt(int min, int max){
-      int d = max - min + 1;
-      return int(((double)rand()/((double)RAND_MAX + 1.0)) * d) + min;
+  template<class G = F>
+  void readTextDescriptors(const TextVocabularyFile &file, 
+    const std::vector<TextVocabularyFile::Line> &lines, cv::Mat &buffer, 
+    std::true_type);
+
+  /**
+   * Reads the descriptors of the nodes of a text vocabulary with 
+   * F::fromString
+   * @param file
+   * @param lines node lines
+   * @param buffer unused
+   */
+  void readTextDescriptors(const TextVocabularyFile &file, 
+    const std::vector<TextVocabularyFile::Line> &lines, cv::Mat &buffer, 
+    std::false_type);
+
+  /// create from packed descriptors when F provides the functions of
+  /// HasPacked8U
+  template<class G = F>
+  void create(const PackedDescriptors &training, std::true_type);
+
+  /// create from packed descriptors when F does not provide them
+  inline void create(const PackedDescriptors &, std::false_type)
+  {
+    throw std::string("Packed descriptors need F::fromArray8U, "
+      "F::toArray8U, F::distances8U, F::meanValue8U and F::BYTES");
   }
 
-protected:
+  /// create from a reader when F provides the functions of HasPacked8U
+  template<class G = F>
+  void create(DescriptorReader &reader, std::true_type);
 
-  /// Branching factor
-  int m_k;
-  
-  /// Depth levels 
-  int m_L;
-  
-  /// Weighting method
-  WeightingType m_weighting;
-  
-  /// Scoring method
-  ScoringType m_scoring;
-  
-  /// Object for computing scores
-  GeneralScoring* m_scoring_object;
-  
-  /// Tree nodes
-  std::vector<Node> m_nodes;
-  
-  /// Words of the vocabulary (tree leaves)
-  /// this condition holds: m_words[wid]->word_id == wid
-  std::vector<Node*> m_words;
-  
-};
+  /// create from a reader when F does not provide them
+  inline void create(DescriptorReader &, std::false_type)
+  {
+    throw std::string("Packed descriptors need F::fromArray8U, "
+      "F::toArray8U, F::distances8U, F::meanValue8U and F::BYTES");
+  }
 
-// --------------------------------------------------------------------------
+  /// computeOccupancy of packed images when F provides F::fromArray8U
+  template<class G = F>
+  void computeOccupancy(const PackedDescriptors &training, 
+    WordOccupancy &occupancy, std::true_type) const;
 
-template<class TDescriptor, class F>
-TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (int k, int L, WeightingType weighting, ScoringType scoring)
-  : m_k(k), m_L(L), m_weighting(weighting), m_scoring(scoring),
-  m_scoring_object(NULL)
-{
-  createScoringObject();
-}
+  /// computeOccupancy of packed images when F does not provide 
+  /// F::fromArray8U
+  inline void computeOccupancy(const PackedDescriptors &, WordOccupancy &,
+    std::false_type) const
+  {
+    throw std::string("Packed descriptors need F::fromArray8U and "
+      "F::BYTES");
+  }
 
-// --------------------------------------------------------------------------
+  /// loadBinary of a mapped file when F provides F::fromArray8U
+  template<class G = F>
+  void loadBinary(const VocabularyFile &file, std::true_type);
 
-template<class TDescriptor, class F>
-TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (const std::string &filename): m_scoring_object(NULL)
-{
-  load(filename);
-}
+  /// loadBinary of a mapped file when F does not provide F::fromArray8U
+  inline void loadBinary(const VocabularyFile &, std::false_type)
+  {
+    throw std::string("Binary vocabularies need F::fromArray8U and "
+      "F::BYTES");
+  }
 
-// --------------------------------------------------------------------------
+  /// loadBinary when F provides F::fromArray8U, called by load
+  inline void loadBinary(const std::string &filename, std::true_type)
+  {
+    loadBinary(filename);
+  }
 
-template<class TDescriptor, class F>
-TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (const char *filename): m_scoring_object(NULL)
-{
-  load(filename);
-}
+  /// loadBinary when F does not provide F::fromArray8U, called by load
+  inline void loadBinary(const std::string &filename, std::false_type)
+  {
+    throw filename + " is a binary vocabulary, which needs "
+      "F::fromArray8U and F::BYTES";
+  }
 
-// --------------------------------------------------------------------------
+  /// saveBinary when F provides F::toArray8U
+  template<class G = F>
+  void saveBinary(std::vector<unsigned char> &data, std::true_type) const;
 
-template<class TDescriptor, class F>
-void TemplatedVocabulary<TDescriptor,F>::createScoringObject()
-{
-  delete m_scoring_object;
-  m_scoring_object = NULL;
-  
-  switch(m_scoring)
+  /// saveBinary when F does not provide F::toArray8U
+  inline void saveBinary(std::vector<unsigned char> &, std::false_type) const
   {
-    case L1_NORM: 
-      m_scoring_object = new L1Scoring;
-      break;
-      
-    case L2_NORM:
-      m_scoring_object = new L2Scoring;
-      break;
-    
-    case CHI_SQUARE:
-      m_scoring_object = new ChiSquareScoring;
-      break;
-      
-    case KL:
-      m_scoring_object = new KLScoring;
+    throw std::string("Binary vocabularies need F::toArray8U and F::BYTES");
+  }
+
+  /**
+   * Returns the raw data of a feature to compare it with the packed 
+   * descriptors of the flat tree, if F provides F::distances8U for 
+   * descriptors stored in a buffer and the feature and the buffer allow it
+   * @param feature
+   * @return raw data of the feature, or NULL if it cannot be compared so
+   */
+  inline const unsigned char* flatRawFeature(const TDescriptor &feature) 
+    const
+  {
+    return flatRawFeature(feature, 
+      std::integral_constant<bool, HasStridedDistances8U<F>::value>());
+  }
+
+  /// flatRawFeature when F provides F::distances8U for buffers
+  template<class G = F>
+  const unsigned char* flatRawFeature(const TDescriptor &feature, 
+    std::true_type) const;
+
+  /// flatRawFeature when F does not provide F::distances8U for buffers
+  inline const unsigned char* flatRawFeature(const TDescriptor &, 
+    std::false_type) const
+  {
+    return NULL;
+  }
+
+  /**
+   * Returns the index of the child of a flat node closest to a feature,
+   * comparing their raw data in m_flat_buffer, where the children are 
+   * contiguous, as findClosest does
+   * @param feature raw data of the feature, given by flatRawFeature
+   * @param first index of the first child in the flat arrays
+   * @param n number of children (n > 0)
+   * @return index of the closest child in [0, n)
+   */
+  inline unsigned int findClosestFlat8U(const unsigned char *feature,
+    unsigned int first, unsigned int n) const
+  {
+    return findClosestFlat8U(feature, first, n,
+      std::integral_constant<bool, HasStridedDistances8U<F>::value>());
+  }
+
+  /// findClosestFlat8U when F provides F::distances8U for buffers
+  template<class G = F>
+  unsigned int findClosestFlat8U(const unsigned char *feature,
+    unsigned int first, unsigned int n, std::true_type) const;
+
+  /// findClosestFlat8U when F does not provide F::distances8U for buffers.
+  /// It is not called, because flatRawFeature returns NULL
+  inline unsigned int findClosestFlat8U(const unsigned char *,
+    unsigned int, unsigned int, std::false_type) const
+  {
+    return 0;
+  }
+      
+  /// Memory reused by the HKmeansStep calls that create a subtree from a
+  /// training set (ObjectTrainingSet or PackedTrainingSet)
+  template<class Set>
+  struct TrainingBuffers
+  {
+    /// Cluster centres of the node
+    typename Set::Clusters clusters, last_clusters;
+    /// Cluster of each descriptor of the node
+    std::vector<int> association, last_association;
+    /// Bounds of the distances to the clusters
+    std::vector<double> upper, lower;
+    /// Descriptors of each cluster
+    std::vector<std::vector<typename Set::Descriptor> > members;
+    /// Indices of the node sorted by cluster
+    std::vector<unsigned int> sorted;
+    /// Children of the node being split at each level
+    std::vector<std::vector<NodeId> > children;
+    /// Offsets of the indices of those children at each level
+    std::vector<std::vector<size_t> > offsets;
+  };
+
+  /// TrainingBuffers that the tasks creating subtrees in parallel take and
+  /// give back, so that their memory is reused by later tasks
+  template<class Set>
+  class TrainingBuffersPool
+  {
+  public:
+    ~TrainingBuffersPool()
+    {
+      for(size_t i = 0; i < m_free.size(); ++i) delete m_free[i];
+    }
+    
+    /// Returns some free buffers
+    TrainingBuffers<Set>* take()
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      if(m_free.empty()) return new TrainingBuffers<Set>;
+      TrainingBuffers<Set> *buffers = m_free.back();
+      m_free.pop_back();
+      return buffers;
+    }
+    
+    /// Gives back buffers obtained with take
+    void give(TrainingBuffers<Set> *buffers)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_free.push_back(buffers);
+    }
+    
+  private:
+    std::mutex m_mutex;
+    std::vector<TrainingBuffers<Set>*> m_free;
+  };
+
+  /**
+   * Creates a level in the tree, under the parent, by running kmeans with
+   * a descriptor set, and recursively creates the subsequent levels too.
+   * If there is a thread pool, the subtrees are created in parallel, so that
+   * the node ids must be fixed with renumberNodes afterwards
+   * @param parent_id id of parent node
+   * @param descriptors descriptors to run the kmeans on
+   * @param current_level current level in the tree
+   * @param seed seed of the random numbers used to create the level. The 
+   *   seeds of the subsequent levels are derived from it
+   * @param leaves if given, leaves[i] is set to the id of the leaf where
+   *   descriptors[i] ends up
+   * @note The splits are saved in the checkpoint as splits of the root
+   */
+  void HKmeansStep(NodeId parent_id, 
+    const std::vector<pDescriptor> &descriptors, int current_level, 
+    unsigned int seed = 0, std::vector<NodeId> *leaves = NULL);
+
+  /// Key of the root node in the checkpoint
+  static const unsigned long long ROOT_KEY = 0;
+
+  /**
+   * Creates a level in the tree as HKmeansStep does, with all the 
+   * descriptors of a training set
+   * @param parent_id id of parent node
+   * @param set training set
+   * @param current_level current level in the tree
+   * @param seed seed of the random numbers used to create the level
+   * @param key key of the parent node in the checkpoint
+   * @param leaves if given, leaves[i] is set to the id of the leaf where
+   *   descriptor i of the set ends up
+   */
+  template<class Set>
+  void HKmeansStep(NodeId parent_id, const Set &set, int current_level, 
+    unsigned int seed, unsigned long long key, std::vector<NodeId> *leaves);
+
+  /**
+   * Creates a level in the tree as HKmeansStep does, with the descriptors
+   * of a training set given by a range of indices. The range is sorted in 
+   * place so that the descriptors of each child are contiguous, and the 
+   * subsequent levels are created with those subranges
+   * @param parent_id id of parent node
+   * @param set training set
+   * @param indices indices in the set of the n descriptors to split
+   * @param n
+   * @param current_level current level in the tree
+   * @param seed seed of the random numbers used to create the level
+   * @param key key of the parent node in the checkpoint
+   * @param buffers memory to use
+   * @param pool buffers of the subtrees created in parallel
+   * @param leaves if given, leaves[i] is set to the id of the leaf where
+   *   descriptor i of the set ends up
+   */
+  template<class Set>
+  void HKmeansStep(NodeId parent_id, const Set &set, unsigned int *indices,
+    size_t n, int current_level, unsigned int seed, unsigned long long key,
+    TrainingBuffers<Set> &buffers, TrainingBuffersPool<Set> &pool, 
+    std::vector<NodeId> *leaves);
+
+  /**
+   * Sorts the indices of the descriptors of a node by cluster, keeping the 
+   * order of the indices of each cluster
+   * @param indices (in/out) n indices
+   * @param n
+   * @param association cluster of each index
+   * @param k number of clusters
+   * @param sorted buffer to use
+   * @param offsets (out) k + 1 offsets: the indices of cluster c are those
+   *   in [offsets[c], offsets[c+1])
+   */
+  static void sortByCluster(unsigned int *indices, size_t n, 
+    const std::vector<int> &association, unsigned int k, 
+    std::vector<unsigned int> &sorted, std::vector<size_t> &offsets);
+
+  /// Function that receives n descriptors stored one after the other
+  typedef std::function<void(const unsigned char *, size_t n)> RowVisitor;
+  
+  /// Function that passes all the descriptors of a node to a RowVisitor
+  typedef std::function<void(const RowVisitor &)> RowScanner;
+
+  /**
+   * Creates a level in the tree, under the parent, from descriptors that
+   * are read on demand, and recursively creates the subsequent levels too.
+   * Sets that fit in memory are split with HKmeansStep. Larger sets are
+   * clustered with a sample, and partitioned into temporary files that 
+   * the next levels read
+   * @param parent_id id of parent node
+   * @param scan function that reads the descriptors of the parent node
+   * @param bytes bytes per descriptor
+   * @param current_level current level in the tree
+   * @param seed seed of the random numbers used to create the level
+   * @param key key of the parent node in the checkpoint
+   */
+  template<class G = F>
+  void streamHKmeansStep(NodeId parent_id, const RowScanner &scan, 
+    int bytes, int current_level, unsigned int seed, unsigned long long key);
+
+  /**
+   * Returns a value that identifies the training in the checkpoint: the 
+   * parameters of the vocabulary, the options that change the tree, the 
+   * seed and the descriptors
+   * @param seed seed of the root
+   * @param bytes bytes per descriptor
+   * @param data_hash hash of the training descriptors
+   * @return fingerprint
+   */
+  unsigned long long trainingFingerprint(unsigned int seed, int bytes,
+    unsigned long long data_hash) const;
+
+  /**
+   * Returns the fingerprint of a training with descriptor objects, which 
+   * are identified by the number of descriptors of each image and their 
+   * raw data
+   * @param seed seed of the root
+   * @param training_features
+   * @return fingerprint
+   */
+  template<class G = F>
+  unsigned long long trainingFingerprint(unsigned int seed,
+    const std::vector<std::vector<TDescriptor> > &training_features,
+    std::true_type) const;
+
+  /// trainingFingerprint when F does not provide the raw data of the
+  /// descriptors, which are needed to resume a training exactly
+  inline unsigned long long trainingFingerprint(unsigned int,
+    const std::vector<std::vector<TDescriptor> > &, std::false_type) const
+  {
+    throw std::string("Checkpoints need F::toArray8U, F::fromArray8U and "
+      "F::BYTES");
+  }
+
+  /**
+   * Reads the split of a node from the checkpoint, if there is a checkpoint
+   * and the set gives the raw data of the cluster centres
+   * @param key key of the node
+   * @param n number of descriptors of the node
+   * @param set training set
+   * @param clusters (out) cluster centres
+   * @param association (out) cluster of each descriptor of the node
+   * @return true iff the split was found
+   * @throw string if the split does not match the descriptors
+   */
+  template<class Set>
+  bool loadSplit(unsigned long long key, size_t n, const Set &set,
+    typename Set::Clusters &clusters, std::vector<int> &association) const;
+
+  /**
+   * Reads the split of a node from the checkpoint as raw data, if there is
+   * a checkpoint
+   * @param key key of the node
+   * @param n number of descriptors of the node, or 0 if the association is
+   *   not stored
+   * @param bytes bytes per descriptor
+   * @param clusters (out) raw data of the cluster centres
+   * @param association (out) cluster of each descriptor of the node
+   * @return true iff the split was found
+   * @throw string if the split does not match the descriptors
+   */
+  bool loadSplit(unsigned long long key, size_t n, int bytes,
+    std::vector<unsigned char> &clusters, std::vector<int> &association) const;
+
+  /**
+   * Saves the split of a node in the checkpoint, if there is a checkpoint
+   * and the set gives the raw data of the cluster centres
+   * @param key key of the node
+   * @param set training set
+   * @param clusters cluster centres
+   * @param association cluster of each descriptor of the node
+   */
+  template<class Set>
+  void saveSplit(unsigned long long key, const Set &set,
+    const typename Set::Clusters &clusters,
+    const std::vector<int> &association) const;
+
+  /**
+   * Saves the split of a node in the checkpoint as raw data, if there is a
+   * checkpoint
+   * @param key key of the node
+   * @param clusters raw data of the cluster centres
+   * @param association cluster of each descriptor of the node
+   */
+  void saveSplit(unsigned long long key, 
+    const std::vector<unsigned char> &clusters,
+    const std::vector<int> &association) const;
+
+  /// Opens the checkpoint of m_training while a vocabulary is created
+  class CheckpointScope
+  {
+  public:
+    /**
+     * Opens the checkpoint, if m_training has a checkpoint file
+     * @param voc vocabulary being created
+     * @param fingerprint value that identifies the training
+     * @throw string if the file cannot be used
+     */
+    CheckpointScope(TemplatedVocabulary &voc, unsigned long long fingerprint)
+      : m_voc(voc)
+    {
+      open(fingerprint);
+    }
+    
+    /**
+     * Creates the scope without opening the checkpoint, for trainings that
+     * are identified while their descriptors are read (see open)
+     * @param voc vocabulary being created
+     */
+    explicit CheckpointScope(TemplatedVocabulary &voc)
+      : m_voc(voc)
+    {
+    }
+    
+    /**
+     * Opens the checkpoint, if m_training has a checkpoint file. It must be
+     * called before the first split is looked for in the checkpoint
+     * @param fingerprint value that identifies the training
+     * @throw string if the file cannot be used
+     */
+    void open(unsigned long long fingerprint)
+    {
+      if(!m_voc.m_training.checkpoint_file.empty() && !m_voc.m_checkpoint)
+      {
+        m_voc.m_checkpoint = new TrainingCheckpoint(
+          m_voc.m_training.checkpoint_file, fingerprint);
+      }
+    }
+    
+    ~CheckpointScope()
+    {
+      delete m_voc.m_checkpoint;
+      m_voc.m_checkpoint = NULL;
+    }
+    
+    /// Deletes the checkpoint file once the vocabulary is created
+    void finish()
+    {
+      if(m_voc.m_checkpoint) m_voc.m_checkpoint->remove();
+    }
+    
+  private:
+    TemplatedVocabulary &m_voc;
+  };
+
+  /**
+   * Gives the nodes the ids they would have if the tree had been created by
+   * a single thread: the children of each node are consecutive, and the 
+   * subtrees are numbered in depth-first order
+   * @param values if given, values indexed by node id, which are moved 
+   *   along with the nodes
+   */
+  void renumberNodes(std::vector<unsigned int> *values = NULL);
+
+  /**
+   * Splits some descriptors of a training set into at most k clusters with
+   * the clustering set in m_training, balanced if m_training.max_occupancy
+   * is set
+   * @param set training set
+   * @param indices indices in the set of the n descriptors to split
+   * @param n (> 0)
+   * @param seed seed of the random numbers
+   * @param clusters (out) cluster centres
+   * @param association (out) cluster of each of the n descriptors
+   * @param buffers memory to use in the iterations
+   */
+  template<class Set>
+  void clusterDescriptors(const Set &set, const unsigned int *indices,
+    size_t n, unsigned int seed, typename Set::Clusters &clusters,
+    std::vector<int> &association, TrainingBuffers<Set> &buffers) const;
+
+  /**
+   * Associates each of some descriptors of a training set with its closest
+   * cluster, in parallel if there is a thread pool. Ties are broken by 
+   * choosing the lowest index, as findClosest does
+   * @param set training set
+   * @param indices indices in the set of the n descriptors, or NULL if they
+   *   are the first n descriptors of the set
+   * @param n number of descriptors
+   * @param clusters cluster centres
+   * @param association (out) index of the cluster of each descriptor
+   */
+  template<class Set>
+  void associate(const Set &set, const unsigned int *indices, size_t n,
+    const typename Set::Clusters &clusters, 
+    std::vector<int> &association) const;
+
+  /**
+   * Associates each descriptor with its closest cluster, as associate does,
+   * but keeps bounds of the distances between iterations of kmeans to skip
+   * the distances that cannot change the association, with the algorithm 
+   * set in m_training.assignment. The bounds are strict, so that the result
+   * is the same as associate's, ties included
+   * @param set training set
+   * @param indices indices in the set of the n descriptors
+   * @param n number of descriptors
+   * @param clusters cluster centres
+   * @param last_clusters clusters of the previous call, or NULL in the first
+   *   call, which computes all the distances and initializes the bounds
+   * @param upper (in/out) upper bound of the distance from each descriptor
+   *   to its cluster
+   * @param lower (in/out) lower bounds of the distances from each descriptor
+   *   to the other clusters
+   * @param association (in/out) index of the cluster of each descriptor
+   */
+  template<class Set>
+  void associateBounded(const Set &set, const unsigned int *indices, 
+    size_t n, const typename Set::Clusters &clusters, 
+    const typename Set::Clusters *last_clusters,
+    std::vector<double> &upper, std::vector<double> &lower,
+    std::vector<int> &association) const;
+
+  /**
+   * Updates the association of n descriptors with Hamerly's algorithm: each
+   * descriptor keeps an upper bound of the distance to its cluster and a 
+   * lower bound of the distance to the second closest one
+   * @param n number of descriptors
+   * @param k number of clusters
+   * @param shifts distance each cluster moved, or empty to compute all the
+   *   distances and initialize the bounds
+   * @param cluster_distances k x k distances between clusters
+   * @param distance function (i, c) that returns the distance from 
+   *   descriptor i to cluster c
+   * @param all_distances function (i, d) that stores in d the distances from
+   *   descriptor i to the k clusters
+   * @param upper (in/out) n upper bounds
+   * @param lower (in/out) n lower bounds
+   * @param association (in/out) index of the cluster of each descriptor
+   */
+  template<class Distance, class Distances>
+  void updateHamerly(size_t n, unsigned int k, 
+    const std::vector<double> &shifts, 
+    const std::vector<double> &cluster_distances, const Distance &distance,
+    const Distances &all_distances, std::vector<double> &upper, 
+    std::vector<double> &lower, std::vector<int> &association) const;
+
+  /**
+   * Updates the association of n descriptors with Elkan's algorithm: each
+   * descriptor keeps an upper bound of the distance to its cluster and a 
+   * lower bound of the distance to each cluster
+   * @param n number of descriptors
+   * @param k number of clusters
+   * @param shifts distance each cluster moved, or empty to compute all the
+   *   distances and initialize the bounds
+   * @param cluster_distances k x k distances between clusters
+   * @param distance function (i, c)
+   * @param all_distances function (i, d)
+   * @param upper (in/out) n upper bounds
+   * @param lower (in/out) n x k lower bounds
+   * @param association (in/out) index of the cluster of each descriptor
+   */
+  template<class Distance, class Distances>
+  void updateElkan(size_t n, unsigned int k, 
+    const std::vector<double> &shifts, 
+    const std::vector<double> &cluster_distances, const Distance &distance,
+    const Distances &all_distances, std::vector<double> &upper, 
+    std::vector<double> &lower, std::vector<int> &association) const;
+
+  /**
+   * Creates k clusters from some descriptors of a training set with 
+   * mini-batch kmeans, as set in m_training. Each cluster is the mean of 
+   * all the descriptors associated with it in the batches so far, as 
+   * updated by the set. The random numbers are taken from RandomInt
+   * @param set training set
+   * @param indices indices in the set of the n descriptors to cluster
+   * @param n
+   * @param clusters (out) cluster centres
+   */
+  template<class Set>
+  void miniBatchKmeans(const Set &set, const unsigned int *indices, 
+    size_t n, typename Set::Clusters &clusters) const;
+
+  /**
+   * Returns the maximum number of descriptors of a cluster when the
+   * clusters are balanced with m_training.max_occupancy
+   * @param n number of descriptors of the node
+   * @param k number of clusters
+   * @return capacity of each cluster (at least n / k, rounded up)
+   */
+  size_t clusterCapacity(size_t n, unsigned int k) const;
+
+  /**
+   * Balances the clusters of a node as set in m_training.max_occupancy:
+   * the association is capped, the centres are moved to the means of the
+   * capped clusters and the descriptors are associated again, until the
+   * capped association does not change or max_iterations times
+   * @param set training set
+   * @param indices indices in the set of the n descriptors of the node
+   * @param n
+   * @param clusters (in/out) cluster centres
+   * @param association (in/out) closest cluster of each descriptor. On
+   *   return, cluster of each descriptor within the capacity
+   * @param buffers memory to use in the iterations
+   */
+  template<class Set>
+  void balanceClusters(const Set &set, const unsigned int *indices, 
+    size_t n, typename Set::Clusters &clusters, 
+    std::vector<int> &association, TrainingBuffers<Set> &buffers) const;
+
+  /**
+   * Moves the descriptors of the clusters with more than some capacity to
+   * other clusters. The result is the stable assignment found by letting
+   * each descriptor try its clusters from the closest one, and letting
+   * each cluster keep its closest descriptors when it is full (ties broken
+   * by cluster and descriptor index), so that it does not depend on the
+   * order of the descriptors nor on the thread pool
+   * @param n number of descriptors
+   * @param k number of clusters
+   * @param capacity maximum descriptors per cluster (capacity * k >= n)
+   * @param distance function (i, c) that returns the distance from
+   *   descriptor i to cluster c
+   * @param all_distances function (i, d) that stores in d the distances from
+   *   descriptor i to the k clusters
+   * @param association (in/out) closest cluster of each descriptor. On
+   *   return, cluster of each descriptor within the capacity
+   */
+  template<class Distance, class Distances>
+  void capAssociation(size_t n, unsigned int k, size_t capacity,
+    const Distance &distance, const Distances &all_distances,
+    std::vector<int> &association) const;
+
+  /**
+   * Creates k clusters from the given descriptors with some seeding algorithm.
+   * @note In this class, kmeans++ or kmeans|| is used, as set in 
+   *   m_training, but this function should be overriden by inherited 
+   *   classes.
+   */
+  virtual void initiateClusters(const std::vector<pDescriptor> &descriptors,
+    std::vector<TDescriptor> &clusters) const;
+  
+  /**
+   * Creates k clusters from the given descriptor sets by running the
+   * initial step of kmeans++
+   * @param descriptors 
+   * @param clusters resulting clusters
+   */
+  void initiateClustersKMpp(const std::vector<pDescriptor> &descriptors,
+    std::vector<TDescriptor> &clusters) const;
+
+  /**
+   * Creates k clusters from the given descriptors with the kmeans|| 
+   * seeding algorithm
+   * @param descriptors
+   * @param clusters resulting clusters
+   */
+  void initiateClustersKMParallel(const std::vector<pDescriptor> &descriptors,
+    std::vector<TDescriptor> &clusters) const;
+
+  /**
+   * Creates k clusters from some descriptor objects with initiateClusters
+   * @param set training set
+   * @param indices indices in the set of the n descriptors to cluster
+   * @param n
+   * @param clusters (out) cluster centres
+   */
+  void seedClusters(const ObjectTrainingSet<TDescriptor, F> &set,
+    const unsigned int *indices, size_t n, 
+    std::vector<TDescriptor> &clusters) const;
+
+  /**
+   * Creates k clusters from packed descriptors. This is the seeding used
+   * by the packed and streamed training. By default, the descriptors are
+   * given to initiateClusters, so that the seeding is the same as with
+   * descriptor objects, including the one of derived classes that 
+   * override initiateClusters
+   * @param set training set
+   * @param indices indices in the set of the n descriptors to cluster
+   * @param n
+   * @param clusters (out) raw data of the cluster centres
+   */
+  virtual void seedClusters(const PackedTrainingSet<TDescriptor, F> &set,
+    const unsigned int *indices, size_t n,
+    std::vector<unsigned char> &clusters) const;
+
+  /// seedClusters when F provides F::fromArray8U and F::toArray8U
+  template<class G = F>
+  void seedClusters(const PackedTrainingSet<TDescriptor, F> &set,
+    const unsigned int *indices, size_t n,
+    std::vector<unsigned char> &clusters, std::true_type) const;
+
+  /// seedClusters when F does not provide F::fromArray8U or F::toArray8U
+  inline void seedClusters(const PackedTrainingSet<TDescriptor, F> &,
+    const unsigned int *, size_t, std::vector<unsigned char> &, 
+    std::false_type) const
+  {
+    throw std::string("Packed descriptors need F::fromArray8U, "
+      "F::toArray8U and F::BYTES");
+  }
+
+  /**
+   * Chooses up to k of n descriptors as initial cluster centres with the
+   * kmeans|| algorithm. The candidates of each round are sampled in 
+   * parallel, with one engine per chunk of SEEDING_CHUNK descriptors 
+   * seeded from RandomInt, so the result depends only on the state of the
+   * engine of the node
+   * @param n number of descriptors
+   * @param distance function (a, b) that returns the distance between 
+   *   descriptors a and b
+   * @param range_distances function (c, i, m, d) that stores in d the 
+   *   distances from descriptor c to descriptors i..i+m-1, with 
+   *   m <= SEEDING_CHUNK
+   * @param seeds (out) indices of the descriptors chosen
+   */
+  template<class Distance, class Distances>
+  void seedKMParallel(size_t n, const Distance &distance, 
+    const Distances &range_distances, std::vector<size_t> &seeds) const;
+  
+  /**
+   * Create the words of the vocabulary once the tree has been built
+   */
+  void createWords();
+  
+  /**
+   * Sets the weights of the nodes of tree according to the given features.
+   * Before calling this function, the nodes and the words must be already
+   * created (by calling HKmeansStep and createWords)
+   * @param features
+   */
+  void setNodeWeights(const std::vector<std::vector<TDescriptor> > &features);
+
+  /**
+   * Sets the weights of the nodes of tree according to the features of a
+   * reader, as the in-memory version does
+   * @param reader
+   */
+  template<class G = F>
+  void setNodeWeights(DescriptorReader &reader);
+
+  /**
+   * Sets the weights of the nodes of tree according to packed features, as
+   * the in-memory version does
+   * @param training
+   */
+  template<class G = F>
+  void setNodeWeights(const PackedDescriptors &training);
+
+  /**
+   * Adds one to the number of images of each word found in an image whose
+   * descriptors are stored in a buffer
+   * @param image descriptors of the image, one after the other
+   * @param n number of descriptors
+   * @param bytes bytes per descriptor
+   * @param Ni (in/out) number of images of each word
+   */
+  template<class G = F>
+  void countImageWords(const unsigned char *image, int n, int bytes,
+    std::vector<unsigned int> &Ni) const;
+
+  /**
+   * Adds the words found in an image to the counts of computeOccupancy
+   * @param ids (in/out) word of each descriptor of the image. They are 
+   *   sorted on return
+   * @param d distance from each descriptor to its word
+   * @param word_descriptors (in/out) number of descriptors of each word
+   * @param word_images (in/out) number of images of each word
+   * @param distance_sum (in/out) sum of the distances to the words
+   */
+  static void countOccupancy(std::vector<WordId> &ids, 
+    const std::vector<double> &d, std::vector<unsigned int> &word_descriptors,
+    std::vector<unsigned int> &word_images, double &distance_sum);
+
+  /**
+   * Counts the training images that have descriptors in each leaf, from the
+   * assignment made by HKmeansStep
+   * @param features training descriptors of each image
+   * @param leaves leaf of each descriptor of features, one image after other
+   * @param Ni (out) number of images of each node, indexed by node id
+   */
+  void countLeafImages(const std::vector<std::vector<TDescriptor> > &features,
+    const std::vector<NodeId> &leaves, std::vector<unsigned int> &Ni) const;
+
+  /**
+   * Counts the training images that have descriptors in each leaf, from the
+   * assignment made by HKmeansStep with packed descriptors
+   * @param training
+   * @param leaves leaf of each descriptor of training
+   * @param Ni (out) number of images of each node, indexed by node id
+   */
+  void countLeafImages(const PackedDescriptors &training,
+    const std::vector<NodeId> &leaves, std::vector<unsigned int> &Ni) const;
+
+  /**
+   * Sets the weights of the words from the number of training images of
+   * each node, once the words are created
+   * @param Ni number of images of each node, indexed by node id
+   * @param NDocs number of training images
+   */
+  void setLeafWeights(const std::vector<unsigned int> &Ni, 
+    unsigned int NDocs);
+
+  /**
+   * Sets the weights of the words from the number of training images 
+   * each word appears in
+   * @param Ni number of images of each word (unused for TF and BINARY)
+   * @param NDocs number of training images
+   */
+  void setNodeWeights(const std::vector<unsigned int> &Ni, 
+    unsigned int NDocs);
+
+  /**
+   * Compiles the tree in m_nodes into the flat arrays used by transform:
+   * nodes in level order with their children stored contiguously, and the
+   * descriptors of the children of each node stored side by side.
+   * It must be called whenever m_nodes changes. If the flat tree is empty,
+   * m_nodes is used instead
+   */
+  void createFlatTree();
+
+  /**
+   * Computes the checksum returned by getBinaryHash by composing the
+   * binary file of the vocabulary
+   * @return hash
+   */
+  virtual unsigned long long computeBinaryHash() const;
+  
+  /**
+   * Returns a random number in the range [min..max]
+   * @param min
+   * @param max
+   * @return random T number in [min..max]
+   */
+  template <class T>
+  static T RandomValue(T min, T max){
+      std::mt19937 *engine = randomEngine();
+      if(engine)
+        return ((T)(*engine)()/(T)std::mt19937::max()) * (max - min) + min;
+      else
+        return ((T)rand()/(T)RAND_MAX) * (max - min) + min;
+  }
+
+  /**
+   * Returns a random int in the range [min..max]
+   * @param min
+   * @param max
+   * @return random int in [min..max]
+   */
+  static int RandomInt(int min, int max){
+      int d = max - min + 1;
+      std::mt19937 *engine = randomEngine();
+      if(engine)
+        return int(((double)(*engine)()/
+          ((double)std::mt19937::max() + 1.0)) * d) + min;
+      else
+        return int(((double)rand()/((double)RAND_MAX + 1.0)) * d) + min;
+  }
+
+  /**
+   * Returns the random engine RandomValue and RandomInt use in the calling
+   * thread. While creating the vocabulary, it is the engine of the node 
+   * being split; otherwise it is NULL, and rand() is used
+   * @return reference to the engine pointer of this thread
+   */
+  static std::mt19937*& randomEngine()
+  {
+    static thread_local std::mt19937 *engine = NULL;
+    return engine;
+  }
+
+  /// Makes RandomValue and RandomInt use an engine in this thread while 
+  /// it exists
+  class RandomEngineScope
+  {
+  public:
+    explicit RandomEngineScope(std::mt19937 &engine)
+      : m_last(randomEngine())
+    {
+      randomEngine() = &engine;
+    }
+    
+    ~RandomEngineScope()
+    {
+      randomEngine() = m_last;
+    }
+    
+  private:
+    std::mt19937 *m_last;
+  };
+
+  /**
+   * Derives the seed of a child node from the seed of its parent
+   * @param seed seed of the parent
+   * @param i index of the child
+   * @return seed of the child
+   */
+  static unsigned int childSeed(unsigned int seed, unsigned int i)
+  {
+    // splitmix64 finalizer
+    unsigned long long z = 
+      (((unsigned long long)seed << 32) | i) + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (unsigned int)(z ^ (z >> 31));
+  }
+
+protected:
+
+  /// Branching factor
+  int m_k;
+  
+  /// Depth levels 
+  int m_L;
+  
+  /// Weighting method
+  WeightingType m_weighting;
+  
+  /// Scoring method
+  ScoringType m_scoring;
+  
+  /// Object for computing scores
+  GeneralScoring* m_scoring_object;
+  
+  /// Tree nodes
+  std::vector<Node> m_nodes;
+  
+  /// Words of the vocabulary (tree leaves)
+  /// this condition holds: m_words[wid]->word_id == wid
+  std::vector<Node*> m_words;
+
+  /// Flat tree nodes in level order (root at index 0)
+  std::vector<FlatNode> m_flat_nodes;
+
+  /// Descriptors of the flat tree nodes: m_flat_descriptors[i] is the
+  /// descriptor of m_flat_nodes[i]
+  std::vector<TDescriptor> m_flat_descriptors;
+
+  /// Contiguous buffer the flat descriptors point to, if their type allows it
+  cv::Mat m_flat_buffer;
+
+  /// Thread pool (not owned) to transform large sets of features and to 
+  /// create the vocabulary
+  ThreadPool *m_pool;
+
+  /// Protects m_nodes while the subtrees are created in parallel
+  std::mutex m_nodes_mutex;
+
+  /// Checkpoint of the vocabulary being created, or NULL
+  TrainingCheckpoint *m_checkpoint;
+
+  /// Options used by create
+  TrainingOptions m_training;
+
+  /// Checksum of the binary file, if m_has_binary_hash
+  mutable unsigned long long m_binary_hash;
+
+  /// Whether m_binary_hash is up to date. It must be reset whenever the
+  /// parameters, the nodes or the weights change
+  mutable bool m_has_binary_hash;
+
+  /// Protects m_binary_hash while it is computed
+  mutable std::mutex m_binary_hash_mutex;
+  
+};
+
+// --------------------------------------------------------------------------
+
+/**
+ * Makes a set of descriptors share a contiguous buffer, if their type
+ * allows it. This generic version does nothing
+ * @param descriptors
+ * @param buffer (out) buffer where the descriptor data are stored
+ */
+template<class T>
+inline void packDescriptors(std::vector<T> &, cv::Mat &buffer)
+{
+  buffer.release();
+}
+
+/**
+ * Copies a set of single-row cv::Mat descriptors into a single matrix, one
+ * row each, and makes the descriptors point to their row. Empty descriptors
+ * are left empty. If the descriptors do not share size and type, they are
+ * left unchanged
+ * @param descriptors
+ * @param buffer (out) matrix where the descriptor data are stored
+ */
+inline void packDescriptors(std::vector<cv::Mat> &descriptors, 
+  cv::Mat &buffer)
+{
+  buffer.release();
+
+  int rows = 0, cols = 0, type = 0;
+  std::vector<cv::Mat>::const_iterator dit;
+  for(dit = descriptors.begin(); dit != descriptors.end(); ++dit)
+  {
+    if(dit->empty()) continue;
+    
+    if(rows == 0)
+    {
+      cols = dit->cols;
+      type = dit->type();
+    }
+    else if(dit->rows != 1 || dit->cols != cols || dit->type() != type)
+    {
+      return;
+    }
+    ++rows;
+  }
+  
+  if(rows == 0) return;
+
+  buffer.create(rows, cols, type);
+  
+  int r = 0;
+  std::vector<cv::Mat>::iterator it;
+  for(it = descriptors.begin(); it != descriptors.end(); ++it)
+  {
+    if(it->empty()) continue;
+    
+    cv::Mat row = buffer.row(r++);
+    it->copyTo(row);
+    *it = row;
+  }
+}
+
+/**
+ * Returns the raw data of a descriptor laid out as a row of the buffer
+ * made by packDescriptors. This generic version returns NULL
+ * @param descriptor
+ * @param buffer
+ * @return NULL
+ */
+template<class T>
+inline const unsigned char* packedData(const T &, const cv::Mat &)
+{
+  return NULL;
+}
+
+/**
+ * Returns the raw data of a cv::Mat descriptor laid out as a row of the
+ * buffer made by packDescriptors
+ * @param descriptor
+ * @param buffer
+ * @return data of the descriptor, or NULL if it is not a row of the size
+ *   and type of those of the buffer
+ */
+inline const unsigned char* packedData(const cv::Mat &descriptor, 
+  const cv::Mat &buffer)
+{
+  if(descriptor.rows != 1 || descriptor.cols != buffer.cols || 
+    descriptor.type() != buffer.type())
+  {
+    return NULL;
+  }
+  return descriptor.data;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+const size_t TemplatedVocabulary<TDescriptor,F>::SEEDING_CHUNK;
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
+  (int k, int L, WeightingType weighting, ScoringType scoring)
+  : m_k(k), m_L(L), m_weighting(weighting), m_scoring(scoring),
+  m_scoring_object(NULL), m_pool(NULL),
+  m_checkpoint(NULL), m_binary_hash(0), m_has_binary_hash(false)
+{
+  createScoringObject();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
+  (const std::string &filename): m_scoring_object(NULL), m_pool(NULL),
+  m_checkpoint(NULL), m_binary_hash(0), m_has_binary_hash(false)
+{
+  load(filename);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
+  (const char *filename): m_scoring_object(NULL), m_pool(NULL),
+  m_checkpoint(NULL), m_binary_hash(0), m_has_binary_hash(false)
+{
+  load(filename);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::createScoringObject()
+{
+  delete m_scoring_object;
+  m_scoring_object = NULL;
+  
+  switch(m_scoring)
+  {
+    case L1_NORM: 
+      m_scoring_object = new L1Scoring;
+      break;
+      
+    case L2_NORM:
+      m_scoring_object = new L2Scoring;
+      break;
+    
+    case CHI_SQUARE:
+      m_scoring_object = new ChiSquareScoring;
+      break;
+      
+    case KL:
+      m_scoring_object = new KLScoring;
       break;
       
     case BHATTACHARYYA:
@@ -495,324 +1876,1481 @@ void TemplatedVocabulary<TDescriptor,F>::createScoringObject()
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-void TemplatedVocabulary<TDescriptor,F>::setScoringType(ScoringType type)
+void TemplatedVocabulary<TDescriptor,F>::setScoringType(ScoringType type)
+{
+  m_scoring = type;
+  m_has_binary_hash = false;
+  createScoringObject();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::setWeightingType(WeightingType type)
+{
+  this->m_weighting = type;
+  this->m_has_binary_hash = false;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary(
+  const TemplatedVocabulary<TDescriptor, F> &voc)
+  : m_scoring_object(NULL), m_pool(NULL),
+  m_checkpoint(NULL), m_binary_hash(0), m_has_binary_hash(false)
+{
+  *this = voc;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+TemplatedVocabulary<TDescriptor,F>::~TemplatedVocabulary()
+{
+  delete m_scoring_object;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+TemplatedVocabulary<TDescriptor, F>* 
+TemplatedVocabulary<TDescriptor,F>::clone() const
+{
+  return new TemplatedVocabulary<TDescriptor, F>(*this);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+TemplatedVocabulary<TDescriptor, F>& 
+TemplatedVocabulary<TDescriptor,F>::operator=
+  (const TemplatedVocabulary<TDescriptor, F> &voc)
+{  
+  this->m_k = voc.m_k;
+  this->m_L = voc.m_L;
+  this->m_scoring = voc.m_scoring;
+  this->m_weighting = voc.m_weighting;
+  this->m_pool = voc.m_pool;
+  this->m_training = voc.m_training;
+
+  this->createScoringObject();
+  
+  this->m_nodes.clear();
+  this->m_words.clear();
+  
+  this->m_nodes = voc.m_nodes;
+  this->createWords();
+  this->createFlatTree();
+  
+  return *this;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::create(
+  const std::vector<std::vector<TDescriptor> > &training_features)
+{
+  m_nodes.clear();
+  m_has_binary_hash = false;
+  m_words.clear();
+  m_flat_nodes.clear();
+  m_flat_descriptors.clear();
+  
+  // expected_nodes = Sum_{i=0..L} ( k^i )
+	int expected_nodes = 
+		(int)((pow((double)m_k, (double)m_L + 1) - 1)/(m_k - 1));
+
+  m_nodes.reserve(expected_nodes); // avoid allocations when creating the tree
+  
+  
+  std::vector<pDescriptor> features;
+  getFeatures(training_features, features);
+
+
+  // create root  
+  m_nodes.push_back(Node(0)); // root
+  
+  // count the images of each word with the leaves of the clustering
+  const bool count_leaves = !m_training.transform_weights && 
+    m_training.max_occupancy <= 0 && 
+    (m_weighting == IDF || m_weighting == TF_IDF);
+  std::vector<NodeId> leaves(count_leaves ? features.size() : 0);
+  std::vector<unsigned int> Ni;
+  
+  // create the tree. The seed only depends on the state of rand(), so that
+  // the tree does not depend on the number of threads
+  const unsigned int seed = (unsigned int)rand();
+  
+  // the descriptors are only read to identify them if there is a 
+  // checkpoint
+  const unsigned long long fingerprint = 
+    m_training.checkpoint_file.empty() ? 0 :
+    trainingFingerprint(seed, training_features, std::integral_constant<
+      bool, HasArray8U<F>::value && HasToArray8U<F>::value>());
+  CheckpointScope checkpoint(*this, fingerprint);
+  
+  HKmeansStep(0, features, 1, seed, (count_leaves ? &leaves : NULL));
+  
+  if(count_leaves)
+  {
+    countLeafImages(training_features, leaves, Ni);
+    std::vector<NodeId>().swap(leaves);
+  }
+  
+  renumberNodes(count_leaves ? &Ni : NULL);
+
+  // create the words
+  createWords();
+
+  // compile the tree for transform
+  createFlatTree();
+
+  // and set the weight of each node of the tree
+  if(count_leaves)
+    setLeafWeights(Ni, training_features.size());
+  else
+    setNodeWeights(training_features);
+  
+  checkpoint.finish();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::create(
+  const std::vector<std::vector<TDescriptor> > &training_features,
+  int k, int L)
+{
+  m_k = k;
+  m_L = L;
+  
+  create(training_features);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::create(
+  const std::vector<std::vector<TDescriptor> > &training_features,
+  int k, int L, WeightingType weighting, ScoringType scoring)
+{
+  m_k = k;
+  m_L = L;
+  m_weighting = weighting;
+  m_scoring = scoring;
+  createScoringObject();
+  
+  create(training_features);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::create(
+  const std::vector<std::vector<TDescriptor> > &training_features,
+  int k, int L, WeightingType weighting, ScoringType scoring,
+  const TrainingOptions &options)
+{
+  m_training = options;
+  
+  create(training_features, k, L, weighting, scoring);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::create(DescriptorReader &reader)
+{
+  create(reader, std::integral_constant<bool, HasPacked8U<F>::value>());
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::create(DescriptorReader &reader,
+  std::true_type)
+{
+  m_nodes.clear();
+  m_has_binary_hash = false;
+  m_words.clear();
+  m_flat_nodes.clear();
+  m_flat_descriptors.clear();
+  
+  // expected_nodes = Sum_{i=0..L} ( k^i )
+	int expected_nodes = 
+		(int)((pow((double)m_k, (double)m_L + 1) - 1)/(m_k - 1));
+
+  m_nodes.reserve(expected_nodes); // avoid allocations when creating the tree
+  
+  // create root  
+  m_nodes.push_back(Node(0)); // root
+  
+  // create the tree, reading the root descriptors from the reader
+  const int bytes = reader.descriptorBytes();
+  const unsigned int seed = (unsigned int)rand();
+  std::vector<unsigned char> image;
+  
+  // the descriptors are identified in the checkpoint as the first pass 
+  // reads them, as the in-memory training does, and the checkpoint is 
+  // opened after it, before the root is split
+  CheckpointScope checkpoint(*this);
+  const bool identify = !m_training.checkpoint_file.empty();
+  bool first_pass = true;
+  
+  RowScanner scan = [&](const RowVisitor &visit)
+  {
+    unsigned long long data_hash = TrainingCheckpoint::hash(NULL, 0);
+    
+    reader.rewind();
+    while(reader.next(image))
+    {
+      if(first_pass && identify)
+      {
+        const unsigned long long m = image.size() / bytes;
+        data_hash = TrainingCheckpoint::hash(&m, sizeof(m), data_hash);
+        data_hash = TrainingCheckpoint::hash(image.data(), image.size(),
+          data_hash);
+      }
+      
+      if(!image.empty()) visit(image.data(), image.size() / bytes);
+    }
+    
+    if(first_pass)
+    {
+      first_pass = false;
+      if(identify) 
+        checkpoint.open(trainingFingerprint(seed, bytes, data_hash));
+    }
+  };
+  
+  streamHKmeansStep(0, scan, bytes, 1, seed, ROOT_KEY);
+  renumberNodes();
+
+  // create the words
+  createWords();
+
+  // compile the tree for transform
+  createFlatTree();
+
+  // and set the weight of each node of the tree
+  setNodeWeights(reader);
+  
+  checkpoint.finish();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::create(DescriptorReader &reader,
+  int k, int L, WeightingType weighting, ScoringType scoring)
+{
+  m_k = k;
+  m_L = L;
+  m_weighting = weighting;
+  m_scoring = scoring;
+  createScoringObject();
+  
+  create(reader);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::create(
+  const PackedDescriptors &training)
+{
+  create(training, std::integral_constant<bool, HasPacked8U<F>::value>());
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::create(
+  const PackedDescriptors &training, std::true_type)
+{
+  m_nodes.clear();
+  m_has_binary_hash = false;
+  m_words.clear();
+  m_flat_nodes.clear();
+  m_flat_descriptors.clear();
+  
+  // expected_nodes = Sum_{i=0..L} ( k^i )
+	int expected_nodes = 
+		(int)((pow((double)m_k, (double)m_L + 1) - 1)/(m_k - 1));
+
+  m_nodes.reserve(expected_nodes); // avoid allocations when creating the tree
+  
+  // create root  
+  m_nodes.push_back(Node(0)); // root
+  
+  // count the images of each word with the leaves of the clustering
+  const bool count_leaves = !m_training.transform_weights && 
+    m_training.max_occupancy <= 0 && 
+    (m_weighting == IDF || m_weighting == TF_IDF);
+  std::vector<NodeId> leaves(count_leaves ? training.size() : 0);
+  std::vector<unsigned int> Ni;
+  
+  // create the tree
+  const unsigned int seed = (unsigned int)rand();
+  const int bytes = training.descriptorBytes();
+  CheckpointScope checkpoint(*this, trainingFingerprint(seed, bytes, 
+    TrainingCheckpoint::hash(training.data(), training.size() * bytes)));
+  
+  HKmeansStep(0, PackedTrainingSet<TDescriptor, F>(training), 1, seed, 
+    ROOT_KEY, (count_leaves ? &leaves : NULL));
+  
+  if(count_leaves)
+  {
+    countLeafImages(training, leaves, Ni);
+    std::vector<NodeId>().swap(leaves);
+  }
+  
+  renumberNodes(count_leaves ? &Ni : NULL);
+
+  // create the words
+  createWords();
+
+  // compile the tree for transform
+  createFlatTree();
+
+  // and set the weight of each node of the tree
+  if(count_leaves)
+    setLeafWeights(Ni, training.images());
+  else
+    setNodeWeights(training);
+  
+  checkpoint.finish();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::create(
+  const PackedDescriptors &training,
+  int k, int L, WeightingType weighting, ScoringType scoring)
 {
-  m_scoring = type;
+  m_k = k;
+  m_L = L;
+  m_weighting = weighting;
+  m_scoring = scoring;
   createScoringObject();
+  
+  create(training);
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-void TemplatedVocabulary<TDescriptor,F>::setWeightingType(WeightingType type)
+void TemplatedVocabulary<TDescriptor,F>::getFeatures(
+  const std::vector<std::vector<TDescriptor> > &training_features,
+  std::vector<pDescriptor> &features) const
 {
-  this->m_weighting = type;
+  features.resize(0);
+  
+  typename std::vector<std::vector<TDescriptor> >::const_iterator vvit;
+  typename std::vector<TDescriptor>::const_iterator vit;
+  for(vvit = training_features.begin(); vvit != training_features.end(); ++vvit)
+  {
+    features.reserve(features.size() + vvit->size());
+    for(vit = vvit->begin(); vit != vvit->end(); ++vit)
+    {
+      features.push_back(&(*vit));
+    }
+  }
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary(
-  const TemplatedVocabulary<TDescriptor, F> &voc)
-  : m_scoring_object(NULL)
+void TemplatedVocabulary<TDescriptor,F>::HKmeansStep(NodeId parent_id, 
+  const std::vector<pDescriptor> &descriptors, int current_level, 
+  unsigned int seed, std::vector<NodeId> *leaves)
 {
-  *this = voc;
+  HKmeansStep(parent_id, ObjectTrainingSet<TDescriptor, F>(descriptors), 
+    current_level, seed, ROOT_KEY, leaves);
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-TemplatedVocabulary<TDescriptor,F>::~TemplatedVocabulary()
+template<class Set>
+void TemplatedVocabulary<TDescriptor,F>::HKmeansStep(NodeId parent_id, 
+  const Set &set, int current_level, unsigned int seed, 
+  unsigned long long key, std::vector<NodeId> *leaves)
 {
-  delete m_scoring_object;
+  // all the levels sort ranges of a single array of indices
+  std::vector<unsigned int> indices(set.size());
+  for(size_t i = 0; i < indices.size(); ++i) indices[i] = i;
+  
+  TrainingBuffers<Set> buffers;
+  TrainingBuffersPool<Set> pool;
+  
+  HKmeansStep(parent_id, set, indices.data(), indices.size(), 
+    current_level, seed, key, buffers, pool, leaves);
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-TemplatedVocabulary<TDescriptor, F>& 
-TemplatedVocabulary<TDescriptor,F>::operator=
-  (const TemplatedVocabulary<TDescriptor, F> &voc)
-{  
-  this->m_k = voc.m_k;
-  this->m_L = voc.m_L;
-  this->m_scoring = voc.m_scoring;
-  this->m_weighting = voc.m_weighting;
+template<class Set>
+void TemplatedVocabulary<TDescriptor,F>::HKmeansStep(NodeId parent_id, 
+  const Set &set, unsigned int *indices, size_t n, int current_level, 
+  unsigned int seed, unsigned long long key, TrainingBuffers<Set> &buffers,
+  TrainingBuffersPool<Set> &pool, std::vector<NodeId> *leaves)
+{
+  if(n == 0) return;
+  
+  if(buffers.children.size() <= (size_t)std::max(m_L, current_level))
+  {
+    buffers.children.resize(std::max(m_L, current_level) + 1);
+    buffers.offsets.resize(std::max(m_L, current_level) + 1);
+  }
+  std::vector<NodeId> &children_ids = buffers.children[current_level];
+  std::vector<size_t> &offsets = buffers.offsets[current_level];
+  
+  // features associated to each cluster, unless the split was saved
+  typename Set::Clusters &clusters = buffers.clusters;
+  if(!loadSplit(key, n, set, clusters, buffers.association))
+  {
+    clusterDescriptors(set, indices, n, seed, clusters, buffers.association,
+      buffers);
+    saveSplit(key, set, clusters, buffers.association);
+  }
+  
+  const unsigned int nclusters = set.count(clusters);
+  sortByCluster(indices, n, buffers.association, nclusters, buffers.sorted,
+    offsets);
+  
+  // create nodes
+  children_ids.clear();
+  {
+    std::unique_lock<std::mutex> lock(m_nodes_mutex);
+    
+    for(unsigned int i = 0; i < nclusters; ++i)
+    {
+      NodeId id = m_nodes.size();
+      m_nodes.push_back(Node(id));
+      set.getCluster(clusters, i, m_nodes.back().descriptor);
+      detachDescriptor(m_nodes.back().descriptor);
+      m_nodes.back().parent = parent_id;
+      m_nodes[parent_id].children.push_back(id);
+      children_ids.push_back(id);
+    }
+  }
+  
+  if(leaves)
+  {
+    for(unsigned int i = 0; i < nclusters; ++i)
+    {
+      if(current_level >= m_L || offsets[i+1] - offsets[i] <= 1)
+      {
+        // the child is a leaf
+        for(size_t j = offsets[i]; j < offsets[i+1]; ++j)
+          (*leaves)[indices[j]] = children_ids[i];
+      }
+    }
+  }
+  
+  // go on with the next level
+  if(current_level < m_L)
+  {
+    // the descriptors of child i are those in [offsets[i], offsets[i+1])
+    auto train = [&](unsigned int i, TrainingBuffers<Set> &child_buffers)
+      {
+        if(offsets[i+1] - offsets[i] > 1)
+        {
+          HKmeansStep(children_ids[i], set, indices + offsets[i],
+            offsets[i+1] - offsets[i], current_level + 1, childSeed(seed, i),
+            TrainingCheckpoint::childKey(key, i), child_buffers, pool, 
+            leaves);
+        }
+      };
+    
+    if(useThreadPool(n))
+    {
+      // create the subtrees in parallel, each task with its own buffers
+      m_pool->parallelFor(0, (int)nclusters, 1, [&](int b, int e)
+        {
+          TrainingBuffers<Set> *child_buffers = pool.take();
+          try
+          {
+            for(int i = b; i < e; ++i) train(i, *child_buffers);
+          }
+          catch(...)
+          {
+            pool.give(child_buffers);
+            throw;
+          }
+          pool.give(child_buffers);
+        });
+    }
+    else
+    {
+      for(unsigned int i = 0; i < nclusters; ++i) train(i, buffers);
+    }
+  }
+}
 
-  this->createScoringObject();
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+unsigned long long TemplatedVocabulary<TDescriptor,F>::trainingFingerprint(
+  unsigned int seed, int bytes, unsigned long long data_hash) const
+{
+  unsigned long long h = TrainingCheckpoint::hash(NULL, 0);
+  auto add = [&h](unsigned long long v)
+    {
+      h = TrainingCheckpoint::hash(&v, sizeof(v), h);
+    };
+  auto addReal = [&h](double v)
+    {
+      h = TrainingCheckpoint::hash(&v, sizeof(v), h);
+    };
   
-  this->m_nodes.clear();
-  this->m_words.clear();
+  add(m_k);
+  add(m_L);
+  add(seed);
+  add(bytes);
+  add(data_hash);
+  add(m_training.clustering);
+  add(m_training.seeding);
+  add(m_training.seeding_rounds);
+  addReal(m_training.oversampling);
+  add(m_training.batch_size);
+  add(m_training.max_iterations);
+  addReal(m_training.tolerance);
+  addReal(m_training.max_occupancy);
+  add(m_training.max_in_memory);
   
-  this->m_nodes = voc.m_nodes;
-  this->createWords();
+  return h;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+unsigned long long TemplatedVocabulary<TDescriptor,F>::trainingFingerprint(
+  unsigned int seed, 
+  const std::vector<std::vector<TDescriptor> > &training_features,
+  std::true_type) const
+{
+  const int bytes = F::BYTES;
+  std::vector<unsigned char> data;
   
-  return *this;
+  unsigned long long data_hash = TrainingCheckpoint::hash(NULL, 0);
+  for(size_t i = 0; i < training_features.size(); ++i)
+  {
+    const std::vector<TDescriptor> &image = training_features[i];
+    const unsigned long long m = image.size();
+    data_hash = TrainingCheckpoint::hash(&m, sizeof(m), data_hash);
+    
+    data.resize(image.size() * bytes);
+    for(size_t j = 0; j < image.size(); ++j)
+    {
+      F::toArray8U(image[j], &data[j * bytes]);
+    }
+    data_hash = TrainingCheckpoint::hash(data.data(), data.size(), 
+      data_hash);
+  }
+  
+  return trainingFingerprint(seed, bytes, data_hash);
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-void TemplatedVocabulary<TDescriptor,F>::create(
-  const std::vector<std::vector<TDescriptor> > &training_features)
+template<class Set>
+bool TemplatedVocabulary<TDescriptor,F>::loadSplit(unsigned long long key,
+  size_t n, const Set &set, typename Set::Clusters &clusters, 
+  std::vector<int> &association) const
 {
-  m_nodes.clear();
-  m_words.clear();
+  // the clusters are stored as raw data, so that they are exact
+  if(set.bytes() == 0) return false;
   
-  // expected_nodes = Sum_{i=0..L} ( k^i )
-	int expected_nodes = 
-		(int)((pow((double)m_k, (double)m_L + 1) - 1)/(m_k - 1));
+  std::vector<unsigned char> data;
+  if(!loadSplit(key, n, set.bytes(), data, association)) return false;
+  
+  set.fromRaw(data, clusters);
+  return true;
+}
 
-  m_nodes.reserve(expected_nodes); // avoid allocations when creating the tree
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::loadSplit(unsigned long long key,
+  size_t n, int bytes, std::vector<unsigned char> &clusters, 
+  std::vector<int> &association) const
+{
+  TrainingCheckpoint::Split split;
+  if(!m_checkpoint || !m_checkpoint->find(key, split)) return false;
   
+  clusters.swap(split.clusters);
+  association.swap(split.association);
   
-  std::vector<pDescriptor> features;
-  getFeatures(training_features, features);
+  const size_t nclusters = clusters.size() / bytes;
+  for(size_t i = 0; i < association.size(); ++i)
+  {
+    if(association[i] < 0 || association[i] >= (int)nclusters)
+      association.clear();
+  }
+  
+  if(association.size() != n || clusters.size() % bytes != 0 ||
+    nclusters == 0 || (int)nclusters > m_k)
+  {
+    throw std::string("Checkpoint ") + m_training.checkpoint_file + 
+      " does not match the training descriptors";
+  }
+  
+  return true;
+}
 
+// --------------------------------------------------------------------------
 
-  // create root  
-  m_nodes.push_back(Node(0)); // root
+template<class TDescriptor, class F>
+template<class Set>
+void TemplatedVocabulary<TDescriptor,F>::saveSplit(unsigned long long key, 
+  const Set &set, const typename Set::Clusters &clusters, 
+  const std::vector<int> &association) const
+{
+  if(!m_checkpoint || set.bytes() == 0) return;
   
-  // create the tree
-  HKmeansStep(0, features, 1);
+  std::vector<unsigned char> data;
+  set.toRaw(clusters, data);
+  saveSplit(key, data, association);
+}
 
-  // create the words
-  createWords();
+// --------------------------------------------------------------------------
 
-  // and set the weight of each node of the tree
-  setNodeWeights(training_features);
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::saveSplit(unsigned long long key, 
+  const std::vector<unsigned char> &clusters, 
+  const std::vector<int> &association) const
+{
+  if(!m_checkpoint) return;
+  
+  m_checkpoint->save(key, clusters.data(), clusters.size(), 
+    association.data(), association.size());
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::sortByCluster(unsigned int *indices,
+  size_t n, const std::vector<int> &association, unsigned int k,
+  std::vector<unsigned int> &sorted, std::vector<size_t> &offsets)
+{
+  // count the indices of each cluster
+  offsets.assign(k + 1, 0);
+  for(size_t i = 0; i < n; ++i) ++offsets[association[i] + 1];
+  for(unsigned int c = 0; c < k; ++c) offsets[c + 1] += offsets[c];
+  
+  // place them, which moves offsets[c] to the beginning of cluster c + 1
+  sorted.resize(n);
+  for(size_t i = 0; i < n; ++i) sorted[offsets[association[i]]++] = indices[i];
+  
+  for(unsigned int c = k; c > 0; --c) offsets[c] = offsets[c - 1];
+  offsets[0] = 0;
+  
+  std::copy(sorted.begin(), sorted.begin() + n, indices);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class Set>
+void TemplatedVocabulary<TDescriptor,F>::clusterDescriptors(const Set &set,
+  const unsigned int *indices, size_t n, unsigned int seed, 
+  typename Set::Clusters &clusters, std::vector<int> &association, 
+  TrainingBuffers<Set> &buffers) const
+{
+  clusters.clear();
+  
+  if((int)n <= m_k)
+  {
+    // trivial case: one cluster per feature
+    association.resize(n);
+    
+    for(unsigned int i = 0; i < n; i++)
+    {
+      association[i] = i;
+      set.addCluster(clusters, indices[i]);
+    }
+    return;
+  }
+  
+  std::mt19937 engine(seed);
+  RandomEngineScope random_scope(engine);
+  
+  if(m_training.clustering == MINI_BATCH_KMEANS && 
+    (int)n > m_training.batch_size)
+  {
+    // select clusters with mini-batch kmeans, and then the groups
+    miniBatchKmeans(set, indices, n, clusters);
+    associate(set, indices, n, clusters, association);
+  }
+  else
+  {
+    // select clusters and groups with kmeans
+    const bool bounded = (m_training.assignment != FULL_ASSIGNMENT);
+    std::vector<int> &last_association = buffers.last_association;
+    
+    seedClusters(set, indices, n, clusters);
+    if(bounded)
+    {
+      associateBounded(set, indices, n, clusters, NULL, buffers.upper, 
+        buffers.lower, association);
+    }
+    else
+    {
+      associate(set, indices, n, clusters, association);
+    }
+    
+    // descriptors of each cluster
+    const unsigned int k = set.count(clusters);
+    std::vector<std::vector<typename Set::Descriptor> > &members = 
+      buffers.members;
+    if(members.size() < k) members.resize(k);
+    
+    do
+    {
+      // calculate cluster centres
+      for(unsigned int c = 0; c < k; ++c) members[c].clear();
+      for(size_t i = 0; i < n; ++i)
+      {
+        members[association[i]].push_back(set[indices[i]]);
+      }
+      
+      if(bounded) buffers.last_clusters = clusters;
+      for(unsigned int c = 0; c < k; ++c)
+      {
+        set.mean(members[c], clusters, c);
+      }
+      
+      // associate features with clusters, until they do not change
+      if(bounded)
+      {
+        last_association = association;
+        associateBounded(set, indices, n, clusters, &buffers.last_clusters,
+          buffers.upper, buffers.lower, association);
+      }
+      else
+      {
+        last_association.swap(association);
+        associate(set, indices, n, clusters, association);
+      }
+      
+    } while(association != last_association);
+  }
+  
+  if(m_training.max_occupancy > 0)
+    balanceClusters(set, indices, n, clusters, association, buffers);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class Set>
+void TemplatedVocabulary<TDescriptor,F>::associate(const Set &set,
+  const unsigned int *indices, size_t n, 
+  const typename Set::Clusters &clusters, 
+  std::vector<int> &association) const
+{
+  association.resize(n);
+  
+  const unsigned int k = set.count(clusters);
+  
+  auto run = [&](int b, int e)
+    {
+      std::vector<double> d(k);
+      
+      for(int i = b; i < e; ++i)
+      {
+        set.distances(indices ? indices[i] : i, clusters, &d[0]);
+        
+        unsigned int best = 0;
+        for(unsigned int c = 1; c < k; ++c)
+        {
+          if(d[c] < d[best]) best = c;
+        }
+        association[i] = best;
+      }
+    };
+  
+  if(useThreadPool(n))
+  {
+    m_pool->parallelFor(0, (int)n, PARALLEL_GRAIN, run);
+  }
+  else
+  {
+    run(0, (int)n);
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class Set>
+void TemplatedVocabulary<TDescriptor,F>::associateBounded(const Set &set,
+  const unsigned int *indices, size_t n, 
+  const typename Set::Clusters &clusters, 
+  const typename Set::Clusters *last_clusters,
+  std::vector<double> &upper, std::vector<double> &lower,
+  std::vector<int> &association) const
+{
+  const unsigned int k = set.count(clusters);
+  
+  std::vector<double> cluster_distances(k * k);
+  for(unsigned int c = 0; c < k; ++c)
+  {
+    set.clusterDistances(clusters, c, &cluster_distances[c * k]);
+  }
+  
+  // distance each cluster moved
+  std::vector<double> shifts;
+  if(last_clusters)
+  {
+    shifts.resize(k);
+    for(unsigned int c = 0; c < k; ++c)
+    {
+      shifts[c] = set.shift(*last_clusters, clusters, c);
+    }
+  }
   
+  auto distance = [&](size_t i, unsigned int c) -> double
+    {
+      return set.distance(indices[i], clusters, c);
+    };
+  
+  auto all_distances = [&](size_t i, double *d)
+    {
+      set.distances(indices[i], clusters, d);
+    };
+  
+  if(m_training.assignment == ELKAN_ASSIGNMENT)
+  {
+    updateElkan(n, k, shifts, cluster_distances, distance, all_distances, 
+      upper, lower, association);
+  }
+  else
+  {
+    updateHamerly(n, k, shifts, cluster_distances, distance, all_distances,
+      upper, lower, association);
+  }
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-void TemplatedVocabulary<TDescriptor,F>::create(
-  const std::vector<std::vector<TDescriptor> > &training_features,
-  int k, int L)
+template<class Set>
+void TemplatedVocabulary<TDescriptor,F>::miniBatchKmeans(const Set &set,
+  const unsigned int *indices, size_t n, 
+  typename Set::Clusters &clusters) const
 {
-  m_k = k;
-  m_L = L;
+  seedClusters(set, indices, n, clusters);
   
-  create(training_features);
+  const unsigned int k = set.count(clusters);
+  
+  // descriptors associated with each cluster in the last batch, or in all
+  // the batches if the set needs them to update the means
+  std::vector<std::vector<typename Set::Descriptor> > members(k);
+  std::vector<int> counts;
+  std::vector<int> sizes(k, 0);
+  
+  std::vector<unsigned int> batch(m_training.batch_size);
+  std::vector<int> association;
+  std::vector<bool> moved(k);
+  
+  for(int it = 0; it < m_training.max_iterations; ++it)
+  {
+    // sample the batch
+    for(size_t i = 0; i < batch.size(); ++i)
+    {
+      batch[i] = indices[RandomInt(0, (int)n - 1)];
+    }
+    
+    associate(set, batch.data(), batch.size(), clusters, association);
+    
+    std::fill(moved.begin(), moved.end(), false);
+    for(size_t i = 0; i < batch.size(); ++i)
+    {
+      members[association[i]].push_back(set[batch[i]]);
+      moved[association[i]] = true;
+    }
+    
+    // update the clusters that got descriptors
+    double shift = 0;
+    for(unsigned int c = 0; c < k; ++c)
+    {
+      if(moved[c]) 
+        shift += set.updateCluster(members[c], counts, sizes, clusters, c);
+    }
+    
+    if(shift / k <= m_training.tolerance) break;
+  }
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-void TemplatedVocabulary<TDescriptor,F>::create(
-  const std::vector<std::vector<TDescriptor> > &training_features,
-  int k, int L, WeightingType weighting, ScoringType scoring)
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::streamHKmeansStep(NodeId parent_id,
+  const RowScanner &scan, int bytes, int current_level, unsigned int seed,
+  unsigned long long key)
 {
-  m_k = k;
-  m_L = L;
-  m_weighting = weighting;
-  m_scoring = scoring;
-  createScoringObject();
+  const size_t M = 
+    (size_t)std::max(m_training.max_in_memory, std::max(m_k, 1));
   
-  create(training_features);
+  // read the descriptors while they fit in memory, and a uniform sample 
+  // of M of them afterwards
+  PackedDescriptors sample(bytes);
+  size_t n = 0;
+  std::mt19937_64 engine(childSeed(seed, ~0u));
+  
+  scan([&](const unsigned char *rows, size_t count)
+    {
+      if(n < M)
+      {
+        const size_t m = std::min(count, M - n);
+        sample.append(rows, m);
+        rows += m * bytes;
+        count -= m;
+        n += m;
+      }
+      
+      for(size_t r = 0; r < count; ++r, ++n, rows += bytes)
+      {
+        const size_t j = (size_t)(engine() % (n + 1));
+        if(j < M) memcpy(sample[j], rows, bytes);
+      }
+    });
+  
+  if(n == 0) return;
+  
+  typedef PackedTrainingSet<TDescriptor, F> Set;
+  
+  if(n <= M)
+  {
+    // the whole subtree is created in memory
+    HKmeansStep(parent_id, Set(sample), current_level, seed, key, NULL);
+    return;
+  }
+  
+  // cluster the sample, unless the clusters were saved. The association
+  // of the sample is not needed
+  std::vector<unsigned char> clusters;
+  {
+    std::vector<int> association;
+    if(!loadSplit(key, 0, bytes, clusters, association))
+    {
+      std::vector<unsigned int> indices(sample.size());
+      for(size_t i = 0; i < indices.size(); ++i) indices[i] = i;
+      
+      TrainingBuffers<Set> buffers;
+      clusterDescriptors(Set(sample), indices.data(), indices.size(), seed, 
+        clusters, association, buffers);
+      saveSplit(key, clusters, std::vector<int>());
+    }
+  }
+  
+  sample.clear();
+  
+  // create nodes
+  const Set centres(clusters.data(), clusters.size() / bytes, bytes);
+  const unsigned int nclusters = centres.size();
+  
+  std::vector<NodeId> children_ids;
+  children_ids.reserve(nclusters);
+  for(unsigned int i = 0; i < nclusters; ++i)
+  {
+    NodeId id = m_nodes.size();
+    m_nodes.push_back(Node(id));
+    centres.getCluster(clusters, i, m_nodes.back().descriptor);
+    detachDescriptor(m_nodes.back().descriptor);
+    m_nodes.back().parent = parent_id;
+    m_nodes[parent_id].children.push_back(id);
+    children_ids.push_back(id);
+  }
+  
+  if(current_level >= m_L) return;
+  
+  // partition the descriptors into one file per child
+  std::vector<std::unique_ptr<SpillFile> > files(nclusters);
+  std::vector<size_t> counts(nclusters, 0);
+  for(size_t i = 0; i < files.size(); ++i)
+    files[i].reset(new SpillFile(m_training.temp_directory));
+  
+  scan([&](const unsigned char *rows, size_t count)
+    {
+      std::vector<int> association;
+      associate(Set(rows, count, bytes), NULL, count, clusters, association);
+      
+      for(size_t r = 0; r < count; ++r)
+      {
+        files[association[r]]->write(rows + r * bytes, bytes);
+        ++counts[association[r]];
+      }
+    });
+  
+  // go on with the next level
+  for(unsigned int i = 0; i < nclusters; ++i)
+  {
+    if(counts[i] > 1)
+    {
+      SpillFile &file = *files[i];
+      
+      RowScanner child_scan = [&file, bytes](const RowVisitor &visit)
+      {
+        const size_t CHUNK = 4096;
+        std::vector<unsigned char> buffer(CHUNK * bytes);
+        
+        file.rewind();
+        size_t read;
+        while((read = file.read(buffer.data(), buffer.size())) > 0)
+        {
+          visit(buffer.data(), read / bytes);
+        }
+      };
+      
+      streamHKmeansStep(children_ids[i], child_scan, bytes, 
+        current_level + 1, childSeed(seed, i), 
+        TrainingCheckpoint::childKey(key, i));
+    }
+    
+    files[i].reset();
+  }
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-void TemplatedVocabulary<TDescriptor,F>::getFeatures(
-  const std::vector<std::vector<TDescriptor> > &training_features,
-  std::vector<pDescriptor> &features) const
+template<class Distance, class Distances>
+void TemplatedVocabulary<TDescriptor,F>::updateHamerly(size_t n, 
+  unsigned int k, const std::vector<double> &shifts, 
+  const std::vector<double> &cluster_distances, const Distance &distance,
+  const Distances &all_distances, std::vector<double> &upper, 
+  std::vector<double> &lower, std::vector<int> &association) const
 {
-  features.resize(0);
+  const bool init = shifts.empty();
   
-  typename std::vector<std::vector<TDescriptor> >::const_iterator vvit;
-  typename std::vector<TDescriptor>::const_iterator vit;
-  for(vvit = training_features.begin(); vvit != training_features.end(); ++vvit)
+  if(init)
   {
-    features.reserve(features.size() + vvit->size());
-    for(vit = vvit->begin(); vit != vvit->end(); ++vit)
+    upper.resize(n);
+    lower.resize(n);
+    association.resize(n);
+  }
+  
+  // half the distance from each cluster to the closest other one
+  std::vector<double> half_gaps(k, std::numeric_limits<double>::max());
+  for(unsigned int c = 0; c < k; ++c)
+  {
+    for(unsigned int c2 = 0; c2 < k; ++c2)
     {
-      features.push_back(&(*vit));
+      if(c2 != c) 
+        half_gaps[c] = std::min(half_gaps[c], cluster_distances[c*k+c2] / 2);
+    }
+  }
+  
+  // the lower bounds decrease by the largest shift of the other clusters
+  unsigned int max_c = 0;
+  double max_shift = 0, second_shift = 0;
+  for(unsigned int c = 0; c < shifts.size(); ++c)
+  {
+    if(shifts[c] > max_shift)
+    {
+      second_shift = max_shift;
+      max_shift = shifts[c];
+      max_c = c;
+    }
+    else if(shifts[c] > second_shift)
+    {
+      second_shift = shifts[c];
     }
   }
+  
+  auto run = [&](int b, int e)
+    {
+      std::vector<double> d(k);
+      
+      for(int i = b; i < e; ++i)
+      {
+        if(!init)
+        {
+          const unsigned int a = association[i];
+          upper[i] += shifts[a];
+          lower[i] -= (a == max_c ? second_shift : max_shift);
+          
+          // the cluster is still the closest one if it is strictly closer
+          // than any other cluster can be
+          const double z = std::max(lower[i], half_gaps[a]);
+          if(upper[i] < z) continue;
+          
+          upper[i] = distance(i, a);
+          if(upper[i] < z) continue;
+        }
+        
+        // closest and second closest clusters, ties broken as in findClosest
+        all_distances(i, &d[0]);
+        
+        unsigned int best = 0;
+        double second = std::numeric_limits<double>::max();
+        for(unsigned int c = 1; c < k; ++c)
+        {
+          if(d[c] < d[best])
+          {
+            second = d[best];
+            best = c;
+          }
+          else if(d[c] < second)
+          {
+            second = d[c];
+          }
+        }
+        
+        association[i] = best;
+        upper[i] = d[best];
+        lower[i] = second;
+      }
+    };
+  
+  if(useThreadPool(n))
+  {
+    m_pool->parallelFor(0, (int)n, PARALLEL_GRAIN, run);
+  }
+  else
+  {
+    run(0, (int)n);
+  }
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-void TemplatedVocabulary<TDescriptor,F>::HKmeansStep(NodeId parent_id, 
-  const std::vector<pDescriptor> &descriptors, int current_level)
+template<class Distance, class Distances>
+void TemplatedVocabulary<TDescriptor,F>::updateElkan(size_t n, 
+  unsigned int k, const std::vector<double> &shifts, 
+  const std::vector<double> &cluster_distances, const Distance &distance,
+  const Distances &all_distances, std::vector<double> &upper, 
+  std::vector<double> &lower, std::vector<int> &association) const
 {
-  if(descriptors.empty()) return;
-        
-  // features associated to each cluster
-  std::vector<TDescriptor> clusters;
-  std::vector<std::vector<unsigned int> > groups; // groups[i] = [j1, j2, ...]
-	// j1, j2, ... indices of descriptors associated to cluster i
-
-  clusters.reserve(m_k);
-	groups.reserve(m_k);
+  const bool init = shifts.empty();
   
-  //const int msizes[] = { m_k, descriptors.size() };
-  //cv::SparseMat assoc(2, msizes, CV_8U);
-  //cv::SparseMat last_assoc(2, msizes, CV_8U);  
-  //// assoc.row(cluster_idx).col(descriptor_idx) = 1 iif associated
+  if(init)
+  {
+    upper.resize(n);
+    lower.resize(n * k);
+    association.resize(n);
+  }
   
-  if((int)descriptors.size() <= m_k)
+  // half the distance from each cluster to the closest other one
+  std::vector<double> half_gaps(k, std::numeric_limits<double>::max());
+  for(unsigned int c = 0; c < k; ++c)
   {
-    // trivial case: one cluster per feature
-    groups.resize(descriptors.size());
-
-    for(unsigned int i = 0; i < descriptors.size(); i++)
+    for(unsigned int c2 = 0; c2 < k; ++c2)
     {
-      groups[i].push_back(i);
-      clusters.push_back(*descriptors[i]);
+      if(c2 != c) 
+        half_gaps[c] = std::min(half_gaps[c], cluster_distances[c*k+c2] / 2);
     }
   }
-  else
-  {
-    // select clusters and groups with kmeans
-    
-    bool first_time = true;
-    bool goon = true;
-    
-    // to check if clusters move after iterations
-    std::vector<int> last_association, current_association;
-
-    while(goon)
+  
+  auto run = [&](int b, int e)
     {
-      // 1. Calculate clusters
-
-			if(first_time)
-			{
-        // random sample 
-        initiateClusters(descriptors, clusters);
-      }
-      else
+      for(int i = b; i < e; ++i)
       {
-        // calculate cluster centres
-
-        for(unsigned int c = 0; c < clusters.size(); ++c)
+        double *l = &lower[(size_t)i * k];
+        
+        if(init)
         {
-          std::vector<pDescriptor> cluster_descriptors;
-          cluster_descriptors.reserve(groups[c].size());
+          all_distances(i, l);
           
-          /*
-          for(unsigned int d = 0; d < descriptors.size(); ++d)
+          unsigned int best = 0;
+          for(unsigned int c = 1; c < k; ++c)
           {
-            if( assoc.find<unsigned char>(c, d) )
-            {
-              cluster_descriptors.push_back(descriptors[d]);
-            }
+            if(l[c] < l[best]) best = c;
           }
-          */
+          association[i] = best;
+          upper[i] = l[best];
+          continue;
+        }
+        
+        unsigned int a = association[i];
+        double u = upper[i] + shifts[a];
+        for(unsigned int c = 0; c < k; ++c)
+        {
+          l[c] = std::max(0., l[c] - shifts[c]);
+        }
+        
+        if(u < half_gaps[a])
+        {
+          upper[i] = u;
+          continue;
+        }
+        
+        // cluster c is skipped if it is strictly farther than a. The 
+        // clusters are visited in order, so that ties go to the lowest index
+        bool tight = false;
+        for(unsigned int c = 0; c < k; ++c)
+        {
+          if(c == a) continue;
+          
+          const double z = std::max(l[c], cluster_distances[a*k+c] / 2);
+          if(u < z) continue;
           
-          std::vector<unsigned int>::const_iterator vit;
-          for(vit = groups[c].begin(); vit != groups[c].end(); ++vit)
+          if(!tight)
           {
-            cluster_descriptors.push_back(descriptors[*vit]);
+            u = l[a] = distance(i, a);
+            tight = true;
+            if(u < z) continue;
           }
           
-          
-          F::meanValue(cluster_descriptors, clusters[c]);
+          const double dc = l[c] = distance(i, c);
+          if(dc < u || (dc == u && c < a))
+          {
+            a = c;
+            u = dc;
+          }
         }
         
-      } // if(!first_time)
+        association[i] = a;
+        upper[i] = u;
+      }
+    };
+  
+  if(useThreadPool(n))
+  {
+    m_pool->parallelFor(0, (int)n, PARALLEL_GRAIN, run);
+  }
+  else
+  {
+    run(0, (int)n);
+  }
+}
 
-      // 2. Associate features with clusters
+// --------------------------------------------------------------------------
 
-      // calculate distances to cluster centers
-      groups.clear();
-      groups.resize(clusters.size(), std::vector<unsigned int>());
-      current_association.resize(descriptors.size());
+template<class TDescriptor, class F>
+size_t TemplatedVocabulary<TDescriptor,F>::clusterCapacity(size_t n, 
+  unsigned int k) const
+{
+  const size_t even = (n + k - 1) / k;
+  const size_t capacity = (size_t)(m_training.max_occupancy * n / k);
+  return std::max(even, capacity);
+}
 
-      //assoc.clear();
+// --------------------------------------------------------------------------
 
-      typename std::vector<pDescriptor>::const_iterator fit;
-      //unsigned int d = 0;
-      for(fit = descriptors.begin(); fit != descriptors.end(); ++fit)//, ++d)
-      {
-        double best_dist = F::distance(*(*fit), clusters[0]);
-        unsigned int icluster = 0;
-        
-        for(unsigned int c = 1; c < clusters.size(); ++c)
-        {
-          double dist = F::distance(*(*fit), clusters[c]);
-          if(dist < best_dist)
-          {
-            best_dist = dist;
-            icluster = c;
-          }
-        }
+template<class TDescriptor, class F>
+template<class Set>
+void TemplatedVocabulary<TDescriptor,F>::balanceClusters(const Set &set,
+  const unsigned int *indices, size_t n, typename Set::Clusters &clusters, 
+  std::vector<int> &association, TrainingBuffers<Set> &buffers) const
+{
+  const unsigned int k = set.count(clusters);
+  const size_t capacity = clusterCapacity(n, k);
+  
+  auto distance = [&](size_t i, unsigned int c) -> double
+    {
+      return set.distance(indices[i], clusters, c);
+    };
+  
+  auto all_distances = [&](size_t i, double *d)
+    {
+      set.distances(indices[i], clusters, d);
+    };
+  
+  std::vector<int> &last_association = buffers.last_association;
+  std::vector<std::vector<typename Set::Descriptor> > &members = 
+    buffers.members;
+  if(members.size() < k) members.resize(k);
+  
+  for(int it = 1; ; ++it)
+  {
+    capAssociation(n, k, capacity, distance, all_distances, association);
+    
+    if(it >= m_training.max_iterations || 
+      (it > 1 && association == last_association)) break;
+    
+    last_association = association;
+    
+    // move the centres to the capped clusters
+    for(unsigned int c = 0; c < k; ++c) members[c].clear();
+    for(size_t i = 0; i < n; ++i)
+    {
+      members[association[i]].push_back(set[indices[i]]);
+    }
+    
+    // a cluster left empty keeps its centre
+    for(unsigned int c = 0; c < k; ++c)
+    {
+      if(!members[c].empty()) set.mean(members[c], clusters, c);
+    }
+    
+    associate(set, indices, n, clusters, association);
+  }
+}
 
-        //assoc.ref<unsigned char>(icluster, d) = 1;
+// --------------------------------------------------------------------------
 
-        groups[icluster].push_back(fit - descriptors.begin());
-        current_association[ fit - descriptors.begin() ] = icluster;
-      }
+template<class TDescriptor, class F>
+template<class Distance, class Distances>
+void TemplatedVocabulary<TDescriptor,F>::capAssociation(size_t n, 
+  unsigned int k, size_t capacity, const Distance &distance, 
+  const Distances &all_distances, std::vector<int> &association) const
+{
+  // distance from each descriptor to its closest cluster
+  std::vector<double> closest(n);
+  auto run = [&](int b, int e)
+    {
+      for(int i = b; i < e; ++i) closest[i] = distance(i, association[i]);
+    };
+  
+  if(useThreadPool(n))
+  {
+    m_pool->parallelFor(0, (int)n, PARALLEL_GRAIN, run);
+  }
+  else
+  {
+    run(0, (int)n);
+  }
+  
+  // descriptors kept by each cluster, as a heap of (distance, index) with 
+  // the farthest one at the front
+  typedef std::pair<double, unsigned int> Candidate;
+  std::vector<std::vector<Candidate> > kept(k);
+  std::vector<unsigned int> rejected;
+  
+  auto propose = [&](unsigned int i, unsigned int c, double d)
+    {
+      std::vector<Candidate> &heap = kept[c];
+      const Candidate candidate(d, i);
       
-      // kmeans++ ensures all the clusters has any feature associated with them
-
-      // 3. check convergence
-      if(first_time)
+      if(heap.size() < capacity)
+      {
+        heap.push_back(candidate);
+        std::push_heap(heap.begin(), heap.end());
+      }
+      else if(candidate < heap.front())
       {
-        first_time = false;
+        rejected.push_back(heap.front().second);
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = candidate;
+        std::push_heap(heap.begin(), heap.end());
       }
       else
       {
-        //goon = !eqUChar(last_assoc, assoc);
-        
-        goon = false;
-        for(unsigned int i = 0; i < current_association.size(); i++)
-        {
-          if(current_association[i] != last_association[i]){
-            goon = true;
-            break;
-          }
-        }
+        rejected.push_back(i);
       }
+    };
+  
+  for(size_t i = 0; i < n; ++i) propose(i, association[i], closest[i]);
+  
+  // the rejected descriptors try the other clusters from the closest one.
+  // The clusters of each of them are sorted by distance in k consecutive
+  // entries of ranked, the first time it is rejected
+  std::unordered_map<unsigned int, size_t> blocks;
+  std::vector<Candidate> ranked;
+  std::vector<unsigned int> next;
+  
+  while(!rejected.empty())
+  {
+    const unsigned int i = rejected.back();
+    rejected.pop_back();
+    
+    size_t block;
+    std::unordered_map<unsigned int, size_t>::const_iterator it = 
+      blocks.find(i);
+    
+    if(it == blocks.end())
+    {
+      block = next.size();
+      blocks[i] = block;
+      next.push_back(0);
+      
+      ranked.resize((block + 1) * k);
+      std::vector<double> d(k);
+      all_distances(i, &d[0]);
+      for(unsigned int c = 0; c < k; ++c)
+        ranked[block * k + c] = Candidate(d[c], c);
+      std::sort(ranked.begin() + block * k, ranked.end());
+    }
+    else
+    {
+      block = it->second;
+    }
+    
+    // the closest cluster was already tried
+    unsigned int &r = next[block];
+    while(r < k && (int)ranked[block * k + r].second == association[i]) ++r;
+    
+    // there is always room somewhere, since capacity * k >= n
+    if(r < k)
+    {
+      const Candidate &c = ranked[block * k + r++];
+      propose(i, c.second, c.first);
+    }
+  }
+  
+  for(unsigned int c = 0; c < k; ++c)
+  {
+    for(size_t j = 0; j < kept[c].size(); ++j)
+      association[kept[c][j].second] = c;
+  }
+}
 
-			if(goon)
-			{
-				// copy last feature-cluster association
-				last_association = current_association;
-				//last_assoc = assoc.clone();
-			}
-			
-		} // while(goon)
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::renumberNodes(
+  std::vector<unsigned int> *values)
+{
+  if(m_nodes.empty()) return;
+  
+  // new_id[old id] = new id
+  std::vector<NodeId> new_id(m_nodes.size());
+  new_id[0] = 0;
+  NodeId next_id = 1;
+  
+  // depth-first, numbering all the children of a node before going down
+  std::vector<NodeId> stack(1, 0);
+  while(!stack.empty())
+  {
+    const Node &node = m_nodes[stack.back()];
+    stack.pop_back();
+    
+    for(size_t i = 0; i < node.children.size(); ++i)
+      new_id[node.children[i]] = next_id++;
     
-  } // if must run kmeans
+    for(size_t i = node.children.size(); i > 0; --i)
+      stack.push_back(node.children[i-1]);
+  }
   
-  // create nodes
-  for(unsigned int i = 0; i < clusters.size(); ++i)
+  bool identity = true;
+  for(size_t i = 0; i < new_id.size() && identity; ++i)
+    identity = (new_id[i] == i);
+  if(identity) return;
+  
+  std::vector<Node> nodes(m_nodes.size());
+  for(size_t i = 0; i < m_nodes.size(); ++i)
   {
-    NodeId id = m_nodes.size();
-    m_nodes.push_back(Node(id));
-    m_nodes.back().descriptor = clusters[i];
-    m_nodes.back().parent = parent_id;
-    m_nodes[parent_id].children.push_back(id);
+    Node &node = nodes[new_id[i]];
+    node = m_nodes[i];
+    node.id = new_id[i];
+    node.parent = new_id[node.parent];
+    for(size_t j = 0; j < node.children.size(); ++j)
+      node.children[j] = new_id[node.children[j]];
   }
   
-  // go on with the next level
-  if(current_level < m_L)
+  m_nodes.swap(nodes);
+  
+  if(values)
   {
-    // iterate again with the resulting clusters
-    const std::vector<NodeId> &children_ids = m_nodes[parent_id].children;
-    for(unsigned int i = 0; i < clusters.size(); ++i)
-    {
-      NodeId id = children_ids[i];
-
-      std::vector<pDescriptor> child_features;
-      child_features.reserve(groups[i].size());
-
-      std::vector<unsigned int>::const_iterator vit;
-      for(vit = groups[i].begin(); vit != groups[i].end(); ++vit)
-      {
-        child_features.push_back(descriptors[*vit]);
-      }
-
-      if(child_features.size() > 1)
-      {
-        HKmeansStep(id, child_features, current_level + 1);
-      }
-    }
+    std::vector<unsigned int> moved(values->size());
+    for(size_t i = 0; i < values->size(); ++i)
+      moved[new_id[i]] = (*values)[i];
+    values->swap(moved);
   }
 }
 
@@ -823,7 +3361,10 @@ void TemplatedVocabulary<TDescriptor, F>::initiateClusters
   (const std::vector<pDescriptor> &descriptors,
    std::vector<TDescriptor> &clusters) const
 {
-  initiateClustersKMpp(descriptors, clusters);  
+  if(m_training.seeding == KMEANS_PARALLEL_SEEDING)
+    initiateClustersKMParallel(descriptors, clusters);
+  else
+    initiateClustersKMpp(descriptors, clusters);  
 }
 
 // --------------------------------------------------------------------------
@@ -913,36 +3454,487 @@ void TemplatedVocabulary<TDescriptor,F>::initiateClustersKMpp(
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
-void TemplatedVocabulary<TDescriptor,F>::createWords()
+void TemplatedVocabulary<TDescriptor,F>::initiateClustersKMParallel(
+  const std::vector<pDescriptor> &pfeatures,
+    std::vector<TDescriptor> &clusters) const
+{
+  std::vector<size_t> seeds;
+  
+  seedKMParallel(pfeatures.size(), 
+    [&](size_t a, size_t b)
+    {
+      return F::distance(*pfeatures[a], *pfeatures[b]);
+    },
+    [&](size_t c, size_t i, size_t m, double *d)
+    {
+      for(size_t j = 0; j < m; ++j)
+        d[j] = F::distance(*pfeatures[c], *pfeatures[i + j]);
+    },
+    seeds);
+  
+  clusters.resize(0);
+  clusters.reserve(seeds.size());
+  for(size_t i = 0; i < seeds.size(); ++i)
+    clusters.push_back(*pfeatures[seeds[i]]);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::seedClusters(
+  const ObjectTrainingSet<TDescriptor, F> &set, const unsigned int *indices,
+  size_t n, std::vector<TDescriptor> &clusters) const
+{
+  std::vector<pDescriptor> descriptors(n);
+  for(size_t i = 0; i < n; ++i) descriptors[i] = set[indices[i]];
+  
+  initiateClusters(descriptors, clusters);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::seedClusters(
+  const PackedTrainingSet<TDescriptor, F> &set, const unsigned int *indices,
+  size_t n, std::vector<unsigned char> &clusters) const
+{
+  seedClusters(set, indices, n, clusters, std::integral_constant<bool,
+    HasArray8U<F>::value && HasToArray8U<F>::value>());
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::seedClusters(
+  const PackedTrainingSet<TDescriptor, F> &set, const unsigned int *indices,
+  size_t n, std::vector<unsigned char> &clusters, std::true_type) const
+{
+  const int bytes = set.bytes();
+  
+  // descriptor objects on the raw data (copies if F cannot use it)
+  std::vector<TDescriptor> descriptors(n);
+  std::vector<pDescriptor> pdescriptors(n);
+  for(size_t i = 0; i < n; ++i)
+  {
+    F::fromArray8U(descriptors[i], set[indices[i]]);
+    pdescriptors[i] = &descriptors[i];
+  }
+  
+  std::vector<TDescriptor> centres;
+  initiateClusters(pdescriptors, centres);
+  
+  clusters.resize(centres.size() * bytes);
+  for(size_t c = 0; c < centres.size(); ++c)
+  {
+    F::toArray8U(centres[c], &clusters[c * bytes]);
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class Distance, class Distances>
+void TemplatedVocabulary<TDescriptor,F>::seedKMParallel(size_t n, 
+  const Distance &distance, const Distances &range_distances,
+  std::vector<size_t> &seeds) const
+{
+  // Implements kmeans|| seeding algorithm (Bahmani et al., 2012)
+  // Algorithm:
+  // 1. Choose one candidate uniformly at random from among the data points.
+  // 2. For each data point x, compute D(x), the distance between x and the
+  //    nearest candidate, and the cost, the sum of all D(x).
+  // 3. Sample each data point x independently with probability 
+  //    l * D(x) / cost, and add the samples to the candidates.
+  // 4. Repeat Steps 2 and 3 for some rounds.
+  // 5. Weight each candidate with the number of data points closest to it,
+  //    and choose k centers among the candidates with weighted kmeans++.
+  // As in initiateClustersKMpp, D(x) is not squared.
+
+  seeds.resize(0);
+  if(n == 0) return;
+  
+  const size_t nchunks = (n + SEEDING_CHUNK - 1) / SEEDING_CHUNK;
+  const double l = m_training.oversampling * m_k;
+  
+  std::vector<size_t> candidates;
+  std::vector<double> min_dists(n);
+  std::vector<unsigned int> nearest(n);
+  
+  // cost and samples of each chunk, added up in order afterwards
+  std::vector<double> chunk_costs(nchunks);
+  std::vector<std::vector<size_t> > chunk_samples(nchunks);
+  
+  // candidates from this one on are not in min_dists yet
+  size_t first_new = 0;
+  unsigned int round_seed = 0;
+  double cost = 0;
+  
+  // 2.
+  auto update = [&](int b, int e)
+    {
+      std::vector<double> d(SEEDING_CHUNK);
+      
+      for(int chunk = b; chunk < e; ++chunk)
+      {
+        const size_t i = chunk * SEEDING_CHUNK;
+        const size_t m = std::min(SEEDING_CHUNK, n - i);
+        
+        for(size_t c = first_new; c < candidates.size(); ++c)
+        {
+          range_distances(candidates[c], i, m, &d[0]);
+          
+          for(size_t j = 0; j < m; ++j)
+          {
+            if(c == 0 || d[j] < min_dists[i + j])
+            {
+              min_dists[i + j] = d[j];
+              nearest[i + j] = c;
+            }
+          }
+        }
+        
+        chunk_costs[chunk] = std::accumulate(min_dists.begin() + i,
+          min_dists.begin() + i + m, 0.0);
+      }
+    };
+  
+  // 3.
+  auto sample = [&](int b, int e)
+    {
+      for(int chunk = b; chunk < e; ++chunk)
+      {
+        const size_t i = chunk * SEEDING_CHUNK;
+        const size_t m = std::min(SEEDING_CHUNK, n - i);
+        std::mt19937 engine(childSeed(round_seed, chunk));
+        
+        chunk_samples[chunk].resize(0);
+        for(size_t j = 0; j < m; ++j)
+        {
+          const double r = (double)engine() / 
+            ((double)std::mt19937::max() + 1.0);
+          
+          if(r * cost < l * min_dists[i + j]) 
+            chunk_samples[chunk].push_back(i + j);
+        }
+      }
+    };
+  
+  auto run = [&](const std::function<void(int, int)> &f)
+    {
+      if(useThreadPool(n))
+        m_pool->parallelFor(0, (int)nchunks, 1, f);
+      else
+        f(0, (int)nchunks);
+    };
+  
+  // 1.
+  candidates.push_back(RandomInt(0, n-1));
+  const unsigned int seed = 
+    RandomInt(0, std::numeric_limits<int>::max() - 1);
+  
+  run(update);
+  cost = std::accumulate(chunk_costs.begin(), chunk_costs.end(), 0.0);
+  
+  // 4.
+  for(int round = 0; cost > 0 && 
+    (round < m_training.seeding_rounds || (int)candidates.size() < m_k); 
+    ++round)
+  {
+    round_seed = childSeed(seed, round);
+    run(sample);
+    
+    first_new = candidates.size();
+    for(size_t chunk = 0; chunk < nchunks; ++chunk)
+    {
+      candidates.insert(candidates.end(), chunk_samples[chunk].begin(),
+        chunk_samples[chunk].end());
+    }
+    
+    if(candidates.size() > first_new)
+    {
+      run(update);
+      cost = std::accumulate(chunk_costs.begin(), chunk_costs.end(), 0.0);
+    }
+  }
+  
+  if((int)candidates.size() <= m_k)
+  {
+    seeds.swap(candidates);
+    return;
+  }
+  
+  // 5.
+  const size_t m = candidates.size();
+  std::vector<double> weights(m, 0);
+  for(size_t i = 0; i < n; ++i) weights[nearest[i]] += 1;
+  
+  // weight times the distance to the closest center, which is unknown
+  // until the first center is chosen
+  std::vector<double> scores(weights);
+  std::vector<double> center_dists(m, std::numeric_limits<double>::max());
+  
+  while((int)seeds.size() < m_k)
+  {
+    const double score_sum = std::accumulate(scores.begin(), scores.end(), 
+      0.0);
+    if(score_sum <= 0) break;
+    
+    double cut_d;
+    do
+    {
+      cut_d = RandomValue<double>(0, score_sum);
+    } while(cut_d == 0.0);
+    
+    size_t c = 0;
+    double d_up_now = 0;
+    for(; c < m; ++c)
+    {
+      d_up_now += scores[c];
+      if(d_up_now >= cut_d) break;
+    }
+    if(c == m) c = m - 1;
+    
+    seeds.push_back(candidates[c]);
+    
+    for(size_t c2 = 0; c2 < m; ++c2)
+    {
+      if(center_dists[c2] > 0)
+      {
+        const double d = (c2 == c ? 0 : 
+          distance(candidates[c], candidates[c2]));
+        if(d < center_dists[c2]) center_dists[c2] = d;
+      }
+      scores[c2] = weights[c2] * center_dists[c2];
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::createWords()
+{
+  m_words.resize(0);
+  
+  if(!m_nodes.empty())
+  {
+    m_words.reserve( (int)pow((double)m_k, (double)m_L) );
+
+    typename std::vector<Node>::iterator nit;
+    
+    nit = m_nodes.begin(); // ignore root
+    for(++nit; nit != m_nodes.end(); ++nit)
+    {
+      if(nit->isLeaf())
+      {
+        nit->word_id = m_words.size();
+        m_words.push_back( &(*nit) );
+      }
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::setNodeWeights
+  (const std::vector<std::vector<TDescriptor> > &training_features)
+{
+  const unsigned int NWords = m_words.size();
+  const unsigned int NDocs = training_features.size();
+
+  std::vector<unsigned int> Ni(NWords, 0);
+  
+  if(m_weighting == IDF || m_weighting == TF_IDF)
+  {
+    // IDF and TF-IDF: we calculte the idf path now
+
+    // Note: this actually calculates the idf part of the tf-idf score.
+    // The complete tf-idf score is calculated in ::transform
+
+    std::vector<bool> counted(NWords, false);
+    
+    typename std::vector<std::vector<TDescriptor> >::const_iterator mit;
+    typename std::vector<TDescriptor>::const_iterator fit;
+
+    for(mit = training_features.begin(); mit != training_features.end(); ++mit)
+    {
+      fill(counted.begin(), counted.end(), false);
+
+      for(fit = mit->begin(); fit < mit->end(); ++fit)
+      {
+        WordId word_id;
+        transform(*fit, word_id);
+
+        if(!counted[word_id])
+        {
+          Ni[word_id]++;
+          counted[word_id] = true;
+        }
+      }
+    }
+  }
+  
+  setNodeWeights(Ni, NDocs);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::setNodeWeights
+  (DescriptorReader &reader)
+{
+  unsigned int NDocs = 0;
+  std::vector<unsigned int> Ni(m_words.size(), 0);
+  
+  if(m_weighting == IDF || m_weighting == TF_IDF)
+  {
+    const int bytes = reader.descriptorBytes();
+    std::vector<unsigned char> image;
+
+    reader.rewind();
+    while(reader.next(image))
+    {
+      countImageWords(image.data(), (int)(image.size() / bytes), bytes, Ni);
+      ++NDocs;
+    }
+  }
+  
+  setNodeWeights(Ni, NDocs);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::setNodeWeights
+  (const PackedDescriptors &training)
+{
+  std::vector<unsigned int> Ni(m_words.size(), 0);
+  
+  if(m_weighting == IDF || m_weighting == TF_IDF)
+  {
+    for(size_t i = 0; i < training.images(); ++i)
+    {
+      const size_t begin = training.imageBegin(i);
+      countImageWords(training[begin], 
+        (int)(training.imageEnd(i) - begin), 
+        training.descriptorBytes(), Ni);
+    }
+  }
+  
+  setNodeWeights(Ni, training.images());
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::countImageWords
+  (const unsigned char *image, int n, int bytes, 
+   std::vector<unsigned int> &Ni) const
+{
+  std::vector<WordId> ids;
+  
+  if(useThreadPool(n))
+  {
+    std::vector<WordValue> weights;
+    quantize(image, n, bytes, ids, weights, NULL, 0);
+  }
+  else
+  {
+    TDescriptor feature;
+    ids.resize(n);
+    for(int i = 0; i < n; ++i)
+    {
+      F::fromArray8U(feature, image + (size_t)i * bytes);
+      transform(feature, ids[i]);
+    }
+  }
+  
+  // count each word once
+  std::sort(ids.begin(), ids.end());
+  typename std::vector<WordId>::const_iterator end = 
+    std::unique(ids.begin(), ids.end());
+  
+  typename std::vector<WordId>::const_iterator it;
+  for(it = ids.begin(); it != end; ++it) Ni[*it]++;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::countLeafImages
+  (const std::vector<std::vector<TDescriptor> > &features,
+   const std::vector<NodeId> &leaves, std::vector<unsigned int> &Ni) const
+{
+  Ni.assign(m_nodes.size(), 0);
+  
+  std::vector<NodeId> nodes;
+  std::vector<NodeId>::const_iterator first = leaves.begin();
+  
+  typename std::vector<std::vector<TDescriptor> >::const_iterator mit;
+  for(mit = features.begin(); mit != features.end(); ++mit)
+  {
+    nodes.assign(first, first + mit->size());
+    first += mit->size();
+    
+    // count each leaf once
+    std::sort(nodes.begin(), nodes.end());
+    std::vector<NodeId>::const_iterator nit, nend = 
+      std::unique(nodes.begin(), nodes.end());
+    for(nit = nodes.begin(); nit != nend; ++nit) Ni[*nit]++;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::countLeafImages
+  (const PackedDescriptors &training, const std::vector<NodeId> &leaves, 
+   std::vector<unsigned int> &Ni) const
+{
+  Ni.assign(m_nodes.size(), 0);
+  
+  std::vector<NodeId> nodes;
+  for(size_t i = 0; i < training.images(); ++i)
+  {
+    nodes.assign(leaves.begin() + training.imageBegin(i), 
+      leaves.begin() + training.imageEnd(i));
+    
+    // count each leaf once
+    std::sort(nodes.begin(), nodes.end());
+    std::vector<NodeId>::const_iterator nit, nend = 
+      std::unique(nodes.begin(), nodes.end());
+    for(nit = nodes.begin(); nit != nend; ++nit) Ni[*nit]++;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::setLeafWeights
+  (const std::vector<unsigned int> &Ni, unsigned int NDocs)
 {
-  m_words.resize(0);
-  
-  if(!m_nodes.empty())
+  std::vector<unsigned int> word_Ni(m_words.size());
+  for(size_t i = 0; i < m_words.size(); ++i)
   {
-    m_words.reserve( (int)pow((double)m_k, (double)m_L) );
-
-    typename std::vector<Node>::iterator nit;
-    
-    nit = m_nodes.begin(); // ignore root
-    for(++nit; nit != m_nodes.end(); ++nit)
-    {
-      if(nit->isLeaf())
-      {
-        nit->word_id = m_words.size();
-        m_words.push_back( &(*nit) );
-      }
-    }
+    word_Ni[i] = Ni[m_words[i]->id];
   }
+  
+  setNodeWeights(word_Ni, NDocs);
 }
 
 // --------------------------------------------------------------------------
 
 template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::setNodeWeights
-  (const std::vector<std::vector<TDescriptor> > &training_features)
+  (const std::vector<unsigned int> &Ni, unsigned int NDocs)
 {
   const unsigned int NWords = m_words.size();
-  const unsigned int NDocs = training_features.size();
+  m_has_binary_hash = false;
 
   if(m_weighting == TF || m_weighting == BINARY)
   {
@@ -952,34 +3944,6 @@ void TemplatedVocabulary<TDescriptor,F>::setNodeWeights
   }
   else if(m_weighting == IDF || m_weighting == TF_IDF)
   {
-    // IDF and TF-IDF: we calculte the idf path now
-
-    // Note: this actually calculates the idf part of the tf-idf score.
-    // The complete tf-idf score is calculated in ::transform
-
-    std::vector<unsigned int> Ni(NWords, 0);
-    std::vector<bool> counted(NWords, false);
-    
-    typename std::vector<std::vector<TDescriptor> >::const_iterator mit;
-    typename std::vector<TDescriptor>::const_iterator fit;
-
-    for(mit = training_features.begin(); mit != training_features.end(); ++mit)
-    {
-      fill(counted.begin(), counted.end(), false);
-
-      for(fit = mit->begin(); fit < mit->end(); ++fit)
-      {
-        WordId word_id;
-        transform(*fit, word_id);
-
-        if(!counted[word_id])
-        {
-          Ni[word_id]++;
-          counted[word_id] = true;
-        }
-      }
-    }
-
     // set ln(N/Ni)
     for(unsigned int i = 0; i < NWords; i++)
     {
@@ -988,9 +3952,59 @@ void TemplatedVocabulary<TDescriptor,F>::setNodeWeights
         m_words[i]->weight = log((double)NDocs / (double)Ni[i]);
       }// else // This cannot occur if using kmeans++
     }
-  
   }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::createFlatTree()
+{
+  m_has_binary_hash = false;
+  m_flat_nodes.clear();
+  m_flat_descriptors.clear();
+  m_flat_buffer.release();
+
+  if(m_nodes.empty()) return;
+
+  m_flat_nodes.reserve(m_nodes.size());
+  m_flat_descriptors.reserve(m_nodes.size());
+
+  // breadth-first traversal: the children of each node are appended
+  // contiguously when the node is visited
+  FlatNode root;
+  root.id = 0;
+  root.first_child = 0;
+  root.n_children = 0;
+  m_flat_nodes.push_back(root);
+  m_flat_descriptors.push_back(m_nodes[0].descriptor);
+
+  for(unsigned int i = 0; i < m_flat_nodes.size(); ++i)
+  {
+    const std::vector<NodeId> &children = m_nodes[m_flat_nodes[i].id].children;
+
+    m_flat_nodes[i].first_child = m_flat_nodes.size();
+    m_flat_nodes[i].n_children = children.size();
+
+    std::vector<NodeId>::const_iterator cit;
+    for(cit = children.begin(); cit != children.end(); ++cit)
+    {
+      FlatNode node;
+      node.id = *cit;
+      node.first_child = 0;
+      node.n_children = 0;
+      m_flat_nodes.push_back(node);
+      m_flat_descriptors.push_back(m_nodes[*cit].descriptor);
+    }
+  }
+
+  packDescriptors(m_flat_descriptors, m_flat_buffer);
 
+  // share the packed data with the tree nodes
+  for(unsigned int i = 0; i < m_flat_nodes.size(); ++i)
+  {
+    m_nodes[m_flat_nodes[i].id].descriptor = m_flat_descriptors[i];
+  }
 }
 
 // --------------------------------------------------------------------------
@@ -1071,6 +4085,15 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
     return;
   }
 
+  if(useThreadPool(features.size()))
+  {
+    std::vector<WordId> ids;
+    std::vector<WordValue> weights;
+    quantize(features, ids, weights, NULL, 0);
+    createVectors(ids, weights, NULL, v, NULL);
+    return;
+  }
+
   // normalize 
   LNorm norm;
   bool must = m_scoring_object->mustNormalize(norm);
@@ -1133,6 +4156,16 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   {
     return;
   }
+
+  if(useThreadPool(features.size()))
+  {
+    std::vector<WordId> ids;
+    std::vector<WordValue> weights;
+    std::vector<NodeId> nids;
+    quantize(features, ids, weights, &nids, levelsup);
+    createVectors(ids, weights, &nids, v, &fv);
+    return;
+  }
   
   // normalize 
   LNorm norm;
@@ -1193,6 +4226,215 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::transform(const cv::Mat &features,
+  BowVector &v, std::vector<WordId> *word_ids) const
+{
+  transformRows(features.ptr<unsigned char>(), features.rows, features.step,
+    v, NULL, 0, word_ids);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::transform(const cv::Mat &features,
+  BowVector &v, FeatureVector &fv, int levelsup, 
+  std::vector<WordId> *word_ids) const
+{
+  transformRows(features.ptr<unsigned char>(), features.rows, features.step,
+    v, &fv, levelsup, word_ids);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::transform(
+  const unsigned char *features, int n, size_t stride, BowVector &v,
+  std::vector<WordId> *word_ids) const
+{
+  transformRows(features, n, stride, v, NULL, 0, word_ids);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::transform(
+  const unsigned char *features, int n, size_t stride, BowVector &v, 
+  FeatureVector &fv, int levelsup, std::vector<WordId> *word_ids) const
+{
+  transformRows(features, n, stride, v, &fv, levelsup, word_ids);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::transformRows(
+  const unsigned char *features, int n, size_t stride, BowVector &v, 
+  FeatureVector *fv, int levelsup, std::vector<WordId> *word_ids, 
+  std::true_type) const
+{
+  v.clear();
+  if(fv) fv->clear();
+  if(word_ids) word_ids->clear();
+  
+  if(empty())
+  {
+    return;
+  }
+
+  if(word_ids) word_ids->resize(n);
+
+  if(useThreadPool(n))
+  {
+    std::vector<WordId> aux;
+    std::vector<WordId> &ids = (word_ids ? *word_ids : aux);
+    std::vector<WordValue> weights;
+    std::vector<NodeId> nids;
+    quantize(features, n, stride, ids, weights, (fv ? &nids : NULL), 
+      levelsup);
+    createVectors(ids, weights, (fv ? &nids : NULL), v, fv);
+    return;
+  }
+
+  // normalize 
+  LNorm norm;
+  bool must = m_scoring_object->mustNormalize(norm);
+
+  const bool tf = (m_weighting == TF || m_weighting == TF_IDF);
+
+  // the rows are wrapped by the same descriptor
+  TDescriptor feature;
+  
+  for(int i_feature = 0; i_feature < n; ++i_feature, features += stride)
+  {
+    F::fromArray8U(feature, features);
+    
+    WordId id;
+    NodeId nid;
+    WordValue w;
+    // w is the idf value if TF_IDF, 1 if TF, idf if IDF, 1 if BINARY
+
+    transform(feature, id, w, (fv ? &nid : NULL), levelsup);
+    
+    if(word_ids) (*word_ids)[i_feature] = id;
+
+    if(w > 0) // not stopped
+    {
+      if(tf)
+        v.addWeight(id, w);
+      else
+        v.addIfNotExist(id, w);
+      
+      if(fv) fv->addFeature(nid, i_feature);
+    }
+  }
+
+  if(tf && !v.empty() && !must)
+  {
+    // unnecessary when normalizing
+    const double nd = v.size();
+    for(BowVector::iterator vit = v.begin(); vit != v.end(); vit++) 
+      vit->second /= nd;
+  }
+  
+  if(must) v.normalize(norm);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::quantize(
+  const std::vector<TDescriptor> &features, std::vector<WordId> &ids, 
+  std::vector<WordValue> &weights, std::vector<NodeId> *nids, 
+  int levelsup) const
+{
+  ids.resize(features.size());
+  weights.resize(features.size());
+  if(nids) nids->resize(features.size());
+
+  m_pool->parallelFor(0, (int)features.size(), PARALLEL_GRAIN,
+    [&](int begin, int end)
+    {
+      for(int i = begin; i < end; ++i)
+      {
+        transform(features[i], ids[i], weights[i], 
+          (nids ? &(*nids)[i] : NULL), levelsup);
+      }
+    });
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::quantize(
+  const unsigned char *features, int n, size_t stride, 
+  std::vector<WordId> &ids, std::vector<WordValue> &weights, 
+  std::vector<NodeId> *nids, int levelsup) const
+{
+  ids.resize(n);
+  weights.resize(n);
+  if(nids) nids->resize(n);
+
+  m_pool->parallelFor(0, n, PARALLEL_GRAIN,
+    [&](int begin, int end)
+    {
+      // each range wraps its rows with its own descriptor
+      TDescriptor feature;
+      for(int i = begin; i < end; ++i)
+      {
+        F::fromArray8U(feature, features + i * stride);
+        transform(feature, ids[i], weights[i], 
+          (nids ? &(*nids)[i] : NULL), levelsup);
+      }
+    });
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::createVectors(
+  const std::vector<WordId> &ids, const std::vector<WordValue> &weights,
+  const std::vector<NodeId> *nids, BowVector &v, FeatureVector *fv) const
+{
+  // the words are added in the order of the features, as in the sequential
+  // transform, so that the results are exactly the same
+  
+  // normalize 
+  LNorm norm;
+  bool must = m_scoring_object->mustNormalize(norm);
+
+  const bool tf = (m_weighting == TF || m_weighting == TF_IDF);
+
+  for(unsigned int i_feature = 0; i_feature < ids.size(); ++i_feature)
+  {
+    const WordValue w = weights[i_feature];
+    
+    if(w > 0) // not stopped
+    {
+      if(tf)
+        v.addWeight(ids[i_feature], w);
+      else
+        v.addIfNotExist(ids[i_feature], w);
+      
+      if(fv && nids) fv->addFeature((*nids)[i_feature], i_feature);
+    }
+  }
+
+  if(tf && !v.empty() && !must)
+  {
+    // unnecessary when normalizing
+    const double nd = v.size();
+    for(BowVector::iterator vit = v.begin(); vit != v.end(); vit++) 
+      vit->second /= nd;
+  }
+  
+  if(must) v.normalize(norm);
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F> 
 inline double TemplatedVocabulary<TDescriptor,F>::score
   (const BowVector &v1, const BowVector &v2) const
@@ -1216,44 +4458,161 @@ template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::transform(const TDescriptor &feature, 
   WordId &word_id, WordValue &weight, NodeId *nid, int levelsup) const
 { 
-  // propagate the feature down the tree
-  std::vector<NodeId> nodes;
-  typename std::vector<NodeId>::const_iterator nit;
-
   // level at which the node must be stored in nid, if given
   const int nid_level = m_L - levelsup;
   if(nid_level <= 0 && nid != NULL) *nid = 0; // root
 
+  if(!m_flat_nodes.empty())
+  {
+    // propagate the feature down the flat tree. The children of a node
+    // are contiguous in m_flat_buffer, so they are compared as raw data 
+    // when possible, without gathering pointers to them
+    const unsigned char *raw = flatRawFeature(feature);
+    unsigned int final_idx = 0; // root
+    int current_level = 0;
+
+    do
+    {
+      ++current_level;
+      const FlatNode &node = m_flat_nodes[final_idx];
+      const unsigned int first = node.first_child;
+
+      final_idx = first + (raw ?
+        findClosestFlat8U(raw, first, node.n_children) :
+        findClosest(feature, &m_flat_descriptors[first], node.n_children));
+
+      if(nid != NULL && current_level == nid_level)
+        *nid = m_flat_nodes[final_idx].id;
+
+    } while( m_flat_nodes[final_idx].n_children > 0 );
+
+    // turn node id into word id
+    const Node &leaf = m_nodes[m_flat_nodes[final_idx].id];
+    word_id = leaf.word_id;
+    weight = leaf.weight;
+    return;
+  }
+
+  // propagate the feature down the tree
+  std::vector<NodeId> nodes;
+  typename std::vector<NodeId>::const_iterator nit;
+
   NodeId final_id = 0; // root
   int current_level = 0;
 
-  do
+  do
+  {
+    ++current_level;
+    nodes = m_nodes[final_id].children;
+    final_id = nodes[0];
+ 
+    double best_d = F::distance(feature, m_nodes[final_id].descriptor);
+
+    for(nit = nodes.begin() + 1; nit != nodes.end(); ++nit)
+    {
+      NodeId id = *nit;
+      double d = F::distance(feature, m_nodes[id].descriptor);
+      if(d < best_d)
+      {
+        best_d = d;
+        final_id = id;
+      }
+    }
+    
+    if(nid != NULL && current_level == nid_level)
+      *nid = final_id;
+    
+  } while( !m_nodes[final_id].isLeaf() );
+
+  // turn node id into word id
+  word_id = m_nodes[final_id].word_id;
+  weight = m_nodes[final_id].weight;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+unsigned int TemplatedVocabulary<TDescriptor,F>::findClosest(
+  const TDescriptor &feature, const TDescriptor *descriptors, 
+  unsigned int n, double *best_d)
+{
+  // distances are computed by chunks to keep them in the stack
+  const unsigned int CHUNK = 64;
+  double d[CHUNK];
+  
+  unsigned int best = 0;
+  double best_dist = 0;
+  
+  for(unsigned int i = 0; i < n; i += CHUNK)
+  {
+    const unsigned int m = (n - i < CHUNK ? n - i : CHUNK);
+    distances(feature, descriptors + i, m, d);
+    
+    for(unsigned int j = 0; j < m; ++j)
+    {
+      if(i + j == 0 || d[j] < best_dist)
+      {
+        best_dist = d[j];
+        best = i + j;
+      }
+    }
+  }
+  
+  if(best_d) *best_d = best_dist;
+  return best;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+const unsigned char* TemplatedVocabulary<TDescriptor,F>::flatRawFeature(
+  const TDescriptor &feature, std::true_type) const
+{
+  if(m_flat_buffer.empty() || 
+    m_flat_buffer.cols * m_flat_buffer.elemSize() != (size_t)F::BYTES)
+  {
+    return NULL;
+  }
+  return packedData(feature, m_flat_buffer);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+unsigned int TemplatedVocabulary<TDescriptor,F>::findClosestFlat8U(
+  const unsigned char *feature, unsigned int first, unsigned int n, 
+  std::true_type) const
+{
+  // distances are computed by chunks to keep them in the stack
+  const unsigned int CHUNK = 64;
+  double d[CHUNK];
+
+  // the descriptors of the children are consecutive rows of the buffer
+  const size_t stride = m_flat_buffer.step;
+  const unsigned char *descriptors = 
+    packedData(m_flat_descriptors[first], m_flat_buffer);
+  
+  unsigned int best = 0;
+  double best_dist = 0;
+  
+  for(unsigned int i = 0; i < n; i += CHUNK)
   {
-    ++current_level;
-    nodes = m_nodes[final_id].children;
-    final_id = nodes[0];
- 
-    double best_d = F::distance(feature, m_nodes[final_id].descriptor);
-
-    for(nit = nodes.begin() + 1; nit != nodes.end(); ++nit)
+    const unsigned int m = (n - i < CHUNK ? n - i : CHUNK);
+    F::distances8U(feature, descriptors + i * stride, stride, m, d);
+    
+    for(unsigned int j = 0; j < m; ++j)
     {
-      NodeId id = *nit;
-      double d = F::distance(feature, m_nodes[id].descriptor);
-      if(d < best_d)
+      if(i + j == 0 || d[j] < best_dist)
       {
-        best_d = d;
-        final_id = id;
+        best_dist = d[j];
+        best = i + j;
       }
     }
-    
-    if(nid != NULL && current_level == nid_level)
-      *nid = final_id;
-    
-  } while( !m_nodes[final_id].isLeaf() );
-
-  // turn node id into word id
-  word_id = m_nodes[final_id].word_id;
-  weight = m_nodes[final_id].weight;
+  }
+  
+  return best;
 }
 
 // --------------------------------------------------------------------------
@@ -1327,11 +4686,507 @@ int TemplatedVocabulary<TDescriptor,F>::stopWords(double minWeight)
       (*wit)->weight = 0;
     }
   }
+  if(c > 0) m_has_binary_hash = false;
   return c;
 }
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::computeOccupancy(
+  const std::vector<std::vector<TDescriptor> > &features,
+  WordOccupancy &occupancy) const
+{
+  std::vector<unsigned int> word_descriptors(m_words.size(), 0);
+  std::vector<unsigned int> word_images(m_words.size(), 0);
+  double distance_sum = 0;
+  
+  std::vector<WordId> ids;
+  std::vector<double> d;
+  
+  for(size_t m = 0; m < features.size() && !empty(); ++m)
+  {
+    const std::vector<TDescriptor> &image = features[m];
+    const int n = image.size();
+    ids.resize(n);
+    d.resize(n);
+    
+    auto run = [&](int b, int e)
+      {
+        for(int i = b; i < e; ++i)
+        {
+          transform(image[i], ids[i]);
+          d[i] = F::distance(image[i], m_words[ids[i]]->descriptor);
+        }
+      };
+    
+    if(useThreadPool(n))
+      m_pool->parallelFor(0, n, PARALLEL_GRAIN, run);
+    else
+      run(0, n);
+    
+    countOccupancy(ids, d, word_descriptors, word_images, distance_sum);
+  }
+  
+  occupancy.compute(word_descriptors, word_images, features.size(), 
+    distance_sum);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::computeOccupancy(
+  const PackedDescriptors &training, WordOccupancy &occupancy) const
+{
+  computeOccupancy(training, occupancy, 
+    std::integral_constant<bool, HasArray8U<F>::value>());
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::computeOccupancy(
+  const PackedDescriptors &training, WordOccupancy &occupancy, 
+  std::true_type) const
+{
+  std::vector<unsigned int> word_descriptors(m_words.size(), 0);
+  std::vector<unsigned int> word_images(m_words.size(), 0);
+  double distance_sum = 0;
+  
+  std::vector<WordId> ids;
+  std::vector<double> d;
+  
+  for(size_t m = 0; m < training.images() && !empty(); ++m)
+  {
+    const size_t first = training.imageBegin(m);
+    const int n = training.imageEnd(m) - first;
+    ids.resize(n);
+    d.resize(n);
+    
+    auto run = [&](int b, int e)
+      {
+        // each range wraps its rows with its own descriptor
+        TDescriptor feature;
+        for(int i = b; i < e; ++i)
+        {
+          F::fromArray8U(feature, training[first + i]);
+          transform(feature, ids[i]);
+          d[i] = F::distance(feature, m_words[ids[i]]->descriptor);
+        }
+      };
+    
+    if(useThreadPool(n))
+      m_pool->parallelFor(0, n, PARALLEL_GRAIN, run);
+    else
+      run(0, n);
+    
+    countOccupancy(ids, d, word_descriptors, word_images, distance_sum);
+  }
+  
+  occupancy.compute(word_descriptors, word_images, training.images(), 
+    distance_sum);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::countOccupancy(
+  std::vector<WordId> &ids, const std::vector<double> &d,
+  std::vector<unsigned int> &word_descriptors,
+  std::vector<unsigned int> &word_images, double &distance_sum)
+{
+  for(size_t i = 0; i < ids.size(); ++i)
+  {
+    ++word_descriptors[ids[i]];
+    distance_sum += d[i];
+  }
+  
+  // count each word once
+  std::sort(ids.begin(), ids.end());
+  typename std::vector<WordId>::const_iterator it, end = 
+    std::unique(ids.begin(), ids.end());
+  for(it = ids.begin(); it != end; ++it) ++word_images[*it];
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::saveBinary(
+  const std::string &filename) const
+{
+  std::vector<unsigned char> data;
+  saveBinary(data);
+  VocabularyFile::save(filename, data);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+unsigned long long TemplatedVocabulary<TDescriptor,F>::getBinaryHash() const
+{
+  std::unique_lock<std::mutex> lock(m_binary_hash_mutex);
+  if(!m_has_binary_hash)
+  {
+    m_binary_hash = computeBinaryHash();
+    m_has_binary_hash = true;
+  }
+  return m_binary_hash;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+unsigned long long
+TemplatedVocabulary<TDescriptor,F>::computeBinaryHash() const
+{
+  std::vector<unsigned char> data;
+  saveBinary(data);
+  
+  VocabularyFile::Header header;
+  memcpy(&header, data.data(), sizeof(header));
+  return header.checksum;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::saveBinary(
+  std::vector<unsigned char> &data) const
+{
+  saveBinary(data, std::integral_constant<bool, HasToArray8U<F>::value>());
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::saveBinary(
+  std::vector<unsigned char> &data, std::true_type) const
+{
+  const int bytes = F::BYTES;
+  
+  VocabularyFile::Header header;
+  memset(&header, 0, sizeof(header));
+  header.k = m_k;
+  header.L = m_L;
+  header.weighting = m_weighting;
+  header.scoring = m_scoring;
+  header.descriptor_bytes = bytes;
+  
+  // the node table is the flat tree. A tree without words is saved empty
+  std::vector<VocabularyFile::Node> nodes;
+  std::vector<unsigned char> descriptors;
+  std::vector<uint32_t> words;
+  
+  if(!m_words.empty())
+  {
+    const size_t n = m_flat_nodes.size();
+    nodes.resize(n);
+    descriptors.assign(n * bytes, 0);
+    words.resize(m_words.size());
+    
+    // index of each node id in the flat tree
+    std::vector<uint32_t> index(m_nodes.size());
+    for(size_t i = 0; i < n; ++i) index[m_flat_nodes[i].id] = i;
+    
+    for(size_t i = 0; i < n; ++i)
+    {
+      const FlatNode &flat = m_flat_nodes[i];
+      const Node &node = m_nodes[flat.id];
+      
+      VocabularyFile::Node &entry = nodes[i];
+      entry.id = flat.id;
+      entry.parent = (i == 0 ? 0 : index[node.parent]);
+      entry.first_child = flat.first_child;
+      entry.n_children = flat.n_children;
+      entry.word_id = (flat.n_children == 0 ? node.word_id : 0);
+      entry.reserved = 0;
+      entry.weight = node.weight;
+      
+      // the root descriptor is left as zeros
+      if(i > 0) F::toArray8U(m_flat_descriptors[i], &descriptors[i * bytes]);
+    }
+    
+    for(size_t w = 0; w < m_words.size(); ++w) 
+      words[w] = index[m_words[w]->id];
+  }
+  
+  VocabularyFile::compose(header, nodes, descriptors.data(), words, data);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::loadBinary(
+  const std::string &filename)
+{
+  VocabularyFile file(filename);
+  loadBinary(file);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::loadBinary(
+  const VocabularyFile &file)
+{
+  loadBinary(file, std::integral_constant<bool, HasArray8U<F>::value>());
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::loadBinary(
+  const VocabularyFile &file, std::true_type)
+{
+  const VocabularyFile::Header &header = file.header();
+  
+  if(header.nodes > 0 && header.descriptor_bytes != (uint32_t)F::BYTES)
+  {
+    throw std::string("Binary vocabulary ") + file.filename() + 
+      " has descriptors of another size";
+  }
+  
+  m_k = header.k;
+  m_L = header.L;
+  m_weighting = (WeightingType)header.weighting;
+  m_scoring = (ScoringType)header.scoring;
+  m_has_binary_hash = false;
+  createScoringObject();
+  
+  m_words.clear();
+  m_nodes.clear();
+  m_flat_nodes.clear();
+  m_flat_descriptors.clear();
+  m_flat_buffer.release();
+  
+  const uint32_t n = header.nodes;
+  const int bytes = header.descriptor_bytes;
+  const VocabularyFile::Node *table = file.nodes();
+  
+  m_nodes.resize(std::max(n, 1u)); // root, also in an empty vocabulary
+  m_flat_nodes.resize(n);
+  m_flat_descriptors.resize(n);
+  
+  // the descriptors are copied to one buffer, which the flat descriptors
+  // wrap if their type allows it
+  if(n > 0)
+  {
+    m_flat_buffer.create(n, bytes, CV_8U);
+    memcpy(m_flat_buffer.data, file.descriptor(0), (size_t)n * bytes);
+  }
+  
+  for(uint32_t i = 0; i < n; ++i)
+  {
+    const VocabularyFile::Node &entry = table[i];
+    
+    Node &node = m_nodes[entry.id];
+    node.id = entry.id;
+    node.parent = table[entry.parent].id;
+    node.weight = entry.weight;
+    node.word_id = (entry.n_children == 0 ? entry.word_id : 0);
+    
+    node.children.resize(entry.n_children);
+    for(uint32_t c = 0; c < entry.n_children; ++c)
+      node.children[c] = table[entry.first_child + c].id;
+    
+    FlatNode &flat = m_flat_nodes[i];
+    flat.id = entry.id;
+    flat.first_child = entry.first_child;
+    flat.n_children = entry.n_children;
+    
+    if(i > 0)
+    {
+      F::fromArray8U(m_flat_descriptors[i],
+        m_flat_buffer.ptr<unsigned char>(i));
+      node.descriptor = m_flat_descriptors[i];
+    }
+  }
+  
+  m_words.resize(header.words);
+  for(uint32_t w = 0; w < header.words; ++w)
+    m_words[w] = &m_nodes[table[file.words()[w]].id];
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::saveText(
+  const std::string &filename) const
+{
+  FILE *f = fopen(filename.c_str(), "w");
+  if(!f) throw std::string("Could not open file ") + filename;
+  
+  bool ok = (fprintf(f, "%d %d %d %d\n", m_k, m_L, (int)m_scoring, 
+    (int)m_weighting) > 0);
+  
+  // the nodes are written in id order, so that each parent comes first
+  for(size_t i = 1; ok && i < m_nodes.size(); ++i)
+  {
+    const Node &node = m_nodes[i];
+    if(node.parent >= i)
+    {
+      fclose(f);
+      throw std::string("The nodes of the vocabulary are not sorted to be "
+        "saved in ") + filename;
+    }
+    
+    std::string d = F::toString(node.descriptor);
+    d.erase(d.find_last_not_of(" ") + 1);
+    
+    ok = (fprintf(f, "%u %d %s %.17g\n", node.parent, 
+      (node.isLeaf() ? 1 : 0), d.c_str(), node.weight) > 0);
+  }
+  
+  if(fclose(f) != 0 || !ok) 
+    throw std::string("Could not write file ") + filename;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::loadText(const std::string &filename)
+{
+  TextVocabularyFile file(filename);
+  
+  std::vector<TextVocabularyFile::Line> lines;
+  file.parse(lines, m_pool);
+  
+  m_k = file.getBranchingFactor();
+  m_L = file.getDepthLevels();
+  m_scoring = (ScoringType)file.getScoringType();
+  m_weighting = (WeightingType)file.getWeightingType();
+  createScoringObject();
+  
+  m_words.clear();
+  m_nodes.clear();
+  m_flat_nodes.clear();
+  m_flat_descriptors.clear();
+  m_flat_buffer.release();
+  
+  // node i + 1 is in line i. The parser checked that parents come first
+  m_nodes.resize(lines.size() + 1);
+  m_nodes[0].id = 0;
+  
+  for(size_t i = 0; i < lines.size(); ++i)
+  {
+    Node &node = m_nodes[i + 1];
+    node.id = i + 1;
+    node.parent = lines[i].parent;
+    node.weight = lines[i].weight;
+    m_nodes[node.parent].children.push_back(node.id);
+  }
+  
+  for(size_t i = 0; i < lines.size(); ++i)
+  {
+    if(lines[i].leaf != m_nodes[i + 1].isLeaf()) 
+      throw file.wrongLine(lines[i].number);
+  }
+  
+  // the flat tree copies the descriptors of the buffer
+  cv::Mat buffer;
+  readTextDescriptors(file, lines, buffer, 
+    std::integral_constant<bool, HasArray8U<F>::value>());
+  
+  createWords();
+  createFlatTree();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+template<class G>
+void TemplatedVocabulary<TDescriptor,F>::readTextDescriptors(
+  const TextVocabularyFile &file, 
+  const std::vector<TextVocabularyFile::Line> &lines, cv::Mat &buffer,
+  std::true_type)
+{
+  const int bytes = F::BYTES;
+  const int n = (int)lines.size();
+  if(n == 0) return;
+  
+  // the descriptors are read as bytes if the first one is written so
+  std::vector<unsigned char> first(bytes);
+  bool raw = TextVocabularyFile::parseBytes(lines[0].descriptor, 
+    lines[0].descriptor_length, first.data(), bytes);
+  
+  if(raw)
+  {
+    TDescriptor a, b;
+    F::fromArray8U(a, first.data());
+    F::fromString(b, std::string(lines[0].descriptor, 
+      lines[0].descriptor_length));
+    raw = (F::distance(a, b) == 0);
+  }
+  
+  if(!raw)
+  {
+    readTextDescriptors(file, lines, buffer, std::false_type());
+    return;
+  }
+  
+  buffer.create(n, bytes, CV_8U);
+  
+  auto read = [&](int begin, int end)
+    {
+      for(int i = begin; i < end; ++i)
+      {
+        unsigned char *row = buffer.ptr<unsigned char>(i);
+        if(!TextVocabularyFile::parseBytes(lines[i].descriptor, 
+          lines[i].descriptor_length, row, bytes))
+        {
+          throw file.wrongLine(lines[i].number);
+        }
+        F::fromArray8U(m_nodes[i + 1].descriptor, row);
+      }
+    };
+  
+  if(useThreadPool(n))
+    m_pool->parallelFor(0, n, PARALLEL_GRAIN, read);
+  else
+    read(0, n);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::readTextDescriptors(
+  const TextVocabularyFile &, 
+  const std::vector<TextVocabularyFile::Line> &lines, cv::Mat &,
+  std::false_type)
+{
+  const int n = (int)lines.size();
+  
+  auto read = [&](int begin, int end)
+    {
+      for(int i = begin; i < end; ++i)
+      {
+        F::fromString(m_nodes[i + 1].descriptor, 
+          std::string(lines[i].descriptor, lines[i].descriptor_length));
+      }
+    };
+  
+  if(useThreadPool(n))
+    m_pool->parallelFor(0, n, PARALLEL_GRAIN, read);
+  else
+    read(0, n);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::convertToBinary(
+  const std::string &from, const std::string &to)
+{
+  TemplatedVocabulary<TDescriptor,F> voc;
+  voc.load(from);
+  voc.saveBinary(to);
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::save(const std::string &filename) const
 {
@@ -1346,6 +5201,20 @@ void TemplatedVocabulary<TDescriptor,F>::save(const std::string &filename) const
 template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::load(const std::string &filename)
 {
+  if(VocabularyFile::isVocabularyFile(filename))
+  {
+    loadBinary(filename, 
+      std::integral_constant<bool, HasArray8U<F>::value>());
+    return;
+  }
+  
+  if(filename.size() >= 4 && 
+    filename.compare(filename.size() - 4, 4, ".txt") == 0)
+  {
+    loadText(filename);
+    return;
+  }
+  
   cv::FileStorage fs(filename.c_str(), cv::FileStorage::READ);
   if(!fs.isOpened()) throw std::string("Could not open file ") + filename;
   
@@ -1457,6 +5326,8 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
 {
   m_words.clear();
   m_nodes.clear();
+  m_flat_nodes.clear();
+  m_flat_descriptors.clear();
   
   cv::FileNode fvoc = fs[name];
   
@@ -1501,6 +5372,8 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
     m_nodes[nid].word_id = wid;
     m_words[wid] = &m_nodes[nid];
   }
+
+  createFlatTree();
 }
 
 // --------------------------------------------------------------------------
@@ -0,0 +1,153 @@
+/**
+ * File: TextVocabularyFile.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: parser of vocabularies in the text format of ORB-SLAM
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_TEXT_VOCABULARY_FILE__
+#define __D_T_TEXT_VOCABULARY_FILE__
+
+#include <cstddef>
+#include <vector>
+#include <string>
+
+#include "ThreadPool.h"
+
+namespace DBoW2 {
+
+/// Vocabulary file in the text format of ORB-SLAM. The first line is
+/// "k L scoring weighting", and each of the next lines is a node, the root
+/// excluded, in node id order (from 1): "parent isLeaf descriptor weight",
+/// where the descriptor is written by F::toString. Blank lines are ignored.
+/// The whole file is read in memory and its lines are parsed by chunks in
+/// parallel, without allocating memory per line
+class TextVocabularyFile
+{
+public:
+
+  /// Node read from a line
+  struct Line
+  {
+    /// Id of the parent node
+    unsigned int parent;
+    /// Whether the node is a word
+    bool leaf;
+    /// Weight of the node
+    double weight;
+    /// Text of the descriptor in the file (not null-terminated)
+    const char *descriptor;
+    /// Length of the text of the descriptor
+    size_t descriptor_length;
+    /// Number of the line in the file, from 1
+    size_t number;
+  };
+
+  /**
+   * Reads a file and parses its first line
+   * @param filename
+   * @throw string if the file cannot be read or its first line is wrong
+   */
+  explicit TextVocabularyFile(const std::string &filename);
+
+  /**
+   * Parses the nodes of the file. The descriptors of the lines point to
+   * the text kept by this object
+   * @param lines (out) line of each node, by node id - 1
+   * @param pool if given, pool to parse the file in parallel
+   * @throw string if a line is wrong
+   */
+  void parse(std::vector<Line> &lines, ThreadPool *pool = NULL) const;
+
+  /**
+   * Parses the text of a descriptor as n integers in [0, 255] separated
+   * by whitespace, as FORB::toString writes them
+   * @param text
+   * @param length length of the text
+   * @param bytes (out) n bytes
+   * @param n
+   * @return true iff the text has exactly n numbers of that range
+   */
+  static bool parseBytes(const char *text, size_t length,
+    unsigned char *bytes, int n);
+
+  /**
+   * Returns the name of the file
+   * @return filename
+   */
+  inline const std::string& filename() const { return m_filename; }
+
+  /**
+   * Returns the branching factor of the tree (k)
+   * @return k
+   */
+  inline int getBranchingFactor() const { return m_k; }
+
+  /**
+   * Returns the depth levels of the tree (L)
+   * @return L
+   */
+  inline int getDepthLevels() const { return m_L; }
+
+  /**
+   * Returns the scoring type as a number
+   * @return ScoringType
+   */
+  inline int getScoringType() const { return m_scoring; }
+
+  /**
+   * Returns the weighting type as a number
+   * @return WeightingType
+   */
+  inline int getWeightingType() const { return m_weighting; }
+
+  /**
+   * Returns the error of a wrong line
+   * @param line line number, from 1
+   * @return error message
+   */
+  std::string wrongLine(size_t line) const;
+
+protected:
+
+  /// Range of the file parsed by a task
+  struct Chunk
+  {
+    /// First and last + 1 bytes of the range, which begins at a line
+    size_t begin, end;
+    /// Number of the first line of the range, from 1
+    size_t first_line;
+    /// Node lines in the range
+    size_t nodes;
+  };
+
+  /**
+   * Parses a node line
+   * @param p first byte of the line
+   * @param end end of the line, without the line break
+   * @param line (out) node
+   * @return false if the line is wrong
+   */
+  static bool parseLine(const char *p, const char *end, Line &line);
+
+protected:
+
+  /// Name of the file
+  std::string m_filename;
+
+  /// Contents of the file, followed by a null character
+  std::vector<char> m_data;
+
+  /// Offset of the second line
+  size_t m_body;
+
+  /// Parameters of the first line
+  int m_k, m_L, m_scoring, m_weighting;
+
+};
+
+} // namespace DBoW2
+
+#endif
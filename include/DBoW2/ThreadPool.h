@@ -0,0 +1,148 @@
+/**
+ * File: ThreadPool.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: pool of threads to run loops in parallel
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_THREAD_POOL__
+#define __D_T_THREAD_POOL__
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace DBoW2 {
+
+/// Pool of threads to run loops in parallel
+/**
+ * The same pool can be used by several threads at once. The thread that
+ * runs a loop takes part in it, so that nested loops do not block the pool.
+ * Each worker keeps its own queue of tasks: it runs the last task it queued
+ * first, and steals the oldest tasks of the other queues when its own is
+ * empty, so that recursive loops are shared out by their largest parts
+ */
+class ThreadPool
+{
+public:
+
+  /**
+   * Creates a pool
+   * @param threads number of threads that run the loops, including the 
+   *   calling one. If <= 0, the number of hardware threads is used
+   */
+  explicit ThreadPool(int threads = 0);
+
+  /**
+   * Waits for the running tasks and stops the threads
+   */
+  ~ThreadPool();
+
+  /**
+   * Returns the number of threads that run the loops, including the calling
+   * one
+   * @return number of threads
+   */
+  inline int size() const { return (int)m_workers.size() + 1; }
+
+  /**
+   * Runs f(b, e) on consecutive ranges [b, e) that cover [begin, end), and
+   * returns when all of them have finished. If f throws an exception, the
+   * ranges that have not started are skipped, and the first exception is
+   * thrown again by this function
+   * @param begin
+   * @param end
+   * @param grain number of items of each range (the last one may be shorter)
+   * @param f function to run
+   */
+  void parallelFor(int begin, int end, int grain, 
+    const std::function<void(int, int)> &f);
+
+protected:
+
+  /// Set of tasks whose completion is waited for together
+  struct Job
+  {
+    /// Number of tasks not finished yet
+    int pending;
+    /// Notified when pending reaches 0
+    std::condition_variable done;
+    /// First exception thrown by a task
+    std::exception_ptr error;
+  };
+
+  /// Task of a job
+  struct Task
+  {
+    /// Job the task belongs to
+    Job *job;
+    /// Function to run
+    std::function<void()> f;
+  };
+
+protected:
+
+  /**
+   * Loop of the worker threads
+   * @param q index of the queue of the worker
+   */
+  void workerLoop(int q);
+
+  /**
+   * Runs a task and updates its job, unless another task of the job has
+   * failed. m_mutex must not be locked
+   * @param task
+   */
+  void runTask(Task &task);
+
+  /**
+   * Returns the index of the queue of the calling thread
+   * @return index in m_queues: 0 if the thread is not a worker of this pool
+   */
+  int queueIndex() const;
+
+  /**
+   * Takes a task from the queue of the calling thread, or steals one from
+   * the other queues. m_mutex must be locked
+   * @param q index of the queue of the calling thread
+   * @param task (out) task taken
+   * @return true iff a task was taken
+   */
+  bool takeTask(int q, Task &task);
+
+protected:
+
+  /// Worker threads
+  std::vector<std::thread> m_workers;
+
+  /// Tasks waiting to be run. m_queues[i + 1] belongs to m_workers[i], and
+  /// m_queues[0] receives the tasks of threads that are not workers
+  std::vector<std::deque<Task> > m_queues;
+
+  /// Number of tasks in all the queues
+  int m_ntasks;
+
+  /// Protects m_queues, m_ntasks, m_stop and the jobs
+  std::mutex m_mutex;
+
+  /// Notified when there are new tasks or the pool stops
+  std::condition_variable m_cond;
+
+  /// The pool is being destroyed
+  bool m_stop;
+
+private:
+
+  ThreadPool(const ThreadPool &);
+  ThreadPool& operator=(const ThreadPool &);
+};
+
+} // namespace DBoW2
+
+#endif
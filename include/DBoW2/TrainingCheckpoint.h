@@ -0,0 +1,136 @@
+/**
+ * File: TrainingCheckpoint.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: file that keeps the node splits of a vocabulary training,
+ *   so that an interrupted training can be resumed
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_TRAINING_CHECKPOINT__
+#define __D_T_TRAINING_CHECKPOINT__
+
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+
+namespace DBoW2 {
+
+/// Journal of the nodes split while a vocabulary is created. Each split
+/// is appended to the file as soon as it is computed, as a record with the
+/// cluster centres and the cluster of each descriptor of the node.
+/// The file starts with the 4 bytes "DBCK", a version and a fingerprint of
+/// the training. Each record has a key that identifies the node, the
+/// centres, the associations and a checksum. Numbers are little-endian.
+/// A record cut by an interruption is discarded when the file is opened
+/// again, and overwritten by the next one
+class TrainingCheckpoint
+{
+public:
+
+  /// Split of a node read from the file
+  struct Split
+  {
+    /// Cluster centres, in the format of the vocabulary
+    std::vector<unsigned char> clusters;
+    /// Cluster of each descriptor of the node
+    std::vector<int> association;
+  };
+
+  /**
+   * Opens the checkpoint file, or creates it if it does not exist
+   * @param filename
+   * @param fingerprint value that identifies the training. An existing
+   *   file must have been created with the same value
+   * @throw string if the file cannot be created, or if it belongs to
+   *   another training
+   */
+  TrainingCheckpoint(const std::string &filename,
+    unsigned long long fingerprint);
+
+  /**
+   * Closes the file
+   */
+  ~TrainingCheckpoint();
+
+  /**
+   * Returns the number of splits in the file
+   * @return number of splits
+   */
+  size_t size() const;
+
+  /**
+   * Reads the split of a node, if it is in the file. This function can be
+   * called from several threads
+   * @param key key of the node
+   * @param split (out) split
+   * @return true iff the split was found
+   * @throw string if the file cannot be read
+   */
+  bool find(unsigned long long key, Split &split);
+
+  /**
+   * Appends the split of a node to the file. This function can be called
+   * from several threads
+   * @param key key of the node
+   * @param clusters cluster centres, in the format of the vocabulary
+   * @param bytes size of clusters
+   * @param association cluster of each descriptor
+   * @param n number of descriptors
+   * @throw string if the file cannot be written
+   */
+  void save(unsigned long long key, const unsigned char *clusters,
+    size_t bytes, const int *association, size_t n);
+
+  /**
+   * Closes and deletes the file
+   */
+  void remove();
+
+  /**
+   * Returns the key of the child of a node
+   * @param key key of the parent node. The root has key 0
+   * @param i index of the child
+   * @return key of the child
+   */
+  static unsigned long long childKey(unsigned long long key, unsigned int i);
+
+  /**
+   * Computes the 64-bit FNV-1a hash of some data
+   * @param data
+   * @param bytes
+   * @param h hash of the previous data, to hash several blocks in sequence
+   * @return hash
+   */
+  static unsigned long long hash(const void *data, size_t bytes,
+    unsigned long long h = 14695981039346656037ULL);
+
+protected:
+
+  /// Checkpoint file
+  FILE *m_file;
+
+  /// Path of the file
+  std::string m_filename;
+
+  /// Offset of each record in the file, by key
+  std::unordered_map<unsigned long long, long> m_records;
+
+  /// Offset where the next record is written
+  long m_end;
+
+  /// Protects the file and the records
+  mutable std::mutex m_mutex;
+
+private:
+
+  TrainingCheckpoint(const TrainingCheckpoint &);
+  TrainingCheckpoint& operator=(const TrainingCheckpoint &);
+};
+
+} // namespace DBoW2
+
+#endif
@@ -0,0 +1,144 @@
+/**
+ * File: TrainingOptions.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: options of the vocabulary training
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_TRAINING_OPTIONS__
+#define __D_T_TRAINING_OPTIONS__
+
+#include <string>
+
+namespace DBoW2 {
+
+/// Clustering algorithm run at each node of the tree
+enum ClusteringType
+{
+  KMEANS,           // Lloyd iterations until no assignment changes
+  MINI_BATCH_KMEANS // kmeans on random batches of the node descriptors
+};
+
+/// Algorithm that chooses the initial cluster centres at each node
+enum SeedingType
+{
+  KMEANS_PP_SEEDING,      // kmeans++: one pass over the descriptors per 
+                          // centre
+  KMEANS_PARALLEL_SEEDING // kmeans||: a few parallel passes that oversample
+                          // candidates, which are reduced to k centres.
+                          // It computes about seeding_rounds * oversampling
+                          // times as many distances as kmeans++, so it is
+                          // faster only with a thread pool
+};
+
+/// Way the descriptors are associated with clusters in the KMEANS iterations
+enum AssignmentType
+{
+  FULL_ASSIGNMENT,   // distances to all the clusters are computed
+  HAMERLY_ASSIGNMENT,// distances that cannot change the association are 
+                     // skipped with two bounds per descriptor and the
+                     // triangle inequality
+  ELKAN_ASSIGNMENT   // as HAMERLY_ASSIGNMENT, with k + 1 bounds per 
+                     // descriptor, which skip more distances
+};
+
+/// Options of the vocabulary training
+struct TrainingOptions
+{
+  /// Clustering algorithm
+  ClusteringType clustering;
+  
+  /// Seeding of the clusters. It is ignored if initiateClusters is 
+  /// overridden, except when training from packed descriptors
+  SeedingType seeding;
+  
+  /// KMEANS_PARALLEL_SEEDING: number of sampling rounds. More rounds are 
+  /// made if fewer than k candidates have been sampled
+  int seeding_rounds;
+  
+  /// KMEANS_PARALLEL_SEEDING: expected number of candidates sampled in 
+  /// each round, as a factor of k
+  double oversampling;
+  
+  /// KMEANS: association of descriptors with clusters. HAMERLY_ASSIGNMENT 
+  /// and ELKAN_ASSIGNMENT produce the same clusters as FULL_ASSIGNMENT with
+  /// fewer distance computations, but keep 16 and 8 * (k + 1) bytes of 
+  /// bounds per descriptor
+  AssignmentType assignment;
+  
+  /// Mini-batch kmeans: number of descriptors sampled at each iteration. 
+  /// Nodes with fewer descriptors than this are split with KMEANS
+  int batch_size;
+  
+  /// Mini-batch kmeans and balanced clusters: maximum number of iterations
+  /// at each node
+  int max_iterations;
+  
+  /// Mini-batch kmeans: the iterations stop when the mean distance the 
+  /// cluster centres move in one iteration is not greater than this
+  double tolerance;
+
+  /// If greater than 0, the clusters of each node are balanced: no cluster
+  /// gets more than max_occupancy times the mean number of descriptors per
+  /// cluster (n / k). The descriptors that do not fit in their closest 
+  /// cluster go to the closest one with room, and the centres and this 
+  /// assignment are iterated until it does not change, or max_iterations 
+  /// times. Values lower than 1 are taken as 1 (clusters of equal size).
+  /// This bounds the training descriptors assigned to each word to 
+  /// max_occupancy^L times the mean, which flattens the inverted rows of 
+  /// the database at the cost of some quantization error. transform still
+  /// finds the closest words, so the bound is approximate for it:
+  /// TemplatedVocabulary::computeOccupancy measures the result. Training 
+  /// from a DescriptorReader, the nodes that do not fit in memory are 
+  /// balanced with their sample only
+  double max_occupancy;
+
+  /// IDF and TF_IDF weights: if false, the images each word appears in are
+  /// counted with the leaves the training descriptors were assigned to by 
+  /// the clustering. If true, the training descriptors are transformed 
+  /// again once the tree is built, which costs a second pass over them, but
+  /// matches transform also when a node has duplicated descriptors. 
+  /// Training from a DescriptorReader or with balanced clusters always 
+  /// transforms them again
+  bool transform_weights;
+
+  /// Training from a DescriptorReader: nodes with at most this number of
+  /// descriptors are loaded and split in memory. Larger nodes are clustered
+  /// with a random sample of this size, and their descriptors are spilled
+  /// into one temporary file per child
+  int max_in_memory;
+  
+  /// Training from a DescriptorReader: directory of the temporary files. 
+  /// If empty, the system temporary directory is used
+  std::string temp_directory;
+
+  /// If not empty, file where the split of each node is saved as soon as
+  /// it is computed. If create is interrupted, calling it again with the
+  /// same descriptors, parameters and seed (the state of rand()) resumes 
+  /// from the splits in the file, and creates the same vocabulary as an 
+  /// uninterrupted run. The file is deleted when create finishes.
+  /// Checkpoints store the raw data of the descriptors, so F must provide
+  /// F::toArray8U, F::fromArray8U and F::BYTES
+  std::string checkpoint_file;
+
+  /**
+   * Sets the default options: KMEANS with kmeans++ seeding and 
+   * FULL_ASSIGNMENT, 5 rounds of k candidates for KMEANS_PARALLEL_SEEDING,
+   * batches of 1000 descriptors, 100 iterations and 0 tolerance for 
+   * MINI_BATCH_KMEANS, unbalanced clusters, weights from the clustering, 
+   * 1M descriptors in memory, and no checkpoint
+   */
+  TrainingOptions()
+    : clustering(KMEANS), seeding(KMEANS_PP_SEEDING), seeding_rounds(5), 
+      oversampling(1), assignment(FULL_ASSIGNMENT), batch_size(1000), 
+      max_iterations(100), tolerance(0), max_occupancy(0), 
+      transform_weights(false), 
+      max_in_memory(1000000)
+  {}
+};
+
+} // namespace DBoW2
+
+#endif
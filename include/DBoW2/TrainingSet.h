@@ -0,0 +1,717 @@
+/**
+ * File: TrainingSet.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: access to the training descriptors of a vocabulary for the
+ *   kmeans that creates it
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_TRAINING_SET__
+#define __D_T_TRAINING_SET__
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "FClass.h"
+#include "MajorityVote.h"
+#include "PackedDescriptors.h"
+
+namespace DBoW2 {
+
+/**
+ * Makes a descriptor own its data, so that it does not depend on the buffer
+ * it was read from. This generic version does nothing
+ * @param descriptor
+ */
+template<class T>
+inline void detachDescriptor(T &)
+{
+}
+
+/**
+ * Makes a cv::Mat descriptor own its data
+ * @param descriptor
+ */
+inline void detachDescriptor(cv::Mat &descriptor)
+{
+  if(!descriptor.empty()) descriptor = descriptor.clone();
+}
+
+/**
+ * Calculates the distances between a descriptor and n descriptors with 
+ * F::distances, when F provides it. It is a free template so that it is 
+ * only instantiated for such F
+ * @param a descriptor
+ * @param b array of n descriptors
+ * @param n
+ * @param d (out) array of n distances
+ */
+template<class F, class TDescriptor>
+inline void descriptorDistances(const TDescriptor &a, const TDescriptor *b,
+  int n, double *d, std::true_type)
+{
+  F::distances(a, b, n, d);
+}
+
+/**
+ * Calculates the distances between a descriptor and n descriptors with 
+ * F::distance, when F does not provide F::distances
+ * @param a descriptor
+ * @param b array of n descriptors
+ * @param n
+ * @param d (out) array of n distances
+ */
+template<class F, class TDescriptor>
+inline void descriptorDistances(const TDescriptor &a, const TDescriptor *b,
+  int n, double *d, std::false_type)
+{
+  for(int i = 0; i < n; ++i) d[i] = F::distance(a, b[i]);
+}
+
+/**
+ * Updates the mean of a cluster of mini-batch kmeans as the weighted mean
+ * of its previous mean, which stands for size descriptors, and its new
+ * descriptors, when F provides F::weightedMeanValue. It is a free template
+ * so that it is only instantiated for such F
+ * @param members new descriptors of the cluster. They are cleared
+ * @param size (in/out) number of descriptors of the cluster
+ * @param cluster (in/out) cluster centre
+ */
+template<class F, class TDescriptor>
+void updateMeanValue(std::vector<const TDescriptor *> &members, int &size,
+  TDescriptor &cluster, std::true_type)
+{
+  const int m = (int)members.size();
+  std::vector<double> weights(m, 1.);
+
+  // the previous mean stands for the descriptors of the previous batches
+  TDescriptor last = cluster;
+  if(size > 0)
+  {
+    members.push_back(&last);
+    weights.push_back(size);
+  }
+
+  F::weightedMeanValue(members, weights, cluster);
+  size += m;
+  members.clear();
+}
+
+/**
+ * Updates the mean of a cluster of mini-batch kmeans from all its
+ * descriptors, when F does not provide F::weightedMeanValue
+ * @param members all the descriptors of the cluster
+ * @param size unused
+ * @param cluster (out) cluster centre
+ */
+template<class F, class TDescriptor>
+inline void updateMeanValue(std::vector<const TDescriptor *> &members,
+  int &, TDescriptor &cluster, std::false_type)
+{
+  F::meanValue(members, cluster);
+}
+
+// --------------------------------------------------------------------------
+
+/**
+ * Training descriptors given as objects. The kmeans of TemplatedVocabulary
+ * refers to the training descriptors and to the cluster centres by their
+ * indices, and reads them through a training set: this class or 
+ * PackedTrainingSet. Both provide the same members:
+ * - Descriptor: type of the descriptors given to the mean functions of F
+ * - Clusters: container of cluster centres
+ * - size, operator[]: the descriptors
+ * - count, addCluster, getCluster: the cluster centres
+ * - distance, distances, clusterDistances, shift: distances between
+ *   descriptors and cluster centres
+ * - mean, updateCluster: cluster centres computed from descriptors
+ * - bytes, toRaw, fromRaw: cluster centres as raw data, for checkpoints
+ */
+template<class TDescriptor, class F>
+class ObjectTrainingSet
+{
+public:
+
+  /// Pointer to a descriptor
+  typedef const TDescriptor *Descriptor;
+
+  /// Cluster centres
+  typedef std::vector<TDescriptor> Clusters;
+
+  /**
+   * Reads some descriptor objects
+   * @param descriptors pointers to the descriptors
+   */
+  explicit ObjectTrainingSet(const std::vector<Descriptor> &descriptors)
+    : m_descriptors(descriptors)
+  {
+  }
+
+  /**
+   * Returns the number of descriptors
+   * @return size
+   */
+  inline size_t size() const
+  {
+    return m_descriptors.size();
+  }
+
+  /**
+   * Returns a descriptor
+   * @param i index of the descriptor
+   * @return pointer to the descriptor
+   */
+  inline Descriptor operator[](unsigned int i) const
+  {
+    return m_descriptors[i];
+  }
+
+  /**
+   * Returns the number of cluster centres
+   * @param clusters
+   * @return number of centres
+   */
+  inline unsigned int count(const Clusters &clusters) const
+  {
+    return clusters.size();
+  }
+
+  /**
+   * Adds a descriptor to the cluster centres
+   * @param clusters (in/out) centres
+   * @param i index of the descriptor
+   */
+  inline void addCluster(Clusters &clusters, unsigned int i) const
+  {
+    clusters.push_back(*m_descriptors[i]);
+  }
+
+  /**
+   * Returns a cluster centre as a descriptor object
+   * @param clusters
+   * @param c index of the centre
+   * @param descriptor (out) centre. It may share the data of clusters
+   */
+  inline void getCluster(const Clusters &clusters, unsigned int c,
+    TDescriptor &descriptor) const
+  {
+    descriptor = clusters[c];
+  }
+
+  /**
+   * Returns the distance between a descriptor and a cluster centre
+   * @param i index of the descriptor
+   * @param clusters
+   * @param c index of the centre
+   * @return distance
+   */
+  inline double distance(unsigned int i, const Clusters &clusters,
+    unsigned int c) const
+  {
+    return F::distance(*m_descriptors[i], clusters[c]);
+  }
+
+  /**
+   * Calculates the distances between a descriptor and all the cluster
+   * centres
+   * @param i index of the descriptor
+   * @param clusters
+   * @param d (out) distance to each centre
+   */
+  inline void distances(unsigned int i, const Clusters &clusters,
+    double *d) const
+  {
+    descriptorDistances<F>(*m_descriptors[i], clusters.data(), 
+      (int)clusters.size(), d,
+      std::integral_constant<bool, HasDistances<F>::value>());
+  }
+
+  /**
+   * Calculates the distances between a cluster centre and all of them
+   * @param clusters
+   * @param c index of the centre
+   * @param d (out) distance to each centre
+   */
+  inline void clusterDistances(const Clusters &clusters, unsigned int c,
+    double *d) const
+  {
+    descriptorDistances<F>(clusters[c], clusters.data(), 
+      (int)clusters.size(), d,
+      std::integral_constant<bool, HasDistances<F>::value>());
+  }
+
+  /**
+   * Returns the distance a cluster centre moved
+   * @param last previous centres
+   * @param clusters current centres
+   * @param c index of the centre
+   * @return distance
+   */
+  inline double shift(const Clusters &last, const Clusters &clusters,
+    unsigned int c) const
+  {
+    return F::distance(last[c], clusters[c]);
+  }
+
+  /**
+   * Sets a cluster centre to the mean of some descriptors
+   * @param members descriptors
+   * @param clusters (in/out) centres
+   * @param c index of the centre
+   */
+  inline void mean(const std::vector<Descriptor> &members,
+    Clusters &clusters, unsigned int c) const
+  {
+    F::meanValue(members, clusters[c]);
+  }
+
+  /**
+   * Updates a cluster centre of mini-batch kmeans with the descriptors
+   * associated with it in the last batch. It is computed from the bit
+   * counts of its descriptors if F provides F::meanValueCounts8U and the
+   * raw data of the descriptors, from its previous mean if F provides
+   * F::weightedMeanValue, or as the mean of all its descriptors otherwise
+   * @param members new descriptors of the centre. They are cleared unless
+   *   they are needed by the next updates
+   * @param counts (in/out) bit counts of all the centres, allocated when
+   *   empty
+   * @param sizes (in/out) number of descriptors of each centre
+   * @param clusters (in/out) centres
+   * @param c index of the centre
+   * @return distance the centre moved
+   */
+  inline double updateCluster(std::vector<Descriptor> &members,
+    std::vector<int> &counts, std::vector<int> &sizes, Clusters &clusters,
+    unsigned int c) const
+  {
+    const TDescriptor last = clusters[c];
+    updateCluster(members, counts, sizes, c, clusters[c],
+      std::integral_constant<bool, HasMeanCounts8U<F>::value &&
+        HasArray8U<F>::value && HasToArray8U<F>::value>());
+    return F::distance(last, clusters[c]);
+  }
+
+  /**
+   * Returns the size of the raw data of the cluster centres
+   * @return F::BYTES, or 0 if F does not provide the raw data of the
+   *   descriptors, which are needed by the checkpoints
+   */
+  inline int bytes() const
+  {
+    return bytes(std::integral_constant<bool,
+      HasArray8U<F>::value && HasToArray8U<F>::value>());
+  }
+
+  /**
+   * Stores the raw data of the cluster centres, if bytes() > 0
+   * @param clusters
+   * @param data (out) raw data of the centres, one after the other
+   */
+  inline void toRaw(const Clusters &clusters,
+    std::vector<unsigned char> &data) const
+  {
+    toRaw(clusters, data, std::integral_constant<bool,
+      HasArray8U<F>::value && HasToArray8U<F>::value>());
+  }
+
+  /**
+   * Reads the cluster centres from their raw data, if bytes() > 0
+   * @param data raw data of the centres, one after the other
+   * @param clusters (out) centres
+   */
+  inline void fromRaw(std::vector<unsigned char> &data,
+    Clusters &clusters) const
+  {
+    fromRaw(data, clusters, std::integral_constant<bool,
+      HasArray8U<F>::value && HasToArray8U<F>::value>());
+  }
+
+protected:
+
+  /// updateCluster with the bit counts
+  void updateCluster(std::vector<Descriptor> &members,
+    std::vector<int> &counts, std::vector<int> &sizes, unsigned int c,
+    TDescriptor &cluster, std::true_type) const
+  {
+    const int bytes = F::BYTES;
+    if(counts.empty()) counts.resize(sizes.size() * bytes * 8, 0);
+
+    std::vector<unsigned char> data(members.size() * bytes);
+    std::vector<const unsigned char *> rows(members.size());
+    for(size_t i = 0; i < members.size(); ++i)
+    {
+      F::toArray8U(*members[i], &data[i * bytes]);
+      rows[i] = &data[i * bytes];
+    }
+
+    int *count = &counts[c * bytes * 8];
+    MajorityVote::add(rows.data(), (int)rows.size(), bytes, count);
+    sizes[c] += (int)members.size();
+    members.clear();
+
+    std::vector<unsigned char> mean(bytes);
+    F::meanValueCounts8U(count, sizes[c], mean.data());
+
+    F::fromArray8U(cluster, mean.data());
+    detachDescriptor(cluster);
+  }
+
+  /// updateCluster with the means
+  inline void updateCluster(std::vector<Descriptor> &members,
+    std::vector<int> &, std::vector<int> &sizes, unsigned int c,
+    TDescriptor &cluster, std::false_type) const
+  {
+    updateMeanValue<F>(members, sizes[c], cluster,
+      std::integral_constant<bool, HasWeightedMean<F>::value>());
+  }
+
+  /// bytes when F provides the raw data
+  static inline int bytes(std::true_type)
+  {
+    return F::BYTES;
+  }
+
+  /// bytes when F does not provide the raw data
+  static inline int bytes(std::false_type)
+  {
+    return 0;
+  }
+
+  /// toRaw when F provides the raw data
+  static void toRaw(const Clusters &clusters,
+    std::vector<unsigned char> &data, std::true_type)
+  {
+    data.resize(clusters.size() * F::BYTES);
+    for(size_t c = 0; c < clusters.size(); ++c)
+    {
+      F::toArray8U(clusters[c], &data[c * F::BYTES]);
+    }
+  }
+
+  /// toRaw when F does not provide the raw data
+  static inline void toRaw(const Clusters &, std::vector<unsigned char> &,
+    std::false_type)
+  {
+  }
+
+  /// fromRaw when F provides the raw data
+  static void fromRaw(std::vector<unsigned char> &data, Clusters &clusters,
+    std::true_type)
+  {
+    clusters.resize(data.size() / F::BYTES);
+    for(size_t c = 0; c < clusters.size(); ++c)
+    {
+      F::fromArray8U(clusters[c], &data[c * F::BYTES]);
+      detachDescriptor(clusters[c]);
+    }
+  }
+
+  /// fromRaw when F does not provide the raw data
+  static inline void fromRaw(std::vector<unsigned char> &, Clusters &,
+    std::false_type)
+  {
+  }
+
+protected:
+
+  /// Descriptors
+  const std::vector<Descriptor> &m_descriptors;
+};
+
+// --------------------------------------------------------------------------
+
+/// Training descriptors given as raw data stored one after the other, as
+/// read by F::fromArray8U. They are compared with F::distances8U, and
+/// averaged with F::meanValue8U. See ObjectTrainingSet
+template<class TDescriptor, class F>
+class PackedTrainingSet
+{
+public:
+
+  /// Raw data of a descriptor
+  typedef const unsigned char *Descriptor;
+
+  /// Raw data of the cluster centres, one after the other
+  typedef std::vector<unsigned char> Clusters;
+
+  /**
+   * Reads the descriptors of a buffer
+   * @param data raw data of the descriptors
+   * @param n number of descriptors
+   * @param bytes bytes per descriptor
+   */
+  PackedTrainingSet(const unsigned char *data, size_t n, int bytes)
+    : m_data(data), m_size(n), m_bytes(bytes)
+  {
+  }
+
+  /**
+   * Reads packed descriptors
+   * @param descriptors
+   */
+  explicit PackedTrainingSet(const PackedDescriptors &descriptors)
+    : m_data(descriptors.data()), m_size(descriptors.size()),
+      m_bytes(descriptors.descriptorBytes())
+  {
+  }
+
+  /**
+   * Returns the number of descriptors
+   * @return size
+   */
+  inline size_t size() const
+  {
+    return m_size;
+  }
+
+  /**
+   * Returns a descriptor
+   * @param i index of the descriptor
+   * @return raw data of the descriptor
+   */
+  inline Descriptor operator[](unsigned int i) const
+  {
+    return m_data + (size_t)i * m_bytes;
+  }
+
+  /**
+   * Returns the number of cluster centres
+   * @param clusters
+   * @return number of centres
+   */
+  inline unsigned int count(const Clusters &clusters) const
+  {
+    return clusters.size() / m_bytes;
+  }
+
+  /**
+   * Adds a descriptor to the cluster centres
+   * @param clusters (in/out) centres
+   * @param i index of the descriptor
+   */
+  inline void addCluster(Clusters &clusters, unsigned int i) const
+  {
+    clusters.insert(clusters.end(), (*this)[i], (*this)[i] + m_bytes);
+  }
+
+  /**
+   * Returns a cluster centre as a descriptor object
+   * @param clusters
+   * @param c index of the centre
+   * @param descriptor (out) centre. It may point to the data of clusters
+   */
+  inline void getCluster(const Clusters &clusters, unsigned int c,
+    TDescriptor &descriptor) const
+  {
+    F::fromArray8U(descriptor, &clusters[c * m_bytes]);
+  }
+
+  /**
+   * Returns the distance between a descriptor and a cluster centre
+   * @param i index of the descriptor
+   * @param clusters
+   * @param c index of the centre
+   * @return distance
+   */
+  inline double distance(unsigned int i, const Clusters &clusters,
+    unsigned int c) const
+  {
+    double d;
+    distances8U((*this)[i], &clusters[c * m_bytes], 1, &d);
+    return d;
+  }
+
+  /**
+   * Calculates the distances between a descriptor and all the cluster
+   * centres
+   * @param i index of the descriptor
+   * @param clusters
+   * @param d (out) distance to each centre
+   */
+  inline void distances(unsigned int i, const Clusters &clusters,
+    double *d) const
+  {
+    distances8U((*this)[i], clusters.data(), count(clusters), d);
+  }
+
+  /**
+   * Calculates the distances between a cluster centre and all of them
+   * @param clusters
+   * @param c index of the centre
+   * @param d (out) distance to each centre
+   */
+  inline void clusterDistances(const Clusters &clusters, unsigned int c,
+    double *d) const
+  {
+    distances8U(&clusters[c * m_bytes], clusters.data(), count(clusters),
+      d);
+  }
+
+  /**
+   * Returns the distance a cluster centre moved
+   * @param last previous centres
+   * @param clusters current centres
+   * @param c index of the centre
+   * @return distance
+   */
+  inline double shift(const Clusters &last, const Clusters &clusters,
+    unsigned int c) const
+  {
+    double d;
+    distances8U(&last[c * m_bytes], &clusters[c * m_bytes], 1, &d);
+    return d;
+  }
+
+  /**
+   * Sets a cluster centre to the mean of some descriptors
+   * @param members descriptors
+   * @param clusters (in/out) centres
+   * @param c index of the centre
+   */
+  inline void mean(const std::vector<Descriptor> &members,
+    Clusters &clusters, unsigned int c) const
+  {
+    F::meanValue8U(members, &clusters[c * m_bytes]);
+  }
+
+  /**
+   * Updates a cluster centre of mini-batch kmeans with the descriptors
+   * associated with it in the last batch. It is computed from the bit
+   * counts of its descriptors if F provides F::meanValueCounts8U, or as the
+   * mean of all its descriptors otherwise
+   * @param members new descriptors of the centre. They are cleared unless
+   *   they are needed by the next updates
+   * @param counts (in/out) bit counts of all the centres, allocated when
+   *   empty
+   * @param sizes (in/out) number of descriptors of each centre
+   * @param clusters (in/out) centres
+   * @param c index of the centre
+   * @return distance the centre moved
+   */
+  inline double updateCluster(std::vector<Descriptor> &members,
+    std::vector<int> &counts, std::vector<int> &sizes, Clusters &clusters,
+    unsigned int c) const
+  {
+    unsigned char *cluster = &clusters[c * m_bytes];
+    const std::vector<unsigned char> last(cluster, cluster + m_bytes);
+    updateCluster(members, counts, sizes, c, cluster,
+      std::integral_constant<bool, HasMeanCounts8U<F>::value>());
+    
+    double d;
+    distances8U(last.data(), cluster, 1, &d);
+    return d;
+  }
+
+  /**
+   * Returns the size of the raw data of the cluster centres
+   * @return bytes per descriptor
+   */
+  inline int bytes() const
+  {
+    return m_bytes;
+  }
+
+  /**
+   * Stores the raw data of the cluster centres
+   * @param clusters
+   * @param data (out) raw data of the centres
+   */
+  inline void toRaw(const Clusters &clusters,
+    std::vector<unsigned char> &data) const
+  {
+    data = clusters;
+  }
+
+  /**
+   * Reads the cluster centres from their raw data
+   * @param data raw data of the centres. They are moved to clusters
+   * @param clusters (out) centres
+   */
+  inline void fromRaw(std::vector<unsigned char> &data,
+    Clusters &clusters) const
+  {
+    clusters.swap(data);
+  }
+
+protected:
+
+  /**
+   * Calculates the distances between a descriptor and n descriptors stored
+   * one after the other, with F::distances8U for buffers if F provides it
+   * @param a raw data of a descriptor
+   * @param b raw data of the n descriptors
+   * @param n
+   * @param d (out) array of n distances
+   */
+  inline void distances8U(const unsigned char *a, const unsigned char *b,
+    unsigned int n, double *d) const
+  {
+    distances8U(a, b, n, d,
+      std::integral_constant<bool, HasStridedDistances8U<F>::value>());
+  }
+
+  /// distances8U with F::distances8U for buffers
+  inline void distances8U(const unsigned char *a, const unsigned char *b,
+    unsigned int n, double *d, std::true_type) const
+  {
+    F::distances8U(a, b, m_bytes, (int)n, d);
+  }
+
+  /// distances8U with F::distances8U for arrays of pointers
+  void distances8U(const unsigned char *a, const unsigned char *b,
+    unsigned int n, double *d, std::false_type) const
+  {
+    // the pointers are given by chunks to keep them in the stack
+    const unsigned int CHUNK = 64;
+    const unsigned char *p[CHUNK];
+
+    for(unsigned int i = 0; i < n; i += CHUNK)
+    {
+      const unsigned int m = (n - i < CHUNK ? n - i : CHUNK);
+      for(unsigned int j = 0; j < m; ++j) p[j] = b + (size_t)(i + j) * m_bytes;
+      F::distances8U(a, p, (int)m, d + i);
+    }
+  }
+
+  /// updateCluster with the bit counts
+  void updateCluster(std::vector<Descriptor> &members,
+    std::vector<int> &counts, std::vector<int> &sizes, unsigned int c,
+    unsigned char *cluster, std::true_type) const
+  {
+    if(counts.empty()) counts.resize(sizes.size() * m_bytes * 8, 0);
+
+    int *count = &counts[c * m_bytes * 8];
+    MajorityVote::add(members.data(), (int)members.size(), m_bytes, count);
+    sizes[c] += (int)members.size();
+    members.clear();
+
+    F::meanValueCounts8U(count, sizes[c], cluster);
+  }
+
+  /// updateCluster with the mean of all the descriptors
+  inline void updateCluster(std::vector<Descriptor> &members,
+    std::vector<int> &, std::vector<int> &, unsigned int,
+    unsigned char *cluster, std::false_type) const
+  {
+    F::meanValue8U(members, cluster);
+  }
+
+protected:
+
+  /// Raw data of the descriptors
+  const unsigned char *m_data;
+
+  /// Number of descriptors
+  size_t m_size;
+
+  /// Bytes per descriptor
+  int m_bytes;
+};
+
+} // namespace DBoW2
+
+#endif
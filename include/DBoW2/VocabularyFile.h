@@ -0,0 +1,275 @@
+/**
+ * File: VocabularyFile.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: binary vocabulary file that can be memory-mapped and used
+ *   without parsing
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_VOCABULARY_FILE__
+#define __D_T_VOCABULARY_FILE__
+
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+namespace DBoW2 {
+
+/// Binary vocabulary file. It starts with a Header, which begins with the
+/// 4 bytes "DBVB" and a version, and has these sections, each aligned to
+/// 64 bytes:
+/// - node table: one Node per node of the tree in level order (the root
+///   first), so that the children of each node are contiguous
+/// - descriptors: raw data of the descriptor of each node (as read by
+///   F::fromArray8U), in the order of the node table. The root descriptor
+///   is all zeros
+/// - word table: index in the node table of each word
+/// - node index: index in the node table of each node id
+/// Numbers are little-endian, and weights are IEEE-754 doubles, so that the
+/// tables are used in place on little-endian hosts. The checksum is the
+/// hash of the whole file with the checksum field set to 0 (see fileHash)
+class VocabularyFile
+{
+public:
+
+  /// Version of the format
+  static const uint32_t VERSION = 1;
+
+  /// Alignment of the sections in bytes
+  static const size_t ALIGNMENT = 64;
+
+  /// Header of the file
+  struct Header
+  {
+    char magic[4];
+    uint32_t version;
+    /// Size of the header
+    uint32_t header_bytes;
+    /// Branching factor and depth levels of the tree
+    uint32_t k, L;
+    /// WeightingType and ScoringType of the vocabulary
+    uint32_t weighting, scoring;
+    /// Bytes per descriptor
+    uint32_t descriptor_bytes;
+    /// Number of nodes (root included) and of words
+    uint32_t nodes, words;
+    /// Offsets of the sections from the beginning of the file
+    uint64_t nodes_offset, descriptors_offset, words_offset, index_offset;
+    /// Size of the file
+    uint64_t file_bytes;
+    /// Hash of the file
+    uint64_t checksum;
+    uint64_t reserved;
+  };
+
+  /// Entry of the node table
+  struct Node
+  {
+    /// Node id
+    uint32_t id;
+    /// Index of the parent in the node table (0 for the root)
+    uint32_t parent;
+    /// Index of the first child in the node table
+    uint32_t first_child;
+    /// Number of children (0 if the node is a word)
+    uint32_t n_children;
+    /// Word id if the node is a word
+    uint32_t word_id;
+    uint32_t reserved;
+    /// Weight if the node is a word
+    double weight;
+  };
+
+  /**
+   * Composes the contents of a vocabulary file
+   * @param header header with the parameters of the vocabulary (k, L,
+   *   weighting, scoring and descriptor_bytes). The other fields are set
+   *   by this function
+   * @param nodes node table
+   * @param descriptors raw data of the nodes.size() descriptors
+   * @param words index in the node table of each word
+   * @param data (out) contents of the file
+   */
+  static void compose(const Header &header, const std::vector<Node> &nodes,
+    const unsigned char *descriptors, const std::vector<uint32_t> &words,
+    std::vector<unsigned char> &data);
+
+  /**
+   * Writes the contents of a vocabulary file
+   * @param filename
+   * @param data contents composed by compose
+   * @throw string if the file cannot be written
+   */
+  static void save(const std::string &filename,
+    const std::vector<unsigned char> &data);
+
+  /**
+   * Returns a 64-bit hash of some data taken as 8-byte words. Each word is
+   * multiplied into the hash and then mixed, so that every bit of a word
+   * changes the low bits of the hash. The hash of several blocks in
+   * sequence is obtained by giving the hash of the previous ones as h, if
+   * their sizes are multiple of 8
+   * @param data
+   * @param bytes
+   * @param h hash of the previous blocks
+   * @return hash
+   */
+  static uint64_t checksum(const void *data, size_t bytes,
+    uint64_t h = 14695981039346656037ULL);
+
+  /**
+   * Returns the hash of the contents of a vocabulary file: that of the
+   * whole file with the checksum field set to 0
+   * @param data contents of the file
+   * @param bytes size of the file
+   * @return hash
+   */
+  static uint64_t fileHash(const unsigned char *data, size_t bytes);
+
+  /**
+   * Returns whether a file starts as a binary vocabulary file
+   * @param filename
+   * @return true iff the file starts with the magic bytes
+   */
+  static bool isVocabularyFile(const std::string &filename);
+
+  /**
+   * Maps a vocabulary file in memory, read-only, and checks that its
+   * tables are consistent
+   * @param filename
+   * @param verify if true, the checksum is checked too, which reads the
+   *   whole file
+   * @throw string if the file cannot be read, is not a vocabulary file or
+   *   is corrupt
+   */
+  explicit VocabularyFile(const std::string &filename, bool verify = true);
+
+  /**
+   * Copies the contents of a vocabulary file from memory, and checks them
+   * @param data contents of the file
+   * @param size bytes of data
+   * @param name name for the error messages
+   * @param verify if true, the checksum is checked too
+   * @throw string if the data are not a vocabulary file or are corrupt
+   */
+  VocabularyFile(const unsigned char *data, size_t size,
+    const std::string &name, bool verify = true);
+
+  /**
+   * Unmaps the file
+   */
+  ~VocabularyFile();
+
+  /**
+   * Returns the name of the file
+   * @return filename
+   */
+  inline const std::string& filename() const
+  {
+    return m_filename;
+  }
+
+  /**
+   * Returns the contents of the file
+   * @return size() bytes
+   */
+  inline const unsigned char* data() const
+  {
+    return m_data;
+  }
+
+  /**
+   * Returns the size of the file
+   * @return bytes
+   */
+  inline size_t size() const
+  {
+    return m_size;
+  }
+
+  /**
+   * Returns the header
+   * @return header
+   */
+  inline const Header& header() const
+  {
+    return *(const Header*)m_data;
+  }
+
+  /**
+   * Returns the node table
+   * @return header().nodes nodes
+   */
+  inline const Node* nodes() const
+  {
+    return (const Node*)(m_data + header().nodes_offset);
+  }
+
+  /**
+   * Returns the raw data of the descriptor of a node
+   * @param i index in the node table
+   * @return header().descriptor_bytes bytes
+   */
+  inline const unsigned char* descriptor(uint32_t i) const
+  {
+    return m_data + header().descriptors_offset +
+      (size_t)i * header().descriptor_bytes;
+  }
+
+  /**
+   * Returns the word table
+   * @return header().words indices in the node table
+   */
+  inline const uint32_t* words() const
+  {
+    return (const uint32_t*)(m_data + header().words_offset);
+  }
+
+  /**
+   * Returns the node index
+   * @return header().nodes indices in the node table, by node id
+   */
+  inline const uint32_t* nodeIndex() const
+  {
+    return (const uint32_t*)(m_data + header().index_offset);
+  }
+
+protected:
+
+  /**
+   * Checks the header and the tables
+   * @param filename name for the error messages
+   * @param verify if true, checks the checksum too
+   * @throw string if the file is not valid
+   */
+  void check(const std::string &filename, bool verify) const;
+
+protected:
+
+  /// Name of the file
+  std::string m_filename;
+
+  /// Data of the file
+  const unsigned char *m_data;
+
+  /// Size of the file
+  size_t m_size;
+
+  /// Whether m_data is a mapping of the file, or points to m_buffer
+  bool m_mapped;
+
+  /// Contents of the file if it cannot be mapped
+  std::vector<uint64_t> m_buffer;
+
+private:
+
+  VocabularyFile(const VocabularyFile &);
+  VocabularyFile& operator=(const VocabularyFile &);
+};
+
+} // namespace DBoW2
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * File: WordOccupancy.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: distribution of a set of descriptors among the words of
+ *   a vocabulary
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_WORD_OCCUPANCY__
+#define __D_T_WORD_OCCUPANCY__
+
+#include <iostream>
+#include <vector>
+
+namespace DBoW2 {
+
+/// Distribution of a set of descriptors among the words of a vocabulary, 
+/// which tells how long the inverted rows of a database with those images
+/// are, and how much quantization error the words have. Computing it for 
+/// the training images of two vocabularies (e.g. with and without balanced
+/// clusters) shows how the word frequencies changed
+class WordOccupancy
+{
+public:
+
+  /// Words of the vocabulary
+  unsigned int words;
+  
+  /// Words that no descriptor is quantized to
+  unsigned int empty_words;
+  
+  /// Number of descriptors
+  unsigned long long descriptors;
+  
+  /// Number of images
+  unsigned int images;
+  
+  /// Descriptors of the most frequent word
+  unsigned int max_descriptors;
+  
+  /// Mean descriptors per word
+  double mean_descriptors;
+  
+  /// Gini coefficient of the descriptors per word: 0 if all the words have
+  /// the same number of descriptors, close to 1 if a few words have most
+  double gini;
+  
+  /// Images the most common word is in: length of the longest inverted row
+  /// of a database with these images
+  unsigned int max_images;
+  
+  /// Mean images per word: mean length of the inverted rows
+  double mean_images;
+  
+  /// Mean length of the inverted rows visited by the words of a query 
+  /// whose descriptors are distributed as these: sum_w(n_w * N_w) / n, 
+  /// where n_w is the number of descriptors of word w and N_w the number 
+  /// of images it is in. It is proportional to the query time
+  double expected_images;
+  
+  /// Mean distance from the descriptors to their words
+  double mean_distance;
+
+  /**
+   * Empty distribution
+   */
+  WordOccupancy();
+  
+  /**
+   * Computes the distribution from the occurrences of each word
+   * @param word_descriptors number of descriptors of each word
+   * @param word_images number of images each word is in
+   * @param images number of images
+   * @param distance_sum sum of the distances from the descriptors to their
+   *   words
+   */
+  void compute(const std::vector<unsigned int> &word_descriptors, 
+    const std::vector<unsigned int> &word_images, unsigned int images,
+    double distance_sum);
+  
+  /**
+   * Prints this distribution next to a previous one, with the relative
+   * change of each value
+   * @param os stream
+   * @param before previous distribution, e.g. of the same images with
+   *   another vocabulary
+   */
+  void printChange(std::ostream &os, const WordOccupancy &before) const;
+
+  /**
+   * Prints the distribution
+   * @param os stream
+   * @param occupancy
+   */
+  friend std::ostream& operator<<(std::ostream &os, 
+    const WordOccupancy &occupancy);
+};
+
+} // namespace DBoW2
+
+#endif
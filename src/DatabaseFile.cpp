@@ -0,0 +1,471 @@
+/**
+ * File: DatabaseFile.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: binary snapshot of the indexes of a database
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "DatabaseFile.h"
+#include "VocabularyFile.h"
+
+using namespace std;
+
+namespace DBoW2 {
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+const char DATABASE_MAGIC[4] = { 'D', 'B', 'D', 'B' };
+
+/// Flags of the header
+const uint32_t COMPRESSED = 1;
+const uint32_t DIRECT_INDEX = 2;
+const uint32_t EMBEDDED_VOCABULARY = 4;
+
+/// Header of the file
+struct Header
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t entries;
+  uint32_t words;
+  int32_t di_levels;
+  uint64_t vocabulary_hash;
+  uint64_t checksum;
+  uint32_t first_entry;
+  uint32_t generation;
+};
+
+/// Returns whether the arrays can be written and read as they are in
+/// memory in this host
+bool littleEndian()
+{
+  const uint16_t one = 1;
+  return *(const unsigned char *)&one == 1;
+}
+
+/// Writes the data of a file (or the entries of a directory) to the disk
+bool syncFile(const string &filename)
+{
+#ifdef _WIN32
+  HANDLE h = CreateFileA(filename.c_str(), GENERIC_WRITE, 0, NULL,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if(h == INVALID_HANDLE_VALUE) return false;
+  const bool ok = FlushFileBuffers(h) != 0;
+  CloseHandle(h);
+  return ok;
+#else
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0) return false;
+  const bool ok = fsync(fd) == 0;
+  close(fd);
+  return ok;
+#endif
+}
+
+/// Appends the differences between consecutive values in a variable-length
+/// code: 7 bits per byte, with the high bit set in all the bytes of a value
+/// but the last one. Differences are zigzag-encoded to be non-negative
+void encode(const vector<uint32_t> &values, vector<unsigned char> &data)
+{
+  data.clear();
+  data.reserve(values.size() * 2);
+
+  int64_t previous = 0;
+  for(size_t i = 0; i < values.size(); ++i)
+  {
+    const int64_t d = (int64_t)values[i] - previous;
+    previous = values[i];
+
+    uint64_t z = ((uint64_t)d << 1) ^ (uint64_t)(d >> 63);
+    while(z >= 0x80)
+    {
+      data.push_back((unsigned char)(z | 0x80));
+      z >>= 7;
+    }
+    data.push_back((unsigned char)z);
+  }
+}
+
+/// Decodes n values written by encode
+/// @return false if the data do not have exactly n values
+bool decode(const vector<unsigned char> &data, size_t n,
+  vector<uint32_t> &values)
+{
+  values.resize(n);
+
+  const unsigned char *p = data.data();
+  const unsigned char *end = p + data.size();
+
+  int64_t previous = 0;
+  for(size_t i = 0; i < n; ++i)
+  {
+    uint64_t z = 0;
+    for(int shift = 0; ; shift += 7)
+    {
+      if(p == end || shift > 63) return false;
+      z |= (uint64_t)(*p & 0x7f) << shift;
+      if(!(*p++ & 0x80)) break;
+    }
+
+    const int64_t d = (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+    previous += d;
+    if(previous < 0 || previous > 0xffffffffLL) return false;
+    values[i] = (uint32_t)previous;
+  }
+  return p == end;
+}
+
+/// Writes the sections of a file, hashing them
+class SectionWriter
+{
+public:
+
+  SectionWriter(FILE *f, uint64_t h): m_file(f), m_hash(h), m_ok(true) {}
+
+  /// Writes a section of n items
+  void write(uint64_t n, const void *data, uint64_t bytes)
+  {
+    const uint64_t sizes[2] = { n, bytes };
+    put(sizes, sizeof(sizes));
+    put(data, bytes);
+
+    const unsigned char padding[8] = { 0 };
+    put(padding, (8 - bytes % 8) % 8);
+  }
+
+  /// Writes an integer section, compressed or not
+  void write(const vector<uint32_t> &values, bool compress)
+  {
+    if(compress)
+    {
+      vector<unsigned char> data;
+      encode(values, data);
+      write(values.size(), data.data(), data.size());
+    }
+    else
+    {
+      write(values.size(), values.data(), values.size() * sizeof(uint32_t));
+    }
+  }
+
+  bool ok() const { return m_ok; }
+  uint64_t hash() const { return m_hash; }
+
+protected:
+
+  void put(const void *data, size_t bytes)
+  {
+    if(bytes == 0) return;
+    m_hash = VocabularyFile::checksum(data, bytes, m_hash);
+    m_ok = m_ok && fwrite(data, 1, bytes, m_file) == bytes;
+  }
+
+  FILE *m_file;
+  uint64_t m_hash;
+  bool m_ok;
+};
+
+/// Reads the sections of a file into preallocated arrays, hashing them
+class SectionReader
+{
+public:
+
+  SectionReader(FILE *f, uint64_t size, uint64_t h, const string &corrupt)
+    : m_file(f), m_left(size), m_hash(h), m_corrupt(corrupt) {}
+
+  /// Reads a section of items of some size, as they are stored
+  template<class T>
+  void read(vector<T> &values)
+  {
+    uint64_t n, bytes;
+    header(n, bytes);
+    if(n > bytes / sizeof(T) || bytes != n * sizeof(T)) throw m_corrupt;
+
+    values.resize(n);
+    get(values.data(), bytes);
+    padding(bytes);
+  }
+
+  /// Reads an integer section, compressed or not
+  void read(vector<uint32_t> &values, bool compressed)
+  {
+    if(!compressed)
+    {
+      read(values);
+      return;
+    }
+
+    uint64_t n, bytes;
+    header(n, bytes);
+    if(n > bytes) throw m_corrupt; // at least 1 byte per value
+
+    vector<unsigned char> data(bytes);
+    get(data.data(), bytes);
+    padding(bytes);
+
+    if(!decode(data, n, values)) throw m_corrupt;
+  }
+
+  uint64_t hash() const { return m_hash; }
+
+protected:
+
+  void header(uint64_t &n, uint64_t &bytes)
+  {
+    uint64_t sizes[2];
+    get(sizes, sizeof(sizes));
+    n = sizes[0];
+    bytes = sizes[1];
+
+    // the sizes are checked before allocating anything
+    if(bytes > m_left) throw m_corrupt;
+  }
+
+  void padding(uint64_t bytes)
+  {
+    unsigned char padding[8];
+    get(padding, (8 - bytes % 8) % 8);
+  }
+
+  void get(void *data, uint64_t bytes)
+  {
+    if(bytes == 0) return;
+    if(bytes > m_left || fread(data, 1, bytes, m_file) != bytes)
+      throw m_corrupt;
+    m_left -= bytes;
+    m_hash = VocabularyFile::checksum(data, bytes, m_hash);
+  }
+
+  FILE *m_file;
+  uint64_t m_left;
+  uint64_t m_hash;
+  string m_corrupt;
+};
+
+/// Returns the sum of some counts
+uint64_t sum(const vector<uint32_t> &counts)
+{
+  uint64_t s = 0;
+  for(size_t i = 0; i < counts.size(); ++i) s += counts[i];
+  return s;
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+DatabaseFile::DatabaseFile()
+  : entries(0), first_entry(0), generation(0), direct_index(false),
+  di_levels(0), vocabulary_hash(0)
+{
+}
+
+// --------------------------------------------------------------------------
+
+void DatabaseFile::save(const std::string &filename, bool compress) const
+{
+  if(!littleEndian())
+    throw string("Binary databases need a little-endian host");
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, DATABASE_MAGIC, 4);
+  header.version = VERSION;
+  header.flags = (compress ? COMPRESSED : 0) |
+    (direct_index ? DIRECT_INDEX : 0) |
+    (vocabulary.empty() ? 0 : EMBEDDED_VOCABULARY);
+  header.entries = entries;
+  header.first_entry = first_entry;
+  header.generation = generation;
+  header.words = word_items.size();
+  header.di_levels = di_levels;
+  header.vocabulary_hash = vocabulary_hash;
+
+  FILE *f = fopen(filename.c_str(), "wb");
+  if(!f) throw string("Could not open file ") + filename;
+
+  // the header is written again with the checksum at the end
+  SectionWriter writer(f, VocabularyFile::checksum(&header, sizeof(header)));
+  bool ok = (fwrite(&header, 1, sizeof(header), f) == sizeof(header));
+
+  writer.write(vocabulary.size(), vocabulary.data(), vocabulary.size());
+  writer.write(word_items, compress);
+  writer.write(item_entries, compress);
+  writer.write(item_weights.size(), item_weights.data(),
+    item_weights.size() * sizeof(double));
+  writer.write(entry_nodes, compress);
+  writer.write(node_ids, compress);
+  writer.write(node_features, compress);
+  writer.write(features, compress);
+  writer.write(removed_entries, compress);
+
+  header.checksum = writer.hash();
+  ok = ok && writer.ok() && fseek(f, 0, SEEK_SET) == 0 &&
+    fwrite(&header, 1, sizeof(header), f) == sizeof(header);
+
+  if(fclose(f) != 0 || !ok)
+    throw string("Could not write file ") + filename;
+}
+
+// --------------------------------------------------------------------------
+
+void DatabaseFile::load(const std::string &filename)
+{
+  FILE *f = fopen(filename.c_str(), "rb");
+  if(!f) throw string("Could not open file ") + filename;
+
+  fseek(f, 0, SEEK_END);
+  const long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  Header header;
+  if(size < (long)sizeof(header) ||
+    fread(&header, 1, sizeof(header), f) != sizeof(header) ||
+    !equal(header.magic, header.magic + 4, DATABASE_MAGIC))
+  {
+    fclose(f);
+    throw filename + " is not a binary database";
+  }
+
+  if(header.version != VERSION)
+  {
+    fclose(f);
+    throw string("Unsupported version of binary database ") + filename;
+  }
+
+  if(!littleEndian())
+  {
+    fclose(f);
+    throw string("Binary databases need a little-endian host");
+  }
+
+  const string corrupt = string("Binary database ") + filename +
+    " is corrupt";
+
+  const uint64_t checksum = header.checksum;
+  header.checksum = 0;
+
+  const bool compressed = (header.flags & COMPRESSED) != 0;
+  SectionReader reader(f, size - sizeof(header),
+    VocabularyFile::checksum(&header, sizeof(header)), corrupt);
+
+  try
+  {
+    reader.read(vocabulary);
+    reader.read(word_items, compressed);
+    reader.read(item_entries, compressed);
+    reader.read(item_weights);
+    reader.read(entry_nodes, compressed);
+    reader.read(node_ids, compressed);
+    reader.read(node_features, compressed);
+    reader.read(features, compressed);
+    reader.read(removed_entries, compressed);
+  }
+  catch(...)
+  {
+    fclose(f);
+    throw;
+  }
+  fclose(f);
+
+  entries = header.entries;
+  first_entry = header.first_entry;
+  generation = header.generation;
+  direct_index = (header.flags & DIRECT_INDEX) != 0;
+  di_levels = header.di_levels;
+  vocabulary_hash = header.vocabulary_hash;
+
+  if(reader.hash() != checksum || first_entry > entries ||
+    ((header.flags & EMBEDDED_VOCABULARY) != 0) == vocabulary.empty() ||
+    word_items.size() != header.words ||
+    sum(word_items) != item_entries.size() ||
+    item_weights.size() != item_entries.size() ||
+    entry_nodes.size() != (direct_index ? entries - first_entry : 0) ||
+    sum(entry_nodes) != node_ids.size() ||
+    node_features.size() != node_ids.size() ||
+    sum(node_features) != features.size())
+  {
+    throw corrupt;
+  }
+
+  // the rows of the inverted index are searched by entry id, so their
+  // ids must be ascending
+  size_t begin = 0;
+  for(size_t w = 0; w < word_items.size(); ++w)
+  {
+    const size_t end = begin + word_items[w];
+    for(size_t i = begin; i < end; ++i)
+    {
+      if(item_entries[i] < first_entry || item_entries[i] >= entries ||
+        (i > begin && item_entries[i] <= item_entries[i-1]))
+      {
+        throw corrupt;
+      }
+    }
+    begin = end;
+  }
+
+  for(size_t i = 0; i < removed_entries.size(); ++i)
+  {
+    if(removed_entries[i] < first_entry || removed_entries[i] >= entries ||
+      (i > 0 && removed_entries[i] <= removed_entries[i-1])) throw corrupt;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+bool DatabaseFile::isDatabaseFile(const std::string &filename)
+{
+  FILE *f = fopen(filename.c_str(), "rb");
+  if(!f) return false;
+
+  char magic[4];
+  const bool ok = (fread(magic, 1, 4, f) == 4 &&
+    equal(magic, magic + 4, DATABASE_MAGIC));
+  fclose(f);
+  return ok;
+}
+
+// --------------------------------------------------------------------------
+
+void DatabaseFile::replace(const std::string &from, const std::string &to)
+{
+  // otherwise a crash could leave the renamed file without its data
+  if(!syncFile(from)) throw string("Could not write file ") + from;
+
+#ifdef _WIN32
+  // rename does not replace existing files. The move is written through
+  const bool ok = MoveFileExA(from.c_str(), to.c_str(),
+    MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  // the rename is written to the disk with the entries of the directory
+  const size_t slash = to.find_last_of('/');
+  const string dir = (slash == string::npos ? string(".") :
+    to.substr(0, slash + 1));
+  const bool ok = rename(from.c_str(), to.c_str()) == 0 && syncFile(dir);
+#endif
+  if(!ok) throw string("Could not replace file ") + to;
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
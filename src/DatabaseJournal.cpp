@@ -0,0 +1,429 @@
+/**
+ * File: DatabaseJournal.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: append-only journal of the entries added to a database
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "DatabaseJournal.h"
+#include "VocabularyFile.h"
+
+using namespace std;
+
+namespace DBoW2 {
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+const char JOURNAL_MAGIC[4] = { 'D', 'B', 'W', 'L' };
+
+/// Flags of the header
+const uint32_t DIRECT_INDEX = 1;
+
+/// Types of record
+const uint32_t ADD_ENTRY = 1;
+const uint32_t REMOVE_ENTRY = 2;
+
+/// Header of the file
+struct Header
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t vocabulary_hash;
+  uint32_t flags;
+  int32_t di_levels;
+  uint32_t generation;
+  uint32_t reserved;
+};
+
+/// Header of a record, which is followed by its data and its checksum
+struct Record
+{
+  uint32_t type;
+  uint32_t entry_id;
+  uint32_t words;
+  uint32_t nodes;
+  uint32_t features;
+  uint32_t reserved;
+};
+
+/// Returns whether the records can be written and read as they are in
+/// memory in this host
+bool littleEndian()
+{
+  const uint16_t one = 1;
+  return *(const unsigned char *)&one == 1;
+}
+
+/// Returns the size of the data of a record, without header nor checksum
+inline uint64_t dataBytes(const Record &r)
+{
+  return (uint64_t)r.words * (sizeof(double) + sizeof(uint32_t)) +
+    (uint64_t)r.nodes * 2 * sizeof(uint32_t) +
+    (uint64_t)r.features * sizeof(uint32_t);
+}
+
+/// Appends some bytes to a buffer
+inline unsigned char* put(unsigned char *p, const void *data, size_t bytes)
+{
+  memcpy(p, data, bytes);
+  return p + bytes;
+}
+
+/// Reads some bytes from a buffer
+inline const unsigned char* get(const unsigned char *p, void *data,
+  size_t bytes)
+{
+  memcpy(data, p, bytes);
+  return p + bytes;
+}
+
+/// Writes the data of a file to the disk
+bool syncFile(FILE *f)
+{
+#ifdef _WIN32
+  return _commit(_fileno(f)) == 0;
+#else
+  return fsync(fileno(f)) == 0;
+#endif
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+DatabaseJournal::DatabaseJournal()
+  : m_file(NULL), m_size(0), m_direct_index(false), m_sync(false)
+{
+}
+
+// --------------------------------------------------------------------------
+
+DatabaseJournal::~DatabaseJournal()
+{
+  close();
+}
+
+// --------------------------------------------------------------------------
+
+void DatabaseJournal::close()
+{
+  if(m_file)
+  {
+    fclose(m_file);
+    m_file = NULL;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+void DatabaseJournal::open(const std::string &filename,
+  uint64_t vocabulary_hash, bool direct_index, int di_levels,
+  uint32_t generation, const Replay &replay,
+  const ReplayRemoval &replay_removal, bool sync)
+{
+  close();
+
+  if(!littleEndian())
+    throw string("Database journals need a little-endian host");
+
+  m_filename = filename;
+  m_direct_index = direct_index;
+  m_sync = sync;
+  m_size = 0;
+
+  m_file = fopen(filename.c_str(), "r+b");
+  if(!m_file) m_file = fopen(filename.c_str(), "w+b");
+  if(!m_file) throw string("Could not open file ") + filename;
+
+  fseek(m_file, 0, SEEK_END);
+  const uint64_t size = ftell(m_file);
+  fseek(m_file, 0, SEEK_SET);
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, JOURNAL_MAGIC, 4);
+  header.version = VERSION;
+  header.vocabulary_hash = vocabulary_hash;
+  header.flags = (direct_index ? DIRECT_INDEX : 0);
+  header.di_levels = di_levels;
+  header.generation = generation;
+
+  if(size == 0)
+  {
+    // new journal
+    m_buffer.assign((const unsigned char *)&header,
+      (const unsigned char *)&header + sizeof(header));
+    write();
+    return;
+  }
+
+  Header file_header;
+  if(size < sizeof(file_header) ||
+    fread(&file_header, 1, sizeof(file_header), m_file) !=
+      sizeof(file_header) ||
+    !equal(file_header.magic, file_header.magic + 4, JOURNAL_MAGIC))
+  {
+    close();
+    throw filename + " is not a database journal";
+  }
+
+  if(file_header.version != VERSION)
+  {
+    close();
+    throw string("Unsupported version of database journal ") + filename;
+  }
+
+  if(memcmp(&file_header, &header, offsetof(Header, generation)) != 0)
+  {
+    close();
+    throw string("Journal ") + filename + " was written by a database "
+      "with other vocabulary or parameters";
+  }
+
+  // the ids of the records do not match those of the database if they
+  // were renumbered after the journal was written
+  if(file_header.generation != generation)
+  {
+    close();
+    throw string("Journal ") + filename + " does not continue the "
+      "database, whose entries were renumbered";
+  }
+
+  // the records are read until the end or an incomplete one
+  m_size = sizeof(header);
+
+  BowVector v;
+  FeatureVector fv;
+  Record r;
+
+  while(m_size + sizeof(r) <= size &&
+    fread(&r, 1, sizeof(r), m_file) == sizeof(r))
+  {
+    const uint64_t bytes = dataBytes(r) + sizeof(uint64_t);
+    if((r.type != ADD_ENTRY && r.type != REMOVE_ENTRY) ||
+      (r.type == REMOVE_ENTRY && dataBytes(r) > 0) ||
+      (!direct_index && r.nodes > 0) ||
+      bytes > size - m_size - sizeof(r))
+    {
+      break;
+    }
+
+    m_buffer.resize(sizeof(r) + bytes);
+    memcpy(m_buffer.data(), &r, sizeof(r));
+    if(fread(m_buffer.data() + sizeof(r), 1, bytes, m_file) != bytes) break;
+
+    uint64_t checksum;
+    memcpy(&checksum, m_buffer.data() + m_buffer.size() - sizeof(checksum),
+      sizeof(checksum));
+    if(VocabularyFile::checksum(m_buffer.data(),
+      m_buffer.size() - sizeof(checksum)) != checksum) break;
+
+    if(r.type == REMOVE_ENTRY)
+    {
+      try
+      {
+        replay_removal(r.entry_id);
+      }
+      catch(...)
+      {
+        close();
+        throw;
+      }
+
+      m_size += m_buffer.size();
+      continue;
+    }
+
+    const unsigned char *weights = m_buffer.data() + sizeof(r);
+    const unsigned char *words = weights + r.words * sizeof(double);
+    const unsigned char *nodes = words + r.words * sizeof(uint32_t);
+    const unsigned char *counts = nodes + r.nodes * sizeof(uint32_t);
+    const unsigned char *features = counts + r.nodes * sizeof(uint32_t);
+
+    v.clear();
+    for(uint32_t i = 0; i < r.words; ++i)
+    {
+      WordValue value;
+      uint32_t word;
+      weights = get(weights, &value, sizeof(value));
+      words = get(words, &word, sizeof(word));
+      v.insert(v.end(), make_pair(word, value));
+    }
+
+    fv.clear();
+    uint64_t total = 0;
+    for(uint32_t i = 0; i < r.nodes; ++i)
+    {
+      uint32_t node, n;
+      nodes = get(nodes, &node, sizeof(node));
+      counts = get(counts, &n, sizeof(n));
+
+      total += n;
+      if(total > r.features) break;
+
+      FeatureVector::iterator fit = fv.insert(fv.end(),
+        make_pair(node, std::vector<unsigned int>(n)));
+      features = get(features, fit->second.data(), n * sizeof(uint32_t));
+    }
+    if(total != r.features) break;
+
+    try
+    {
+      replay(r.entry_id, v, fv);
+    }
+    catch(...)
+    {
+      close();
+      throw;
+    }
+
+    m_size += m_buffer.size();
+  }
+
+  if(m_size < size && !truncate(m_size))
+  {
+    close();
+    throw string("Could not truncate file ") + filename;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+void DatabaseJournal::append(EntryId id, const BowVector &v,
+  const FeatureVector &fv)
+{
+  if(!m_file) throw string("The database journal is not open");
+
+  Record r;
+  memset(&r, 0, sizeof(r));
+  r.type = ADD_ENTRY;
+  r.entry_id = id;
+  r.words = v.size();
+
+  FeatureVector::const_iterator fit;
+  if(m_direct_index)
+  {
+    r.nodes = fv.size();
+    for(fit = fv.begin(); fit != fv.end(); ++fit)
+      r.features += fit->second.size();
+  }
+
+  m_buffer.resize(sizeof(r) + dataBytes(r) + sizeof(uint64_t));
+
+  unsigned char *weights = put(m_buffer.data(), &r, sizeof(r));
+  unsigned char *words = weights + r.words * sizeof(double);
+  unsigned char *nodes = words + r.words * sizeof(uint32_t);
+  unsigned char *counts = nodes + r.nodes * sizeof(uint32_t);
+  unsigned char *features = counts + r.nodes * sizeof(uint32_t);
+
+  BowVector::const_iterator vit;
+  for(vit = v.begin(); vit != v.end(); ++vit)
+  {
+    const uint32_t word = vit->first;
+    weights = put(weights, &vit->second, sizeof(double));
+    words = put(words, &word, sizeof(word));
+  }
+
+  if(m_direct_index)
+  {
+    for(fit = fv.begin(); fit != fv.end(); ++fit)
+    {
+      const uint32_t node = fit->first;
+      const uint32_t n = fit->second.size();
+      nodes = put(nodes, &node, sizeof(node));
+      counts = put(counts, &n, sizeof(n));
+      features = put(features, fit->second.data(), n * sizeof(uint32_t));
+    }
+  }
+
+  const uint64_t checksum = VocabularyFile::checksum(m_buffer.data(),
+    m_buffer.size() - sizeof(checksum));
+  put(features, &checksum, sizeof(checksum));
+
+  write();
+}
+
+// --------------------------------------------------------------------------
+
+void DatabaseJournal::appendRemoval(EntryId id)
+{
+  if(!m_file) throw string("The database journal is not open");
+
+  Record r;
+  memset(&r, 0, sizeof(r));
+  r.type = REMOVE_ENTRY;
+  r.entry_id = id;
+
+  m_buffer.resize(sizeof(r) + sizeof(uint64_t));
+  unsigned char *p = put(m_buffer.data(), &r, sizeof(r));
+
+  const uint64_t checksum = VocabularyFile::checksum(m_buffer.data(),
+    sizeof(r));
+  put(p, &checksum, sizeof(checksum));
+
+  write();
+}
+
+// --------------------------------------------------------------------------
+
+void DatabaseJournal::write()
+{
+  const bool ok = fseek(m_file, m_size, SEEK_SET) == 0 &&
+    fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) == m_buffer.size() &&
+    fflush(m_file) == 0 && (!m_sync || syncFile(m_file));
+
+  if(!ok)
+  {
+    // a partial record would hide the next ones
+    truncate(m_size);
+    throw string("Could not write file ") + m_filename;
+  }
+
+  m_size += m_buffer.size();
+}
+
+// --------------------------------------------------------------------------
+
+void DatabaseJournal::reset()
+{
+  if(!m_file) throw string("The database journal is not open");
+
+  if(!truncate(sizeof(Header)) || (m_sync && !syncFile(m_file)))
+    throw string("Could not truncate file ") + m_filename;
+
+  m_size = sizeof(Header);
+}
+
+// --------------------------------------------------------------------------
+
+bool DatabaseJournal::truncate(uint64_t size)
+{
+  fflush(m_file);
+#ifdef _WIN32
+  return _chsize_s(_fileno(m_file), size) == 0;
+#else
+  return ftruncate(fileno(m_file), size) == 0;
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
@@ -0,0 +1,224 @@
+/**
+ * File: DescriptorReader.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: sources of training descriptors read from disk or from a 
+ *   callback, and temporary files to train vocabularies out of core
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <cstdio>
+#include <string>
+#include <sstream>
+#include <atomic>
+#include <algorithm>
+#include <random>
+#include <stdint.h>
+
+#include "DescriptorReader.h"
+
+using namespace std;
+
+namespace DBoW2 {
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+const char SHARD_MAGIC[4] = { 'D', 'B', 'S', 'H' };
+
+/// Writes a 32-bit little-endian number
+bool writeU32(FILE *f, uint32_t v)
+{
+  unsigned char b[4] = { (unsigned char)v, (unsigned char)(v >> 8),
+    (unsigned char)(v >> 16), (unsigned char)(v >> 24) };
+  return fwrite(b, 1, 4, f) == 4;
+}
+
+/// Reads a 32-bit little-endian number
+bool readU32(FILE *f, uint32_t &v)
+{
+  unsigned char b[4];
+  if(fread(b, 1, 4, f) != 4) return false;
+  v = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) |
+    ((uint32_t)b[3] << 24);
+  return true;
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+ShardReader::ShardReader(const std::vector<std::string> &files, 
+  int descriptor_bytes)
+  : m_files(files), m_bytes(descriptor_bytes), m_current(0), m_file(NULL)
+{
+}
+
+// --------------------------------------------------------------------------
+
+ShardReader::~ShardReader()
+{
+  if(m_file) fclose(m_file);
+}
+
+// --------------------------------------------------------------------------
+
+void ShardReader::rewind()
+{
+  if(m_file) fclose(m_file);
+  m_file = NULL;
+  m_current = 0;
+}
+
+// --------------------------------------------------------------------------
+
+void ShardReader::open(size_t i)
+{
+  m_file = fopen(m_files[i].c_str(), "rb");
+  if(!m_file) throw string("Could not open file ") + m_files[i];
+  
+  char magic[4];
+  uint32_t bytes;
+  if(fread(magic, 1, 4, m_file) != 4 || 
+    !equal(magic, magic + 4, SHARD_MAGIC) || !readU32(m_file, bytes))
+  {
+    throw m_files[i] + " is not a descriptor shard";
+  }
+  
+  if((int)bytes != m_bytes)
+  {
+    stringstream ss;
+    ss << m_files[i] << " has descriptors of " << bytes 
+      << " bytes instead of " << m_bytes;
+    throw ss.str();
+  }
+}
+
+// --------------------------------------------------------------------------
+
+bool ShardReader::next(std::vector<unsigned char> &descriptors)
+{
+  while(m_current < m_files.size())
+  {
+    if(!m_file) open(m_current);
+    
+    uint32_t n;
+    if(readU32(m_file, n))
+    {
+      descriptors.resize((size_t)n * m_bytes);
+      if(fread(descriptors.data(), 1, descriptors.size(), m_file) != 
+        descriptors.size())
+      {
+        throw string("Unexpected end of file ") + m_files[m_current];
+      }
+      return true;
+    }
+    
+    // end of this shard
+    fclose(m_file);
+    m_file = NULL;
+    ++m_current;
+  }
+  
+  descriptors.clear();
+  return false;
+}
+
+// --------------------------------------------------------------------------
+
+ShardWriter::ShardWriter(const std::string &filename, int descriptor_bytes)
+  : m_bytes(descriptor_bytes)
+{
+  m_file = fopen(filename.c_str(), "wb");
+  if(!m_file) throw string("Could not open file ") + filename;
+  
+  if(fwrite(SHARD_MAGIC, 1, 4, m_file) != 4 || 
+    !writeU32(m_file, (uint32_t)descriptor_bytes))
+  {
+    fclose(m_file);
+    throw string("Could not write file ") + filename;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+ShardWriter::~ShardWriter()
+{
+  fclose(m_file);
+}
+
+// --------------------------------------------------------------------------
+
+void ShardWriter::add(const unsigned char *descriptors, int n)
+{
+  const size_t bytes = (size_t)n * m_bytes;
+  if(!writeU32(m_file, (uint32_t)n) || 
+    fwrite(descriptors, 1, bytes, m_file) != bytes)
+  {
+    throw string("Could not write descriptor shard");
+  }
+}
+
+// --------------------------------------------------------------------------
+
+SpillFile::SpillFile(const std::string &directory)
+{
+  if(directory.empty())
+  {
+    m_file = tmpfile();
+    if(!m_file) throw string("Could not create a temporary file");
+  }
+  else
+  {
+    static std::atomic<unsigned int> counter(0);
+    std::random_device rd;
+    
+    stringstream ss;
+    ss << directory << "/dbow2-" << std::hex << rd() << "-" << counter++ 
+      << ".tmp";
+    m_path = ss.str();
+    
+    m_file = fopen(m_path.c_str(), "w+b");
+    if(!m_file) throw string("Could not create file ") + m_path;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+SpillFile::~SpillFile()
+{
+  fclose(m_file);
+  if(!m_path.empty()) remove(m_path.c_str());
+}
+
+// --------------------------------------------------------------------------
+
+void SpillFile::write(const void *data, size_t bytes)
+{
+  if(fwrite(data, 1, bytes, m_file) != bytes)
+  {
+    throw string("Could not write temporary file ") + m_path;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+void SpillFile::rewind()
+{
+  fflush(m_file);
+  fseek(m_file, 0, SEEK_SET);
+}
+
+// --------------------------------------------------------------------------
+
+size_t SpillFile::read(void *data, size_t bytes)
+{
+  return fread(data, 1, bytes, m_file);
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
+
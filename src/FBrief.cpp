@@ -8,10 +8,15 @@
  */
  
 #include <vector>
+#include <cstring>
 #include <string>
 #include <sstream>
+#include <algorithm>
+#include <stdint.h>
 
 #include "FBrief.h"
+#include "HammingDistance.h"
+#include "MajorityVote.h"
 
 using namespace std;
 
@@ -28,6 +33,23 @@ void FBrief::meanValue(const std::vector<FBrief::pDescriptor> &descriptors,
   
   const int N2 = descriptors.size() / 2;
   
+  // the majority of each bit does not depend on where it is stored, so it
+  // can be computed on the memory of the bitsets when there is no padding
+  if(sizeof(FBrief::TDescriptor) * 8 == FBrief::L)
+  {
+    vector<const unsigned char *> data(descriptors.size());
+    for(size_t i = 0; i < descriptors.size(); ++i)
+    {
+      data[i] = reinterpret_cast<const unsigned char*>(descriptors[i]);
+    }
+    
+    unsigned char result[sizeof(FBrief::TDescriptor)];
+    MajorityVote::majority(&data[0], (int)data.size(), 
+      sizeof(FBrief::TDescriptor), N2 + 1, result);
+    memcpy(static_cast<void*>(&mean), result, sizeof(FBrief::TDescriptor));
+    return;
+  }
+  
   vector<int> counters(FBrief::L, 0);
 
   vector<FBrief::pDescriptor>::const_iterator it;
@@ -47,6 +69,37 @@ void FBrief::meanValue(const std::vector<FBrief::pDescriptor> &descriptors,
   
 }
 
+// --------------------------------------------------------------------------
+
+void FBrief::meanValue8U(const std::vector<const unsigned char *> &descriptors,
+  unsigned char *mean)
+{
+  if(descriptors.empty())
+  {
+    fill(mean, mean + FBrief::L / 8, 0);
+    return;
+  }
+  
+  // a bit is set if more than half of the descriptors have it
+  const int N2 = descriptors.size() / 2;
+  
+  MajorityVote::majority(&descriptors[0], (int)descriptors.size(), 
+    FBrief::L / 8, N2 + 1, mean);
+}
+
+// --------------------------------------------------------------------------
+
+void FBrief::meanValueCounts8U(const int *counts, int n, unsigned char *mean)
+{
+  if(n == 0)
+  {
+    fill(mean, mean + FBrief::L / 8, 0);
+    return;
+  }
+  
+  MajorityVote::majority(counts, FBrief::L / 8, n / 2 + 1, mean);
+}
+
 // --------------------------------------------------------------------------
   
 double FBrief::distance(const FBrief::TDescriptor &a, 
@@ -55,6 +108,74 @@ double FBrief::distance(const FBrief::TDescriptor &a,
   return (double)(a^b).count();
 }
 
+// --------------------------------------------------------------------------
+
+void FBrief::distances(const FBrief::TDescriptor &a, 
+  const FBrief::TDescriptor *b, int n, double *d)
+{
+  // the bits of a bitset are stored in its words, so the distance of two
+  // bitsets is the distance of their memory when there is no padding
+  if(sizeof(FBrief::TDescriptor) * 8 == FBrief::L && 
+    (FBrief::L / 8) % 8 == 0)
+  {
+    const int CHUNK = 64;
+    int dist[CHUNK];
+    
+    const unsigned char *pa = reinterpret_cast<const unsigned char*>(&a);
+    
+    for(int i = 0; i < n; i += CHUNK)
+    {
+      const int m = (n - i < CHUNK ? n - i : CHUNK);
+      
+      HammingDistance::distances(pa, 
+        reinterpret_cast<const unsigned char*>(b + i), 
+        sizeof(FBrief::TDescriptor), m, FBrief::L / 8, dist);
+      
+      for(int j = 0; j < m; ++j) d[i + j] = static_cast<double>(dist[j]);
+    }
+  }
+  else
+  {
+    for(int i = 0; i < n; ++i) d[i] = distance(a, b[i]);
+  }
+}
+
+// --------------------------------------------------------------------------
+
+void FBrief::distances8U(const unsigned char *a, 
+  const unsigned char *const *b, int n, double *d)
+{
+  const int CHUNK = 64;
+  int dist[CHUNK];
+  
+  for(int i = 0; i < n; i += CHUNK)
+  {
+    const int m = (n - i < CHUNK ? n - i : CHUNK);
+    
+    HammingDistance::distances(a, b + i, m, FBrief::L / 8, dist);
+    
+    for(int j = 0; j < m; ++j) d[i + j] = static_cast<double>(dist[j]);
+  }
+}
+
+// --------------------------------------------------------------------------
+
+void FBrief::distances8U(const unsigned char *a, const unsigned char *b,
+  size_t stride, int n, double *d)
+{
+  const int CHUNK = 64;
+  int dist[CHUNK];
+  
+  for(int i = 0; i < n; i += CHUNK, b += CHUNK * stride)
+  {
+    const int m = (n - i < CHUNK ? n - i : CHUNK);
+    
+    HammingDistance::distances(a, b, stride, m, FBrief::L / 8, dist);
+    
+    for(int j = 0; j < m; ++j) d[i + j] = static_cast<double>(dist[j]);
+  }
+}
+
 // --------------------------------------------------------------------------
   
 std::string FBrief::toString(const FBrief::TDescriptor &a)
@@ -72,6 +193,45 @@ void FBrief::fromString(FBrief::TDescriptor &a, const std::string &s)
 
 // --------------------------------------------------------------------------
 
+void FBrief::fromArray8U(FBrief::TDescriptor &a, const unsigned char *p)
+{
+  // bit i is bit 7 - i % 8 of byte i / 8, so each group of 64 bits is 
+  // made of 8 bytes with their bits reversed, the first one lowest
+  a.reset();
+  
+  for(int w = FBrief::L / 64 - 1; w >= 0; --w)
+  {
+    uint64_t x = 0;
+    for(int b = 7; b >= 0; --b) x = (x << 8) | p[w * 8 + b];
+    
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | 
+      ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    x = ((x >> 2) & 0x3333333333333333ULL) | 
+      ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 1) & 0x5555555555555555ULL) | 
+      ((x & 0x5555555555555555ULL) << 1);
+    
+    a <<= 64;
+    a |= FBrief::TDescriptor((unsigned long long)x);
+  }
+}
+
+// --------------------------------------------------------------------------
+
+void FBrief::toArray8U(const FBrief::TDescriptor &a, unsigned char *p)
+{
+  for(int i = 0; i < FBrief::L; i += 8, ++p)
+  {
+    *p = 0;
+    for(int j = 0; j < 8; ++j)
+    {
+      if(a[i + j]) *p |= (1 << (7 - j));
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+
 void FBrief::toMat32F(const std::vector<TDescriptor> &descriptors, 
   cv::Mat &mat)
 {
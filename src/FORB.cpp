@@ -8,12 +8,16 @@
  */
  
 #include <vector>
+#include <cstring>
 #include <string>
 #include <sstream>
+#include <algorithm>
 #include <stdint.h>
 #include <limits.h>
 
 #include "FORB.h"
+#include "HammingDistance.h"
+#include "MajorityVote.h"
 
 using namespace std;
 
@@ -35,41 +39,48 @@ void FORB::meanValue(const std::vector<FORB::pDescriptor> &descriptors,
   }
   else
   {
-    vector<int> sum(FORB::L * 8, 0);
-    
+    vector<const unsigned char *> data(descriptors.size());
     for(size_t i = 0; i < descriptors.size(); ++i)
     {
-      const cv::Mat &d = *descriptors[i];
-      const unsigned char *p = d.ptr<unsigned char>();
-      
-      for(int j = 0; j < d.cols; ++j, ++p)
-      {
-        if(*p & (1 << 7)) ++sum[ j*8     ];
-        if(*p & (1 << 6)) ++sum[ j*8 + 1 ];
-        if(*p & (1 << 5)) ++sum[ j*8 + 2 ];
-        if(*p & (1 << 4)) ++sum[ j*8 + 3 ];
-        if(*p & (1 << 3)) ++sum[ j*8 + 4 ];
-        if(*p & (1 << 2)) ++sum[ j*8 + 5 ];
-        if(*p & (1 << 1)) ++sum[ j*8 + 6 ];
-        if(*p & (1))      ++sum[ j*8 + 7 ];
-      }
+      data[i] = descriptors[i]->ptr<unsigned char>();
     }
     
-    mean = cv::Mat::zeros(1, FORB::L, CV_8U);
-    unsigned char *p = mean.ptr<unsigned char>();
-    
-    const int N2 = (int)descriptors.size() / 2 + descriptors.size() % 2;
-    for(size_t i = 0; i < sum.size(); ++i)
-    {
-      if(sum[i] >= N2)
-      {
-        // set bit
-        *p |= 1 << (7 - (i % 8));
-      }
-      
-      if(i % 8 == 7) ++p;
-    }
+    // new data, since mean may share them with a descriptor
+    mean = cv::Mat(1, FORB::L, CV_8U);
+    meanValue8U(data, mean.ptr<unsigned char>());
+  }
+}
+
+// --------------------------------------------------------------------------
+
+void FORB::meanValue8U(const std::vector<const unsigned char *> &descriptors,
+  unsigned char *mean)
+{
+  if(descriptors.empty())
+  {
+    fill(mean, mean + FORB::L, 0);
+    return;
+  }
+  
+  // a bit is set if at least half of the descriptors (rounded up) have it
+  const int N2 = (int)descriptors.size() / 2 + descriptors.size() % 2;
+  
+  MajorityVote::majority(&descriptors[0], (int)descriptors.size(), FORB::L, 
+    N2, mean);
+}
+
+// --------------------------------------------------------------------------
+
+void FORB::meanValueCounts8U(const int *counts, int n, unsigned char *mean)
+{
+  if(n == 0)
+  {
+    fill(mean, mean + FORB::L, 0);
+    return;
   }
+  
+  const int N2 = n / 2 + n % 2;
+  MajorityVote::majority(counts, FORB::L, N2, mean);
 }
 
 // --------------------------------------------------------------------------
@@ -114,6 +125,65 @@ double FORB::distance(const FORB::TDescriptor &a,
   // return ret;
 }
 
+// --------------------------------------------------------------------------
+
+void FORB::distances(const FORB::TDescriptor &a, 
+  const FORB::TDescriptor *b, int n, double *d)
+{
+  const int CHUNK = 64;
+  const unsigned char *pb[CHUNK];
+  int dist[CHUNK];
+  
+  const unsigned char *pa = a.ptr<unsigned char>();
+  
+  for(int i = 0; i < n; i += CHUNK)
+  {
+    const int m = (n - i < CHUNK ? n - i : CHUNK);
+    
+    for(int j = 0; j < m; ++j) pb[j] = b[i + j].ptr<unsigned char>();
+    
+    HammingDistance::distances(pa, pb, m, a.cols, dist);
+    
+    for(int j = 0; j < m; ++j) d[i + j] = static_cast<double>(dist[j]);
+  }
+}
+
+// --------------------------------------------------------------------------
+
+void FORB::distances8U(const unsigned char *a, 
+  const unsigned char *const *b, int n, double *d)
+{
+  const int CHUNK = 64;
+  int dist[CHUNK];
+  
+  for(int i = 0; i < n; i += CHUNK)
+  {
+    const int m = (n - i < CHUNK ? n - i : CHUNK);
+    
+    HammingDistance::distances(a, b + i, m, FORB::L, dist);
+    
+    for(int j = 0; j < m; ++j) d[i + j] = static_cast<double>(dist[j]);
+  }
+}
+
+// --------------------------------------------------------------------------
+
+void FORB::distances8U(const unsigned char *a, const unsigned char *b,
+  size_t stride, int n, double *d)
+{
+  const int CHUNK = 64;
+  int dist[CHUNK];
+  
+  for(int i = 0; i < n; i += CHUNK, b += CHUNK * stride)
+  {
+    const int m = (n - i < CHUNK ? n - i : CHUNK);
+    
+    HammingDistance::distances(a, b, stride, m, FORB::L, dist);
+    
+    for(int j = 0; j < m; ++j) d[i + j] = static_cast<double>(dist[j]);
+  }
+}
+
 // --------------------------------------------------------------------------
   
 std::string FORB::toString(const FORB::TDescriptor &a)
@@ -150,6 +220,24 @@ void FORB::fromString(FORB::TDescriptor &a, const std::string &s)
 
 // --------------------------------------------------------------------------
 
+void FORB::fromArray8U(FORB::TDescriptor &a, const unsigned char *p)
+{
+  // a matrix header on external data has no reference counter
+  a = cv::Mat(1, FORB::L, CV_8U, const_cast<unsigned char*>(p));
+}
+
+// --------------------------------------------------------------------------
+
+void FORB::toArray8U(const FORB::TDescriptor &a, unsigned char *p)
+{
+  if(a.empty())
+    fill(p, p + FORB::L, 0);
+  else
+    memcpy(p, a.ptr<unsigned char>(), FORB::L);
+}
+
+// --------------------------------------------------------------------------
+
 void FORB::toMat32F(const std::vector<TDescriptor> &descriptors, 
   cv::Mat &mat)
 {
@@ -42,6 +42,35 @@ void FSurf64::meanValue(const std::vector<FSurf64::pDescriptor> &descriptors,
   }
 }
 
+// --------------------------------------------------------------------------
+
+void FSurf64::weightedMeanValue(
+  const std::vector<FSurf64::pDescriptor> &descriptors, 
+  const std::vector<double> &weights, FSurf64::TDescriptor &mean)
+{
+  vector<double> sum(FSurf64::L, 0.);
+  double s = 0.;
+  
+  for(size_t j = 0; j < descriptors.size(); ++j)
+  {
+    const FSurf64::TDescriptor &desc = *descriptors[j];
+    for(int i = 0; i < FSurf64::L; ++i)
+    {
+      sum[i] += weights[j] * desc[i];
+    }
+    s += weights[j];
+  }
+  
+  mean.resize(0);
+  mean.resize(FSurf64::L, 0);
+  if(s <= 0) return;
+  
+  for(int i = 0; i < FSurf64::L; ++i)
+  {
+    mean[i] = (float)(sum[i] / s);
+  }
+}
+
 // --------------------------------------------------------------------------
   
 double FSurf64::distance(const FSurf64::TDescriptor &a, const FSurf64::TDescriptor &b)
@@ -0,0 +1,225 @@
+/**
+ * File: HammingDistance.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: one-to-many hamming distance kernels for binary descriptors
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <cstring>
+#include <stdint.h>
+#include <limits.h>
+
+#include "HammingDistance.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+  (defined(__GNUC__) || defined(__clang__))
+#define DBOW2_HAMMING_X86
+#include <immintrin.h>
+#endif
+
+namespace DBoW2 {
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+/// Descriptors compared by the kernels, given either by pointers or as a
+/// buffer where they are stored at a fixed stride
+struct Descriptors
+{
+  /// Pointers to the descriptors, or NULL if they are in the buffer
+  const unsigned char *const *pointers;
+
+  /// First descriptor of the buffer
+  const unsigned char *buffer;
+
+  /// Bytes from a descriptor of the buffer to the next one
+  size_t stride;
+
+  inline const unsigned char* operator[](int i) const
+  {
+    return (pointers ? pointers[i] : buffer + (size_t)i * stride);
+  }
+};
+
+/// Signature of the kernels
+typedef void (*KernelPtr)(const unsigned char *a, const Descriptors &b,
+  int n, int bytes, int *d);
+
+/**
+ * Returns the number of bits set in v
+ * @param v
+ * @return bit count
+ */
+inline int popcount64(uint64_t v)
+{
+  // Bit count function got from:
+  // http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetKernighan
+  v = v - ((v >> 1) & (uint64_t)~(uint64_t)0/3);
+  v = (v & (uint64_t)~(uint64_t)0/15*3) + ((v >> 2) & 
+    (uint64_t)~(uint64_t)0/15*3);
+  v = (v + (v >> 4)) & (uint64_t)~(uint64_t)0/255*15;
+  return (int)((uint64_t)(v * ((uint64_t)~(uint64_t)0/255)) >> 
+    (sizeof(uint64_t) - 1) * CHAR_BIT);
+}
+
+// --------------------------------------------------------------------------
+
+void distancesScalar(const unsigned char *a, const Descriptors &b,
+  int n, int bytes, int *d)
+{
+  for(int i = 0; i < n; ++i)
+  {
+    const unsigned char *pb = b[i];
+    int ret = 0;
+    for(int j = 0; j < bytes; j += (int)sizeof(uint64_t))
+    {
+      uint64_t va, vb;
+      memcpy(&va, a + j, sizeof(uint64_t));
+      memcpy(&vb, pb + j, sizeof(uint64_t));
+      ret += popcount64(va ^ vb);
+    }
+    d[i] = ret;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+#ifdef DBOW2_HAMMING_X86
+
+__attribute__((target("avx2")))
+void distancesAVX2(const unsigned char *a, const Descriptors &b,
+  int n, int bytes, int *d)
+{
+  if(bytes != 32)
+  {
+    distancesScalar(a, b, n, bytes, d);
+    return;
+  }
+
+  // popcount of each nibble
+  const __m256i lut = _mm256_setr_epi8(
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i va = _mm256_loadu_si256((const __m256i*)a);
+
+  for(int i = 0; i < n; ++i)
+  {
+    const __m256i x = _mm256_xor_si256(va, 
+      _mm256_loadu_si256((const __m256i*)b[i]));
+    
+    const __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(x, low_mask));
+    const __m256i hi = _mm256_shuffle_epi8(lut, 
+      _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask));
+    
+    // 4 partial sums of 64 bits
+    const __m256i s = _mm256_sad_epu8(_mm256_add_epi8(lo, hi), zero);
+    const __m128i s2 = _mm_add_epi64(_mm256_castsi256_si128(s), 
+      _mm256_extracti128_si256(s, 1));
+    
+    d[i] = _mm_cvtsi128_si32(s2) + _mm_extract_epi32(s2, 2);
+  }
+}
+
+// --------------------------------------------------------------------------
+
+__attribute__((target("avx2,avx512vl,avx512vpopcntdq")))
+void distancesAVX512(const unsigned char *a, const Descriptors &b,
+  int n, int bytes, int *d)
+{
+  if(bytes != 32)
+  {
+    distancesScalar(a, b, n, bytes, d);
+    return;
+  }
+
+  const __m256i va = _mm256_loadu_si256((const __m256i*)a);
+
+  for(int i = 0; i < n; ++i)
+  {
+    const __m256i x = _mm256_xor_si256(va, 
+      _mm256_loadu_si256((const __m256i*)b[i]));
+    
+    // 4 partial counts of 64 bits
+    const __m256i c = _mm256_popcnt_epi64(x);
+    const __m128i c2 = _mm_add_epi64(_mm256_castsi256_si128(c), 
+      _mm256_extracti128_si256(c, 1));
+    
+    d[i] = _mm_cvtsi128_si32(c2) + _mm_extract_epi32(c2, 2);
+  }
+}
+
+#endif // DBOW2_HAMMING_X86
+
+// --------------------------------------------------------------------------
+
+/// Kernel selected for this CPU and its name
+struct Kernel
+{
+  KernelPtr f;
+  const char *name;
+
+  Kernel(): f(distancesScalar), name("scalar")
+  {
+#ifdef DBOW2_HAMMING_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512vl") && 
+      __builtin_cpu_supports("avx512vpopcntdq"))
+    {
+      f = distancesAVX512;
+      name = "avx512";
+    }
+    else if(__builtin_cpu_supports("avx2"))
+    {
+      f = distancesAVX2;
+      name = "avx2";
+    }
+#endif
+  }
+};
+
+/**
+ * Returns the kernel to use. It is selected the first time only
+ * @return kernel
+ */
+const Kernel& kernel()
+{
+  static const Kernel k;
+  return k;
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+void HammingDistance::distances(const unsigned char *a, 
+  const unsigned char *const *b, int n, int bytes, int *d)
+{
+  const Descriptors db = { b, NULL, 0 };
+  kernel().f(a, db, n, bytes, d);
+}
+
+// --------------------------------------------------------------------------
+
+void HammingDistance::distances(const unsigned char *a, 
+  const unsigned char *b, size_t stride, int n, int bytes, int *d)
+{
+  const Descriptors db = { NULL, b, stride };
+  kernel().f(a, db, n, bytes, d);
+}
+
+// --------------------------------------------------------------------------
+
+const char* HammingDistance::implementation()
+{
+  return kernel().name;
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
+
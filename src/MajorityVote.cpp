@@ -0,0 +1,163 @@
+/**
+ * File: MajorityVote.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: bitwise majority vote of binary descriptors
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#include "MajorityVote.h"
+
+using namespace std;
+
+namespace DBoW2 {
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+/// Number of bit planes of the vertical counters
+const int PLANES = 8;
+
+/// Descriptors added to the planes before flushing them (2^PLANES - 1)
+const int BLOCK = (1 << PLANES) - 1;
+
+/// Descriptors of up to these bytes are counted without allocating memory
+const int STACK_BYTES = 64;
+
+/**
+ * Adds the bits set in some bytes to their counters
+ * @param p bytes
+ * @param bytes number of bytes
+ * @param weight value added to each counter
+ * @param counts counters of the bits of p
+ */
+inline void addBits(const unsigned char *p, int bytes, int weight, 
+  int *counts)
+{
+  for(int b = 0; b < bytes; ++b, ++p, counts += 8)
+  {
+    const unsigned char v = *p;
+    if(v == 0) continue;
+    
+    if(v & (1 << 7)) counts[0] += weight;
+    if(v & (1 << 6)) counts[1] += weight;
+    if(v & (1 << 5)) counts[2] += weight;
+    if(v & (1 << 4)) counts[3] += weight;
+    if(v & (1 << 3)) counts[4] += weight;
+    if(v & (1 << 2)) counts[5] += weight;
+    if(v & (1 << 1)) counts[6] += weight;
+    if(v & (1))      counts[7] += weight;
+  }
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+void MajorityVote::count(const unsigned char *const *descriptors, int n, 
+  int bytes, int *counts)
+{
+  fill(counts, counts + bytes * 8, 0);
+  add(descriptors, n, bytes, counts);
+}
+
+// --------------------------------------------------------------------------
+
+void MajorityVote::add(const unsigned char *const *descriptors, int n, 
+  int bytes, int *counts)
+{
+  // whole 64-bit words go to the planes; the remaining bytes are counted 
+  // one by one
+  const int W = bytes / 8;
+  const int tail = W * 8;
+  
+  // planes[p * W + w]: bit p of the counters of word w. They are kept in 
+  // the stack for descriptors of up to STACK_BYTES
+  uint64_t stack_planes[PLANES * STACK_BYTES / 8];
+  vector<uint64_t> heap_planes;
+  uint64_t *planes = stack_planes;
+  if(bytes > STACK_BYTES)
+  {
+    heap_planes.resize(PLANES * W);
+    planes = &heap_planes[0];
+  }
+  
+  for(int i = 0; i < n; )
+  {
+    const int m = min(BLOCK, n - i);
+    fill(planes, planes + PLANES * W, 0);
+    
+    for(int j = 0; j < m; ++j, ++i)
+    {
+      const unsigned char *d = descriptors[i];
+      
+      for(int w = 0; w < W; ++w)
+      {
+        uint64_t x;
+        memcpy(&x, d + w * 8, 8);
+        
+        // ripple-carry addition of x to the counters
+        for(int p = 0; x != 0; ++p)
+        {
+          uint64_t &plane = planes[p * W + w];
+          const uint64_t carry = plane & x;
+          plane ^= x;
+          x = carry;
+        }
+      }
+      
+      if(tail < bytes) addBits(d + tail, bytes - tail, 1, counts + tail * 8);
+    }
+    
+    // flush the planes. Their bytes are in the same order as the 
+    // descriptor bytes
+    for(int p = 0; p < PLANES && W > 0; ++p)
+    {
+      addBits(reinterpret_cast<const unsigned char*>(&planes[p * W]), 
+        tail, 1 << p, counts);
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+
+void MajorityVote::majority(const unsigned char *const *descriptors, int n,
+  int bytes, int threshold, unsigned char *result)
+{
+  int stack_counts[STACK_BYTES * 8];
+  vector<int> heap_counts;
+  int *counts = stack_counts;
+  if(bytes > STACK_BYTES)
+  {
+    heap_counts.resize(bytes * 8);
+    counts = &heap_counts[0];
+  }
+  
+  count(descriptors, n, bytes, counts);
+  majority(counts, bytes, threshold, result);
+}
+
+// --------------------------------------------------------------------------
+
+void MajorityVote::majority(const int *counts, int bytes, int threshold,
+  unsigned char *result)
+{
+  fill(result, result + bytes, 0);
+  
+  for(int j = 0; j < bytes * 8; ++j)
+  {
+    if(counts[j] >= threshold) result[j / 8] |= 1 << (7 - j % 8);
+  }
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
+
@@ -0,0 +1,119 @@
+/**
+ * File: PackedDescriptors.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: training descriptors stored in one contiguous buffer
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+
+#include "PackedDescriptors.h"
+
+using namespace std;
+
+namespace DBoW2 {
+
+// --------------------------------------------------------------------------
+
+PackedDescriptors::PackedDescriptors(int descriptor_bytes)
+  : m_memory(NULL), m_data(NULL), m_bytes(descriptor_bytes), m_size(0),
+  m_capacity(0)
+{
+}
+
+// --------------------------------------------------------------------------
+
+PackedDescriptors::~PackedDescriptors()
+{
+  delete [] m_memory;
+}
+
+// --------------------------------------------------------------------------
+
+void PackedDescriptors::reserve(size_t n)
+{
+  if(n <= m_capacity) return;
+  
+  unsigned char *memory = new unsigned char[n * m_bytes + ALIGNMENT - 1];
+  unsigned char *data = memory + 
+    (ALIGNMENT - (uintptr_t)memory % ALIGNMENT) % ALIGNMENT;
+  
+  if(m_size > 0) memcpy(data, m_data, m_size * m_bytes);
+  
+  delete [] m_memory;
+  m_memory = memory;
+  m_data = data;
+  m_capacity = n;
+}
+
+// --------------------------------------------------------------------------
+
+void PackedDescriptors::clear()
+{
+  delete [] m_memory;
+  m_memory = m_data = NULL;
+  m_size = m_capacity = 0;
+  m_images.clear();
+}
+
+// --------------------------------------------------------------------------
+
+void PackedDescriptors::add(const unsigned char *descriptors, size_t n)
+{
+  m_images.push_back(m_size);
+  append(descriptors, n);
+}
+
+// --------------------------------------------------------------------------
+
+void PackedDescriptors::add(const cv::Mat &descriptors)
+{
+  if(descriptors.empty())
+  {
+    m_images.push_back(m_size);
+    return;
+  }
+  
+  if(descriptors.type() != CV_8U || descriptors.cols != m_bytes)
+  {
+    throw string("PackedDescriptors: descriptors must be CV_8U rows of ") +
+      to_string(m_bytes) + " bytes";
+  }
+  
+  m_images.push_back(m_size);
+  
+  if(descriptors.isContinuous())
+  {
+    append(descriptors.ptr<unsigned char>(), descriptors.rows);
+  }
+  else
+  {
+    for(int i = 0; i < descriptors.rows; ++i)
+      append(descriptors.ptr<unsigned char>(i), 1);
+  }
+}
+
+// --------------------------------------------------------------------------
+
+void PackedDescriptors::append(const unsigned char *descriptors, size_t n)
+{
+  if(m_images.empty()) m_images.push_back(0);
+  
+  if(m_size + n > m_capacity)
+  {
+    reserve(std::max(m_size + n, m_capacity * 2));
+  }
+  
+  if(n > 0) memcpy(m_data + m_size * m_bytes, descriptors, n * m_bytes);
+  m_size += n;
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
+
@@ -0,0 +1,149 @@
+/**
+ * File: ScoreAccumulator.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: accumulator of the scores of the entries of a database
+ *   during a query
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#include "ScoreAccumulator.h"
+
+using namespace std;
+
+namespace DBoW2 {
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+/// Maximum number of entries for which arrays are used
+std::atomic<size_t> max_dense_entries(
+  ScoreAccumulator::DEFAULT_MAX_DENSE_ENTRIES);
+
+/// Arrays up to this number of slots are always kept
+const size_t MIN_RELEASED_SLOTS = 1 << 12;
+
+/// An array is too large for a query if it has this many times the slots
+/// it needs
+const size_t RELEASE_FACTOR = 4;
+
+/// Queries in a row for which the array is too large before releasing it
+const unsigned int RELEASE_QUERIES = 64;
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+ScoreAccumulator::ScoreAccumulator()
+  : m_dense(true), m_epoch(1), m_first(0), m_small_queries(0)
+{
+}
+
+// --------------------------------------------------------------------------
+
+ScoreAccumulator& ScoreAccumulator::local()
+{
+  static thread_local ScoreAccumulator accumulator;
+  return accumulator;
+}
+
+// --------------------------------------------------------------------------
+
+void ScoreAccumulator::setMaxDenseEntries(size_t n)
+{
+  max_dense_entries = n;
+}
+
+// --------------------------------------------------------------------------
+
+size_t ScoreAccumulator::getMaxDenseEntries()
+{
+  return max_dense_entries;
+}
+
+// --------------------------------------------------------------------------
+
+void ScoreAccumulator::reset(EntryId first, size_t entries)
+{
+  m_touched.clear();
+  m_sparse.clear();
+  m_first = first;
+
+  m_dense = (entries <= max_dense_entries);
+
+  // release the array if the last queries were on much smaller databases,
+  // or on databases that do not use it. Waiting some queries avoids
+  // allocating it again and again if they alternate with larger ones
+  if(m_slots.size() > MIN_RELEASED_SLOTS && 
+    (!m_dense || entries * RELEASE_FACTOR < m_slots.size()))
+  {
+    if(++m_small_queries >= RELEASE_QUERIES)
+    {
+      std::vector<Slot>().swap(m_slots);
+      m_small_queries = 0;
+    }
+  }
+  else
+  {
+    m_small_queries = 0;
+  }
+
+  // the hash table keeps its buckets when cleared
+  if(m_dense && m_sparse.bucket_count() > MIN_RELEASED_SLOTS)
+  {
+    std::unordered_map<EntryId, Slot>().swap(m_sparse);
+  }
+
+  if(m_dense && m_slots.size() < entries)
+  {
+    try
+    {
+      // the new slots have stamp 0, which is never an epoch
+      Slot empty = Slot();
+      m_slots.resize(entries, empty);
+    }
+    catch(const std::bad_alloc &)
+    {
+      m_dense = false;
+    }
+  }
+
+  if(++m_epoch == 0)
+  {
+    // after 2^32 queries, the stamps could match again
+    for(size_t i = 0; i < m_slots.size(); ++i) m_slots[i].stamp = 0;
+    m_epoch = 1;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+ScoreAccumulator::Slot& ScoreAccumulator::sparseAt(EntryId id)
+{
+  Slot empty = Slot();
+  empty.score = empty.sum_v = empty.sum_w = -0.0; // as in at
+
+  std::pair<std::unordered_map<EntryId, Slot>::iterator, bool> it =
+    m_sparse.insert(std::make_pair(id, empty));
+  if(it.second) m_touched.push_back(id);
+  return it.first->second;
+}
+
+// --------------------------------------------------------------------------
+
+const std::vector<EntryId>& ScoreAccumulator::sortTouched()
+{
+  std::sort(m_touched.begin(), m_touched.end());
+  return m_touched;
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
@@ -0,0 +1,272 @@
+/**
+ * File: TextVocabularyFile.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: parser of vocabularies in the text format of ORB-SLAM
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "TextVocabularyFile.h"
+
+using namespace std;
+
+namespace DBoW2 {
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+/// Minimum size of the ranges parsed in parallel
+const size_t MIN_CHUNK_BYTES = 1 << 16;
+
+/// Whether a character separates the fields of a line
+inline bool isBlank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+/// Skips the blank characters before a field
+inline const char* skipBlanks(const char *p, const char *end)
+{
+  while(p < end && isBlank(*p)) ++p;
+  return p;
+}
+
+/// Parses a non-negative integer and moves p after it
+/// @return false if there is not a number, it does not end with a blank
+///   or it is above max
+inline bool parseUnsigned(const char *&p, const char *end, 
+  unsigned long long max, unsigned long long &value)
+{
+  p = skipBlanks(p, end);
+  if(p == end || *p < '0' || *p > '9') return false;
+
+  value = 0;
+  for(; p < end && *p >= '0' && *p <= '9'; ++p)
+  {
+    value = value * 10 + (unsigned long long)(*p - '0');
+    if(value > max) return false;
+  }
+  return p == end || isBlank(*p);
+}
+
+/// Returns the end of the line that starts at p, without the line break
+inline const char* lineEnd(const char *p, const char *end)
+{
+  const char *q = (const char *)memchr(p, '\n', end - p);
+  return (q ? q : end);
+}
+
+/// Returns whether a line has only blank characters
+inline bool isBlankLine(const char *p, const char *end)
+{
+  return skipBlanks(p, end) == end;
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+TextVocabularyFile::TextVocabularyFile(const std::string &filename)
+  : m_filename(filename), m_body(0)
+{
+  FILE *f = fopen(filename.c_str(), "rb");
+  if(!f) throw string("Could not open file ") + filename;
+
+  fseek(f, 0, SEEK_END);
+  const long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  m_data.resize((size > 0 ? size : 0) + 1);
+  const bool ok = (size <= 0 ||
+    fread(&m_data[0], 1, size, f) == (size_t)size);
+  fclose(f);
+
+  if(!ok) throw string("Could not read file ") + filename;
+  m_data.back() = '\0'; // so that strtod stops at the end
+
+  const char *begin = &m_data[0];
+  const char *data_end = begin + m_data.size() - 1;
+  const char *end = lineEnd(begin, data_end);
+
+  unsigned long long k, L, scoring, weighting;
+  const char *p = begin;
+  if(!parseUnsigned(p, end, 1 << 20, k) || 
+    !parseUnsigned(p, end, 1 << 20, L) ||
+    !parseUnsigned(p, end, 5, scoring) || 
+    !parseUnsigned(p, end, 3, weighting) ||
+    !isBlankLine(p, end) || k == 0 || L == 0)
+  {
+    throw filename + " is not a text vocabulary";
+  }
+
+  m_k = (int)k;
+  m_L = (int)L;
+  m_scoring = (int)scoring;
+  m_weighting = (int)weighting;
+  m_body = (end < data_end ? end + 1 : end) - begin;
+}
+
+// --------------------------------------------------------------------------
+
+void TextVocabularyFile::parse(std::vector<Line> &lines,
+  ThreadPool *pool) const
+{
+  const char *data = &m_data[0];
+  const size_t size = m_data.size() - 1;
+
+  // the body is split in ranges that begin at a line
+  size_t n_chunks = 1;
+  if(pool && pool->size() > 1)
+  {
+    n_chunks = std::min((size_t)pool->size() * 4,
+      (size - m_body) / MIN_CHUNK_BYTES + 1);
+  }
+
+  vector<Chunk> chunks;
+  size_t begin = m_body;
+  for(size_t c = 0; c < n_chunks && begin < size; ++c)
+  {
+    size_t end = m_body + (size - m_body) * (c + 1) / n_chunks;
+    if(end < begin) end = begin;
+    end = lineEnd(data + end, data + size) - data;
+    if(end < size) ++end; // line break
+
+    Chunk chunk;
+    chunk.begin = begin;
+    chunk.end = end;
+    chunk.first_line = 0;
+    chunk.nodes = 0;
+    chunks.push_back(chunk);
+    begin = end;
+  }
+
+  auto run = [&](const std::function<void(int, int)> &f)
+    {
+      if(pool && chunks.size() > 1)
+        pool->parallelFor(0, (int)chunks.size(), 1, f);
+      else if(!chunks.empty())
+        f(0, (int)chunks.size());
+    };
+
+  // the lines of each range are counted to know the id of its first node
+  vector<size_t> physical(chunks.size(), 0);
+  run([&](int b, int e)
+    {
+      for(int c = b; c < e; ++c)
+      {
+        const char *p = data + chunks[c].begin;
+        const char *end = data + chunks[c].end;
+        while(p < end)
+        {
+          const char *q = lineEnd(p, end);
+          ++physical[c];
+          if(!isBlankLine(p, q)) ++chunks[c].nodes;
+          p = q + 1;
+        }
+      }
+    });
+
+  size_t n = 0, line = 2;
+  vector<size_t> first_node(chunks.size());
+  for(size_t c = 0; c < chunks.size(); ++c)
+  {
+    first_node[c] = n;
+    chunks[c].first_line = line;
+    n += chunks[c].nodes;
+    line += physical[c];
+  }
+
+  lines.resize(n);
+
+  run([&](int b, int e)
+    {
+      for(int c = b; c < e; ++c)
+      {
+        const char *p = data + chunks[c].begin;
+        const char *end = data + chunks[c].end;
+        size_t i = first_node[c];
+
+        for(size_t l = chunks[c].first_line; p < end; ++l)
+        {
+          const char *q = lineEnd(p, end);
+          if(!isBlankLine(p, q))
+          {
+            if(!parseLine(p, q, lines[i]) || lines[i].parent > i)
+              throw wrongLine(l);
+            lines[i++].number = l;
+          }
+          p = q + 1;
+        }
+      }
+    });
+}
+
+// --------------------------------------------------------------------------
+
+bool TextVocabularyFile::parseLine(const char *p, const char *end,
+  Line &line)
+{
+  // the weight is the last field
+  while(end > p && isBlank(end[-1])) --end;
+  const char *w = end;
+  while(w > p && !isBlank(w[-1])) --w;
+
+  unsigned long long parent, leaf;
+  if(!parseUnsigned(p, w, 0xffffffffULL, parent) ||
+    !parseUnsigned(p, w, 1, leaf))
+  {
+    return false;
+  }
+
+  char *w_end;
+  line.weight = strtod(w, &w_end);
+  if(w == end || w_end != end) return false;
+
+  p = skipBlanks(p, w);
+  const char *d_end = w;
+  while(d_end > p && isBlank(d_end[-1])) --d_end;
+
+  line.parent = (unsigned int)parent;
+  line.leaf = (leaf == 1);
+  line.descriptor = p;
+  line.descriptor_length = d_end - p;
+  return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool TextVocabularyFile::parseBytes(const char *text, size_t length,
+  unsigned char *bytes, int n)
+{
+  const char *p = text;
+  const char *end = text + length;
+
+  for(int i = 0; i < n; ++i)
+  {
+    unsigned long long v;
+    if(!parseUnsigned(p, end, 255, v)) return false;
+    bytes[i] = (unsigned char)v;
+  }
+  return skipBlanks(p, end) == end;
+}
+
+// --------------------------------------------------------------------------
+
+std::string TextVocabularyFile::wrongLine(size_t line) const
+{
+  return string("Wrong line ") + to_string(line) + " in vocabulary file " +
+    m_filename;
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
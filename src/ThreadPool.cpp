@@ -0,0 +1,222 @@
+/**
+ * File: ThreadPool.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: pool of threads to run loops in parallel
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include "ThreadPool.h"
+
+namespace DBoW2 {
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+/// Pool and queue index of the worker running in this thread
+struct WorkerInfo
+{
+  const ThreadPool *pool;
+  int queue;
+};
+
+thread_local WorkerInfo g_worker = { NULL, 0 };
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+ThreadPool::ThreadPool(int threads)
+  : m_ntasks(0), m_stop(false)
+{
+  if(threads <= 0) threads = (int)std::thread::hardware_concurrency();
+  if(threads <= 0) threads = 1;
+  
+  m_queues.resize(threads);
+  
+  for(int i = 1; i < threads; ++i)
+  {
+    m_workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+  }
+}
+
+// --------------------------------------------------------------------------
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cond.notify_all();
+  
+  for(size_t i = 0; i < m_workers.size(); ++i) m_workers[i].join();
+}
+
+// --------------------------------------------------------------------------
+
+void ThreadPool::parallelFor(int begin, int end, int grain, 
+  const std::function<void(int, int)> &f)
+{
+  if(grain < 1) grain = 1;
+  
+  if(m_workers.empty() || end - begin <= grain)
+  {
+    if(begin < end) f(begin, end);
+    return;
+  }
+
+  const int q = queueIndex();
+  
+  Job job;
+  job.pending = 0;
+
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    
+    // the first range is run by this thread. The others are queued in
+    // reverse order, so that this thread takes them in order
+    std::deque<Task> &queue = m_queues[q];
+    
+    int b = begin + ((end - begin - 1) / grain) * grain;
+    for(; b > begin; b -= grain)
+    {
+      const int e = (end - b < grain ? end : b + grain);
+      
+      Task task;
+      task.job = &job;
+      task.f = std::bind(std::cref(f), b, e);
+      queue.push_back(task);
+      ++job.pending;
+      ++m_ntasks;
+    }
+  }
+  m_cond.notify_all();
+
+  try
+  {
+    f(begin, begin + grain);
+  }
+  catch(...)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    job.error = std::current_exception();
+  }
+
+  // help with the pending tasks until the job is done. They must finish
+  // even if there is an error, since they refer to job and f
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while(job.pending > 0)
+  {
+    Task task;
+    if(takeTask(q, task))
+    {
+      lock.unlock();
+      runTask(task);
+      lock.lock();
+    }
+    else
+    {
+      job.done.wait(lock);
+    }
+  }
+  
+  if(job.error) std::rethrow_exception(job.error);
+}
+
+// --------------------------------------------------------------------------
+
+void ThreadPool::workerLoop(int q)
+{
+  g_worker.pool = this;
+  g_worker.queue = q;
+  
+  std::unique_lock<std::mutex> lock(m_mutex);
+  
+  while(true)
+  {
+    while(!m_stop && m_ntasks == 0) m_cond.wait(lock);
+    
+    Task task;
+    if(!takeTask(q, task)) return; // stopping
+    
+    lock.unlock();
+    runTask(task);
+    lock.lock();
+  }
+}
+
+// --------------------------------------------------------------------------
+
+void ThreadPool::runTask(Task &task)
+{
+  std::exception_ptr error;
+  
+  bool failed;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    failed = (bool)task.job->error;
+  }
+  
+  if(!failed)
+  {
+    try
+    {
+      task.f();
+    }
+    catch(...)
+    {
+      error = std::current_exception();
+    }
+  }
+  
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if(error && !task.job->error) task.job->error = error;
+  if(--task.job->pending == 0) task.job->done.notify_all();
+}
+
+// --------------------------------------------------------------------------
+
+int ThreadPool::queueIndex() const
+{
+  return (g_worker.pool == this ? g_worker.queue : 0);
+}
+
+// --------------------------------------------------------------------------
+
+bool ThreadPool::takeTask(int q, Task &task)
+{
+  if(m_ntasks == 0) return false;
+  
+  // own queue: newest task first
+  if(!m_queues[q].empty())
+  {
+    task = m_queues[q].back();
+    m_queues[q].pop_back();
+    --m_ntasks;
+    return true;
+  }
+  
+  // others: oldest task first
+  const int N = (int)m_queues.size();
+  for(int i = 1; i < N; ++i)
+  {
+    std::deque<Task> &queue = m_queues[(q + i) % N];
+    if(!queue.empty())
+    {
+      task = queue.front();
+      queue.pop_front();
+      --m_ntasks;
+      return true;
+    }
+  }
+  
+  return false;
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
+
@@ -0,0 +1,276 @@
+/**
+ * File: TrainingCheckpoint.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: file that keeps the node splits of a vocabulary training,
+ *   so that an interrupted training can be resumed
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#include "TrainingCheckpoint.h"
+
+using namespace std;
+
+namespace DBoW2 {
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+const char CHECKPOINT_MAGIC[4] = { 'D', 'B', 'C', 'K' };
+const uint32_t CHECKPOINT_VERSION = 1;
+
+/// Size of the header: magic, version and fingerprint
+const long HEADER_BYTES = 16;
+
+/// Size of the fixed part of a record: key, cluster bytes, number of
+/// descriptors and bytes per association
+const size_t RECORD_BYTES = 17;
+
+/// Appends a little-endian number of some bytes to a buffer
+void putNumber(vector<unsigned char> &buffer, uint64_t v, int bytes)
+{
+  for(int i = 0; i < bytes; ++i) buffer.push_back((unsigned char)(v >> (8*i)));
+}
+
+/// Gets a little-endian number of some bytes from a buffer
+uint64_t getNumber(const unsigned char *p, int bytes)
+{
+  uint64_t v = 0;
+  for(int i = 0; i < bytes; ++i) v |= (uint64_t)p[i] << (8*i);
+  return v;
+}
+
+/// Fields of a record
+struct RecordHeader
+{
+  uint64_t key;
+  uint32_t cluster_bytes;
+  uint32_t n;
+  unsigned char width;
+
+  /// Bytes of the record, without the checksum
+  size_t size() const
+  {
+    return RECORD_BYTES + cluster_bytes + (size_t)n * width;
+  }
+};
+
+/// Reads a record at the current position of the file
+/// @param f file
+/// @param header (out) fields of the record
+/// @param data (out) whole record, without the checksum
+/// @return false if the record is not complete or its checksum is wrong
+bool readRecord(FILE *f, RecordHeader &header, vector<unsigned char> &data)
+{
+  data.resize(RECORD_BYTES);
+  if(fread(data.data(), 1, RECORD_BYTES, f) != RECORD_BYTES) return false;
+
+  header.key = getNumber(&data[0], 8);
+  header.cluster_bytes = (uint32_t)getNumber(&data[8], 4);
+  header.n = (uint32_t)getNumber(&data[12], 4);
+  header.width = data[16];
+  if(header.width != 1 && header.width != 2 && header.width != 4)
+    return false;
+
+  const size_t size = header.size();
+  data.resize(size + 8);
+  if(fread(&data[RECORD_BYTES], 1, size + 8 - RECORD_BYTES, f) !=
+    size + 8 - RECORD_BYTES)
+  {
+    return false;
+  }
+
+  const uint64_t checksum = getNumber(&data[size], 8);
+  data.resize(size);
+  return checksum == TrainingCheckpoint::hash(data.data(), size);
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+TrainingCheckpoint::TrainingCheckpoint(const std::string &filename,
+  unsigned long long fingerprint)
+  : m_filename(filename), m_end(HEADER_BYTES)
+{
+  vector<unsigned char> header;
+  header.insert(header.end(), CHECKPOINT_MAGIC, CHECKPOINT_MAGIC + 4);
+  putNumber(header, CHECKPOINT_VERSION, 4);
+  putNumber(header, fingerprint, 8);
+
+  m_file = fopen(filename.c_str(), "r+b");
+
+  if(m_file)
+  {
+    unsigned char stored[HEADER_BYTES];
+    if(fread(stored, 1, HEADER_BYTES, m_file) != (size_t)HEADER_BYTES ||
+      !equal(stored, stored + 4, CHECKPOINT_MAGIC))
+    {
+      fclose(m_file);
+      throw filename + " is not a training checkpoint";
+    }
+
+    if(!equal(stored, stored + HEADER_BYTES, header.begin()))
+    {
+      fclose(m_file);
+      throw string("Checkpoint ") + filename + " belongs to another "
+        "training: the parameters, the seed or the descriptors differ";
+    }
+
+    // index the complete records. Anything after them was cut by an
+    // interruption, and is overwritten by the next records
+    RecordHeader record;
+    vector<unsigned char> data;
+    while(readRecord(m_file, record, data))
+    {
+      m_records[record.key] = m_end;
+      m_end += (long)(data.size() + 8);
+    }
+  }
+  else
+  {
+    m_file = fopen(filename.c_str(), "w+b");
+    if(!m_file) throw string("Could not create file ") + filename;
+
+    if(fwrite(header.data(), 1, header.size(), m_file) != header.size() ||
+      fflush(m_file) != 0)
+    {
+      fclose(m_file);
+      throw string("Could not write file ") + filename;
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+
+TrainingCheckpoint::~TrainingCheckpoint()
+{
+  if(m_file) fclose(m_file);
+}
+
+// --------------------------------------------------------------------------
+
+size_t TrainingCheckpoint::size() const
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  return m_records.size();
+}
+
+// --------------------------------------------------------------------------
+
+bool TrainingCheckpoint::find(unsigned long long key, Split &split)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  std::unordered_map<unsigned long long, long>::const_iterator it =
+    m_records.find(key);
+  if(it == m_records.end()) return false;
+
+  RecordHeader record;
+  vector<unsigned char> data;
+  if(fseek(m_file, it->second, SEEK_SET) != 0 ||
+    !readRecord(m_file, record, data) || record.key != key)
+  {
+    throw string("Could not read checkpoint ") + m_filename;
+  }
+
+  const unsigned char *p = &data[RECORD_BYTES];
+  split.clusters.assign(p, p + record.cluster_bytes);
+  p += record.cluster_bytes;
+
+  split.association.resize(record.n);
+  for(uint32_t i = 0; i < record.n; ++i, p += record.width)
+    split.association[i] = (int)getNumber(p, record.width);
+
+  return true;
+}
+
+// --------------------------------------------------------------------------
+
+void TrainingCheckpoint::save(unsigned long long key,
+  const unsigned char *clusters, size_t bytes, const int *association,
+  size_t n)
+{
+  // the associations take the bytes of the largest one
+  int max_association = 0;
+  for(size_t i = 0; i < n; ++i)
+    max_association = std::max(max_association, association[i]);
+
+  const unsigned char width =
+    (max_association < 256 ? 1 : (max_association < 65536 ? 2 : 4));
+
+  vector<unsigned char> data;
+  data.reserve(RECORD_BYTES + bytes + n * width + 8);
+  putNumber(data, key, 8);
+  putNumber(data, bytes, 4);
+  putNumber(data, n, 4);
+  data.push_back(width);
+  data.insert(data.end(), clusters, clusters + bytes);
+  for(size_t i = 0; i < n; ++i) putNumber(data, association[i], width);
+  putNumber(data, hash(data.data(), data.size()), 8);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  if(fseek(m_file, m_end, SEEK_SET) != 0 ||
+    fwrite(data.data(), 1, data.size(), m_file) != data.size() ||
+    fflush(m_file) != 0)
+  {
+    throw string("Could not write checkpoint ") + m_filename;
+  }
+
+  m_records[key] = m_end;
+  m_end += (long)data.size();
+}
+
+// --------------------------------------------------------------------------
+
+void TrainingCheckpoint::remove()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  if(m_file)
+  {
+    fclose(m_file);
+    m_file = NULL;
+    std::remove(m_filename.c_str());
+  }
+  m_records.clear();
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long TrainingCheckpoint::childKey(unsigned long long key,
+  unsigned int i)
+{
+  // splitmix64 finalizer
+  unsigned long long z = key + (i + 1ULL) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long TrainingCheckpoint::hash(const void *data, size_t bytes,
+  unsigned long long h)
+{
+  const unsigned char *p = (const unsigned char *)data;
+  for(size_t i = 0; i < bytes; ++i)
+  {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
@@ -0,0 +1,353 @@
+/**
+ * File: VocabularyFile.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: binary vocabulary file that can be memory-mapped and used
+ *   without parsing
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "VocabularyFile.h"
+
+using namespace std;
+
+namespace DBoW2 {
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+const char VOCABULARY_MAGIC[4] = { 'D', 'B', 'V', 'B' };
+
+/// Returns whether the tables can be used in place in this host
+bool littleEndian()
+{
+  const uint16_t one = 1;
+  return *(const unsigned char *)&one == 1;
+}
+
+/// Rounds a size up to the alignment of the sections
+uint64_t align(uint64_t bytes)
+{
+  const uint64_t a = VocabularyFile::ALIGNMENT;
+  return (bytes + a - 1) / a * a;
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+uint64_t VocabularyFile::checksum(const void *data, size_t bytes,
+  uint64_t h)
+{
+  // taking 8-byte words is about 8 times faster than hashing each byte.
+  // The multiplication only carries the bits of a word upwards, so the
+  // high bits are folded back after each word
+  const unsigned char *p = (const unsigned char *)data;
+
+  size_t i = 0;
+  for(; i + 8 <= bytes; i += 8)
+  {
+    uint64_t w;
+    memcpy(&w, p + i, 8);
+    h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+  }
+  for(; i < bytes; ++i)
+  {
+    h = (h ^ p[i]) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+  }
+  return h;
+}
+
+// --------------------------------------------------------------------------
+
+uint64_t VocabularyFile::fileHash(const unsigned char *data, size_t bytes)
+{
+  Header header;
+  memcpy(&header, data, sizeof(header));
+  header.checksum = 0;
+
+  const uint64_t h = checksum(&header, sizeof(header));
+  return checksum(data + sizeof(header), bytes - sizeof(header), h);
+}
+
+// --------------------------------------------------------------------------
+
+void VocabularyFile::compose(const Header &parameters,
+  const std::vector<Node> &nodes, const unsigned char *descriptors,
+  const std::vector<uint32_t> &words, std::vector<unsigned char> &data)
+{
+  if(!littleEndian())
+    throw string("Binary vocabularies need a little-endian host");
+
+  Header header = parameters;
+  memcpy(header.magic, VOCABULARY_MAGIC, 4);
+  header.version = VERSION;
+  header.header_bytes = sizeof(Header);
+  header.nodes = nodes.size();
+  header.words = words.size();
+  header.nodes_offset = align(sizeof(Header));
+  header.descriptors_offset =
+    align(header.nodes_offset + nodes.size() * sizeof(Node));
+  header.words_offset = align(header.descriptors_offset +
+    (uint64_t)nodes.size() * header.descriptor_bytes);
+  header.index_offset =
+    align(header.words_offset + words.size() * sizeof(uint32_t));
+  header.file_bytes =
+    align(header.index_offset + nodes.size() * sizeof(uint32_t));
+  header.checksum = 0;
+  header.reserved = 0;
+
+  // padding included
+  data.assign(header.file_bytes, 0);
+  memcpy(&data[0], &header, sizeof(header));
+
+  if(!nodes.empty())
+  {
+    memcpy(&data[header.nodes_offset], &nodes[0],
+      nodes.size() * sizeof(Node));
+    memcpy(&data[header.descriptors_offset], descriptors,
+      nodes.size() * header.descriptor_bytes);
+
+    uint32_t *index = (uint32_t *)&data[header.index_offset];
+    for(uint32_t i = 0; i < nodes.size(); ++i)
+    {
+      if(nodes[i].id >= nodes.size())
+        throw string("Wrong node id in a binary vocabulary");
+      index[nodes[i].id] = i;
+    }
+  }
+
+  if(!words.empty())
+  {
+    memcpy(&data[header.words_offset], &words[0],
+      words.size() * sizeof(uint32_t));
+  }
+
+  header.checksum = fileHash(&data[0], data.size());
+  memcpy(&data[0], &header, sizeof(header));
+}
+
+// --------------------------------------------------------------------------
+
+void VocabularyFile::save(const std::string &filename,
+  const std::vector<unsigned char> &data)
+{
+  FILE *f = fopen(filename.c_str(), "wb");
+  if(!f) throw string("Could not open file ") + filename;
+
+  const bool ok = (fwrite(&data[0], 1, data.size(), f) == data.size());
+  if(fclose(f) != 0 || !ok)
+    throw string("Could not write file ") + filename;
+}
+
+// --------------------------------------------------------------------------
+
+bool VocabularyFile::isVocabularyFile(const std::string &filename)
+{
+  FILE *f = fopen(filename.c_str(), "rb");
+  if(!f) return false;
+
+  char magic[4];
+  const bool ok = (fread(magic, 1, 4, f) == 4 &&
+    equal(magic, magic + 4, VOCABULARY_MAGIC));
+  fclose(f);
+  return ok;
+}
+
+// --------------------------------------------------------------------------
+
+VocabularyFile::VocabularyFile(const std::string &filename, bool verify)
+  : m_filename(filename), m_data(NULL), m_size(0), m_mapped(false)
+{
+#ifndef _WIN32
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0) throw string("Could not open file ") + filename;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0)
+  {
+    close(fd);
+    throw string("Could not read file ") + filename;
+  }
+
+  m_size = st.st_size;
+  if(m_size >= sizeof(Header))
+  {
+    void *p = mmap(NULL, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(p != MAP_FAILED)
+    {
+      m_data = (const unsigned char *)p;
+      m_mapped = true;
+    }
+  }
+  close(fd);
+#endif
+
+  if(!m_mapped)
+  {
+    // read the file in an 8-byte aligned buffer
+    FILE *f = fopen(filename.c_str(), "rb");
+    if(!f) throw string("Could not open file ") + filename;
+
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    m_size = (size > 0 ? size : 0);
+    m_buffer.resize((m_size + 7) / 8);
+    const bool ok =
+      (m_size == 0 || fread(&m_buffer[0], 1, m_size, f) == m_size);
+    fclose(f);
+
+    if(!ok) throw string("Could not read file ") + filename;
+    m_data = (const unsigned char *)(m_buffer.empty() ? NULL : &m_buffer[0]);
+  }
+
+  try
+  {
+    check(filename, verify);
+  }
+  catch(...)
+  {
+#ifndef _WIN32
+    if(m_mapped) munmap((void *)m_data, m_size);
+#endif
+    throw;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+VocabularyFile::VocabularyFile(const unsigned char *data, size_t size,
+  const std::string &name, bool verify)
+  : m_filename(name), m_data(NULL), m_size(size), m_mapped(false)
+{
+  // 8-byte aligned copy
+  m_buffer.resize((size + 7) / 8);
+  if(size > 0)
+  {
+    memcpy(&m_buffer[0], data, size);
+    m_data = (const unsigned char *)&m_buffer[0];
+  }
+
+  check(name, verify);
+}
+
+// --------------------------------------------------------------------------
+
+VocabularyFile::~VocabularyFile()
+{
+#ifndef _WIN32
+  if(m_mapped) munmap((void *)m_data, m_size);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+void VocabularyFile::check(const std::string &filename, bool verify) const
+{
+  if(m_size < sizeof(Header) ||
+    !equal(m_data, m_data + 4, VOCABULARY_MAGIC))
+  {
+    throw filename + " is not a binary vocabulary";
+  }
+
+  const Header &h = header();
+  if(h.version != VERSION)
+    throw string("Unsupported version of binary vocabulary ") + filename;
+
+  if(!littleEndian())
+    throw string("Binary vocabularies need a little-endian host");
+
+  const string corrupt = string("Binary vocabulary ") + filename +
+    " is corrupt";
+
+  // the sections must be inside the file
+  auto fits = [this](uint64_t offset, uint64_t bytes)
+    {
+      return offset % 8 == 0 && offset <= m_size && bytes <= m_size - offset;
+    };
+
+  if(h.header_bytes != sizeof(Header) || h.file_bytes != m_size ||
+    !fits(h.nodes_offset, (uint64_t)h.nodes * sizeof(Node)) ||
+    !fits(h.descriptors_offset, (uint64_t)h.nodes * h.descriptor_bytes) ||
+    !fits(h.words_offset, (uint64_t)h.words * sizeof(uint32_t)) ||
+    !fits(h.index_offset, (uint64_t)h.nodes * sizeof(uint32_t)) ||
+    (h.nodes == 0 && h.words != 0) || (h.nodes > 0 && h.words == 0) ||
+    (h.nodes > 0 && h.descriptor_bytes == 0))
+  {
+    throw corrupt;
+  }
+
+  if(verify && h.checksum != fileHash(m_data, m_size)) throw corrupt;
+
+  // the tables must be a tree in level order, so that they can be
+  // traversed without checking them again
+  const Node *table = nodes();
+  const uint32_t *index = nodeIndex();
+  const uint32_t *word_table = words();
+
+  for(uint32_t i = 0; i < h.nodes; ++i)
+  {
+    const Node &node = table[i];
+
+    if(node.id >= h.nodes || index[node.id] != i || node.parent >= h.nodes ||
+      (i == 0 && node.parent != 0) || (i > 0 && node.parent >= i))
+    {
+      throw corrupt;
+    }
+
+    if(node.n_children > 0)
+    {
+      if(node.first_child <= i ||
+        (uint64_t)node.first_child + node.n_children > h.nodes)
+      {
+        throw corrupt;
+      }
+
+      for(uint32_t c = 0; c < node.n_children; ++c)
+      {
+        if(table[node.first_child + c].parent != i) throw corrupt;
+      }
+    }
+    else if(i > 0)
+    {
+      if(node.word_id >= h.words || word_table[node.word_id] != i)
+        throw corrupt;
+    }
+  }
+
+  for(uint32_t w = 0; w < h.words; ++w)
+  {
+    if(word_table[w] == 0 || word_table[w] >= h.nodes ||
+      table[word_table[w]].n_children > 0 ||
+      table[word_table[w]].word_id != w)
+    {
+      throw corrupt;
+    }
+  }
+
+  if(h.nodes > 0 && table[0].n_children == 0) throw corrupt;
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
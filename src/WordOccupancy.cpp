@@ -0,0 +1,121 @@
+/**
+ * File: WordOccupancy.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: distribution of a set of descriptors among the words of
+ *   a vocabulary
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "WordOccupancy.h"
+
+using namespace std;
+
+namespace DBoW2 {
+
+// --------------------------------------------------------------------------
+
+WordOccupancy::WordOccupancy()
+  : words(0), empty_words(0), descriptors(0), images(0), 
+    max_descriptors(0), mean_descriptors(0), gini(0), max_images(0), 
+    mean_images(0), expected_images(0), mean_distance(0)
+{
+}
+
+// --------------------------------------------------------------------------
+
+void WordOccupancy::compute(const std::vector<unsigned int> &word_descriptors,
+  const std::vector<unsigned int> &word_images, unsigned int images,
+  double distance_sum)
+{
+  *this = WordOccupancy();
+  this->words = word_descriptors.size();
+  this->images = images;
+  
+  double weighted_images = 0, images_sum = 0;
+  for(size_t w = 0; w < word_descriptors.size(); ++w)
+  {
+    const unsigned int n = word_descriptors[w];
+    const unsigned int N = word_images[w];
+    
+    if(n == 0) ++empty_words;
+    descriptors += n;
+    max_descriptors = std::max(max_descriptors, n);
+    max_images = std::max(max_images, N);
+    images_sum += N;
+    weighted_images += (double)n * N;
+  }
+  
+  if(words == 0 || descriptors == 0) return;
+  
+  mean_descriptors = (double)descriptors / words;
+  mean_images = images_sum / words;
+  expected_images = weighted_images / descriptors;
+  mean_distance = distance_sum / descriptors;
+  
+  // gini = sum_i (2i - W - 1) x_i / (W sum_i x_i), with x sorted ascending
+  // and i = 1..W
+  vector<unsigned int> sorted(word_descriptors);
+  std::sort(sorted.begin(), sorted.end());
+  
+  double g = 0;
+  for(size_t i = 0; i < sorted.size(); ++i)
+  {
+    g += (2. * (i + 1) - (double)words - 1.) * sorted[i];
+  }
+  gini = g / ((double)words * descriptors);
+}
+
+// --------------------------------------------------------------------------
+
+void WordOccupancy::printChange(std::ostream &os, 
+  const WordOccupancy &before) const
+{
+  auto line = [&os](const char *name, double a, double b)
+    {
+      os << name << ": " << a << " -> " << b;
+      if(a != 0) 
+        os << " (" << (b > a ? "+" : "") << 100. * (b - a) / a << "%)";
+      os << endl;
+    };
+  
+  line("Words", before.words, words);
+  line("Empty words", before.empty_words, empty_words);
+  line("Descriptors", (double)before.descriptors, (double)descriptors);
+  line("Max descriptors per word", before.max_descriptors, max_descriptors);
+  line("Mean descriptors per word", before.mean_descriptors, 
+    mean_descriptors);
+  line("Gini of descriptors per word", before.gini, gini);
+  line("Max images per word", before.max_images, max_images);
+  line("Mean images per word", before.mean_images, mean_images);
+  line("Expected images per query word", before.expected_images, 
+    expected_images);
+  line("Mean distance to words", before.mean_distance, mean_distance);
+}
+
+// --------------------------------------------------------------------------
+
+std::ostream& operator<<(std::ostream &os, const WordOccupancy &occupancy)
+{
+  os << "Words: " << occupancy.words 
+    << " (" << occupancy.empty_words << " empty)" << endl
+    << "Descriptors: " << occupancy.descriptors 
+    << " in " << occupancy.images << " images" << endl
+    << "Descriptors per word: max = " << occupancy.max_descriptors
+    << ", mean = " << occupancy.mean_descriptors 
+    << ", Gini = " << occupancy.gini << endl
+    << "Images per word: max = " << occupancy.max_images
+    << ", mean = " << occupancy.mean_images 
+    << ", expected per query word = " << occupancy.expected_images << endl
+    << "Mean distance to words: " << occupancy.mean_distance;
+  return os;
+}
+
+// --------------------------------------------------------------------------
+
+} // namespace DBoW2
@@ -0,0 +1,209 @@
+/**
+ * File: TestUtils.h
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks and training data shared by the tests
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#ifndef __D_T_TEST_UTILS__
+#define __D_T_TEST_UTILS__
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <random>
+
+#include "DBoW2.h"
+
+/// Number of checks failed by the test
+static int test_failures = 0;
+
+/// Checks a condition, and reports it if it is false
+#define TEST_CHECK(condition) \
+  do \
+  { \
+    if(!(condition)) \
+    { \
+      ++test_failures; \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": failed: " \
+        << #condition << std::endl; \
+    } \
+  } while(0)
+
+/// Checks that a statement throws a string, as the library does on errors
+#define TEST_THROWS(statement) \
+  do \
+  { \
+    bool thrown = false; \
+    try { statement; } catch(const std::string &) { thrown = true; } \
+    if(!thrown) \
+    { \
+      ++test_failures; \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": did not throw: " \
+        << #statement << std::endl; \
+    } \
+  } while(0)
+
+// --------------------------------------------------------------------------
+
+/**
+ * Returns the exit code of the test, and prints the checks failed
+ * @param name name of the test
+ * @return 0 iff no check failed
+ */
+inline int testResult(const char *name)
+{
+  if(test_failures == 0)
+  {
+    std::cout << name << ": passed" << std::endl;
+    return 0;
+  }
+  std::cout << name << ": " << test_failures << " checks failed"
+    << std::endl;
+  return 1;
+}
+
+// --------------------------------------------------------------------------
+
+/**
+ * Creates random 32-byte descriptors for some images. Each descriptor is
+ * one of some prototypes with some bits flipped, so that they form
+ * clusters, and consecutive images share half of their prototypes, so
+ * that they are similar
+ * @param images number of images
+ * @param per_image descriptors per image
+ * @param seed seed of the random numbers
+ * @param raw (out) descriptors of each image, one after the other
+ */
+inline void randomImages(int images, int per_image, unsigned int seed,
+  std::vector<std::vector<unsigned char> > &raw)
+{
+  const int BYTES = 32;
+  const int PROTOTYPES = 400; // per image
+  std::mt19937 engine(seed);
+
+  std::vector<std::vector<unsigned char> > prototypes(
+    (images + 1) * PROTOTYPES / 2, std::vector<unsigned char>(BYTES));
+  for(size_t i = 0; i < prototypes.size(); ++i)
+    for(int b = 0; b < BYTES; ++b) prototypes[i][b] = engine() & 0xff;
+
+  raw.assign(images, std::vector<unsigned char>());
+  for(int i = 0; i < images; ++i)
+  {
+    raw[i].reserve(per_image * BYTES);
+    for(int j = 0; j < per_image; ++j)
+    {
+      std::vector<unsigned char> d =
+        prototypes[i * PROTOTYPES / 2 + engine() % PROTOTYPES];
+      for(int f = 0; f < 40; ++f) d[engine() % BYTES] ^= 1 << engine() % 8;
+      raw[i].insert(raw[i].end(), d.begin(), d.end());
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+
+/**
+ * Converts raw descriptors into descriptor objects of F
+ * @param raw descriptors of each image
+ * @param features (out) descriptors of each image
+ */
+template<class F, class TDescriptor>
+void toDescriptors(const std::vector<std::vector<unsigned char> > &raw,
+  std::vector<std::vector<TDescriptor> > &features)
+{
+  features.assign(raw.size(), std::vector<TDescriptor>());
+  for(size_t i = 0; i < raw.size(); ++i)
+  {
+    for(size_t j = 0; j < raw[i].size() / F::BYTES; ++j)
+    {
+      TDescriptor d;
+      F::fromArray8U(d, &raw[i][j * F::BYTES]);
+      DBoW2::detachDescriptor(d);
+      features[i].push_back(d);
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+
+/**
+ * Packs raw descriptors in a single buffer
+ * @param raw descriptors of each image
+ * @param packed (out) descriptors, with 32 bytes per descriptor
+ */
+inline void toPacked(const std::vector<std::vector<unsigned char> > &raw,
+  DBoW2::PackedDescriptors &packed)
+{
+  packed.clear();
+  for(size_t i = 0; i < raw.size(); ++i)
+    packed.add(raw[i].data(), raw[i].size() / packed.descriptorBytes());
+}
+
+// --------------------------------------------------------------------------
+
+/**
+ * Returns the binary file of a vocabulary, which tells whether two
+ * vocabularies are equal
+ * @param voc
+ * @return data of the file
+ */
+template<class Vocabulary>
+std::vector<unsigned char> binaryData(const Vocabulary &voc)
+{
+  std::vector<unsigned char> data;
+  voc.saveBinary(data);
+  return data;
+}
+
+// --------------------------------------------------------------------------
+
+/**
+ * Describes what a database returns: its entries, the results of some
+ * queries and the direct index, which tells whether two databases are
+ * equal
+ * @param db
+ * @param queries features of each query
+ * @return description
+ */
+template<class TDescriptor, class F>
+std::string databaseState(const DBoW2::TemplatedDatabase<TDescriptor, F> &db,
+  const std::vector<std::vector<TDescriptor> > &queries)
+{
+  std::ostringstream s;
+  s.precision(17);
+  s << db.size() << " " << db.getFirstEntry() << " " << db.removedSize()
+    << " " << db.usingDirectIndex() << " " << db.getDirectIndexLevels()
+    << "\n";
+
+  for(size_t i = 0; i < queries.size(); ++i)
+  {
+    DBoW2::QueryResults ret;
+    db.query(queries[i], ret, 0);
+    for(size_t j = 0; j < ret.size(); ++j)
+      s << ret[j].Id << ":" << ret[j].Score << " ";
+    s << "\n";
+  }
+
+  for(DBoW2::EntryId id = db.getFirstEntry(); db.usingDirectIndex() &&
+    id < (DBoW2::EntryId)db.size(); ++id)
+  {
+    const DBoW2::FeatureVector &fv = db.retrieveFeatures(id);
+    for(DBoW2::FeatureVector::const_iterator it = fv.begin();
+      it != fv.end(); ++it)
+    {
+      s << it->first << ":";
+      for(size_t j = 0; j < it->second.size(); ++j)
+        s << it->second[j] << ",";
+    }
+    s << "\n";
+  }
+  return s.str();
+}
+
+// --------------------------------------------------------------------------
+
+#endif
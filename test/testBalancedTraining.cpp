@@ -0,0 +1,127 @@
+/**
+ * File: testBalancedTraining.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the occupancy of the vocabularies created with 
+ *   balanced clusters
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+/// Vocabulary that records the number of descriptors of each clustered node
+template<class TDescriptor, class F>
+class RecordingVocabulary: public TemplatedVocabulary<TDescriptor, F>
+{
+public:
+  typedef TemplatedVocabulary<TDescriptor, F> Base;
+
+  RecordingVocabulary(): Base(9, 3, TF_IDF, L1_NORM){}
+
+  /// Descriptors of each clustered node
+  mutable vector<size_t> nodes;
+
+protected:
+  virtual void initiateClusters(
+    const vector<typename Base::pDescriptor> &descriptors,
+    vector<TDescriptor> &clusters) const
+  {
+    nodes.push_back(descriptors.size());
+    Base::initiateClusters(descriptors, clusters);
+  }
+};
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+  PackedDescriptors packed(F::BYTES);
+  toPacked(raw, packed);
+
+  TrainingOptions options;
+  options.max_occupancy = 1;
+
+  // clusters of equal size: no node below the root has more than n / k
+  // descriptors, rounded up
+  RecordingVocabulary<TDescriptor, F> even;
+  even.setTrainingOptions(options);
+  srand(15);
+  even.create(features);
+  const size_t n = even.nodes[0];
+  TEST_CHECK(n == packed.size());
+  TEST_CHECK(*max_element(even.nodes.begin() + 1, even.nodes.end()) <=
+    (n + 8) / 9);
+
+  // balanced words have fewer training descriptors than unbalanced ones
+  Vocabulary unbalanced(9, 3, TF_IDF, L1_NORM);
+  srand(15);
+  unbalanced.create(features);
+
+  options.max_occupancy = 1.5;
+  Vocabulary voc(9, 3, TF_IDF, L1_NORM);
+  voc.setTrainingOptions(options);
+  srand(15);
+  voc.create(features);
+
+  WordOccupancy a, b;
+  unbalanced.computeOccupancy(features, a);
+  voc.computeOccupancy(features, b);
+  TEST_CHECK(b.descriptors == a.descriptors);
+  TEST_CHECK(b.max_descriptors < a.max_descriptors && b.gini < a.gini);
+  TEST_CHECK(b.mean_distance < 1.2 * a.mean_distance);
+
+  // the same with threads and from packed descriptors
+  ThreadPool pool(3);
+  Vocabulary threaded(9, 3, TF_IDF, L1_NORM);
+  threaded.setTrainingOptions(options);
+  threaded.setThreadPool(&pool);
+  srand(15);
+  threaded.create(features);
+  TEST_CHECK(binaryData(threaded) == binaryData(voc));
+
+  Vocabulary from_packed(9, 3, TF_IDF, L1_NORM);
+  from_packed.setTrainingOptions(options);
+  srand(15);
+  from_packed.create(packed);
+  TEST_CHECK(binaryData(from_packed) == binaryData(voc));
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 15, raw);
+
+  // an image with many descriptors close to a few ones, which unbalanced
+  // clusters gather in a few words
+  mt19937 engine(15);
+  raw.push_back(vector<unsigned char>());
+  for(int i = 0; i < 2000; ++i)
+  {
+    vector<unsigned char> d(raw[0].begin() + i % 50 * 32,
+      raw[0].begin() + i % 50 * 32 + 32);
+    for(int f = 0; f < 50; ++f) d[engine() % 32] ^= 1 << engine() % 8;
+    raw.back().insert(raw.back().end(), d.begin(), d.end());
+  }
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testBalancedTraining");
+}
@@ -0,0 +1,127 @@
+/**
+ * File: testBinaryVocabulary.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the round trip of the binary vocabulary files, and
+ *   that damaged files are refused
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+static const char *FILENAME = "testBinaryVocabulary.dbow2";
+
+// ----------------------------------------------------------------------------
+
+/// Whether two vocabularies transform some images in the same way
+template<class TDescriptor, class F>
+bool sameTransforms(const TemplatedVocabulary<TDescriptor, F> &a,
+  const TemplatedVocabulary<TDescriptor, F> &b,
+  const vector<vector<TDescriptor> > &features)
+{
+  bool same = a.size() == b.size();
+  for(size_t i = 0; same && i < features.size(); ++i)
+  {
+    BowVector va, vb;
+    FeatureVector fa, fb;
+    a.transform(features[i], va, fa, 2);
+    b.transform(features[i], vb, fb, 2);
+    same = (va == vb && fa == fb);
+  }
+  for(WordId w = 0; same && w < a.size(); ++w)
+    same = a.getWordWeight(w) == b.getWordWeight(w) &&
+      a.getParentNode(w, 1) == b.getParentNode(w, 1);
+  return same;
+}
+
+// ----------------------------------------------------------------------------
+
+/// Writes some contents into the file
+void writeFile(const vector<unsigned char> &data)
+{
+  FILE *f = fopen(FILENAME, "wb");
+  fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+
+  Vocabulary voc(9, 3, TF_IDF, L1_NORM);
+  srand(16);
+  voc.create(features);
+  const vector<unsigned char> data = binaryData(voc);
+
+  // saved and loaded, by loadBinary and by load
+  voc.saveBinary(FILENAME);
+  TEST_CHECK(VocabularyFile::isVocabularyFile(FILENAME));
+  Vocabulary loaded, detected;
+  loaded.loadBinary(FILENAME);
+  detected.load(FILENAME);
+  TEST_CHECK(binaryData(loaded) == data && binaryData(detected) == data);
+  TEST_CHECK(sameTransforms(voc, loaded, features));
+  TEST_CHECK(loaded.getBinaryHash() == voc.getBinaryHash());
+
+  // from memory
+  VocabularyFile file(data.data(), data.size(), "memory");
+  Vocabulary copied;
+  copied.loadBinary(file);
+  TEST_CHECK(binaryData(copied) == data);
+
+  // a changed byte breaks the checksum
+  vector<unsigned char> corrupt = data;
+  corrupt[corrupt.size() / 2] ^= 1;
+  writeFile(corrupt);
+  TEST_THROWS(loaded.loadBinary(FILENAME));
+
+  // truncated files
+  for(size_t size : { (size_t)0, (size_t)10, sizeof(VocabularyFile::Header),
+    data.size() / 2, data.size() - 1 })
+  {
+    writeFile(vector<unsigned char>(data.begin(), data.begin() + size));
+    TEST_THROWS(loaded.loadBinary(FILENAME));
+  }
+
+  // descriptors of another size, with a valid checksum
+  vector<unsigned char> other = data;
+  VocabularyFile::Header header;
+  memcpy(&header, other.data(), sizeof(header));
+  header.descriptor_bytes = 16;
+  header.checksum = 0;
+  memcpy(other.data(), &header, sizeof(header));
+  header.checksum = VocabularyFile::fileHash(other.data(), other.size());
+  memcpy(other.data(), &header, sizeof(header));
+  TEST_THROWS(copied.loadBinary(VocabularyFile(other.data(), other.size(),
+    "memory")));
+
+  remove(FILENAME);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 16, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testBinaryVocabulary");
+}
@@ -0,0 +1,73 @@
+/**
+ * File: testBoundedAssignment.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks that the assignments with distance bounds create the
+ *   same vocabularies as the full assignment
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+  PackedDescriptors packed(F::BYTES);
+  toPacked(raw, packed);
+
+  Vocabulary reference(9, 3, TF_IDF, L1_NORM);
+  srand(10);
+  reference.create(features);
+  const vector<unsigned char> expected = binaryData(reference);
+
+  ThreadPool pool(3);
+  for(AssignmentType assignment : { HAMERLY_ASSIGNMENT, ELKAN_ASSIGNMENT })
+  {
+    TrainingOptions options;
+    options.assignment = assignment;
+
+    Vocabulary voc(9, 3, TF_IDF, L1_NORM);
+    voc.setTrainingOptions(options);
+    srand(10);
+    voc.create(features);
+    TEST_CHECK(binaryData(voc) == expected);
+
+    Vocabulary threaded(9, 3, TF_IDF, L1_NORM);
+    threaded.setTrainingOptions(options);
+    threaded.setThreadPool(&pool);
+    srand(10);
+    threaded.create(features);
+    TEST_CHECK(binaryData(threaded) == expected);
+
+    Vocabulary from_packed(9, 3, TF_IDF, L1_NORM);
+    from_packed.setTrainingOptions(options);
+    srand(10);
+    from_packed.create(packed);
+    TEST_CHECK(binaryData(from_packed) == expected);
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 10, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testBoundedAssignment");
+}
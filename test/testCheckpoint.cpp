@@ -0,0 +1,201 @@
+/**
+ * File: testCheckpoint.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks that interrupted trainings resume from their
+ *   checkpoint files and create the vocabularies of uninterrupted ones
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+static const char *CHECKPOINT = "testCheckpoint.ckpt";
+
+// ----------------------------------------------------------------------------
+
+/// Vocabulary whose training is interrupted after some nodes
+template<class TDescriptor, class F>
+class InterruptedVocabulary: public TemplatedVocabulary<TDescriptor, F>
+{
+public:
+  typedef TemplatedVocabulary<TDescriptor, F> Base;
+
+  InterruptedVocabulary(): Base(9, 3, TF_IDF, L1_NORM), nodes_left(-1){}
+
+  /// Nodes seeded before the exception, or -1 not to interrupt
+  mutable int nodes_left;
+
+protected:
+  virtual void initiateClusters(
+    const vector<typename Base::pDescriptor> &descriptors,
+    vector<TDescriptor> &clusters) const
+  {
+    if(nodes_left == 0) throw string("interrupted");
+    if(nodes_left > 0) --nodes_left;
+    Base::initiateClusters(descriptors, clusters);
+  }
+};
+
+// ----------------------------------------------------------------------------
+
+/// Size of the given file, or -1 if it does not exist
+long fileSize(const char *filename)
+{
+  ifstream f(filename, ios::binary | ios::ate);
+  return f.is_open() ? (long)f.tellg() : -1;
+}
+
+// ----------------------------------------------------------------------------
+
+/// Removes the last bytes of the file, as an interrupted write would
+void cutFile(const char *filename, long bytes)
+{
+  vector<char> data;
+  {
+    ifstream f(filename, ios::binary);
+    data.assign(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+  }
+  ofstream f(filename, ios::binary | ios::trunc);
+  f.write(data.data(), data.size() - bytes);
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * Interrupts create(training), and checks that other trainings do not
+ * resume from its checkpoint and that the same one does
+ * @param other training that must not resume from the checkpoint
+ */
+template<class TDescriptor, class F, class Training>
+void testResume(const TrainingOptions &options, Training &training,
+  Training &other, const vector<unsigned char> &expected)
+{
+  remove(CHECKPOINT);
+
+  InterruptedVocabulary<TDescriptor, F> voc;
+  voc.setTrainingOptions(options);
+  voc.nodes_left = 20;
+  srand(14);
+  TEST_THROWS(voc.create(training));
+  voc.nodes_left = -1;
+  TEST_CHECK(fileSize(CHECKPOINT) > 0);
+
+  // another seed or other descriptors are refused
+  srand(15);
+  TEST_THROWS(voc.create(training));
+  srand(14);
+  TEST_THROWS(voc.create(other));
+
+  // a torn last record is discarded
+  cutFile(CHECKPOINT, 7);
+  srand(14);
+  voc.create(training);
+  TEST_CHECK(binaryData(voc) == expected);
+  TEST_CHECK(fileSize(CHECKPOINT) == -1);
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  // the same descriptors with one bit changed
+  vector<vector<unsigned char> > changed = raw;
+  changed[2][5] ^= 1;
+
+  vector<vector<TDescriptor> > features, other_features;
+  toDescriptors<F>(raw, features);
+  toDescriptors<F>(changed, other_features);
+  PackedDescriptors packed(F::BYTES), other_packed(F::BYTES);
+  toPacked(raw, packed);
+  toPacked(changed, other_packed);
+
+  ThreadPool pool(3);
+  for(int mini_batch = 0; mini_batch < 2; ++mini_batch)
+  {
+    TrainingOptions options;
+    if(mini_batch)
+    {
+      options.clustering = MINI_BATCH_KMEANS;
+      options.batch_size = 300;
+      options.max_iterations = 20;
+    }
+
+    Vocabulary reference(9, 3, TF_IDF, L1_NORM);
+    reference.setTrainingOptions(options);
+    srand(14);
+    reference.create(features);
+    const vector<unsigned char> expected = binaryData(reference);
+
+    options.checkpoint_file = CHECKPOINT;
+    testResume<TDescriptor, F>(options, features, other_features, expected);
+    testResume<TDescriptor, F>(options, packed, other_packed, expected);
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+void testStreamed(const vector<vector<unsigned char> > &raw)
+{
+  // the images of the same descriptors split in another way
+  vector<vector<unsigned char> > split = raw;
+  split[1].insert(split[1].end(), split[2].begin(), split[2].begin() + 32);
+  split[2].erase(split[2].begin(), split[2].begin() + 32);
+
+  vector<string> files, other_files;
+  files.push_back("testCheckpoint.0.shard");
+  other_files.push_back("testCheckpoint.1.shard");
+  {
+    ShardWriter writer(files[0], 32), other(other_files[0], 32);
+    for(size_t i = 0; i < raw.size(); ++i)
+    {
+      writer.add(raw[i].data(), raw[i].size() / 32);
+      other.add(split[i].data(), split[i].size() / 32);
+    }
+  }
+  ShardReader reader(files, 32), other(other_files, 32);
+
+  for(int in_memory : { 100000, 1500 })
+  {
+    TrainingOptions options;
+    options.max_in_memory = in_memory;
+
+    OrbVocabulary reference(9, 3, TF_IDF, L1_NORM);
+    reference.setTrainingOptions(options);
+    srand(14);
+    reference.create(reader);
+
+    options.checkpoint_file = CHECKPOINT;
+    testResume<FORB::TDescriptor, FORB, DescriptorReader>(options, reader,
+      other, binaryData(reference));
+  }
+
+  remove(files[0].c_str());
+  remove(other_files[0].c_str());
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 14, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+  testStreamed(raw);
+
+  return testResult("testCheckpoint");
+}
@@ -0,0 +1,86 @@
+/**
+ * File: testClusteringWeights.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the IDF weights counted with the assignments of the
+ *   clustering against those of the transformed training images
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <set>
+#include <cmath>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+  PackedDescriptors packed(F::BYTES);
+  toPacked(raw, packed);
+
+  for(WeightingType weighting : { TF_IDF, IDF })
+  {
+    // weights from the leaves the descriptors were assigned to
+    Vocabulary voc(9, 3, weighting, L1_NORM);
+    srand(11);
+    voc.create(features);
+
+    // the images each word appears in, transforming them again
+    vector<unsigned int> Ni(voc.size(), 0);
+    for(size_t i = 0; i < features.size(); ++i)
+    {
+      set<WordId> words;
+      for(size_t j = 0; j < features[i].size(); ++j)
+        words.insert(voc.transform(features[i][j]));
+      for(set<WordId>::const_iterator w = words.begin(); w != words.end();
+        ++w) ++Ni[*w];
+    }
+
+    bool same = true;
+    for(WordId w = 0; w < voc.size(); ++w)
+    {
+      const double expected = (Ni[w] > 0 ?
+        log((double)features.size() / Ni[w]) : 0);
+      same = same && fabs(voc.getWordWeight(w) - expected) < 1e-9;
+    }
+    TEST_CHECK(voc.size() > 500 && same);
+
+    // without duplicated descriptors, this is what transform_weights does
+    TrainingOptions options;
+    options.transform_weights = true;
+    Vocabulary transformed(9, 3, weighting, L1_NORM);
+    transformed.setTrainingOptions(options);
+    srand(11);
+    transformed.create(features);
+    TEST_CHECK(binaryData(transformed) == binaryData(voc));
+
+    Vocabulary from_packed(9, 3, weighting, L1_NORM);
+    srand(11);
+    from_packed.create(packed);
+    TEST_CHECK(binaryData(from_packed) == binaryData(voc));
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 11, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testClusteringWeights");
+}
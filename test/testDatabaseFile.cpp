@@ -0,0 +1,160 @@
+/**
+ * File: testDatabaseFile.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the round trip of the binary database snapshots, and
+ *   that damaged snapshots are refused without changing the database
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+static const char *SNAPSHOT = "testDatabaseFile.dbdb";
+static const char *DAMAGED = "testDatabaseFile.damaged.dbdb";
+static const char *VOCABULARY = "testDatabaseFile.dbow2";
+
+// ----------------------------------------------------------------------------
+
+/// Contents of a file
+vector<char> readFile(const char *filename)
+{
+  ifstream f(filename, ios::binary);
+  return vector<char>(istreambuf_iterator<char>(f),
+    istreambuf_iterator<char>());
+}
+
+// ----------------------------------------------------------------------------
+
+/// Writes some contents into a file
+void writeFile(const char *filename, const vector<char> &data)
+{
+  ofstream f(filename, ios::binary);
+  f.write(data.data(), data.size());
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testDatabase(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+  typedef TemplatedMappedVocabulary<TDescriptor, F> MappedVocabulary;
+  typedef TemplatedDatabase<TDescriptor, F> Database;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+
+  Vocabulary voc(9, 3, TF_IDF, L1_NORM), other(5, 3, TF_IDF, L1_NORM);
+  srand(19);
+  voc.create(features);
+  other.create(features);
+
+  for(int di = 0; di < 2; ++di)
+  for(int compress = 0; compress < 2; ++compress)
+  for(int embed = 0; embed < 2; ++embed)
+  {
+    Database db(voc, di == 1, 1);
+    for(size_t i = 0; i < features.size(); ++i) db.add(features[i]);
+    const string state = databaseState(db, features);
+    db.saveBinary(SNAPSHOT, embed == 1, compress == 1);
+
+    // with the same vocabulary, by loadBinary and by load
+    Database same(voc, di == 0, 3), loaded(voc);
+    same.loadBinary(SNAPSHOT);
+    loaded.load(SNAPSHOT);
+    TEST_CHECK(databaseState(same, features) == state);
+    TEST_CHECK(databaseState(loaded, features) == state);
+
+    // with another vocabulary or none, only if it is embedded
+    Database replaced(other);
+    if(embed)
+    {
+      Database read(SNAPSHOT);
+      replaced.loadBinary(SNAPSHOT);
+      TEST_CHECK(databaseState(read, features) == state);
+      TEST_CHECK(databaseState(replaced, features) == state);
+      TEST_CHECK(replaced.getVocabulary()->getBinaryHash() ==
+        voc.getBinaryHash());
+    }
+    else
+    {
+      TEST_THROWS(Database read(SNAPSHOT));
+      TEST_THROWS(replaced.loadBinary(SNAPSHOT));
+    }
+
+    // damaged snapshots leave the database as it was
+    Database kept(other, di == 0, 2);
+    kept.add(features[0]);
+    const string kept_state = databaseState(kept, features);
+    const vector<char> data = readFile(SNAPSHOT);
+    for(size_t pos : { (size_t)0, data.size() / 3, data.size() / 2,
+      data.size() - 1 })
+    {
+      vector<char> damaged = data;
+      damaged[pos] ^= 0x10;
+      writeFile(DAMAGED, damaged);
+      TEST_THROWS(kept.loadBinary(DAMAGED));
+      damaged.assign(data.begin(), data.begin() + pos);
+      writeFile(DAMAGED, damaged);
+      TEST_THROWS(kept.loadBinary(DAMAGED));
+    }
+    TEST_CHECK(databaseState(kept, features) == kept_state);
+    TEST_CHECK(kept.getVocabulary()->getBinaryHash() ==
+      other.getBinaryHash());
+  }
+
+  // a mapped vocabulary is kept, and embedded as its file
+  voc.saveBinary(VOCABULARY);
+  MappedVocabulary mapped(VOCABULARY);
+  Database db(mapped, true, 2);
+  for(size_t i = 0; i < features.size(); ++i) db.add(features[i]);
+  const string state = databaseState(db, features);
+
+  db.saveBinary(SNAPSHOT, false);
+  Database same(mapped, false);
+  same.load(SNAPSHOT);
+  TEST_CHECK(databaseState(same, features) == state);
+  TEST_CHECK(dynamic_cast<const MappedVocabulary*>(same.getVocabulary()));
+
+  db.saveBinary(SNAPSHOT, true);
+  Database read(SNAPSHOT);
+  TEST_CHECK(databaseState(read, features) == state);
+
+  // an empty database
+  Database empty(voc);
+  empty.saveBinary(SNAPSHOT);
+  Database read_empty(SNAPSHOT);
+  TEST_CHECK(read_empty.size() == 0 &&
+    read_empty.getVocabulary()->size() == voc.size());
+
+  // other files
+  TEST_THROWS(read_empty.loadBinary(VOCABULARY));
+  remove(SNAPSHOT);
+  TEST_THROWS(read_empty.loadBinary(SNAPSHOT));
+
+  remove(DAMAGED);
+  remove(VOCABULARY);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 500, 19, raw);
+
+  testDatabase<FORB::TDescriptor, FORB>(raw);
+  testDatabase<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testDatabaseFile");
+}
@@ -0,0 +1,177 @@
+/**
+ * File: testDatabaseJournal.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks that databases are recovered from their snapshots
+ *   and journals, also after torn writes and interrupted checkpoints
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+static const char *SNAPSHOT = "testDatabaseJournal.dbdb";
+static const char *JOURNAL = "testDatabaseJournal.log";
+static const char *TORN = "testDatabaseJournal.torn.log";
+
+// ----------------------------------------------------------------------------
+
+/// Size of the given file, or -1 if it does not exist
+long fileSize(const char *filename)
+{
+  ifstream f(filename, ios::binary | ios::ate);
+  return f.is_open() ? (long)f.tellg() : -1;
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testDatabase(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+  typedef TemplatedDatabase<TDescriptor, F> Database;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+
+  Vocabulary voc(9, 3, TF_IDF, L1_NORM), other(5, 3, TF_IDF, L1_NORM);
+  srand(20);
+  voc.create(features);
+  other.create(features);
+
+  for(int di = 0; di < 2; ++di)
+  {
+    remove(SNAPSHOT);
+    remove(JOURNAL);
+
+    // a database that is never saved completely
+    Database reference(voc, di == 1, 1);
+    {
+      Database db(voc, di == 1, 1);
+      db.openJournal(JOURNAL);
+      for(size_t i = 0; i < 3; ++i)
+      {
+        db.add(features[i]);
+        reference.add(features[i]);
+      }
+
+      // the checkpoint empties the journal
+      const long journal = fileSize(JOURNAL);
+      db.checkpoint(SNAPSHOT);
+      TEST_CHECK(fileSize(JOURNAL) < journal);
+      TEST_CHECK((long)db.getJournal()->bytes() == fileSize(JOURNAL));
+
+      for(size_t i = 3; i < features.size(); ++i)
+      {
+        db.add(features[i]);
+        reference.add(features[i]);
+      }
+    }
+    const string state = databaseState(reference, features);
+
+    // recovered from the snapshot and the journal, twice
+    {
+      Database db(voc, di == 1, 1);
+      db.load(SNAPSHOT);
+      TEST_CHECK(db.size() == 3);
+      db.openJournal(JOURNAL);
+      TEST_CHECK(databaseState(db, features) == state);
+      db.openJournal(JOURNAL);
+      TEST_CHECK(databaseState(db, features) == state);
+
+      // and continued
+      db.add(features[0]);
+    }
+    reference.add(features[0]);
+    const string continued = databaseState(reference, features);
+    {
+      Database db(voc, di == 1, 1);
+      db.load(SNAPSHOT);
+      db.openJournal(JOURNAL);
+      TEST_CHECK(databaseState(db, features) == continued);
+    }
+
+    // a torn last entry is dropped, and cut so that the journal goes on
+    const long full = fileSize(JOURNAL);
+    {
+      ifstream in(JOURNAL, ios::binary);
+      vector<char> data((istreambuf_iterator<char>(in)),
+        istreambuf_iterator<char>());
+      ofstream out(TORN, ios::binary);
+      out.write(data.data(), data.size() - 5);
+    }
+    {
+      Database db(voc, di == 1, 1);
+      db.load(SNAPSHOT);
+      db.openJournal(TORN);
+      TEST_CHECK(db.size() == reference.size() - 1);
+      TEST_CHECK(fileSize(TORN) < full - 5);
+      db.add(features[0]);
+    }
+    {
+      Database db(voc, di == 1, 1);
+      db.load(SNAPSHOT);
+      db.openJournal(TORN);
+      TEST_CHECK(databaseState(db, features) == continued);
+    }
+
+    // a checkpoint interrupted after the snapshot was replaced, with the
+    // journal not emptied yet
+    {
+      Database db(voc, di == 1, 1);
+      db.load(SNAPSHOT);
+      db.openJournal(JOURNAL);
+      db.saveBinary(SNAPSHOT, true);
+    }
+    {
+      Database db(SNAPSHOT);
+      db.openJournal(JOURNAL);
+      TEST_CHECK(databaseState(db, features) == continued);
+    }
+
+    // journals of other vocabularies or parameters, or that do not 
+    // continue the database, or that are not journals
+    Database wrong_voc(other, di == 1, 1), wrong_di(voc, di == 0, 1),
+      wrong_levels(voc, di == 1, 2), gap(voc, di == 1, 1), wrong_file(voc);
+    TEST_THROWS(wrong_voc.openJournal(JOURNAL));
+    TEST_THROWS(wrong_di.openJournal(JOURNAL));
+    if(di) TEST_THROWS(wrong_levels.openJournal(JOURNAL));
+    TEST_THROWS(gap.openJournal(JOURNAL));
+    TEST_THROWS(wrong_file.openJournal(SNAPSHOT));
+
+    // copies do not write the journal, and clear closes it
+    Database db(voc, di == 1, 1);
+    db.load(SNAPSHOT);
+    db.openJournal(JOURNAL, true);
+    Database copy(db);
+    TEST_CHECK(copy.getJournal() == NULL && db.getJournal() != NULL);
+    db.clear();
+    TEST_CHECK(db.getJournal() == NULL);
+  }
+
+  remove(SNAPSHOT);
+  remove(JOURNAL);
+  remove(TORN);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 500, 20, raw);
+
+  testDatabase<FORB::TDescriptor, FORB>(raw);
+  testDatabase<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testDatabaseJournal");
+}
@@ -0,0 +1,245 @@
+/**
+ * File: testEntryRemoval.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the removal of database entries, the compaction of
+ *   the indexes and the renumbering of the entries
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <string>
+#include <set>
+#include <algorithm>
+#include <sstream>
+#include <cstdio>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+static const char *SNAPSHOT = "testEntryRemoval.dbdb";
+static const char *JOURNAL = "testEntryRemoval.log";
+
+// ----------------------------------------------------------------------------
+
+/**
+ * Returns the results of some queries, with the ids of the entries mapped
+ * @param db
+ * @param queries features of each query
+ * @param ids if given, id to report for each entry id of the results
+ * @return description
+ */
+template<class TDescriptor, class F>
+string queryResults(const TemplatedDatabase<TDescriptor, F> &db,
+  const vector<vector<TDescriptor> > &queries, const vector<EntryId> *ids)
+{
+  ostringstream s;
+  s.precision(17);
+  for(size_t i = 0; i < queries.size(); ++i)
+  {
+    for(int k : { 0, 1, 3 })
+    {
+      QueryResults ret;
+      db.query(queries[i], ret, k);
+      for(size_t j = 0; j < ret.size(); ++j)
+        s << (ids ? (*ids)[ret[j].Id] : ret[j].Id) << ":" << ret[j].Score
+          << " ";
+      s << "\n";
+    }
+  }
+  return s.str();
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testRemoval(const TemplatedVocabulary<TDescriptor, F> &voc,
+  const vector<vector<TDescriptor> > &features, bool di)
+{
+  typedef TemplatedDatabase<TDescriptor, F> Database;
+
+  // a database without the removed entries
+  const set<EntryId> removed = { 0, 3, 4, 9 };
+  Database db(voc, di, 1), kept(voc, di, 1);
+  vector<EntryId> kept_ids;
+  for(size_t i = 0; i < features.size(); ++i)
+  {
+    db.add(features[i]);
+    if(removed.count(i) == 0)
+    {
+      kept.add(features[i]);
+      kept_ids.push_back(i);
+    }
+  }
+  for(set<EntryId>::const_iterator it = removed.begin(); it != removed.end();
+    ++it) db.remove(*it);
+
+  TEST_THROWS(db.remove(3));
+  TEST_THROWS(db.remove(features.size()));
+  TEST_CHECK(db.removedSize() == removed.size() && db.isRemoved(4) &&
+    !db.isRemoved(5) && db.size() == features.size());
+
+  // queries skip the removed entries, with the scores of the database
+  // without them
+  const string expected = queryResults(kept, features, &kept_ids);
+  TEST_CHECK(queryResults(db, features, NULL) == expected);
+
+  // snapshots keep the removals
+  db.saveBinary(SNAPSHOT, false);
+  Database loaded(voc, di, 1);
+  loaded.load(SNAPSHOT);
+  TEST_CHECK(databaseState(loaded, features) ==
+    databaseState(db, features));
+
+  // compaction keeps the ids
+  Database compacted(db);
+  typename Database::IdMap ids;
+  compacted.compact(false, &ids);
+  TEST_CHECK(ids.size() == features.size() &&
+    ids[3] == Database::REMOVED_ENTRY && ids[5] == 5);
+  TEST_CHECK(queryResults(compacted, features, NULL) == expected);
+  TEST_CHECK(!di || compacted.retrieveFeatures(3).empty());
+  TEST_CHECK(compacted.size() == features.size() &&
+    compacted.removedSize() == removed.size());
+  compacted.compact();
+  TEST_CHECK(queryResults(compacted, features, NULL) == expected);
+
+  // renumbering gives the database without the removed entries
+  Database renumbered(db);
+  renumbered.compact(true, &ids);
+  bool mapped = true;
+  for(size_t i = 0; i < features.size(); ++i)
+    mapped = mapped && ids[i] == (removed.count(i) ? Database::REMOVED_ENTRY :
+      (EntryId)(find(kept_ids.begin(), kept_ids.end(), i) -
+        kept_ids.begin()));
+  TEST_CHECK(mapped);
+  TEST_CHECK(databaseState(renumbered, features) ==
+    databaseState(kept, features));
+  renumbered.add(features[0]);
+  kept.add(features[0]);
+  TEST_CHECK(databaseState(renumbered, features) ==
+    databaseState(kept, features));
+
+  // a compaction prepared apart is refused if the database changed since
+  Database prepared(db);
+  typename Database::Compaction c;
+  prepared.prepareCompaction(c, true);
+  Database changed(prepared);
+  changed.add(features[1]);
+  TEST_THROWS(changed.applyCompaction(c));
+  prepared.applyCompaction(c);
+  kept.remove(kept.size() - 1);
+  kept.compact(true);
+  TEST_CHECK(databaseState(prepared, features) ==
+    databaseState(kept, features));
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testJournal(const TemplatedVocabulary<TDescriptor, F> &voc,
+  const vector<vector<TDescriptor> > &features, bool di)
+{
+  typedef TemplatedDatabase<TDescriptor, F> Database;
+
+  remove(SNAPSHOT);
+  remove(JOURNAL);
+
+  // removals are replayed from the journal
+  Database reference(voc, di, 1);
+  {
+    Database db(voc, di, 1);
+    db.openJournal(JOURNAL);
+    for(size_t i = 0; i < 4; ++i)
+    {
+      db.add(features[i]);
+      reference.add(features[i]);
+    }
+    db.remove(1);
+    reference.remove(1);
+    db.checkpoint(SNAPSHOT);
+    for(size_t i = 4; i < features.size(); ++i)
+    {
+      db.add(features[i]);
+      reference.add(features[i]);
+    }
+    db.remove(2);
+    reference.remove(2);
+
+    // the journal could not be replayed after renumbering
+    TEST_THROWS(db.compact(true));
+    db.compact();
+    reference.compact();
+  }
+  {
+    Database db(voc, di, 1);
+    db.load(SNAPSHOT);
+    TEST_CHECK(db.removedSize() == 1);
+    db.openJournal(JOURNAL);
+    TEST_CHECK(queryResults(db, features, NULL) ==
+      queryResults(reference, features, NULL));
+
+    // compactions are not logged
+    db.compact();
+    TEST_CHECK(databaseState(db, features) ==
+      databaseState(reference, features));
+  }
+
+  // a journal written before renumbering is refused
+  {
+    Database db(voc, di, 1);
+    db.load(SNAPSHOT);
+    db.compact(true);
+    db.saveBinary(SNAPSHOT, false);
+  }
+  Database renumbered(voc, di, 1);
+  renumbered.load(SNAPSHOT);
+  const string state = databaseState(renumbered, features);
+  TEST_THROWS(renumbered.openJournal(JOURNAL));
+  TEST_CHECK(databaseState(renumbered, features) == state);
+
+  remove(SNAPSHOT);
+  remove(JOURNAL);
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testDatabase(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+
+  Vocabulary voc(9, 3, TF_IDF, L1_NORM);
+  srand(24);
+  voc.create(features);
+
+  const ScoringType scorings[] = { L1_NORM, L2_NORM, CHI_SQUARE, KL,
+    BHATTACHARYYA, DOT_PRODUCT };
+  for(int s = 0; s < 6; ++s)
+  {
+    voc.setScoringType(scorings[s]);
+    testRemoval(voc, features, false);
+    testRemoval(voc, features, true);
+  }
+  testJournal(voc, features, false);
+  testJournal(voc, features, true);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(12, 300, 24, raw);
+
+  testDatabase<FORB::TDescriptor, FORB>(raw);
+  testDatabase<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testEntryRemoval");
+}
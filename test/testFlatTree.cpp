@@ -0,0 +1,91 @@
+/**
+ * File: testFlatTree.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks that the compiled tree of the vocabulary finds the
+ *   same words and nodes as the descent of the node tree
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <cstdio>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+/// Vocabulary whose compiled tree can be dropped, so that transform
+/// descends the node tree
+template<class TDescriptor, class F>
+class NodeTreeVocabulary: public TemplatedVocabulary<TDescriptor, F>
+{
+public:
+  NodeTreeVocabulary(const TemplatedVocabulary<TDescriptor, F> &voc)
+    : TemplatedVocabulary<TDescriptor, F>(voc)
+  {
+    this->m_flat_nodes.clear();
+    this->m_flat_descriptors.clear();
+    this->m_flat_buffer = cv::Mat();
+  }
+};
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+
+  Vocabulary voc(9, 3, TF_IDF, L1_NORM);
+  srand(1);
+  voc.create(features);
+  NodeTreeVocabulary<TDescriptor, F> reference(voc);
+
+  for(size_t i = 0; i < features.size(); ++i)
+  {
+    for(int levelsup = 0; levelsup <= 3; ++levelsup)
+    {
+      BowVector v1, v2;
+      FeatureVector fv1, fv2;
+      voc.transform(features[i], v1, fv1, levelsup);
+      reference.transform(features[i], v2, fv2, levelsup);
+      TEST_CHECK(v1 == v2);
+      TEST_CHECK(fv1 == fv2);
+    }
+  }
+
+  // the copies and the loaded vocabularies compile their tree too
+  Vocabulary copy(voc);
+  voc.saveBinary("testFlatTree.dbow2");
+  Vocabulary loaded("testFlatTree.dbow2");
+  for(size_t i = 0; i < features.size(); ++i)
+  {
+    BowVector v1, v2, v3;
+    voc.transform(features[i], v1);
+    copy.transform(features[i], v2);
+    loaded.transform(features[i], v3);
+    TEST_CHECK(v1 == v2);
+    TEST_CHECK(v1 == v3);
+  }
+  remove("testFlatTree.dbow2");
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 500, 1, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testFlatTree");
+}
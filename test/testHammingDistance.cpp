@@ -0,0 +1,126 @@
+/**
+ * File: testHammingDistance.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the Hamming distance kernel selected for this CPU
+ *   against a bit by bit count
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <random>
+
+#include "HammingDistance.h"
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+/// Distance between two descriptors, counted bit by bit
+int referenceDistance(const unsigned char *a, const unsigned char *b,
+  int bytes)
+{
+  int d = 0;
+  for(int i = 0; i < bytes; ++i)
+    for(int bit = 0; bit < 8; ++bit)
+      if(((a[i] ^ b[i]) >> bit) & 1) ++d;
+  return d;
+}
+
+// ----------------------------------------------------------------------------
+
+void testKernel(int bytes, size_t stride, size_t offset, mt19937 &engine)
+{
+  const int N = 70;
+  vector<unsigned char> buffer(offset + N * stride);
+  vector<unsigned char> a(bytes);
+  for(size_t i = 0; i < buffer.size(); ++i) buffer[i] = engine() & 0xff;
+  for(int i = 0; i < bytes; ++i) a[i] = engine() & 0xff;
+
+  // some extreme distances: equal and complementary descriptors
+  const unsigned char *b = &buffer[offset];
+  std::copy(a.begin(), a.end(), buffer.begin() + offset);
+  for(int i = 0; i < bytes; ++i) buffer[offset + stride + i] = ~a[i];
+
+  vector<const unsigned char *> pointers(N);
+  for(int i = 0; i < N; ++i) pointers[i] = b + i * stride;
+
+  // every length, so that the vectorized loops and their tails are run
+  for(int n = 0; n <= N; ++n)
+  {
+    vector<int> d1(n + 1, -1), d2(n + 1, -1);
+    HammingDistance::distances(a.data(), b, stride, n, bytes, d1.data());
+    HammingDistance::distances(a.data(), pointers.data(), n, bytes,
+      d2.data());
+
+    bool ok = true;
+    for(int i = 0; i < n; ++i)
+    {
+      const int d = referenceDistance(a.data(), pointers[i], bytes);
+      ok = ok && d1[i] == d && d2[i] == d;
+    }
+    TEST_CHECK(ok);
+    TEST_CHECK(d1[n] == -1 && d2[n] == -1); // nothing written after n
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+void testDescriptorClasses(mt19937 &engine)
+{
+  const int N = 37;
+  vector<unsigned char> buffer(N * FORB::L);
+  for(size_t i = 0; i < buffer.size(); ++i) buffer[i] = engine() & 0xff;
+
+  vector<const unsigned char *> pointers(N);
+  for(int i = 0; i < N; ++i) pointers[i] = &buffer[i * FORB::L];
+
+  vector<cv::Mat> orb(N);
+  vector<FBrief::TDescriptor> brief(N);
+  for(int i = 0; i < N; ++i)
+  {
+    FORB::fromArray8U(orb[i], pointers[i]);
+    FBrief::fromArray8U(brief[i], pointers[i]);
+  }
+
+  vector<double> d1(N), d2(N), d3(N), d4(N);
+  FORB::distances(orb[0], orb.data(), N, d1.data());
+  FORB::distances8U(pointers[0], buffer.data(), FORB::L, N, d2.data());
+  FBrief::distances(brief[0], brief.data(), N, d3.data());
+  FBrief::distances8U(pointers[0], pointers.data(), N, d4.data());
+
+  for(int i = 0; i < N; ++i)
+  {
+    const double d = referenceDistance(pointers[0], pointers[i], FORB::L);
+    TEST_CHECK(d1[i] == d && d2[i] == d && d3[i] == d && d4[i] == d);
+    TEST_CHECK(FORB::distance(orb[0], orb[i]) == d);
+    TEST_CHECK(FBrief::distance(brief[0], brief[i]) == d);
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  cout << "Hamming distance implementation: "
+    << HammingDistance::implementation() << endl;
+
+  mt19937 engine(2);
+
+  // packed, padded and unaligned descriptors
+  testKernel(32, 32, 0, engine);
+  testKernel(32, 48, 0, engine);
+  testKernel(32, 32, 1, engine);
+  testKernel(32, 33, 3, engine);
+
+  // lengths without a vectorized version
+  testKernel(64, 64, 0, engine);
+  testKernel(8, 24, 5, engine);
+
+  testDescriptorClasses(engine);
+
+  return testResult("testHammingDistance");
+}
@@ -0,0 +1,112 @@
+/**
+ * File: testInvertedIndex.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the scores of the database queries against the
+ *   scores of the vocabulary, for every scoring type
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <string>
+#include <cmath>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+/**
+ * Checks the results of the queries of a database against the scores of
+ * its vocabulary between the query and each entry
+ * @param db
+ * @param entries bow vector of each entry
+ * @param queries features of each query
+ * @return true iff all the results are right
+ */
+bool rightResults(const OrbDatabase &db, const vector<BowVector> &entries,
+  const vector<vector<FORB::TDescriptor> > &queries)
+{
+  const OrbVocabulary &voc = *db.getVocabulary();
+  // KL is a divergence: the lower, the better
+  const double sign = (voc.getScoringType() == KL ? -1 : 1);
+  bool right = true;
+  for(size_t q = 0; right && q < queries.size(); ++q)
+  {
+    BowVector v;
+    voc.transform(queries[q], v);
+
+    for(int max_id : { -1, 7 })
+    {
+      // the entries with words in common, best first
+      QueryResults ret;
+      db.query(queries[q], ret, 0, max_id);
+
+      vector<bool> returned(entries.size(), false);
+      for(size_t i = 0; right && i < ret.size(); ++i)
+      {
+        const double score = voc.score(v, entries[ret[i].Id]);
+        right = fabs(ret[i].Score - score) < 1e-6 &&
+          (max_id == -1 || (int)ret[i].Id < max_id) &&
+          (i == 0 || sign * ret[i - 1].Score >= sign * ret[i].Score);
+        returned[ret[i].Id] = true;
+      }
+
+      for(size_t e = 0; right && e < entries.size(); ++e)
+      {
+        if(returned[e] || (max_id != -1 && (int)e >= max_id)) continue;
+        bool common = false;
+        for(BowVector::const_iterator it = v.begin(); !common &&
+          it != v.end(); ++it) common = entries[e].count(it->first) > 0;
+        right = !common;
+      }
+    }
+  }
+  return right;
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(20, 300, 21, raw);
+  vector<vector<FORB::TDescriptor> > features;
+  toDescriptors<FORB>(raw, features);
+  const vector<vector<FORB::TDescriptor> > training(features.begin(),
+    features.begin() + 8);
+
+  const ScoringType scorings[] = { L1_NORM, L2_NORM, CHI_SQUARE, KL,
+    BHATTACHARYYA, DOT_PRODUCT };
+  const WeightingType weightings[] = { TF_IDF, TF, IDF, BINARY };
+
+  for(int s = 0; s < 6; ++s)
+  for(int w = 0; w < 4; ++w)
+  {
+    OrbVocabulary voc(6, 3, weightings[w], scorings[s]);
+    srand(21);
+    voc.create(training);
+
+    for(int di = 0; di < 2; ++di)
+    {
+      OrbDatabase db(voc, di == 1, 1);
+      if(di) db.allocate(20, 300);
+      vector<BowVector> entries(features.size());
+      for(size_t i = 0; i < features.size(); ++i)
+        db.add(features[i], &entries[i]);
+      TEST_CHECK(rightResults(db, entries, features));
+
+      // copies have the same rows
+      OrbDatabase copy(db), assigned;
+      assigned = db;
+      const string state = databaseState(db, features);
+      TEST_CHECK(databaseState(copy, features) == state);
+      TEST_CHECK(databaseState(assigned, features) == state);
+    }
+  }
+
+  return testResult("testInvertedIndex");
+}
@@ -0,0 +1,147 @@
+/**
+ * File: testMajorityVote.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the bit-sliced counts and majorities, and the means
+ *   of the binary descriptors, against bit by bit counts
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <random>
+
+#include "MajorityVote.h"
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+/// Number of descriptors with each bit set, bit j being bit 7 - j % 8 of
+/// byte j / 8
+vector<int> referenceCounts(const vector<const unsigned char *> &d, int n,
+  int bytes)
+{
+  vector<int> counts(bytes * 8, 0);
+  for(int i = 0; i < n; ++i)
+    for(int j = 0; j < bytes * 8; ++j)
+      if((d[i][j / 8] >> (7 - j % 8)) & 1) ++counts[j];
+  return counts;
+}
+
+// ----------------------------------------------------------------------------
+
+/// Descriptor with the bits set whose counts reach the threshold
+vector<unsigned char> referenceMajority(const vector<int> &counts,
+  int threshold)
+{
+  vector<unsigned char> result(counts.size() / 8, 0);
+  for(size_t j = 0; j < counts.size(); ++j)
+    if(counts[j] >= threshold) result[j / 8] |= 1 << (7 - j % 8);
+  return result;
+}
+
+// ----------------------------------------------------------------------------
+
+void testVotes(int bytes, mt19937 &engine)
+{
+  // more than 255 descriptors, so that the planes are flushed
+  const int N = 600;
+  vector<unsigned char> buffer(N * bytes);
+  for(size_t i = 0; i < buffer.size(); ++i)
+  {
+    // biased bits, so that the majorities are not all 0 or all 1
+    buffer[i] = engine() & engine() & 0xff;
+    if(i % bytes < (size_t)bytes / 2) buffer[i] = ~buffer[i];
+  }
+
+  vector<const unsigned char *> d(N);
+  for(int i = 0; i < N; ++i) d[i] = &buffer[i * bytes];
+
+  for(int n : { 0, 1, 2, 3, 31, 254, 255, 256, 257, 511, 600 })
+  {
+    const vector<int> expected = referenceCounts(d, n, bytes);
+
+    vector<int> counts(bytes * 8, -1);
+    MajorityVote::count(d.data(), n, bytes, counts.data());
+    TEST_CHECK(counts == expected);
+
+    // counts added in two steps
+    vector<int> added(bytes * 8, 0);
+    MajorityVote::add(d.data(), n / 3, bytes, added.data());
+    MajorityVote::add(d.data() + n / 3, n - n / 3, bytes, added.data());
+    TEST_CHECK(added == expected);
+
+    for(int threshold : { 1, n / 2, n / 2 + 1, n })
+    {
+      vector<unsigned char> m1(bytes), m2(bytes);
+      MajorityVote::majority(d.data(), n, bytes, threshold, m1.data());
+      MajorityVote::majority(expected.data(), bytes, threshold, m2.data());
+      const vector<unsigned char> m = referenceMajority(expected, threshold);
+      TEST_CHECK(m1 == m && m2 == m);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+void testMeans(mt19937 &engine)
+{
+  vector<unsigned char> buffer(301 * 32);
+  for(size_t i = 0; i < buffer.size(); ++i) buffer[i] = engine() & 0xff;
+
+  for(int n : { 1, 2, 5, 300, 301 })
+  {
+    vector<const unsigned char *> d(n);
+    vector<cv::Mat> orb(n);
+    vector<FBrief::TDescriptor> brief(n);
+    vector<FORB::pDescriptor> porb(n);
+    vector<FBrief::pDescriptor> pbrief(n);
+    for(int i = 0; i < n; ++i)
+    {
+      d[i] = &buffer[i * 32];
+      FORB::fromArray8U(orb[i], d[i]);
+      FBrief::fromArray8U(brief[i], d[i]);
+      porb[i] = &orb[i];
+      pbrief[i] = &brief[i];
+    }
+    const vector<int> counts = referenceCounts(d, n, 32);
+
+    // ORB sets the bits of at least half of the descriptors, rounded up
+    const vector<unsigned char> orb_mean =
+      referenceMajority(counts, n / 2 + n % 2);
+    cv::Mat m1;
+    vector<unsigned char> m2(32), m3(32), m4(32);
+    FORB::meanValue(porb, m1);
+    FORB::toArray8U(m1, m2.data());
+    FORB::meanValue8U(d, m3.data());
+    FORB::meanValueCounts8U(counts.data(), n, m4.data());
+    TEST_CHECK(m2 == orb_mean && m3 == orb_mean && m4 == orb_mean);
+
+    // BRIEF sets the bits of more than half of them
+    const vector<unsigned char> brief_mean = referenceMajority(counts,
+      n / 2 + 1);
+    FBrief::TDescriptor b1;
+    vector<unsigned char> b2(32), b3(32);
+    FBrief::meanValue(pbrief, b1);
+    FBrief::toArray8U(b1, b2.data());
+    FBrief::meanValue8U(d, b3.data());
+    TEST_CHECK(b2 == brief_mean && b3 == brief_mean);
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  mt19937 engine(9);
+
+  testVotes(32, engine);
+  testVotes(8, engine);
+  testVotes(61, engine);
+  testMeans(engine);
+
+  return testResult("testMajorityVote");
+}
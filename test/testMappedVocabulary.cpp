@@ -0,0 +1,142 @@
+/**
+ * File: testMappedVocabulary.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks that the vocabularies mapped from binary files work
+ *   as the vocabularies loaded from them
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <string>
+#include <cstdio>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+static const char *FILENAME = "testMappedVocabulary.dbow2";
+
+// ----------------------------------------------------------------------------
+
+/// Whether a mapped vocabulary has the words and transforms of another one
+template<class TDescriptor, class F>
+bool sameVocabulary(const TemplatedVocabulary<TDescriptor, F> &voc,
+  const TemplatedMappedVocabulary<TDescriptor, F> &mapped,
+  const vector<vector<TDescriptor> > &features)
+{
+  bool same = voc.size() == mapped.size() &&
+    voc.getBranchingFactor() == mapped.getBranchingFactor() &&
+    voc.getDepthLevels() == mapped.getDepthLevels() &&
+    voc.getScoringType() == mapped.getScoringType() &&
+    voc.getWeightingType() == mapped.getWeightingType();
+
+  vector<unsigned char> a(F::BYTES), b(F::BYTES);
+  vector<WordId> wa, wb;
+  for(WordId w = 0; same && w < voc.size(); ++w)
+  {
+    F::toArray8U(voc.getWord(w), a.data());
+    F::toArray8U(mapped.getWord(w), b.data());
+    voc.getWordsFromNode(voc.getParentNode(w, 2), wa);
+    mapped.getWordsFromNode(mapped.getParentNode(w, 2), wb);
+    same = a == b && wa == wb &&
+      voc.getWordWeight(w) == mapped.getWordWeight(w);
+  }
+
+  for(size_t i = 0; same && i < features.size(); ++i)
+  {
+    for(int levelsup = 0; same && levelsup < 4; ++levelsup)
+    {
+      BowVector va, vb;
+      FeatureVector fa, fb;
+      voc.transform(features[i], va, fa, levelsup);
+      mapped.transform(features[i], vb, fb, levelsup);
+      same = (va == vb && fa == fb);
+    }
+    for(size_t j = 0; same && j < features[i].size(); ++j)
+      same = voc.transform(features[i][j]) == mapped.transform(features[i][j]);
+  }
+  return same;
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+  typedef TemplatedMappedVocabulary<TDescriptor, F> MappedVocabulary;
+  typedef TemplatedDatabase<TDescriptor, F> Database;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+
+  Vocabulary voc(9, 3, TF_IDF, L1_NORM);
+  srand(17);
+  voc.create(features);
+  voc.saveBinary(FILENAME);
+
+  MappedVocabulary mapped(FILENAME, true);
+  TEST_CHECK(sameVocabulary(voc, mapped, features));
+  TEST_CHECK(binaryData(mapped) == binaryData(voc));
+  TEST_CHECK(mapped.getBinaryHash() == voc.getBinaryHash());
+
+  // raw rows, as the descriptor objects
+  BowVector va, vb;
+  voc.transform(raw[0].data(), (int)raw[0].size() / F::BYTES, F::BYTES, va);
+  mapped.transform(raw[0].data(), (int)raw[0].size() / F::BYTES, F::BYTES,
+    vb);
+  TEST_CHECK(!va.empty() && va == vb);
+
+  // copies share the mapping, and outlive the original
+  MappedVocabulary *copy = new MappedVocabulary(mapped);
+  MappedVocabulary *clone = copy->clone();
+  delete copy;
+  TEST_CHECK(sameVocabulary(voc, *clone, features));
+
+  // the same database results
+  Database db(voc, false), mapped_db(*clone, false);
+  delete clone;
+  for(size_t i = 0; i < features.size(); ++i)
+  {
+    db.add(features[i]);
+    mapped_db.add(features[i]);
+  }
+  bool same = true;
+  for(size_t i = 0; i < features.size(); ++i)
+  {
+    QueryResults a, b;
+    db.query(features[i], a, 0);
+    mapped_db.query(features[i], b, 0);
+    same = same && a.size() == b.size();
+    for(size_t j = 0; same && j < a.size(); ++j)
+      same = a[j].Id == b[j].Id && a[j].Score == b[j].Score;
+  }
+  TEST_CHECK(same);
+
+  // read-only
+  TEST_THROWS(mapped.stopWords(1));
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 17, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  // damaged files are refused
+  FILE *f = fopen(FILENAME, "wb");
+  fputs("DBVB", f);
+  fclose(f);
+  TEST_THROWS(OrbMappedVocabulary mapped(FILENAME));
+  remove(FILENAME);
+  TEST_THROWS(OrbMappedVocabulary mapped(FILENAME));
+
+  return testResult("testMappedVocabulary");
+}
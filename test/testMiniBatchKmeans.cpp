@@ -0,0 +1,138 @@
+/**
+ * File: testMiniBatchKmeans.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the vocabularies created with mini-batch kmeans, and
+ *   that the vocabularies and databases can be explicitly instantiated for
+ *   descriptors without raw data
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <random>
+
+#include "FSurf64.h"
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// every member must compile for every F
+namespace DBoW2 {
+template class TemplatedVocabulary<FSurf64::TDescriptor, FSurf64>;
+template class TemplatedDatabase<FSurf64::TDescriptor, FSurf64>;
+}
+
+// ----------------------------------------------------------------------------
+
+TrainingOptions miniBatchOptions()
+{
+  TrainingOptions options;
+  options.clustering = MINI_BATCH_KMEANS;
+  options.batch_size = 300;
+  options.max_iterations = 30;
+  return options;
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+  PackedDescriptors packed(F::BYTES);
+  toPacked(raw, packed);
+
+  Vocabulary kmeans(9, 3, TF_IDF, L1_NORM);
+  srand(6);
+  kmeans.create(features);
+
+  Vocabulary voc(9, 3, TF_IDF, L1_NORM);
+  voc.setTrainingOptions(miniBatchOptions());
+  srand(6);
+  voc.create(features);
+  const vector<unsigned char> expected = binaryData(voc);
+
+  // the same with threads and from packed descriptors
+  ThreadPool pool(3);
+  Vocabulary threaded(9, 3, TF_IDF, L1_NORM);
+  threaded.setTrainingOptions(miniBatchOptions());
+  threaded.setThreadPool(&pool);
+  srand(6);
+  threaded.create(features);
+  TEST_CHECK(binaryData(threaded) == expected);
+
+  Vocabulary from_packed(9, 3, TF_IDF, L1_NORM);
+  from_packed.setTrainingOptions(miniBatchOptions());
+  srand(6);
+  from_packed.create(packed);
+  TEST_CHECK(binaryData(from_packed) == expected);
+
+  // the words are about as good as those of kmeans
+  WordOccupancy a, b;
+  kmeans.computeOccupancy(features, a);
+  voc.computeOccupancy(features, b);
+  TEST_CHECK(voc.size() > 500);
+  TEST_CHECK(b.mean_distance < 1.2 * a.mean_distance);
+}
+
+// ----------------------------------------------------------------------------
+
+void testFloatDescriptors()
+{
+  typedef TemplatedVocabulary<FSurf64::TDescriptor, FSurf64> Vocabulary;
+
+  mt19937 engine(6);
+  uniform_real_distribution<float> value(-1, 1);
+  vector<vector<FSurf64::TDescriptor> > features(4);
+  for(size_t i = 0; i < features.size(); ++i)
+  {
+    features[i].resize(300, FSurf64::TDescriptor(FSurf64::L));
+    for(size_t j = 0; j < features[i].size(); ++j)
+      for(int k = 0; k < FSurf64::L; ++k) features[i][j][k] = value(engine);
+  }
+
+  // the running means are kept with F::weightedMeanValue
+  Vocabulary voc(5, 2, TF_IDF, L1_NORM), threaded(5, 2, TF_IDF, L1_NORM);
+  TrainingOptions options = miniBatchOptions();
+  options.batch_size = 100;
+  voc.setTrainingOptions(options);
+  threaded.setTrainingOptions(options);
+  ThreadPool pool(3);
+  threaded.setThreadPool(&pool);
+  srand(6);
+  voc.create(features);
+  srand(6);
+  threaded.create(features);
+
+  TEST_CHECK(voc.size() == 25);
+  bool same = voc.size() == threaded.size();
+  for(WordId i = 0; same && i < voc.size(); ++i)
+    same = voc.getWord(i) == threaded.getWord(i);
+  TEST_CHECK(same);
+
+  // raw descriptors need F::fromArray8U
+  PackedDescriptors packed(32);
+  BowVector v;
+  unsigned char row[32] = { 0 };
+  TEST_THROWS(voc.create(packed));
+  TEST_THROWS(voc.transform(row, 1, 32, v));
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 6, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+  testFloatDescriptors();
+
+  return testResult("testMiniBatchKmeans");
+}
@@ -0,0 +1,111 @@
+/**
+ * File: testPackedTraining.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the packed descriptor buffers and that the
+ *   vocabularies created from them are the ones of the descriptor objects
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <cstring>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+void testBuffer(const vector<vector<unsigned char> > &raw)
+{
+  PackedDescriptors packed(32);
+  toPacked(raw, packed);
+
+  size_t n = 0;
+  bool same = packed.images() == raw.size();
+  for(size_t i = 0; same && i < raw.size(); ++i)
+  {
+    same = packed.imageBegin(i) == n &&
+      packed.imageEnd(i) - n == raw[i].size() / 32 &&
+      (raw[i].empty() || memcmp(packed[n], raw[i].data(), raw[i].size()) == 0);
+    n += raw[i].size() / 32;
+  }
+  TEST_CHECK(same && packed.size() == n);
+
+  // rows of a matrix, and descriptors appended to the last image
+  PackedDescriptors rows(32);
+  rows.add(cv::Mat(2, 32, CV_8U, (void*)raw[0].data()));
+  rows.append(raw[0].data() + 64, 3);
+  TEST_CHECK(rows.images() == 1 && rows.size() == 5);
+  TEST_CHECK(memcmp(rows.data(), raw[0].data(), 5 * 32) == 0);
+  TEST_THROWS(rows.add(cv::Mat(2, 16, CV_8U, (void*)raw[0].data())));
+
+  rows.clear();
+  TEST_CHECK(rows.images() == 0 && rows.size() == 0);
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+  PackedDescriptors packed(F::BYTES);
+  toPacked(raw, packed);
+
+  ThreadPool pool(3);
+  for(int weights = 0; weights < 2; ++weights)
+  {
+    TrainingOptions options;
+    options.transform_weights = (weights == 1);
+
+    Vocabulary reference(9, 3, TF_IDF, L1_NORM);
+    reference.setTrainingOptions(options);
+    srand(8);
+    reference.create(features);
+
+    Vocabulary voc(9, 3, TF_IDF, L1_NORM), threaded(9, 3, TF_IDF, L1_NORM);
+    voc.setTrainingOptions(options);
+    threaded.setTrainingOptions(options);
+    threaded.setThreadPool(&pool);
+    srand(8);
+    voc.create(packed);
+    srand(8);
+    threaded.create(packed);
+
+    TEST_CHECK(binaryData(voc) == binaryData(reference));
+    TEST_CHECK(binaryData(threaded) == binaryData(reference));
+  }
+
+  // the occupancy of the packed images is the one of the objects
+  Vocabulary voc(9, 3, TF_IDF, L1_NORM);
+  srand(8);
+  voc.create(packed);
+
+  WordOccupancy a, b;
+  voc.computeOccupancy(features, a);
+  voc.computeOccupancy(packed, b);
+  TEST_CHECK(a.descriptors == b.descriptors && a.images == b.images);
+  TEST_CHECK(a.max_images == b.max_images && a.gini == b.gini);
+  TEST_CHECK(a.mean_distance == b.mean_distance);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 8, raw);
+  raw.push_back(vector<unsigned char>()); // an empty image
+
+  testBuffer(raw);
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testPackedTraining");
+}
@@ -0,0 +1,120 @@
+/**
+ * File: testParallelSeeding.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the vocabularies created with kmeans|| seeding
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <set>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+/// Vocabulary that checks that the seeds are k distinct training
+/// descriptors
+template<class TDescriptor, class F>
+class CheckedVocabulary: public TemplatedVocabulary<TDescriptor, F>
+{
+public:
+  typedef TemplatedVocabulary<TDescriptor, F> Base;
+
+  CheckedVocabulary(): Base(9, 3, TF_IDF, L1_NORM), wrong_seeds(0){}
+
+  /// Number of nodes with wrong seeds
+  mutable int wrong_seeds;
+
+protected:
+  virtual void initiateClusters(
+    const vector<typename Base::pDescriptor> &descriptors,
+    vector<TDescriptor> &clusters) const
+  {
+    Base::initiateClusters(descriptors, clusters);
+
+    set<vector<unsigned char> > training, seeds;
+    vector<unsigned char> d(F::BYTES);
+    for(size_t i = 0; i < descriptors.size(); ++i)
+    {
+      F::toArray8U(*descriptors[i], d.data());
+      training.insert(d);
+    }
+    for(size_t i = 0; i < clusters.size(); ++i)
+    {
+      F::toArray8U(clusters[i], d.data());
+      if(training.count(d) == 0) ++wrong_seeds;
+      seeds.insert(d);
+    }
+    if(seeds.size() != min<size_t>(training.size(), this->m_k) ||
+      clusters.size() != seeds.size()) ++wrong_seeds;
+  }
+};
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+  PackedDescriptors packed(F::BYTES);
+  toPacked(raw, packed);
+
+  TrainingOptions options;
+  options.seeding = KMEANS_PARALLEL_SEEDING;
+
+  CheckedVocabulary<TDescriptor, F> voc;
+  voc.setTrainingOptions(options);
+  srand(13);
+  voc.create(features);
+  TEST_CHECK(voc.wrong_seeds == 0 && voc.size() > 500);
+  const vector<unsigned char> expected = binaryData(voc);
+
+  // the seeds do not depend on the threads
+  for(int threads : { 2, 5 })
+  {
+    ThreadPool pool(threads);
+    Vocabulary threaded(9, 3, TF_IDF, L1_NORM);
+    threaded.setTrainingOptions(options);
+    threaded.setThreadPool(&pool);
+    srand(13);
+    threaded.create(features);
+    TEST_CHECK(binaryData(threaded) == expected);
+  }
+
+  Vocabulary from_packed(9, 3, TF_IDF, L1_NORM);
+  from_packed.setTrainingOptions(options);
+  srand(13);
+  from_packed.create(packed);
+  TEST_CHECK(binaryData(from_packed) == expected);
+
+  // the words are about as good as those seeded with kmeans++
+  Vocabulary kmeans(9, 3, TF_IDF, L1_NORM);
+  srand(13);
+  kmeans.create(features);
+
+  WordOccupancy a, b;
+  kmeans.computeOccupancy(features, a);
+  voc.computeOccupancy(features, b);
+  TEST_CHECK(b.mean_distance < 1.2 * a.mean_distance);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 13, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testParallelSeeding");
+}
@@ -0,0 +1,65 @@
+/**
+ * File: testParallelTraining.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks that the vocabularies created with a thread pool are
+ *   the same as the ones created without it
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+
+  for(int weights = 0; weights < 2; ++weights)
+  {
+    TrainingOptions options;
+    options.transform_weights = (weights == 1);
+
+    Vocabulary reference(10, 3, TF_IDF, L1_NORM);
+    reference.setTrainingOptions(options);
+    srand(5);
+    reference.create(features);
+    const vector<unsigned char> expected = binaryData(reference);
+
+    TEST_CHECK(reference.size() > 500);
+
+    for(int threads : { 2, 5 })
+    {
+      ThreadPool pool(threads);
+      Vocabulary voc(10, 3, TF_IDF, L1_NORM);
+      voc.setTrainingOptions(options);
+      voc.setThreadPool(&pool);
+      srand(5);
+      voc.create(features);
+      TEST_CHECK(binaryData(voc) == expected);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 5, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testParallelTraining");
+}
@@ -0,0 +1,108 @@
+/**
+ * File: testParallelTransform.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks that the thread pool runs every range once, and that
+ *   the transforms with a thread pool give the same results as without it
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <atomic>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+void testThreadPool()
+{
+  ThreadPool pool(4);
+  TEST_CHECK(pool.size() == 4);
+
+  for(int grain : { 1, 7, 1000 })
+  {
+    vector<atomic<int> > runs(2500);
+    for(size_t i = 0; i < runs.size(); ++i) runs[i] = 0;
+
+    pool.parallelFor(0, runs.size(), grain, [&](int b, int e)
+      {
+        for(int i = b; i < e; ++i) ++runs[i];
+      });
+
+    bool ok = true;
+    for(size_t i = 0; i < runs.size(); ++i) ok = ok && runs[i] == 1;
+    TEST_CHECK(ok);
+  }
+
+  // the exceptions are thrown by the calling thread
+  TEST_THROWS(pool.parallelFor(0, 100, 1, [](int b, int)
+    {
+      if(b == 50) throw string("range 50");
+    }));
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+
+  TemplatedVocabulary<TDescriptor, F> voc(9, 3, TF_IDF, L1_NORM);
+  srand(4);
+  voc.create(features);
+
+  // all the descriptors as one set, large enough to be split among the
+  // threads
+  vector<TDescriptor> all;
+  vector<unsigned char> all_raw;
+  for(size_t i = 0; i < features.size(); ++i)
+  {
+    all.insert(all.end(), features[i].begin(), features[i].end());
+    all_raw.insert(all_raw.end(), raw[i].begin(), raw[i].end());
+  }
+  const int n = all.size();
+
+  BowVector v1, m1;
+  FeatureVector fv1, mfv1;
+  vector<WordId> ids1;
+  voc.transform(all, v1, fv1, 2);
+  voc.transform(all_raw.data(), n, F::BYTES, m1, mfv1, 2, &ids1);
+
+  for(int threads : { 2, 3, 8 })
+  {
+    ThreadPool pool(threads);
+    voc.setThreadPool(&pool);
+
+    BowVector v2, m2;
+    FeatureVector fv2, mfv2;
+    vector<WordId> ids2;
+    voc.transform(all, v2, fv2, 2);
+    voc.transform(all_raw.data(), n, F::BYTES, m2, mfv2, 2, &ids2);
+
+    TEST_CHECK(v2 == v1 && fv2 == fv1);
+    TEST_CHECK(m2 == m1 && mfv2 == mfv1 && ids2 == ids1);
+
+    voc.setThreadPool(NULL);
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  testThreadPool();
+
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 4, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testParallelTransform");
+}
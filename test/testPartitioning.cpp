@@ -0,0 +1,139 @@
+/**
+ * File: testPartitioning.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks that each node of the vocabulary tree is clustered
+ *   with the training descriptors of its subtree, in their original order
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <set>
+#include <algorithm>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+/// Vocabulary that records the descriptors each node is clustered with
+template<class TDescriptor, class F>
+class RecordingVocabulary: public TemplatedVocabulary<TDescriptor, F>
+{
+public:
+  typedef TemplatedVocabulary<TDescriptor, F> Base;
+
+  RecordingVocabulary(): Base(9, 3, TF_IDF, L1_NORM){}
+
+  /// Raw descriptors of each clustered node, in the order they were given
+  mutable vector<vector<vector<unsigned char> > > nodes;
+
+protected:
+  virtual void initiateClusters(
+    const vector<typename Base::pDescriptor> &descriptors,
+    vector<TDescriptor> &clusters) const
+  {
+    nodes.push_back(vector<vector<unsigned char> >(descriptors.size(),
+      vector<unsigned char>(F::BYTES)));
+    for(size_t i = 0; i < descriptors.size(); ++i)
+      F::toArray8U(*descriptors[i], nodes.back()[i].data());
+
+    Base::initiateClusters(descriptors, clusters);
+  }
+};
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void checkNodes(const RecordingVocabulary<TDescriptor, F> &voc,
+  const vector<vector<unsigned char> > &training)
+{
+  // leaf of each training descriptor
+  vector<WordId> leaves(training.size());
+  for(size_t i = 0; i < training.size(); ++i)
+  {
+    TDescriptor d;
+    F::fromArray8U(d, training[i].data());
+    leaves[i] = voc.transform(d);
+  }
+
+  TEST_CHECK(voc.nodes.size() > 10 && voc.nodes[0] == training);
+
+  bool same = true;
+  for(size_t n = 0; same && n < voc.nodes.size(); ++n)
+  {
+    const vector<vector<unsigned char> > &node = voc.nodes[n];
+
+    set<WordId> words;
+    for(size_t i = 0; i < node.size(); ++i)
+    {
+      TDescriptor d;
+      F::fromArray8U(d, node[i].data());
+      words.insert(voc.transform(d));
+    }
+
+    // the deepest node above all the leaves of the descriptors is the one
+    // that was clustered
+    vector<WordId> subtree;
+    for(int up = 0; up <= voc.getDepthLevels(); ++up)
+    {
+      voc.getWordsFromNode(voc.getParentNode(*words.begin(), up), subtree);
+      sort(subtree.begin(), subtree.end());
+      if(includes(subtree.begin(), subtree.end(), words.begin(), words.end()))
+        break;
+    }
+
+    // its descriptors are those of its leaves, in the training order
+    vector<vector<unsigned char> > expected;
+    for(size_t i = 0; i < training.size(); ++i)
+      if(binary_search(subtree.begin(), subtree.end(), leaves[i]))
+        expected.push_back(training[i]);
+    same = (node == expected);
+  }
+  TEST_CHECK(same);
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+  PackedDescriptors packed(F::BYTES);
+  toPacked(raw, packed);
+
+  vector<vector<unsigned char> > training;
+  for(size_t i = 0; i < raw.size(); ++i)
+    for(size_t j = 0; j < raw[i].size(); j += F::BYTES)
+      training.push_back(vector<unsigned char>(raw[i].begin() + j,
+        raw[i].begin() + j + F::BYTES));
+
+  RecordingVocabulary<TDescriptor, F> voc;
+  srand(12);
+  voc.create(features);
+  checkNodes(voc, training);
+
+  // the packed descriptors are partitioned in the same way
+  RecordingVocabulary<TDescriptor, F> from_packed;
+  srand(12);
+  from_packed.create(packed);
+  TEST_CHECK(from_packed.nodes == voc.nodes);
+  TEST_CHECK(binaryData(from_packed) == binaryData(voc));
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 12, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testPartitioning");
+}
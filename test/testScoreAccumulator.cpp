@@ -0,0 +1,130 @@
+/**
+ * File: testScoreAccumulator.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the score accumulators, and that the queries give
+ *   the same results with arrays and with hash tables
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <stdint.h>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+/// Accumulator whose query number can be set
+class StampedAccumulator: public ScoreAccumulator
+{
+public:
+  void setEpoch(uint32_t epoch){ m_epoch = epoch; }
+};
+
+// ----------------------------------------------------------------------------
+
+void testAccumulator()
+{
+  StampedAccumulator acc;
+
+  // an array, whose slots are set to zero in every query
+  for(int query = 0; query < 3; ++query)
+  {
+    acc.reset(100, 1000);
+    TEST_CHECK(acc.isDense() && acc.denseCapacity() >= 1000);
+    acc.at(105).score += 1;
+    acc.at(1099).score += 2;
+    acc.at(105).score += 1;
+    acc.at(105).count++;
+    TEST_CHECK(acc.touched().size() == 2 && acc.at(105).score == 2 &&
+      acc.at(105).count == 1 && acc.at(1099).score == 2);
+    TEST_CHECK(acc.sortTouched()[0] == 105);
+  }
+
+  // the stamps are cleared when the query number wraps around
+  acc.at(200).score = 5;
+  acc.setEpoch(0xffffffff);
+  acc.reset(100, 1000);
+  acc.setEpoch(1);
+  TEST_CHECK(acc.at(200).score == 0 && acc.touched().size() == 1);
+
+  // a hash table for larger databases
+  acc.reset(10, ScoreAccumulator::getMaxDenseEntries() + 1);
+  TEST_CHECK(!acc.isDense());
+  acc.at(12).score += 3;
+  acc.at(11).score += 1;
+  acc.at(12).score += 1;
+  TEST_CHECK(acc.sortTouched()[0] == 11 && acc.at(12).score == 4);
+  acc.reset(10, ScoreAccumulator::getMaxDenseEntries() + 1);
+  TEST_CHECK(acc.at(12).score == 0 && acc.touched().size() == 1);
+
+  // a large array is released only after many smaller queries in a row
+  ScoreAccumulator big;
+  big.reset(0, 100000);
+  for(int i = 0; i < 63; ++i) big.reset(0, 100);
+  TEST_CHECK(big.denseCapacity() >= 100000);
+  big.reset(0, 100000);
+  for(int i = 0; i < 63; ++i) big.reset(0, 100);
+  TEST_CHECK(big.denseCapacity() >= 100000);
+  big.reset(0, 100);
+  TEST_CHECK(big.denseCapacity() == 100);
+  TEST_CHECK(big.at(3).score == 0 && big.touched().size() == 1);
+}
+
+// ----------------------------------------------------------------------------
+
+void testQueries()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(20, 300, 22, raw);
+  vector<vector<FORB::TDescriptor> > features;
+  toDescriptors<FORB>(raw, features);
+
+  const ScoringType scorings[] = { L1_NORM, L2_NORM, CHI_SQUARE, KL,
+    BHATTACHARYYA, DOT_PRODUCT };
+
+  for(int s = 0; s < 6; ++s)
+  {
+    OrbVocabulary voc(6, 3, TF_IDF, scorings[s]);
+    srand(22);
+    voc.create(vector<vector<FORB::TDescriptor> >(features.begin(),
+      features.begin() + 8));
+
+    OrbDatabase db(voc, false);
+    for(size_t i = 0; i < features.size(); ++i) db.add(features[i]);
+
+    const size_t max_dense = ScoreAccumulator::getMaxDenseEntries();
+    const string dense = databaseState(db, features);
+    ScoreAccumulator::setMaxDenseEntries(0);
+    const string sparse = databaseState(db, features);
+    ScoreAccumulator::setMaxDenseEntries(max_dense);
+    TEST_CHECK(sparse == dense);
+
+    // each thread has its own accumulator
+    vector<string> states(4);
+    vector<thread> threads;
+    for(size_t t = 0; t < states.size(); ++t)
+      threads.push_back(thread([&, t]()
+        {
+          states[t] = databaseState(db, features);
+        }));
+    for(size_t t = 0; t < threads.size(); ++t) threads[t].join();
+    TEST_CHECK(states == vector<string>(states.size(), dense));
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  testAccumulator();
+  testQueries();
+
+  return testResult("testScoreAccumulator");
+}
@@ -0,0 +1,281 @@
+/**
+ * File: testSlidingWindow.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the databases of limited capacity, which evict their
+ *   oldest entries
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdio>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+static const char *SNAPSHOT = "testSlidingWindow.dbdb";
+static const char *JOURNAL = "testSlidingWindow.log";
+
+// ----------------------------------------------------------------------------
+
+/// Database that tells the memory of its indexes
+template<class TDescriptor, class F>
+class MeasuredDatabase: public TemplatedDatabase<TDescriptor, F>
+{
+public:
+  typedef TemplatedDatabase<TDescriptor, F> Base;
+
+  template<class T>
+  MeasuredDatabase(const T &voc, bool use_di): Base(voc, use_di, 1){}
+
+  /// Entries the inverted rows have room for
+  size_t rowCapacity() const
+  {
+    size_t n = 0;
+    for(size_t i = 0; i < this->m_ifile.size(); ++i)
+      n += this->m_ifile[i].entries.capacity();
+    return n;
+  }
+
+  /// Entries stored in the direct index
+  size_t directEntries() const
+  {
+    return this->m_dfile.size();
+  }
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ * Returns the results of a query, with the ids of the entries shifted
+ * @param ret results
+ * @param shift added to the ids
+ * @return description
+ */
+string describe(const QueryResults &ret, EntryId shift = 0)
+{
+  ostringstream s;
+  s.precision(17);
+  for(size_t i = 0; i < ret.size(); ++i)
+    s << ret[i].Id + shift << ":" << ret[i].Score << " ";
+  return s.str();
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * Returns the results of a database without capacity for the entries kept
+ * by a window
+ * @param full database with all the entries
+ * @param v query
+ * @param k results
+ * @param first first entry of the window
+ * @return description
+ */
+template<class TDescriptor, class F>
+string windowResults(const TemplatedDatabase<TDescriptor, F> &full,
+  const BowVector &v, int k, EntryId first)
+{
+  QueryResults all, ret;
+  full.query(v, all, 0);
+  for(size_t i = 0; i < all.size(); ++i)
+    if(all[i].Id >= first && (k <= 0 || (int)ret.size() < k))
+      ret.push_back(all[i]);
+  return describe(ret);
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testWindow(const TemplatedVocabulary<TDescriptor, F> &voc,
+  const vector<BowVector> &bv, const vector<FeatureVector> &fv, bool di)
+{
+  typedef TemplatedDatabase<TDescriptor, F> Database;
+
+  // the window returns what the full database returns for its entries
+  Database window(voc, di, 1), full(voc, di, 1);
+  window.setCapacity(5);
+  bool right = true;
+  for(int n = 0; n < 40; ++n)
+  {
+    const size_t i = (n * 7) % bv.size();
+    window.add(bv[i], fv[i]);
+    full.add(bv[i], fv[i]);
+    right = right && window.getFirstEntry() == (EntryId)(n < 5 ? 0 : n - 4);
+
+    for(size_t q = 0; right && q < bv.size(); q += 3)
+    {
+      for(int k : { 0, 2 })
+      {
+        QueryResults ret;
+        window.query(bv[q], ret, k);
+        right = describe(ret) ==
+          windowResults(full, bv[q], k, window.getFirstEntry());
+      }
+    }
+    for(EntryId e = 0; right && di && e < window.size(); ++e)
+      right = (e < window.getFirstEntry() ?
+        window.retrieveFeatures(e).empty() :
+        window.retrieveFeatures(e) == full.retrieveFeatures(e));
+  }
+  TEST_CHECK(right);
+
+  // evicted entries cannot be removed; the removed ones are evicted too
+  const EntryId first = window.getFirstEntry();
+  TEST_THROWS(window.remove(first - 1));
+  window.remove(first + 1);
+  full.remove(first + 1);
+  Database compacted(window);
+  compacted.compact();
+  for(size_t q = 0; q < bv.size(); ++q)
+  {
+    QueryResults a, b;
+    window.query(bv[q], a, 0);
+    compacted.query(bv[q], b, 0);
+    right = right && describe(a) == windowResults(full, bv[q], 0, first) &&
+      describe(b) == describe(a);
+  }
+  TEST_CHECK(right);
+  for(size_t i = 0; i < 8; ++i)
+  {
+    window.add(bv[i], fv[i]);
+    compacted.add(bv[i], fv[i]);
+  }
+  TEST_CHECK(window.removedSize() == 0 && compacted.removedSize() == 0);
+
+  // renumbering starts the window at 0
+  Database renumbered(window);
+  typename Database::IdMap ids;
+  renumbered.compact(true, &ids);
+  const EntryId shift = window.getFirstEntry();
+  TEST_CHECK(renumbered.getFirstEntry() == 0 && renumbered.size() == 5);
+  TEST_CHECK(ids.size() == window.size() && ids[shift] == 0 &&
+    ids[shift + 4] == 4 && ids[shift - 1] == Database::REMOVED_ENTRY);
+  for(size_t q = 0; q < bv.size(); ++q)
+  {
+    QueryResults a, b;
+    window.query(bv[q], a, 0);
+    renumbered.query(bv[q], b, 0);
+    right = right && describe(b, shift) == describe(a);
+  }
+  TEST_CHECK(right);
+
+  // snapshots keep the first entry, and are loaded within the capacity
+  window.saveBinary(SNAPSHOT, false);
+  Database smaller(voc, di, 1), same(voc, di, 1);
+  smaller.setCapacity(3);
+  smaller.load(SNAPSHOT);
+  same.load(SNAPSHOT);
+  TEST_CHECK(smaller.getFirstEntry() == window.size() - 3);
+  TEST_CHECK(same.getFirstEntry() == window.getFirstEntry());
+  same.setCapacity(5);
+  for(size_t i = 0; i < 9; ++i)
+  {
+    same.add(bv[i], fv[i]);
+    window.add(bv[i], fv[i]);
+  }
+  for(size_t q = 0; q < bv.size(); ++q)
+  {
+    QueryResults a, b;
+    window.query(bv[q], a, 3);
+    same.query(bv[q], b, 3);
+    right = right && describe(a) == describe(b);
+  }
+  TEST_CHECK(right);
+  remove(SNAPSHOT);
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testLongSession(const TemplatedVocabulary<TDescriptor, F> &voc,
+  const vector<BowVector> &bv, const vector<FeatureVector> &fv, bool di)
+{
+  remove(SNAPSHOT);
+  remove(JOURNAL);
+
+  // the memory stays flat however many entries are added
+  MeasuredDatabase<TDescriptor, F> window(voc, di);
+  window.setCapacity(50);
+  window.openJournal(JOURNAL);
+  size_t capacity = 0;
+  for(int n = 0; n < 6000; ++n)
+  {
+    window.add(bv[n % bv.size()], fv[n % fv.size()]);
+    if(n == 1000) window.checkpoint(SNAPSHOT);
+    if(n == 3000) capacity = window.rowCapacity();
+  }
+  TEST_CHECK(window.rowCapacity() <= capacity * 3 / 2);
+  TEST_CHECK(window.directEntries() == (di ? 50 : 0));
+
+  // recovered from the snapshot and the journal, within the capacity
+  TemplatedDatabase<TDescriptor, F> recovered(voc, di, 1);
+  recovered.setCapacity(50);
+  recovered.load(SNAPSHOT);
+  recovered.openJournal(JOURNAL);
+  recovered.closeJournal();
+  window.closeJournal();
+  TEST_CHECK(recovered.getFirstEntry() == window.getFirstEntry());
+  bool right = true;
+  for(size_t q = 0; q < bv.size(); ++q)
+  {
+    QueryResults a, b;
+    window.query(bv[q], a, 0);
+    recovered.query(bv[q], b, 0);
+    right = right && describe(a) == describe(b);
+  }
+  TEST_CHECK(right);
+
+  remove(SNAPSHOT);
+  remove(JOURNAL);
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testDatabase(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+
+  Vocabulary voc(9, 3, TF_IDF, L1_NORM);
+  srand(25);
+  voc.create(features);
+
+  // bow vectors normalized for each scoring type
+  const ScoringType scorings[] = { L1_NORM, L2_NORM, CHI_SQUARE, KL,
+    BHATTACHARYYA, DOT_PRODUCT };
+  vector<BowVector> bv(features.size());
+  vector<FeatureVector> fv(features.size());
+  for(int s = 0; s < 6; ++s)
+  {
+    voc.setScoringType(scorings[s]);
+    for(size_t i = 0; i < features.size(); ++i)
+      voc.transform(features[i], bv[i], fv[i], 1);
+
+    testWindow(voc, bv, fv, false);
+    testWindow(voc, bv, fv, true);
+  }
+  testLongSession(voc, bv, fv, false);
+  testLongSession(voc, bv, fv, true);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(12, 300, 25, raw);
+
+  testDatabase<FORB::TDescriptor, FORB>(raw);
+  testDatabase<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testSlidingWindow");
+}
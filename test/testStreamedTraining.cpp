@@ -0,0 +1,123 @@
+/**
+ * File: testStreamedTraining.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the shard files and the vocabularies created from
+ *   descriptors read on demand
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <string>
+#include <cstdio>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+/// Writes the images into two shards
+vector<string> writeShards(const vector<vector<unsigned char> > &raw)
+{
+  vector<string> files;
+  files.push_back("testStreamedTraining.0.shard");
+  files.push_back("testStreamedTraining.1.shard");
+
+  ShardWriter first(files[0], 32), second(files[1], 32);
+  for(size_t i = 0; i < raw.size(); ++i)
+  {
+    ShardWriter &writer = (i < raw.size() / 2 ? first : second);
+    writer.add(raw[i].data(), raw[i].size() / 32);
+  }
+  return files;
+}
+
+// ----------------------------------------------------------------------------
+
+void testShards(const vector<vector<unsigned char> > &raw,
+  const vector<string> &files)
+{
+  ShardReader reader(files, 32);
+  vector<unsigned char> image;
+  for(int pass = 0; pass < 2; ++pass)
+  {
+    reader.rewind();
+    size_t i = 0;
+    bool same = true;
+    while(reader.next(image)) same = same && i < raw.size() &&
+      image == raw[i++];
+    TEST_CHECK(same && i == raw.size());
+  }
+
+  // other descriptor sizes and missing files are refused
+  ShardReader other(files, 64);
+  TEST_THROWS(other.next(image));
+  ShardReader missing(vector<string>(1, "testStreamedTraining.missing"), 32);
+  TEST_THROWS(missing.next(image));
+}
+
+// ----------------------------------------------------------------------------
+
+void testVocabulary(const vector<vector<unsigned char> > &raw,
+  const vector<string> &files)
+{
+  vector<vector<FORB::TDescriptor> > features;
+  toDescriptors<FORB>(raw, features);
+  ShardReader reader(files, 32);
+
+  // if the descriptors fit in memory, the vocabulary is the one created
+  // from the descriptor objects
+  OrbVocabulary reference(9, 3, TF_IDF, L1_NORM);
+  srand(7);
+  reference.create(features);
+
+  OrbVocabulary voc(9, 3, TF_IDF, L1_NORM);
+  srand(7);
+  voc.create(reader);
+  TEST_CHECK(binaryData(voc) == binaryData(reference));
+
+  // otherwise, the nodes are split with samples, and their descriptors are
+  // spilled into temporary files
+  TrainingOptions options;
+  options.max_in_memory = 1500;
+  OrbVocabulary streamed(9, 3, TF_IDF, L1_NORM);
+  streamed.setTrainingOptions(options);
+  srand(7);
+  streamed.create(reader);
+  TEST_CHECK(streamed.size() > 500);
+
+  ThreadPool pool(3);
+  OrbVocabulary threaded(9, 3, TF_IDF, L1_NORM);
+  threaded.setTrainingOptions(options);
+  threaded.setThreadPool(&pool);
+  srand(7);
+  threaded.create(reader);
+  TEST_CHECK(binaryData(threaded) == binaryData(streamed));
+
+  // all the training descriptors are quantized
+  WordOccupancy a, b;
+  reference.computeOccupancy(features, a);
+  streamed.computeOccupancy(features, b);
+  TEST_CHECK(b.descriptors == a.descriptors && b.images == raw.size());
+  TEST_CHECK(b.mean_distance < 1.2 * a.mean_distance);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 7, raw);
+  raw.insert(raw.begin() + 2, vector<unsigned char>()); // an empty image
+
+  const vector<string> files = writeShards(raw);
+  testShards(raw, files);
+  testVocabulary(raw, files);
+
+  for(size_t i = 0; i < files.size(); ++i) remove(files[i].c_str());
+
+  return testResult("testStreamedTraining");
+}
@@ -0,0 +1,121 @@
+/**
+ * File: testTextVocabulary.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks the round trip of the vocabularies in the text 
+ *   format of ORB-SLAM, and that wrong files are refused
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+static const char *FILENAME = "testTextVocabulary.txt";
+
+// ----------------------------------------------------------------------------
+
+/// Contents of the file
+string readFile()
+{
+  ifstream f(FILENAME);
+  stringstream ss;
+  ss << f.rdbuf();
+  return ss.str();
+}
+
+// ----------------------------------------------------------------------------
+
+/// Writes some contents into the file
+void writeFile(const string &text)
+{
+  ofstream f(FILENAME);
+  f << text;
+}
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  typedef TemplatedVocabulary<TDescriptor, F> Vocabulary;
+
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+
+  Vocabulary voc(9, 3, TF_IDF, L1_NORM);
+  srand(18);
+  voc.create(features);
+  voc.saveText(FILENAME);
+  const string text = readFile();
+
+  // the loaded vocabulary is saved in the same way and has the same words
+  Vocabulary loaded;
+  loaded.loadText(FILENAME);
+  loaded.saveText(FILENAME);
+  TEST_CHECK(readFile() == text);
+  TEST_CHECK(loaded.size() == voc.size());
+
+  bool same = true;
+  for(size_t i = 0; same && i < features.size(); ++i)
+  {
+    BowVector a, b;
+    voc.transform(features[i], a);
+    loaded.transform(features[i], b);
+    same = a.size() == b.size();
+    for(BowVector::const_iterator ait = a.begin(), bit = b.begin();
+      same && ait != a.end(); ++ait, ++bit)
+      same = ait->first == bit->first &&
+        fabs(ait->second - bit->second) < 1e-6;
+  }
+  TEST_CHECK(same);
+
+  // parsed in parallel and recognized by load
+  ThreadPool pool(3);
+  Vocabulary threaded, detected;
+  threaded.setThreadPool(&pool);
+  threaded.loadText(FILENAME);
+  detected.load(FILENAME);
+  TEST_CHECK(binaryData(threaded) == binaryData(loaded));
+  TEST_CHECK(binaryData(detected) == binaryData(loaded));
+
+  // blank lines are ignored
+  const size_t first = text.find('\n') + 1;
+  writeFile(text.substr(0, first) + "\n\n" + text.substr(first) + "\n");
+  Vocabulary blank;
+  blank.loadText(FILENAME);
+  TEST_CHECK(binaryData(blank) == binaryData(loaded));
+
+  // wrong files
+  const size_t line = text.find('\n', first) + 1;
+  writeFile(text.substr(0, line) + "x" + text.substr(line));
+  TEST_THROWS(blank.loadText(FILENAME));
+  writeFile("10 6 0\n");
+  TEST_THROWS(blank.loadText(FILENAME));
+  writeFile(text.substr(0, text.size() / 2));
+  TEST_THROWS(blank.loadText(FILENAME));
+  remove(FILENAME);
+  TEST_THROWS(blank.loadText(FILENAME));
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(6, 1000, 18, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testTextVocabulary");
+}
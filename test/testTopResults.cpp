@@ -0,0 +1,68 @@
+/**
+ * File: testTopResults.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks that the queries for the best k results return the
+ *   first k results of the full queries, with ties broken by entry id
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(12, 300, 23, raw);
+  vector<vector<FORB::TDescriptor> > features;
+  toDescriptors<FORB>(raw, features);
+
+  const ScoringType scorings[] = { L1_NORM, L2_NORM, CHI_SQUARE, KL,
+    BHATTACHARYYA, DOT_PRODUCT };
+
+  for(int s = 0; s < 6; ++s)
+  {
+    OrbVocabulary voc(6, 3, TF_IDF, scorings[s]);
+    srand(23);
+    voc.create(features);
+
+    // every image is added twice, so that there are ties
+    OrbDatabase db(voc, false);
+    for(int copy = 0; copy < 2; ++copy)
+      for(size_t i = 0; i < features.size(); ++i) db.add(features[i]);
+
+    bool same = true, ties = true;
+    int tied = 0;
+    for(size_t q = 0; q < features.size(); ++q)
+    for(int max_id : { -1, 17 })
+    {
+      QueryResults all;
+      db.query(features[q], all, 0, max_id);
+      for(size_t i = 1; i < all.size(); ++i)
+        if(all[i - 1].Score == all[i].Score)
+        {
+          ties = ties && all[i - 1].Id < all[i].Id;
+          ++tied;
+        }
+
+      for(int k : { 1, 2, 3, 5, 10, 30 })
+      {
+        QueryResults top;
+        db.query(features[q], top, k, max_id);
+        same = same && top.size() == min(all.size(), (size_t)k);
+        for(size_t i = 0; same && i < top.size(); ++i)
+          same = top[i].Id == all[i].Id && top[i].Score == all[i].Score;
+      }
+    }
+    TEST_CHECK(same && ties && tied > 0);
+  }
+
+  return testResult("testTopResults");
+}
@@ -0,0 +1,93 @@
+/**
+ * File: testTransformMat.cpp
+ * Date: October 2026
+ * Author: Dorian Galvez-Lopez
+ * Description: checks that the descriptors of a cv::Mat or a buffer are
+ *   transformed as the descriptor objects
+ * License: see the LICENSE.txt file
+ *
+ */
+
+#include <vector>
+#include <cstring>
+
+#include "TestUtils.h"
+
+using namespace DBoW2;
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void testVocabulary(const vector<vector<unsigned char> > &raw)
+{
+  vector<vector<TDescriptor> > features;
+  toDescriptors<F>(raw, features);
+
+  TemplatedVocabulary<TDescriptor, F> voc(9, 3, TF_IDF, L1_NORM);
+  srand(3);
+  voc.create(features);
+
+  for(size_t i = 0; i < raw.size(); ++i)
+  {
+    const int n = raw[i].size() / F::BYTES;
+
+    // rows of a matrix, and rows padded to 40 bytes
+    cv::Mat rows(n, F::BYTES, CV_8U, (void*)raw[i].data());
+    vector<unsigned char> padded(n * 40 + 1);
+    for(int j = 0; j < n; ++j)
+      memcpy(&padded[j * 40 + 1], &raw[i][j * F::BYTES], F::BYTES);
+
+    for(int levelsup = 0; levelsup <= 2; ++levelsup)
+    {
+      BowVector v, v1, v2;
+      FeatureVector fv, fv1, fv2;
+      vector<WordId> ids1, ids2;
+      voc.transform(features[i], v, fv, levelsup);
+      voc.transform(rows, v1, fv1, levelsup, &ids1);
+      voc.transform(&padded[1], n, 40, v2, fv2, levelsup, &ids2);
+
+      TEST_CHECK(v1 == v && fv1 == fv);
+      TEST_CHECK(v2 == v && fv2 == fv);
+      TEST_CHECK(ids1 == ids2 && (int)ids1.size() == n);
+    }
+
+    BowVector v, v1;
+    vector<WordId> ids;
+    voc.transform(features[i], v);
+    voc.transform(rows, v1, &ids);
+    TEST_CHECK(v1 == v);
+
+    // the word of each descriptor. Words with weight 0 (in all the 
+    // training images) are not in the bow vectors
+    bool ok = true;
+    for(int j = 0; j < n && ok; j += 17)
+    {
+      BowVector single;
+      voc.transform(vector<TDescriptor>(1, features[i][j]), single);
+      ok = single.empty() || 
+        (single.size() == 1 && single.begin()->first == ids[j]);
+    }
+    TEST_CHECK(ok);
+  }
+
+  // no descriptors
+  BowVector v;
+  FeatureVector fv;
+  vector<WordId> ids(3);
+  voc.transform(cv::Mat(), v, fv, 1, &ids);
+  TEST_CHECK(v.empty() && fv.empty() && ids.empty());
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+  vector<vector<unsigned char> > raw;
+  randomImages(5, 400, 3, raw);
+
+  testVocabulary<FORB::TDescriptor, FORB>(raw);
+  testVocabulary<FBrief::TDescriptor, FBrief>(raw);
+
+  return testResult("testTransformMat");
+}